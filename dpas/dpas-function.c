@@ -68,6 +68,11 @@ jit_function_t dpas_new_function(jit_type_t signature)
 	{
 		dpas_out_of_memory();
 	}
+	if(dpas_optimize_functions)
+	{
+		jit_function_set_optimization_level
+			(func, jit_function_get_max_optimization_level());
+	}
 	function_stack = (jit_function_t *)jit_realloc
 		(function_stack, sizeof(jit_function_t) * (function_stack_size + 1));
 	if(!function_stack)
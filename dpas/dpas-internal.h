@@ -45,6 +45,12 @@ extern long dpas_linenum;
  */
 extern int dpas_dump_functions;
 
+/*
+ * Flag that indicates that functions should be compiled at the
+ * maximum optimization level.
+ */
+extern int dpas_optimize_functions;
+
 /*
  * Information about a parameter list (also used for record fields).
  */
@@ -84,6 +84,10 @@ int main(int argc, char **argv)
 		{
 			dpas_dump_functions = 2;
 		}
+		else if(!jit_strcmp(argv[1], "-O"))
+		{
+			dpas_optimize_functions = 1;
+		}
 		else if(!jit_strcmp(argv[1], "--dont-fold"))
 		{
 			dont_fold = 1;
@@ -160,7 +164,7 @@ static void usage(void)
 	printf("Dynamic Pascal Version " VERSION "\n");
 	printf("Copyright (c) 2004 Southern Storm Software, Pty Ltd.\n");
 	printf("\n");
-	printf("Usage: %s [-Idir] file.pas [args]\n", progname);
+	printf("Usage: %s [-Idir] [-O] file.pas [args]\n", progname);
 	exit(1);
 }
 
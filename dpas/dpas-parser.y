@@ -53,6 +53,11 @@ int dpas_error_reported = 0;
  */
 int dpas_dump_functions = 0;
 
+/*
+ * Function optimization flag.
+ */
+int dpas_optimize_functions = 0;
+
 /*
  * Report error messages from the parser.
  */
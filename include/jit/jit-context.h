@@ -28,6 +28,26 @@
 extern	"C" {
 #endif
 
+/*
+ * Compilation statistics.
+ */
+typedef struct jit_compile_stats
+{
+	jit_nuint	num_functions;	/* Number of compiled functions */
+	jit_nuint	num_restarts;	/* Code generation restarts */
+	jit_nuint	num_blocks;	/* Basic blocks after optimization */
+	jit_nuint	num_insns;	/* Instructions after optimization */
+	jit_nuint	code_size;	/* Bytes of generated code */
+	jit_nuint	num_spills;	/* Register values stored to the frame */
+	jit_nuint	num_reloads;	/* Values loaded back from the frame */
+	jit_ulong	optimize_time;	/* Nanoseconds in the optimizer */
+	jit_ulong	liveness_time;	/* Nanoseconds in liveness analysis */
+	jit_ulong	regalloc_time;	/* Nanoseconds in global register allocation */
+	jit_ulong	codegen_time;	/* Nanoseconds in code generation */
+	jit_ulong	total_time;	/* Nanoseconds in the whole compilation */
+	jit_memory_stats_t	memory;	/* Code memory usage of the context */
+} jit_compile_stats_t;
+
 jit_context_t jit_context_create(void) JIT_NOTHROW;
 void jit_context_destroy(jit_context_t context) JIT_NOTHROW;
 
@@ -41,6 +61,15 @@ void jit_context_set_on_demand_driver(
 void jit_context_set_memory_manager(
 	jit_context_t context,
 	jit_memory_manager_t manager) JIT_NOTHROW;
+void jit_context_set_memory_stats_func(
+	jit_context_t context,
+	jit_memory_stats_func get_stats) JIT_NOTHROW;
+int jit_context_get_memory_stats(
+	jit_context_t context,
+	jit_memory_stats_t *stats) JIT_NOTHROW;
+int jit_context_get_compile_stats(
+	jit_context_t context,
+	jit_compile_stats_t *stats) JIT_NOTHROW;
 
 int jit_context_set_meta
 	(jit_context_t context, int type, void *data,
@@ -61,6 +90,23 @@ void jit_context_free_meta(jit_context_t context, int type) JIT_NOTHROW;
 #define	JIT_OPTION_DONT_FOLD		10003
 #define JIT_OPTION_POSITION_INDEPENDENT	10004
 #define JIT_OPTION_CACHE_MAX_PAGE_FACTOR	10005
+#define JIT_OPTION_CONCURRENT_COMPILE	10006
+#define JIT_OPTION_TIERED_COMPILE	10007
+#define JIT_OPTION_INLINE_CACHE		10008
+#define JIT_OPTION_INLINE_LIMIT		10009
+#define JIT_OPTION_COMPILE_STATS	10010
+#define JIT_OPTION_PERF			10011
+#define JIT_OPTION_BUILDER_ARENA	10012
+#define JIT_OPTION_EXCEPTION_TABLES	10013
+#define JIT_OPTION_UNWIND_INFO		10014
+#define JIT_OPTION_BRANCH_PROFILE	10015
+#define JIT_OPTION_CACHE_HUGE_PAGES	10016
+
+/*
+ * Flags for JIT_OPTION_PERF.
+ */
+#define JIT_PERF_MAP			(1 << 0)
+#define JIT_PERF_JITDUMP		(1 << 1)
 
 #ifdef	__cplusplus
 };
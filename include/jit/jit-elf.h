@@ -58,6 +58,9 @@ void jit_readelf_close(jit_readelf_t readelf) JIT_NOTHROW;
 const char *jit_readelf_get_name(jit_readelf_t readelf) JIT_NOTHROW;
 void *jit_readelf_get_symbol
 	(jit_readelf_t readelf, const char *name) JIT_NOTHROW;
+jit_function_t jit_readelf_get_function
+	(jit_readelf_t readelf, jit_context_t context,
+	 const char *name, jit_type_t signature) JIT_NOTHROW;
 void *jit_readelf_get_section
 	(jit_readelf_t readelf, const char *name, jit_nuint *size) JIT_NOTHROW;
 void *jit_readelf_get_section_by_type
@@ -22,6 +22,7 @@
 #define	_JIT_FUNCTION_H
 
 #include <jit/jit-common.h>
+#include <jit/jit-context.h>
 
 #ifdef	__cplusplus
 extern	"C" {
@@ -30,6 +31,7 @@ extern	"C" {
 /* Optimization levels */
 #define JIT_OPTLEVEL_NONE	0
 #define JIT_OPTLEVEL_NORMAL	1
+#define JIT_OPTLEVEL_AGGRESSIVE	2
 
 jit_function_t jit_function_create
 	(jit_context_t context, jit_type_t signature) JIT_NOTHROW;
@@ -37,6 +39,7 @@ jit_function_t jit_function_create_nested
 	(jit_context_t context, jit_type_t signature,
 	 jit_function_t parent) JIT_NOTHROW;
 void jit_function_abandon(jit_function_t func) JIT_NOTHROW;
+void jit_function_destroy(jit_function_t func) JIT_NOTHROW;
 jit_context_t jit_function_get_context(jit_function_t func) JIT_NOTHROW;
 jit_type_t jit_function_get_signature(jit_function_t func) JIT_NOTHROW;
 int jit_function_set_meta
@@ -58,6 +61,7 @@ int jit_function_is_compiled(jit_function_t func) JIT_NOTHROW;
 void jit_function_set_recompilable(jit_function_t func) JIT_NOTHROW;
 void jit_function_clear_recompilable(jit_function_t func) JIT_NOTHROW;
 int jit_function_is_recompilable(jit_function_t func) JIT_NOTHROW;
+void jit_function_set_complete(jit_function_t func) JIT_NOTHROW;
 int jit_function_compile_entry(jit_function_t func, void **entry_point) JIT_NOTHROW;
 void jit_function_setup_entry(jit_function_t func, void *entry_point) JIT_NOTHROW;
 void *jit_function_to_closure(jit_function_t func) JIT_NOTHROW;
@@ -80,6 +84,10 @@ void jit_function_set_optimization_level
 unsigned int jit_function_get_optimization_level
 	(jit_function_t func) JIT_NOTHROW;
 unsigned int jit_function_get_max_optimization_level(void) JIT_NOTHROW;
+int jit_function_get_compile_stats
+	(jit_function_t func, jit_compile_stats_t *stats) JIT_NOTHROW;
+int jit_function_set_name(jit_function_t func, const char *name) JIT_NOTHROW;
+const char *jit_function_get_name(jit_function_t func) JIT_NOTHROW;
 jit_label_t jit_function_reserve_label(jit_function_t func) JIT_NOTHROW;
 int jit_function_labels_equal(jit_function_t func, jit_label_t label, jit_label_t label2);
 int jit_optimize(jit_function_t func);
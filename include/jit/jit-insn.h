@@ -57,6 +57,12 @@ typedef struct
 #define	JIT_CALL_NORETURN		(1 << 1)
 #define	JIT_CALL_TAIL			(1 << 2)
 
+/*
+ * Hints for "jit_insn_branch_if_hint" and "jit_insn_branch_if_not_hint".
+ */
+#define	JIT_BRANCH_LIKELY		1
+#define	JIT_BRANCH_UNLIKELY		2
+
 int jit_insn_get_opcode(jit_insn_t insn) JIT_NOTHROW;
 jit_value_t jit_insn_get_dest(jit_insn_t insn) JIT_NOTHROW;
 jit_value_t jit_insn_get_value1(jit_insn_t insn) JIT_NOTHROW;
@@ -205,6 +211,13 @@ jit_value_t jit_insn_min
 	(jit_function_t func, jit_value_t value1, jit_value_t value2) JIT_NOTHROW;
 jit_value_t jit_insn_max
 	(jit_function_t func, jit_value_t value1, jit_value_t value2) JIT_NOTHROW;
+jit_value_t jit_insn_vector_splat
+	(jit_function_t func, jit_type_t type, jit_value_t value) JIT_NOTHROW;
+jit_value_t jit_insn_vector_extract
+	(jit_function_t func, jit_value_t value, unsigned int index) JIT_NOTHROW;
+jit_value_t jit_insn_vector_shuffle
+	(jit_function_t func, jit_value_t value,
+	 const unsigned int *lanes) JIT_NOTHROW;
 jit_value_t jit_insn_sign
 	(jit_function_t func, jit_value_t value1) JIT_NOTHROW;
 int jit_insn_branch
@@ -213,6 +226,12 @@ int jit_insn_branch_if
 	(jit_function_t func, jit_value_t value, jit_label_t *label) JIT_NOTHROW;
 int jit_insn_branch_if_not
 	(jit_function_t func, jit_value_t value, jit_label_t *label) JIT_NOTHROW;
+int jit_insn_branch_if_hint
+	(jit_function_t func, jit_value_t value, jit_label_t *label,
+	 int hint) JIT_NOTHROW;
+int jit_insn_branch_if_not_hint
+	(jit_function_t func, jit_value_t value, jit_label_t *label,
+	 int hint) JIT_NOTHROW;
 int jit_insn_jump_table
 	(jit_function_t func, jit_value_t value,
 	 jit_label_t *labels, unsigned int num_labels) JIT_NOTHROW;
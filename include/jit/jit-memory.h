@@ -40,6 +40,22 @@ typedef void *jit_function_info_t;
 
 typedef struct jit_memory_manager const* jit_memory_manager_t;
 
+/*
+ * Code memory usage statistics.
+ */
+typedef struct jit_memory_stats
+{
+	jit_nuint	total_size;	/* Memory taken from the system */
+	jit_nuint	used_size;	/* Memory in use by functions and data */
+	jit_nuint	free_size;	/* Memory available for reuse */
+	jit_nuint	free_blocks;	/* Number of separate free blocks */
+	jit_nuint	largest_free;	/* Size of the largest free block */
+	jit_nuint	released_size;	/* Memory given back to the system */
+} jit_memory_stats_t;
+
+typedef void (*jit_memory_stats_func)(jit_memory_context_t memctx,
+				      jit_memory_stats_t *stats);
+
 struct jit_memory_manager
 {
 	jit_memory_context_t (*create)(jit_context_t context);
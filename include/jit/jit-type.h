@@ -91,6 +91,11 @@ JIT_EXPORT_DATA jit_type_t const jit_type_sys_long_double;
 #define	JIT_TYPE_PTR				17
 #define	JIT_TYPE_FIRST_TAGGED		32
 
+/*
+ * Size of the vector types in bytes.
+ */
+#define	JIT_VECTOR_SIZE				16
+
 /*
  * Special tag types.
  */
@@ -149,6 +154,8 @@ jit_type_t jit_type_create_signature
 	(jit_abi_t abi, jit_type_t return_type, jit_type_t *params,
 	 unsigned int num_params, int incref) JIT_NOTHROW;
 jit_type_t jit_type_create_pointer(jit_type_t type, int incref) JIT_NOTHROW;
+jit_type_t jit_type_create_vector
+	(jit_type_t type, unsigned int num_elements) JIT_NOTHROW;
 jit_type_t jit_type_create_tagged
 	(jit_type_t type, int kind, void *data,
 	 jit_meta_free_func free_func, int incref) JIT_NOTHROW;
@@ -188,6 +195,8 @@ int jit_type_is_union(jit_type_t type) JIT_NOTHROW;
 int jit_type_is_signature(jit_type_t type) JIT_NOTHROW;
 int jit_type_is_pointer(jit_type_t type) JIT_NOTHROW;
 int jit_type_is_tagged(jit_type_t type) JIT_NOTHROW;
+int jit_type_is_vector(jit_type_t type) JIT_NOTHROW;
+jit_type_t jit_type_get_vector_element(jit_type_t type) JIT_NOTHROW;
 jit_type_t jit_type_remove_tags(jit_type_t type) JIT_NOTHROW;
 jit_type_t jit_type_normalize(jit_type_t type) JIT_NOTHROW;
 jit_type_t jit_type_promote_int(jit_type_t type) JIT_NOTHROW;
@@ -39,11 +39,13 @@ typedef enum {
 void jit_vmem_init(void);
 
 jit_uint jit_vmem_page_size(void);
+jit_uint jit_vmem_huge_page_size(void);
 jit_nuint jit_vmem_round_up(jit_nuint value);
 jit_nuint jit_vmem_round_down(jit_nuint value);
 
 void *jit_vmem_reserve(jit_uint size);
 void *jit_vmem_reserve_committed(jit_uint size, jit_prot_t prot);
+void *jit_vmem_reserve_huge(jit_uint size, jit_prot_t prot);
 int jit_vmem_release(void *addr, jit_uint size);
 
 int jit_vmem_commit(void *addr, jit_uint size, jit_prot_t prot);
@@ -115,6 +115,28 @@ void *_jit_create_redirector(unsigned char *buf, void *func,
  */
 void *_jit_create_indirector(unsigned char *buf, void **entry);
 
+/*
+ * Get the number of bytes that are needed for the apply or closure stub
+ * of "signature", or zero if the signature must use the general code.
+ * Only used if "jit_apply_stubs" is defined.
+ */
+unsigned int _jit_apply_stub_size(jit_type_t signature);
+
+/*
+ * Create a stub that is called as "stub(entry, args, return_area)"
+ * and applies "entry" to the arguments in the way "signature" says.
+ */
+void *_jit_create_apply_stub(unsigned char *buf, jit_type_t signature);
+
+/*
+ * Create a stub that unpacks the arguments of "signature" for a closure
+ * function, and a closure in "buf" that jumps to it with "func" and
+ * "user_data".
+ */
+void *_jit_create_closure_stub(unsigned char *buf, jit_type_t signature);
+void _jit_create_closure_jump(unsigned char *buf, void *stub,
+			      void *func, void *user_data);
+
 /*
  * Pad a buffer with NOP instructions.  Used to align code.
  * This will only be called if "jit_should_pad" is defined.
@@ -214,6 +214,399 @@ void *_jit_create_indirector(unsigned char *buf, void **entry)
 	return start;
 }
 
+/*
+ * Get the kind of a parameter or return type that the per-signature
+ * stubs can pass in a single register.  Returns -1 for types that
+ * have to go through the general apply code.  "void" is only valid
+ * as a return type.
+ */
+static int
+stub_kind(jit_type_t type)
+{
+	int kind = jit_type_get_kind(jit_type_normalize(type));
+
+	switch(kind)
+	{
+		case JIT_TYPE_SBYTE:
+		case JIT_TYPE_UBYTE:
+		case JIT_TYPE_SHORT:
+		case JIT_TYPE_USHORT:
+		case JIT_TYPE_INT:
+		case JIT_TYPE_UINT:
+		case JIT_TYPE_LONG:
+		case JIT_TYPE_ULONG:
+		case JIT_TYPE_FLOAT32:
+		case JIT_TYPE_FLOAT64:
+		case JIT_TYPE_VOID:
+		{
+			return kind;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Load the value of "kind" at "basereg + disp" into "reg", which is
+ * an xmm register for floating point kinds.  Small integers are
+ * extended to 64 bits as the general apply code does.
+ */
+static unsigned char *
+stub_load(unsigned char *buf, int kind, int reg, int basereg, int disp)
+{
+	switch(kind)
+	{
+		case JIT_TYPE_SBYTE:
+		{
+			x86_64_movsx8_reg_membase_size(buf, reg, basereg, disp, 8);
+		}
+		break;
+
+		case JIT_TYPE_UBYTE:
+		{
+			x86_64_movzx8_reg_membase_size(buf, reg, basereg, disp, 4);
+		}
+		break;
+
+		case JIT_TYPE_SHORT:
+		{
+			x86_64_movsx16_reg_membase_size(buf, reg, basereg, disp, 8);
+		}
+		break;
+
+		case JIT_TYPE_USHORT:
+		{
+			x86_64_movzx16_reg_membase_size(buf, reg, basereg, disp, 4);
+		}
+		break;
+
+		case JIT_TYPE_INT:
+		{
+			x86_64_movsx32_reg_membase_size(buf, reg, basereg, disp, 8);
+		}
+		break;
+
+		case JIT_TYPE_UINT:
+		{
+			x86_64_mov_reg_membase_size(buf, reg, basereg, disp, 4);
+		}
+		break;
+
+		case JIT_TYPE_FLOAT32:
+		{
+			x86_64_movss_reg_membase(buf, reg, basereg, disp);
+		}
+		break;
+
+		case JIT_TYPE_FLOAT64:
+		{
+			x86_64_movsd_reg_membase(buf, reg, basereg, disp);
+		}
+		break;
+
+		default:
+		{
+			x86_64_mov_reg_membase_size(buf, reg, basereg, disp, 8);
+		}
+		break;
+	}
+	return buf;
+}
+
+/*
+ * Get the size of the buffer for the apply or closure stub of
+ * "signature".  Returns zero if the signature has parameters or a
+ * return type that cannot be passed in a single register, or variable
+ * arguments.  Those signatures use the general apply code.
+ */
+unsigned int
+_jit_apply_stub_size(jit_type_t signature)
+{
+	unsigned int num_params;
+	unsigned int param;
+
+	if(jit_type_get_kind(signature) != JIT_TYPE_SIGNATURE ||
+	   jit_type_get_abi(signature) == jit_abi_vararg)
+	{
+		return 0;
+	}
+	if(stub_kind(jit_type_get_return(signature)) < 0)
+	{
+		return 0;
+	}
+	num_params = jit_type_num_params(signature);
+	for(param = 0; param < num_params; ++param)
+	{
+		int kind = stub_kind(jit_type_get_param(signature, param));
+		if(kind < 0 || kind == JIT_TYPE_VOID)
+		{
+			return 0;
+		}
+	}
+
+	/* Each parameter needs at most 32 bytes of code */
+	return 96 + num_params * 32;
+}
+
+/*
+ * Create the apply stub for "signature" in "buf".  The stub is called
+ * as "stub(entry, args, return_area)".  It loads the values that the
+ * "args" array points to straight into the argument registers, or
+ * onto the stack, calls "entry" and stores the return value.
+ */
+void *
+_jit_create_apply_stub(unsigned char *buf, jit_type_t signature)
+{
+	static const int word_regs[6] = {X86_64_RDI, X86_64_RSI, X86_64_RDX,
+					 X86_64_RCX, X86_64_R8, X86_64_R9};
+	void *start = (void *)buf;
+	unsigned int num_params = jit_type_num_params(signature);
+	unsigned int num_word = 0;
+	unsigned int num_sse = 0;
+	unsigned int num_stack = 0;
+	unsigned int param;
+	int kind;
+
+	/* Count the parameters that are passed on the stack */
+	for(param = 0; param < num_params; ++param)
+	{
+		kind = stub_kind(jit_type_get_param(signature, param));
+		if(kind == JIT_TYPE_FLOAT32 || kind == JIT_TYPE_FLOAT64)
+		{
+			if(num_sse < 8)
+			{
+				++num_sse;
+				continue;
+			}
+		}
+		else if(num_word < 6)
+		{
+			++num_word;
+			continue;
+		}
+		++num_stack;
+	}
+
+	/* Set up the frame and keep the return area in RBX.  The stack
+	   must be 16 byte aligned at the call.  */
+	x86_64_push_reg_size(buf, X86_64_RBP, 8);
+	x86_64_mov_reg_reg_size(buf, X86_64_RBP, X86_64_RSP, 8);
+	x86_64_push_reg_size(buf, X86_64_RBX, 8);
+	x86_64_mov_reg_reg_size(buf, X86_64_RBX, X86_64_RDX, 8);
+	x86_64_mov_reg_reg_size(buf, X86_64_R11, X86_64_RDI, 8);
+	x86_64_mov_reg_reg_size(buf, X86_64_R10, X86_64_RSI, 8);
+	x86_64_sub_reg_imm_size(buf, X86_64_RSP,
+				((num_stack * 8 + 15) & ~15) + 8, 8);
+
+	/* Load the arguments through the pointers in the "args" array */
+	num_word = 0;
+	num_sse = 0;
+	num_stack = 0;
+	for(param = 0; param < num_params; ++param)
+	{
+		kind = stub_kind(jit_type_get_param(signature, param));
+		x86_64_mov_reg_membase_size(buf, X86_64_RAX, X86_64_R10,
+					    param * 8, 8);
+		if(kind == JIT_TYPE_FLOAT32 || kind == JIT_TYPE_FLOAT64)
+		{
+			if(num_sse < 8)
+			{
+				buf = stub_load(buf, kind, X86_64_XMM0 + num_sse,
+						X86_64_RAX, 0);
+				++num_sse;
+				continue;
+			}
+
+			/* Copy the raw bits to the stack */
+			kind = (kind == JIT_TYPE_FLOAT32) ? JIT_TYPE_UINT
+							  : JIT_TYPE_ULONG;
+		}
+		else if(num_word < 6)
+		{
+			buf = stub_load(buf, kind, word_regs[num_word],
+					X86_64_RAX, 0);
+			++num_word;
+			continue;
+		}
+		buf = stub_load(buf, kind, X86_64_RAX, X86_64_RAX, 0);
+		x86_64_mov_membase_reg_size(buf, X86_64_RSP, num_stack * 8,
+					    X86_64_RAX, 8);
+		++num_stack;
+	}
+
+	/* Call the function and store its return value */
+	x86_64_call_reg(buf, X86_64_R11);
+	switch(stub_kind(jit_type_get_return(signature)))
+	{
+		case JIT_TYPE_SBYTE:
+		case JIT_TYPE_UBYTE:
+		{
+			x86_64_mov_membase_reg_size(buf, X86_64_RBX, 0, X86_64_RAX, 1);
+		}
+		break;
+
+		case JIT_TYPE_SHORT:
+		case JIT_TYPE_USHORT:
+		{
+			x86_64_mov_membase_reg_size(buf, X86_64_RBX, 0, X86_64_RAX, 2);
+		}
+		break;
+
+		case JIT_TYPE_INT:
+		case JIT_TYPE_UINT:
+		{
+			x86_64_mov_membase_reg_size(buf, X86_64_RBX, 0, X86_64_RAX, 4);
+		}
+		break;
+
+		case JIT_TYPE_LONG:
+		case JIT_TYPE_ULONG:
+		{
+			x86_64_mov_membase_reg_size(buf, X86_64_RBX, 0, X86_64_RAX, 8);
+		}
+		break;
+
+		case JIT_TYPE_FLOAT32:
+		{
+			x86_64_movss_membase_reg(buf, X86_64_RBX, 0, X86_64_XMM0);
+		}
+		break;
+
+		case JIT_TYPE_FLOAT64:
+		{
+			x86_64_movsd_membase_reg(buf, X86_64_RBX, 0, X86_64_XMM0);
+		}
+		break;
+	}
+
+	/* Pop the frame and return */
+	x86_64_mov_reg_membase_size(buf, X86_64_RBX, X86_64_RBP, -8, 8);
+	x86_64_mov_reg_reg_size(buf, X86_64_RSP, X86_64_RBP, 8);
+	x86_64_pop_reg_size(buf, X86_64_RBP, 8);
+	x86_64_ret(buf);
+
+	return start;
+}
+
+/*
+ * Create the closure stub for "signature" in "buf".  The closure jumps
+ * to the stub with the closure function in R11 and its user data in
+ * R10.  The stub spills the argument registers, builds the "args"
+ * array that points at them and at the stack arguments, calls the
+ * closure function and loads the return value into RAX or XMM0.
+ */
+void *
+_jit_create_closure_stub(unsigned char *buf, jit_type_t signature)
+{
+	static const int word_regs[6] = {X86_64_RDI, X86_64_RSI, X86_64_RDX,
+					 X86_64_RCX, X86_64_R8, X86_64_R9};
+	void *start = (void *)buf;
+	unsigned int num_params = jit_type_num_params(signature);
+	unsigned int num_word = 0;
+	unsigned int num_sse = 0;
+	unsigned int num_stack = 0;
+	unsigned int param;
+	int frame_size;
+	int return_offset;
+	int offset;
+	int kind;
+
+	/* The frame holds the "args" array, a slot for each parameter
+	   and the return buffer */
+	return_offset = num_params * 16;
+	frame_size = return_offset + 16;
+
+	x86_64_push_reg_size(buf, X86_64_RBP, 8);
+	x86_64_mov_reg_reg_size(buf, X86_64_RBP, X86_64_RSP, 8);
+	x86_64_sub_reg_imm_size(buf, X86_64_RSP, frame_size, 8);
+
+	for(param = 0; param < num_params; ++param)
+	{
+		kind = stub_kind(jit_type_get_param(signature, param));
+		offset = num_params * 8 + param * 8;
+		if(kind == JIT_TYPE_FLOAT32 || kind == JIT_TYPE_FLOAT64)
+		{
+			if(num_sse < 8)
+			{
+				x86_64_movsd_membase_reg(buf, X86_64_RSP, offset,
+							 X86_64_XMM0 + num_sse);
+				x86_64_lea_membase_size(buf, X86_64_RAX, X86_64_RSP,
+							offset, 8);
+				x86_64_mov_membase_reg_size(buf, X86_64_RSP, param * 8,
+							    X86_64_RAX, 8);
+				++num_sse;
+				continue;
+			}
+		}
+		else if(num_word < 6)
+		{
+			x86_64_mov_membase_reg_size(buf, X86_64_RSP, offset,
+						    word_regs[num_word], 8);
+			x86_64_lea_membase_size(buf, X86_64_RAX, X86_64_RSP,
+						offset, 8);
+			x86_64_mov_membase_reg_size(buf, X86_64_RSP, param * 8,
+						    X86_64_RAX, 8);
+			++num_word;
+			continue;
+		}
+
+		/* Point at the argument in the caller's frame */
+		x86_64_lea_membase_size(buf, X86_64_RAX, X86_64_RBP,
+					16 + num_stack * 8, 8);
+		x86_64_mov_membase_reg_size(buf, X86_64_RSP, param * 8,
+					    X86_64_RAX, 8);
+		++num_stack;
+	}
+
+	/* Call "func(signature, return_buffer, args, user_data)" */
+	x86_64_mov_reg_imm_size(buf, X86_64_RDI, (jit_nint)signature, 8);
+	x86_64_lea_membase_size(buf, X86_64_RSI, X86_64_RSP, return_offset, 8);
+	x86_64_mov_reg_reg_size(buf, X86_64_RDX, X86_64_RSP, 8);
+	x86_64_mov_reg_reg_size(buf, X86_64_RCX, X86_64_R10, 8);
+	x86_64_call_reg(buf, X86_64_R11);
+
+	/* Load the return value */
+	kind = stub_kind(jit_type_get_return(signature));
+	if(kind == JIT_TYPE_FLOAT32 || kind == JIT_TYPE_FLOAT64)
+	{
+		buf = stub_load(buf, kind, X86_64_XMM0, X86_64_RSP, return_offset);
+	}
+	else if(kind != JIT_TYPE_VOID)
+	{
+		buf = stub_load(buf, kind, X86_64_RAX, X86_64_RSP, return_offset);
+	}
+
+	/* Pop the frame and return */
+	x86_64_mov_reg_reg_size(buf, X86_64_RSP, X86_64_RBP, 8);
+	x86_64_pop_reg_size(buf, X86_64_RBP, 8);
+	x86_64_ret(buf);
+
+	return start;
+}
+
+/*
+ * Create a closure that jumps to the closure stub "stub" with the
+ * closure function "func" and "user_data" in R11 and R10.
+ */
+void _jit_create_closure_jump(unsigned char *buf, void *stub,
+			      void *func, void *user_data)
+{
+	jit_nint offset;
+
+	x86_64_mov_reg_imm_size(buf, X86_64_R11, (jit_nint)func, 8);
+	x86_64_mov_reg_imm_size(buf, X86_64_R10, (jit_nint)user_data, 8);
+	offset = (jit_nint)stub - ((jit_nint)buf + 5);
+	if((offset < jit_min_int) || (offset > jit_max_int))
+	{
+		/* RAX is free because the signature has no variable arguments */
+		x86_64_mov_reg_imm_size(buf, X86_64_RAX, (jit_nint)stub, 8);
+		x86_64_jmp_reg(buf, X86_64_RAX);
+	}
+	else
+	{
+		x86_64_jmp_imm(buf, (jit_int)offset);
+	}
+}
+
 void _jit_pad_buffer(unsigned char *buf, int len)
 {
 	while(len >= 6)
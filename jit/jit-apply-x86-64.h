@@ -307,5 +307,11 @@ _jit_classify_struct(jit_param_passing_t *passing,
  */
 #define	jit_indirector_size		0x10
 
+/*
+ * Signatures with only scalar parameters get their own stubs for
+ * function application and closures.
+ */
+#define	jit_apply_stubs			1
+
 
 #endif	/* _JIT_APPLY_X86_64_H */
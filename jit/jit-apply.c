@@ -459,6 +459,83 @@ int jit_raw_supported(jit_type_t signature)
 #endif
 }
 
+/*
+ * Get the apply stub of "signature", or its closure stub if "closure"
+ * is non-zero.  The stubs are created on first use and cached in the
+ * signature until it is freed.  Returns NULL if the platform has no
+ * stubs or the signature must use the general apply code.
+ */
+void *
+_jit_apply_get_stub(jit_type_t signature, int closure)
+{
+#ifdef jit_apply_stubs
+	void **stub;
+	unsigned int size;
+
+	if(!signature || signature->kind != JIT_TYPE_SIGNATURE)
+	{
+		return 0;
+	}
+	stub = closure ? &(signature->closure_stub) : &(signature->apply_stub);
+	if(*stub)
+	{
+		return *stub;
+	}
+	size = _jit_apply_stub_size(signature);
+	if(!size)
+	{
+		return 0;
+	}
+
+	jit_mutex_lock(&_jit_global_lock);
+	if(!*stub)
+	{
+		unsigned char *buf = (unsigned char *)_jit_malloc_exec(size);
+		if(buf)
+		{
+			if(closure)
+			{
+				_jit_create_closure_stub(buf, signature);
+			}
+			else
+			{
+				_jit_create_apply_stub(buf, signature);
+			}
+			_jit_flush_exec(buf, size);
+			*stub = buf;
+		}
+	}
+	jit_mutex_unlock(&_jit_global_lock);
+	return *stub;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Free the stubs of "signature" when it is destroyed.
+ */
+void
+_jit_apply_free_stubs(jit_type_t signature)
+{
+#ifdef jit_apply_stubs
+	unsigned int size;
+
+	if(signature->apply_stub || signature->closure_stub)
+	{
+		size = _jit_apply_stub_size(signature);
+		if(signature->apply_stub)
+		{
+			_jit_free_exec(signature->apply_stub, size);
+		}
+		if(signature->closure_stub)
+		{
+			_jit_free_exec(signature->closure_stub, size);
+		}
+	}
+#endif
+}
+
 /*
  * Define the structure of a vararg list for closures.
  */
@@ -790,12 +867,14 @@ jit_closure_create(jit_context_t context, jit_type_t signature, jit_closure_func
 {
 #ifdef jit_closure_size
 	jit_closure_t closure;
+	void *stub;
 
 	/* Validate the parameters */
 	if(!context || !signature || !func)
 	{
 		return 0;
 	}
+	stub = _jit_apply_get_stub(signature, 1);
 
 	/* Acquire the memory context */
 	_jit_memory_lock(context);
@@ -813,8 +892,19 @@ jit_closure_create(jit_context_t context, jit_type_t signature, jit_closure_func
 		return 0;
 	}
 
-	/* Fill in the closure fields */
-	_jit_create_closure(closure->buf, (void *)closure_handler, closure, signature);
+	/* Fill in the closure fields.  Signatures with only scalar
+	   parameters jump to a stub that unpacks them directly */
+#ifdef jit_apply_stubs
+	if(stub)
+	{
+		_jit_create_closure_jump(closure->buf, stub, (void *)func, user_data);
+	}
+	else
+#endif
+	{
+		_jit_create_closure(closure->buf, (void *)closure_handler,
+				    closure, signature);
+	}
 	closure->signature = signature;
 	closure->func = func;
 	closure->user_data = user_data;
@@ -853,7 +943,8 @@ unsigned int
 jit_get_closure_size(void)
 {
 #ifdef jit_closure_size
-	return jit_closure_size;
+	/* The closure fields follow the code */
+	return sizeof(struct jit_closure);
 #else
 	return 0;
 #endif
@@ -0,0 +1,245 @@
+/*
+ * jit-arena.c - Bump allocator for the function builders.
+ *
+ * Copyright (C) 2026  Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+
+/*
+ * Every allocation is preceded by a header with its size, so that it
+ * can be resized without help from the caller.  The header also keeps
+ * the allocations aligned for any type.
+ */
+#define	ARENA_ALIGN		16
+#define	ARENA_HEADER		ARENA_ALIGN
+#define	ARENA_ROUND(size)	(((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/*
+ * The size of the first chunk.  Later chunks are at least twice as
+ * large as the one before them.
+ */
+#define	ARENA_CHUNK_SIZE	16384
+
+/*
+ * The largest chunk that is kept when the arena is reset.  A function
+ * that needs more than this gives its memory back to the system.
+ */
+#define	ARENA_KEEP_SIZE		(1024 * 1024)
+
+#define	CHUNK_HEADER		ARENA_ROUND(sizeof(struct _jit_arena_chunk))
+#define	CHUNK_DATA(chunk)	((char *)(chunk) + CHUNK_HEADER)
+#define	ALLOC_SIZE(ptr)		(*((unsigned int *)((char *)(ptr) - ARENA_HEADER)))
+
+/*
+ * Add a chunk with room for at least "size" bytes.
+ */
+static int
+add_chunk(_jit_arena_t arena, unsigned int size)
+{
+	_jit_arena_chunk_t chunk;
+	unsigned int chunk_size;
+
+	chunk_size = ARENA_CHUNK_SIZE;
+	if(arena->chunks && chunk_size < arena->chunks->size * 2)
+	{
+		chunk_size = arena->chunks->size * 2;
+	}
+	if(chunk_size < size)
+	{
+		chunk_size = size;
+	}
+
+	chunk = (_jit_arena_chunk_t) jit_malloc(CHUNK_HEADER + chunk_size);
+	if(!chunk)
+	{
+		return 0;
+	}
+	chunk->next = arena->chunks;
+	chunk->size = chunk_size;
+	arena->chunks = chunk;
+	arena->posn = CHUNK_DATA(chunk);
+	arena->limit = arena->posn + chunk_size;
+	arena->last = 0;
+	return 1;
+}
+
+_jit_arena_t
+_jit_arena_acquire(void)
+{
+	jit_thread_control_t control;
+	_jit_arena_t arena;
+
+	/* Reuse the arena that was cached by this thread */
+	control = _jit_thread_get_control();
+	if(control && control->builder_arena)
+	{
+		arena = control->builder_arena;
+		control->builder_arena = 0;
+		return arena;
+	}
+
+	return jit_cnew(struct _jit_arena);
+}
+
+void
+_jit_arena_release(_jit_arena_t arena)
+{
+	jit_thread_control_t control;
+	_jit_arena_chunk_t chunk;
+
+	/* Free all chunks but the newest one, which is the largest */
+	chunk = arena->chunks;
+	if(chunk)
+	{
+		while(chunk->next)
+		{
+			_jit_arena_chunk_t next = chunk->next->next;
+			jit_free(chunk->next);
+			chunk->next = next;
+		}
+		if(chunk->size > ARENA_KEEP_SIZE)
+		{
+			jit_free(chunk);
+			arena->chunks = 0;
+			arena->posn = 0;
+			arena->limit = 0;
+		}
+		else
+		{
+			arena->posn = CHUNK_DATA(chunk);
+		}
+	}
+	arena->last = 0;
+
+	/* Cache the arena for the next builder of this thread, unless
+	   there is one already */
+	control = _jit_thread_get_control();
+	if(control && !control->builder_arena)
+	{
+		control->builder_arena = arena;
+	}
+	else
+	{
+		_jit_arena_destroy(arena);
+	}
+}
+
+void
+_jit_arena_destroy(_jit_arena_t arena)
+{
+	_jit_arena_chunk_t chunk;
+
+	if(arena)
+	{
+		while((chunk = arena->chunks) != 0)
+		{
+			arena->chunks = chunk->next;
+			jit_free(chunk);
+		}
+		jit_free(arena);
+	}
+}
+
+void *
+_jit_arena_alloc(_jit_arena_t arena, unsigned int size)
+{
+	unsigned int total;
+	char *ptr;
+
+	total = ARENA_HEADER + ARENA_ROUND(size);
+	if((unsigned int) (arena->limit - arena->posn) < total)
+	{
+		if(!add_chunk(arena, total))
+		{
+			return 0;
+		}
+	}
+
+	ptr = arena->posn + ARENA_HEADER;
+	arena->posn += total;
+	arena->last = ptr;
+	ALLOC_SIZE(ptr) = size;
+	return ptr;
+}
+
+void *
+_jit_arena_calloc(_jit_arena_t arena, unsigned int num, unsigned int size)
+{
+	void *ptr = _jit_arena_alloc(arena, num * size);
+	if(ptr)
+	{
+		jit_memzero(ptr, num * size);
+	}
+	return ptr;
+}
+
+void *
+_jit_arena_realloc(_jit_arena_t arena, void *ptr, unsigned int size)
+{
+	unsigned int old_size;
+	void *new_ptr;
+
+	if(!ptr)
+	{
+		return _jit_arena_alloc(arena, size);
+	}
+	if(size == 0)
+	{
+		_jit_arena_free(arena, ptr);
+		return 0;
+	}
+
+	/* Shrink in place, or grow in place if it is the last allocation */
+	old_size = ALLOC_SIZE(ptr);
+	if(size <= old_size)
+	{
+		if(ptr == arena->last)
+		{
+			arena->posn = (char *) ptr + ARENA_ROUND(size);
+		}
+		ALLOC_SIZE(ptr) = size;
+		return ptr;
+	}
+	if(ptr == arena->last
+	   && (unsigned int) (arena->limit - (char *) ptr) >= ARENA_ROUND(size))
+	{
+		arena->posn = (char *) ptr + ARENA_ROUND(size);
+		ALLOC_SIZE(ptr) = size;
+		return ptr;
+	}
+
+	new_ptr = _jit_arena_alloc(arena, size);
+	if(new_ptr)
+	{
+		jit_memcpy(new_ptr, ptr, old_size);
+	}
+	return new_ptr;
+}
+
+void
+_jit_arena_free(_jit_arena_t arena, void *ptr)
+{
+	/* Only the last allocation can be given back before a reset */
+	if(ptr && ptr == arena->last)
+	{
+		arena->posn = (char *) ptr - ARENA_HEADER;
+		arena->last = 0;
+	}
+}
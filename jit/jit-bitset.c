@@ -33,14 +33,14 @@ _jit_bitset_init(_jit_bitset_t *bs)
 int
 _jit_bitset_allocate(_jit_bitset_t *bs, int size)
 {
-	bs->size = size;
-	if(size > 0)
+	/* The size is kept in words */
+	bs->size = (size + _JIT_BITSET_WORD_BITS - 1) / _JIT_BITSET_WORD_BITS;
+	if(bs->size > 0)
 	{
-		size = (size + _JIT_BITSET_WORD_BITS - 1) / _JIT_BITSET_WORD_BITS;
-		bs->bits = jit_calloc(size, sizeof(_jit_bitset_word_t));
+		bs->bits = jit_calloc(bs->size, sizeof(_jit_bitset_word_t));
 		if(!bs->bits)
 		{
-			jit_free(bs);
+			bs->size = 0;
 			return 0;
 		}
 	}
@@ -74,7 +74,7 @@ _jit_bitset_set_bit(_jit_bitset_t *bs, int bit)
 	int word;
 	word = bit / _JIT_BITSET_WORD_BITS;
 	bit = bit % _JIT_BITSET_WORD_BITS;
-	bs->bits[word] |= bit;
+	bs->bits[word] |= ((_jit_bitset_word_t) 1) << bit;
 }
 
 void
@@ -83,7 +83,7 @@ _jit_bitset_clear_bit(_jit_bitset_t *bs, int bit)
 	int word;
 	word = bit / _JIT_BITSET_WORD_BITS;
 	bit = bit % _JIT_BITSET_WORD_BITS;
-	bs->bits[word] &= ~bit;
+	bs->bits[word] &= ~(((_jit_bitset_word_t) 1) << bit);
 }
 
 int
@@ -92,7 +92,7 @@ _jit_bitset_test_bit(_jit_bitset_t *bs, int bit)
 	int word;
 	word = bit / _JIT_BITSET_WORD_BITS;
 	bit = bit % _JIT_BITSET_WORD_BITS;
-	return (bs->bits[word] & bit) != 0;
+	return (bs->bits[word] & (((_jit_bitset_word_t) 1) << bit)) != 0;
 }
 
 void
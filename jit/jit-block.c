@@ -184,7 +184,8 @@ alloc_edges(jit_function_t func)
 		}
 		else
 		{
-			block->succs = jit_calloc(block->num_succs, sizeof(_jit_edge_t));
+			block->succs = _jit_builder_calloc(func->builder, block->num_succs,
+							   sizeof(_jit_edge_t));
 			if(!block->succs)
 			{
 				jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
@@ -200,7 +201,8 @@ alloc_edges(jit_function_t func)
 		}
 		else
 		{
-			block->preds = jit_calloc(block->num_preds, sizeof(_jit_edge_t));
+			block->preds = _jit_builder_calloc(func->builder, block->num_preds,
+							   sizeof(_jit_edge_t));
 			if(!block->preds)
 			{
 				jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
@@ -226,7 +228,9 @@ detach_edge_src(_jit_edge_t edge)
 			{
 				block->succs[index] = block->succs[index + 1];
 			}
-			block->succs = jit_realloc(block->succs, block->num_succs * sizeof(_jit_edge_t));
+			block->succs = _jit_builder_realloc(block->func->builder,
+							    block->succs,
+							    block->num_succs * sizeof(_jit_edge_t));
 			return;
 		}
 	}
@@ -247,8 +251,9 @@ detach_edge_dst(_jit_edge_t edge)
 			{
 				block->preds[index] = block->preds[index + 1];
 			}
-			block->preds = jit_realloc(block->preds,
-						   block->num_preds * sizeof(_jit_edge_t));
+			block->preds = _jit_builder_realloc(block->func->builder,
+							    block->preds,
+							    block->num_preds * sizeof(_jit_edge_t));
 			return;
 		}
 	}
@@ -259,7 +264,8 @@ attach_edge_dst(_jit_edge_t edge, jit_block_t block)
 {
 	_jit_edge_t *preds;
 
-	preds = jit_realloc(block->preds, (block->num_preds + 1) * sizeof(_jit_edge_t));
+	preds = _jit_builder_realloc(block->func->builder, block->preds,
+				     (block->num_preds + 1) * sizeof(_jit_edge_t));
 	if(!preds)
 	{
 		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
@@ -279,18 +285,54 @@ delete_edge(jit_function_t func, _jit_edge_t edge)
 	jit_memory_pool_dealloc(&func->builder->edge_pool, edge);
 }
 
+/* Release the instructions of a block */
+static void
+free_insns(jit_block_t block)
+{
+	if(!block->insns_shared)
+	{
+		_jit_builder_free(block->func->builder, block->insns);
+	}
+	block->insns = 0;
+	block->insns_shared = 0;
+}
+
+/* Resize the instruction array of a block.  The block keeps the old
+   array, the caller has to store the new one */
+static jit_insn_t
+realloc_insns(jit_block_t block, int max_insns)
+{
+	jit_insn_t insns;
+
+	if(!block->insns_shared)
+	{
+		return (jit_insn_t) _jit_builder_realloc
+			(block->func->builder, block->insns,
+			 max_insns * sizeof(struct _jit_insn));
+	}
+
+	/* The shared array cannot grow, so copy the instructions out */
+	insns = (jit_insn_t) _jit_builder_malloc
+		(block->func->builder, max_insns * sizeof(struct _jit_insn));
+	if(insns && block->num_insns > 0)
+	{
+		jit_memcpy(insns, block->insns,
+			   block->num_insns * sizeof(struct _jit_insn));
+	}
+	return insns;
+}
+
 /* Block may not be deleted right when it was found useless from
    the control flow perspective as it might be referenced from
    elsewhere, for instance, from some jit_value_t */
 static void
 delete_block(jit_block_t block)
 {
-	jit_free(block->succs);
+	_jit_builder_free(block->func->builder, block->succs);
 	block->succs = 0;
-	jit_free(block->preds);
+	_jit_builder_free(block->func->builder, block->preds);
 	block->preds = 0;
-	jit_free(block->insns);
-	block->insns = 0;
+	free_insns(block);
 
 	block->next = block->func->builder->deleted_blocks;
 	block->func->builder->deleted_blocks = block;
@@ -428,7 +470,8 @@ merge_empty(jit_function_t func, jit_block_t block, int *changed)
 		if(block->num_preds > 1)
 		{
 			block->num_preds = 1;
-			block->preds = jit_realloc(block->preds, sizeof(_jit_edge_t));
+			block->preds = _jit_builder_realloc(func->builder, block->preds,
+							    sizeof(_jit_edge_t));
 			block->preds[0] = fallthru_edge;
 		}
 	}
@@ -437,7 +480,7 @@ merge_empty(jit_function_t func, jit_block_t block, int *changed)
 		if(block->num_preds > 0)
 		{
 			block->num_preds = 0;
-			jit_free(block->preds);
+			_jit_builder_free(func->builder, block->preds);
 			block->preds = 0;
 		}
 	}
@@ -455,7 +498,7 @@ static void
 combine_block(jit_function_t func, jit_block_t block, int *changed)
 {
 	jit_block_t succ_block;
-	int branch, num_insns, max_insns;
+	int branch, num_insns, max_insns, shared;
 	jit_insn_t insns;
 
 	/* Find block successor */
@@ -469,7 +512,8 @@ combine_block(jit_function_t func, jit_block_t block, int *changed)
 	   condition */
 	if(branch && !succ_block->max_insns)
 	{
-		succ_block->insns = jit_malloc(sizeof(struct _jit_insn));
+		succ_block->insns = _jit_builder_malloc(func->builder,
+							 sizeof(struct _jit_insn));
 		if(!succ_block->insns)
 		{
 			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
@@ -483,16 +527,17 @@ combine_block(jit_function_t func, jit_block_t block, int *changed)
 	if(num_insns > max_insns)
 	{
 		max_insns = num_insns;
-		insns = (jit_insn_t) jit_realloc(block->insns,
-						 max_insns * sizeof(struct _jit_insn));
+		insns = realloc_insns(block, max_insns);
 		if(!insns)
 		{
 			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
 		}
+		shared = 0;
 	}
 	else
 	{
 		insns = block->insns;
+		shared = block->insns_shared;
 	}
 
 	/* Copy instruction from the successor block after the instructions
@@ -511,6 +556,7 @@ combine_block(jit_function_t func, jit_block_t block, int *changed)
 	   rather than allocating a fresh array for the empty block. */
 	block->insns = succ_block->insns;
 	block->max_insns = succ_block->max_insns;
+	block->insns_shared = succ_block->insns_shared;
 	if(branch)
 	{
 		/* Copy the branch instruction */
@@ -524,6 +570,7 @@ combine_block(jit_function_t func, jit_block_t block, int *changed)
 	succ_block->insns = insns;
 	succ_block->max_insns = max_insns;
 	succ_block->num_insns = num_insns;
+	succ_block->insns_shared = shared;
 
 	merge_empty(func, block, changed);
 }
@@ -698,7 +745,7 @@ count_blocks(jit_function_t func)
 static void
 free_order(jit_function_t func)
 {
-	jit_free(func->builder->block_order);
+	_jit_builder_free(func->builder, func->builder->block_order);
 	func->builder->block_order = NULL;
 	func->builder->num_block_order = 0;
 }
@@ -768,6 +815,10 @@ _jit_invert_condition (int opcode)
 {
 	switch(opcode)
 	{
+	case JIT_OP_BR_IFALSE:	opcode = JIT_OP_BR_ITRUE;    break;
+	case JIT_OP_BR_ITRUE:	opcode = JIT_OP_BR_IFALSE;   break;
+	case JIT_OP_BR_LFALSE:	opcode = JIT_OP_BR_LTRUE;    break;
+	case JIT_OP_BR_LTRUE:	opcode = JIT_OP_BR_LFALSE;   break;
 	case JIT_OP_BR_IEQ:	opcode = JIT_OP_BR_INE;      break;
 	case JIT_OP_BR_INE:	opcode = JIT_OP_BR_IEQ;      break;
 	case JIT_OP_BR_ILT:	opcode = JIT_OP_BR_IGE;      break;
@@ -823,6 +874,25 @@ _jit_invert_condition (int opcode)
 	return opcode;
 }
 
+/*
+ * Swap the "likely" and "unlikely" hints of a branch whose condition
+ * was inverted.
+ */
+static void
+invert_hint(jit_insn_t insn)
+{
+	int hint = insn->flags & (JIT_INSN_BRANCH_LIKELY | JIT_INSN_BRANCH_UNLIKELY);
+	insn->flags &= ~(JIT_INSN_BRANCH_LIKELY | JIT_INSN_BRANCH_UNLIKELY);
+	if(hint == JIT_INSN_BRANCH_LIKELY)
+	{
+		insn->flags |= JIT_INSN_BRANCH_UNLIKELY;
+	}
+	else if(hint == JIT_INSN_BRANCH_UNLIKELY)
+	{
+		insn->flags |= JIT_INSN_BRANCH_LIKELY;
+	}
+}
+
 void
 _jit_block_clean_cfg(jit_function_t func)
 {
@@ -946,6 +1016,7 @@ _jit_block_clean_cfg(jit_function_t func)
 					.L0:
 				*/
 				insn->opcode = _jit_invert_condition(insn->opcode);
+				invert_hint(insn);
 				detach_edge_dst(block->succs[0]);
 				attach_edge_dst(block->succs[0], block->next->succs[0]->dst);
 				insn->dest = (jit_value_t) block->next->succs[0]->dst->label;
@@ -1017,16 +1088,18 @@ _jit_block_compute_postorder(jit_function_t func)
 
 	num_blocks = count_blocks(func);
 
-	blocks = (jit_block_t *) jit_malloc(num_blocks * sizeof(jit_block_t));
+	blocks = (jit_block_t *) _jit_builder_malloc(func->builder,
+						     num_blocks * sizeof(jit_block_t));
 	if(!blocks)
 	{
 		return 0;
 	}
 
-	stack = (_jit_block_stack_entry_t *) jit_malloc(num_blocks * sizeof(_jit_block_stack_entry_t));
+	stack = (_jit_block_stack_entry_t *) _jit_builder_malloc
+		(func->builder, num_blocks * sizeof(_jit_block_stack_entry_t));
 	if(!stack)
 	{
-		jit_free(blocks);
+		_jit_builder_free(func->builder, blocks);
 		return 0;
 	}
 
@@ -1063,10 +1136,11 @@ _jit_block_compute_postorder(jit_function_t func)
 	}
 	while(top);
 
-	jit_free(stack);
+	_jit_builder_free(func->builder, stack);
 	if(num < num_blocks)
 	{
-		blocks = jit_realloc(blocks, num * sizeof(jit_block_t));
+		blocks = _jit_builder_realloc(func->builder, blocks,
+					      num * sizeof(jit_block_t));
 	}
 
 	func->builder->block_order = blocks;
@@ -1074,13 +1148,313 @@ _jit_block_compute_postorder(jit_function_t func)
 	return 1;
 }
 
+/*
+ * Get the label of a block, giving it a new one if it has none.
+ */
+static jit_label_t
+get_block_label(jit_function_t func, jit_block_t block)
+{
+	jit_label_t label;
+
+	if(block->label == jit_label_undefined)
+	{
+		label = func->builder->next_label++;
+		if(!_jit_block_record_label(block, label))
+		{
+			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+		}
+	}
+	return block->label;
+}
+
+jit_block_t
+_jit_block_add_jump(jit_function_t func, jit_block_t block)
+{
+	_jit_edge_t edge, fallthru_edge;
+	jit_block_t new_block, dst;
+	jit_insn_t insn;
+	int index;
+
+	/* Find the edge to the next block */
+	fallthru_edge = 0;
+	for(index = 0; index < block->num_succs; index++)
+	{
+		if(block->succs[index]->flags == _JIT_EDGE_FALLTHRU)
+		{
+			fallthru_edge = block->succs[index];
+		}
+	}
+	if(!fallthru_edge)
+	{
+		return 0;
+	}
+	dst = fallthru_edge->dst;
+
+	new_block = _jit_block_create(func);
+	if(!new_block)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	new_block->succs = _jit_builder_malloc(func->builder, sizeof(_jit_edge_t));
+	insn = _jit_block_add_insn(new_block);
+	if(!new_block->succs || !insn)
+	{
+		_jit_block_destroy(new_block);
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	edge = jit_memory_pool_alloc(&func->builder->edge_pool, struct _jit_edge);
+	if(!edge)
+	{
+		_jit_block_destroy(new_block);
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	insn->opcode = JIT_OP_BR;
+	insn->flags = JIT_INSN_DEST_IS_LABEL;
+	insn->dest = (jit_value_t) get_block_label(func, dst);
+	new_block->ends_in_dead = 1;
+	_jit_block_attach_after(block, new_block, new_block);
+
+	/* The block now falls through to the new block, which branches
+	   to the old destination */
+	detach_edge_dst(fallthru_edge);
+	attach_edge_dst(fallthru_edge, new_block);
+
+	edge->src = new_block;
+	edge->flags = _JIT_EDGE_BRANCH;
+	new_block->succs[0] = edge;
+	new_block->num_succs = 1;
+	attach_edge_dst(edge, dst);
+
+	return new_block;
+}
+
+int
+_jit_block_invert_branch(jit_function_t func, jit_block_t block)
+{
+	_jit_edge_t branch, fallthru;
+	jit_block_t dst;
+	jit_insn_t insn;
+
+	insn = _jit_block_get_last(block);
+	if(!insn || insn->opcode <= JIT_OP_BR || insn->opcode > JIT_OP_BR_NFGE_INV
+	   || block->num_succs != 2
+	   || block->succs[0]->flags != _JIT_EDGE_BRANCH
+	   || block->succs[1]->flags != _JIT_EDGE_FALLTHRU)
+	{
+		return 0;
+	}
+	branch = block->succs[0];
+	fallthru = block->succs[1];
+
+	insn->opcode = _jit_invert_condition(insn->opcode);
+	insn->dest = (jit_value_t) get_block_label(func, fallthru->dst);
+	invert_hint(insn);
+
+	/* The edges keep their kind and swap their destinations */
+	dst = branch->dst;
+	detach_edge_dst(branch);
+	attach_edge_dst(branch, fallthru->dst);
+	detach_edge_dst(fallthru);
+	attach_edge_dst(fallthru, dst);
+	return 1;
+}
+
+jit_block_t
+_jit_block_split_fallthru(jit_function_t func, jit_block_t block)
+{
+	_jit_edge_t edge, fallthru_edge;
+	jit_block_t new_block;
+	int index;
+
+	/* Find the edge from the previous block */
+	fallthru_edge = 0;
+	for(index = 0; index < block->num_preds; index++)
+	{
+		if(block->preds[index]->flags == _JIT_EDGE_FALLTHRU)
+		{
+			fallthru_edge = block->preds[index];
+		}
+	}
+	if(!fallthru_edge)
+	{
+		return 0;
+	}
+
+	new_block = _jit_block_create(func);
+	if(!new_block)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	new_block->succs = _jit_builder_malloc(func->builder, sizeof(_jit_edge_t));
+	if(!new_block->succs)
+	{
+		_jit_block_destroy(new_block);
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	edge = jit_memory_pool_alloc(&func->builder->edge_pool, struct _jit_edge);
+	if(!edge)
+	{
+		_jit_block_destroy(new_block);
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	_jit_block_attach_before(block, new_block, new_block);
+
+	/* The previous block now falls through to the new block,
+	   which in turn falls through to the original block */
+	detach_edge_dst(fallthru_edge);
+	attach_edge_dst(fallthru_edge, new_block);
+
+	edge->src = new_block;
+	edge->flags = _JIT_EDGE_FALLTHRU;
+	new_block->succs[0] = edge;
+	new_block->num_succs = 1;
+	attach_edge_dst(edge, block);
+
+	return new_block;
+}
+
+static jit_block_t
+intersect_dominators(jit_block_t block1, jit_block_t block2)
+{
+	while(block1 != block2)
+	{
+		while(block1->index < block2->index)
+		{
+			block1 = block1->idom;
+		}
+		while(block2->index < block1->index)
+		{
+			block2 = block2->idom;
+		}
+	}
+	return block1;
+}
+
+int
+_jit_block_compute_dominators(jit_function_t func)
+{
+	jit_block_t block, pred, new_idom;
+	int index, edge, changed;
+
+	/*
+	 * The code below is based on the algorithm described in
+	 * "A Simple, Fast Dominance Algorithm" by Keith D. Cooper,
+	 * Timothy J. Harvey and Ken Kennedy.
+	 */
+
+	if(!_jit_block_compute_postorder(func))
+	{
+		return 0;
+	}
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		block->visited = 0;
+		block->index = -1;
+		block->idom = 0;
+	}
+	for(index = 0; index < func->builder->num_block_order; index++)
+	{
+		func->builder->block_order[index]->index = index;
+	}
+
+	block = func->builder->entry_block;
+	block->idom = block;
+	do
+	{
+		changed = 0;
+
+		/* Go through blocks in reverse post order skipping the entry block */
+		for(index = func->builder->num_block_order - 2; index >= 0; index--)
+		{
+			block = func->builder->block_order[index];
+			new_idom = 0;
+			for(edge = 0; edge < block->num_preds; edge++)
+			{
+				pred = block->preds[edge]->src;
+				if(pred->index < 0 || !pred->idom)
+				{
+					continue;
+				}
+				if(!new_idom)
+				{
+					new_idom = pred;
+				}
+				else
+				{
+					new_idom = intersect_dominators(pred, new_idom);
+				}
+			}
+			if(block->idom != new_idom)
+			{
+				block->idom = new_idom;
+				changed = 1;
+			}
+		}
+	}
+	while(changed);
+
+	func->builder->entry_block->idom = 0;
+	return 1;
+}
+
+int
+_jit_block_dominates(jit_block_t dom, jit_block_t block)
+{
+	while(block && block != dom)
+	{
+		block = block->idom;
+	}
+	return block != 0;
+}
+
+void
+_jit_block_resolve_branch(jit_function_t func, jit_block_t block, int taken)
+{
+	_jit_edge_t branch, fallthru;
+	jit_insn_t insn;
+	int index;
+
+	branch = 0;
+	fallthru = 0;
+	for(index = 0; index < block->num_succs; index++)
+	{
+		if(block->succs[index]->flags == _JIT_EDGE_BRANCH)
+		{
+			branch = block->succs[index];
+		}
+		else if(block->succs[index]->flags == _JIT_EDGE_FALLTHRU)
+		{
+			fallthru = block->succs[index];
+		}
+	}
+	if(!branch || !fallthru)
+	{
+		return;
+	}
+
+	insn = _jit_block_get_last(block);
+	if(taken)
+	{
+		insn->opcode = JIT_OP_BR;
+		insn->value1 = 0;
+		insn->value2 = 0;
+		block->ends_in_dead = 1;
+		delete_edge(func, fallthru);
+	}
+	else
+	{
+		insn->opcode = JIT_OP_NOP;
+		delete_edge(func, branch);
+	}
+}
+
 jit_block_t
 _jit_block_create(jit_function_t func)
 {
 	jit_block_t block;
 
 	/* Allocate memory for the block */
-	block = jit_cnew(struct _jit_block);
+	block = _jit_builder_calloc(func->builder, 1, sizeof(struct _jit_block));
 	if(!block)
 	{
 		return 0;
@@ -1103,10 +1477,10 @@ _jit_block_destroy(jit_block_t block)
 	   not freed) separately. However succs and preds arrays are freed,
 	   these contain pointers to edges, not edges themselves. */
 	jit_meta_destroy(&block->meta);
-	jit_free(block->succs);
-	jit_free(block->preds);
-	jit_free(block->insns);
-	jit_free(block);
+	_jit_builder_free(block->func->builder, block->succs);
+	_jit_builder_free(block->func->builder, block->preds);
+	free_insns(block);
+	_jit_builder_free(block->func->builder, block);
 }
 
 void
@@ -1153,8 +1527,9 @@ ensure_label_table(jit_function_t func, jit_label_t label)
 			num *= 2;
 		}
 
-		info = (_jit_label_info_t *) jit_realloc(func->builder->label_info,
-							 num * sizeof(_jit_label_info_t));
+		info = (_jit_label_info_t *) _jit_builder_realloc
+			(func->builder, func->builder->label_info,
+			 num * sizeof(_jit_label_info_t));
 		if(!info)
 		{
 			return 0;
@@ -1217,8 +1592,7 @@ _jit_block_add_insn(jit_block_t block)
 	if(block->num_insns == block->max_insns)
 	{
 		max_insns = block->max_insns ? block->max_insns * 2 : 4;
-		insns = (jit_insn_t) jit_realloc(block->insns,
-						 max_insns * sizeof(struct _jit_insn));
+		insns = realloc_insns(block, max_insns);
 		if(!insns)
 		{
 			return 0;
@@ -1226,6 +1600,7 @@ _jit_block_add_insn(jit_block_t block)
 
 		block->insns = insns;
 		block->max_insns = max_insns;
+		block->insns_shared = 0;
 	}
 
 	/* Zero-init the instruction */
@@ -1235,6 +1610,74 @@ _jit_block_add_insn(jit_block_t block)
 	return &block->insns[block->num_insns++];
 }
 
+jit_insn_t
+_jit_block_insert_insn(jit_block_t block, int posn)
+{
+	jit_insn_t insn;
+
+	/* Append the instruction and then move it into place */
+	insn = _jit_block_add_insn(block);
+	if(!insn)
+	{
+		return 0;
+	}
+	insn = &block->insns[posn];
+	jit_memmove(insn + 1, insn, (block->num_insns - 1 - posn) * sizeof(struct _jit_insn));
+	jit_memzero(insn, sizeof(struct _jit_insn));
+	return insn;
+}
+
+void
+_jit_block_compact_insns(jit_function_t func)
+{
+	jit_builder_t builder;
+	jit_block_t block;
+	jit_insn_t insns;
+	int num_insns;
+
+	builder = func->builder;
+	num_insns = 0;
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		num_insns += block->num_insns;
+	}
+	if(num_insns == 0)
+	{
+		return;
+	}
+
+	/* If out of memory then the instructions stay where they are */
+	insns = (jit_insn_t) _jit_builder_malloc
+		(builder, num_insns * sizeof(struct _jit_insn));
+	if(!insns)
+	{
+		return;
+	}
+
+	num_insns = 0;
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		if(block->num_insns > 0)
+		{
+			jit_memcpy(insns + num_insns, block->insns,
+				   block->num_insns * sizeof(struct _jit_insn));
+		}
+		free_insns(block);
+		if(block->num_insns > 0)
+		{
+			block->insns = insns + num_insns;
+			block->insns_shared = 1;
+		}
+		block->max_insns = block->num_insns;
+		num_insns += block->num_insns;
+	}
+
+	/* Release the array of the previous compaction, if any */
+	_jit_builder_free(builder, builder->insns);
+	builder->insns = insns;
+	builder->num_insns = num_insns;
+}
+
 jit_insn_t
 _jit_block_get_last(jit_block_t block)
 {
@@ -1261,6 +1704,17 @@ _jit_block_is_final(jit_block_t block)
 	return 1;
 }
 
+int
+_jit_block_is_fallthrough_only(jit_block_t block)
+{
+	if(!block->func->is_optimized || block->address_of || block->num_preds != 1)
+	{
+		return 0;
+	}
+	return (block->preds[0]->src == block->prev
+		&& block->preds[0]->flags == _JIT_EDGE_FALLTHRU);
+}
+
 /*@
  * @deftypefun jit_function_t jit_block_get_function (jit_block_t @var{block})
  * Get the function that a particular @var{block} belongs to.
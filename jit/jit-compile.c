@@ -25,6 +25,16 @@
 #include "jit-rules.h"
 #include "jit-reg-alloc.h"
 #include "jit-setjmp.h"
+#if TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# if HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# elif !defined(__palmos__)
+#  include <time.h>
+# endif
+#endif
 #ifdef _JIT_COMPILE_DEBUG
 # include <jit/jit-dump.h>
 # include <stdio.h>
@@ -43,10 +53,37 @@ typedef struct
 	int			restart;
 	int			page_factor;
 
+	/* Number of instructions that the code size was estimated for */
+	jit_ulong		num_insns;
+
 	struct jit_gencode	gen;
 
+#ifdef JIT_USE_EXCEPTION_TABLES
+	/* Exception table of the generated code, if any */
+	_jit_catch_table_t	catch_table;
+#endif
+
+	/* Statistics if JIT_OPTION_COMPILE_STATS is set */
+	int			collect_stats;
+	jit_compile_stats_t	stats;
+	jit_ulong		codegen_start;
+
 } _jit_compile_t;
 
+/*
+ * The code size of an instruction that is assumed until the context
+ * has compiled enough code to know better, and the number of compiled
+ * instructions that this assumption is worth.
+ */
+#define	JIT_CODE_INSN_SIZE		16
+#define	JIT_CODE_INSN_SAMPLE		64
+
+/*
+ * Limit on the number of times the code space is extended to make room
+ * for the estimated size of a function before code generation.
+ */
+#define	JIT_CODE_MAX_EXTEND		16
+
 #define _JIT_RESULT_TO_OBJECT(x)	((void *) ((jit_nint) (x) - JIT_RESULT_OK))
 #define _JIT_RESULT_FROM_OBJECT(x)	((jit_nint) ((void *) (x)) + JIT_RESULT_OK)
 
@@ -59,6 +96,34 @@ internal_exception_handler(int exception_type)
 	return _JIT_RESULT_TO_OBJECT(exception_type);
 }
 
+/*
+ * Get the time in nanoseconds for the compile statistics.  Returns zero
+ * if the statistics are not collected.
+ */
+static jit_ulong
+get_time(_jit_compile_t *state)
+{
+	if(!state->collect_stats)
+	{
+		return 0;
+	}
+#if defined(CLOCK_MONOTONIC)
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (jit_ulong) ts.tv_sec * 1000000000 + ts.tv_nsec;
+	}
+#elif defined(HAVE_SYS_TIME_H)
+	{
+		struct timeval tv;
+		gettimeofday(&tv, 0);
+		return (jit_ulong) tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+	}
+#else
+	return 0;
+#endif
+}
+
 /*
  * Optimize a function.
  */
@@ -77,10 +142,43 @@ optimize(jit_function_t func)
 	/* Eliminate useless control flow */
 	_jit_block_clean_cfg(func);
 
+	/* Propagate constants and copies and remove dead code, the
+	   resolved branches might leave more control flow to clean up */
+	if(func->optimization_level >= JIT_OPTLEVEL_AGGRESSIVE
+	   && _jit_function_optimize_ssa(func))
+	{
+		_jit_block_clean_cfg(func);
+	}
+
+	/* Move loop invariant code out of the loops */
+	if(func->optimization_level >= JIT_OPTLEVEL_AGGRESSIVE)
+	{
+		_jit_function_optimize_loops(func);
+	}
+
+	/* Keep the likely paths together and the unlikely ones out of the way */
+	_jit_function_layout_blocks(func);
+
 	/* Optimization is done */
 	func->is_optimized = 1;
 }
 
+/*
+ * Stop the callers from copying the instructions of a function for
+ * inlining before they are optimized and freed.  The callers copy the
+ * instructions under the same monitor (see _jit_function_inline).
+ */
+static void
+claim_builder(jit_function_t func)
+{
+	if(func->is_complete)
+	{
+		jit_monitor_lock(&func->context->compile_monitor);
+		func->is_complete = 0;
+		jit_monitor_unlock(&func->context->compile_monitor);
+	}
+}
+
 /*@
  * @deftypefun int jit_optimize (jit_function_t @var{func})
  * Optimize a function by analyzing and transforming its intermediate
@@ -125,6 +223,8 @@ jit_optimize(jit_function_t func)
 		}
 	}
 
+	claim_builder(func);
+
 	/* Override user's exception handler */
 	handler = jit_exception_set_handler(internal_exception_handler);
 
@@ -479,22 +579,64 @@ memory_start(_jit_compile_t *state)
 	_jit_varint_init_encoder(&state->gen.offset_encoder);
 }
 
+/*
+ * Estimate the size of the code of the function from the amount of code
+ * per instruction of the functions that were compiled before.
+ */
+static jit_ulong
+estimate_code_size(_jit_compile_t *state)
+{
+	jit_context_t context = state->gen.context;
+	jit_block_t block;
+	jit_ulong size;
+
+	state->num_insns = 0;
+	for(block = state->func->builder->entry_block; block; block = block->next)
+	{
+		state->num_insns += block->num_insns;
+	}
+
+	size = state->num_insns
+		* (context->code_bytes + JIT_CODE_INSN_SIZE * JIT_CODE_INSN_SAMPLE)
+		/ (context->code_insns + JIT_CODE_INSN_SAMPLE);
+
+	/* Leave some slack for the functions that come out larger than
+	   the average and for their constants */
+	return JIT_FUNCTION_ALIGNMENT + 2 * JIT_PROLOG_SIZE + size + size / 4;
+}
+
 /*
  * Allocate some amount of code space.
  */
 static void
 memory_alloc(_jit_compile_t *state)
 {
+	jit_context_t context = state->gen.context;
+	jit_ulong size;
 	int result;
 
 	/* Try to allocate within the current memory limit */
-	result = _jit_memory_start_function(state->gen.context, state->func);
+	result = _jit_memory_start_function(context, state->func);
 	if(result == JIT_MEMORY_RESTART)
 	{
 		/* Not enough space. Request to extend the limit and retry */
-		_jit_memory_extend_limit(state->gen.context, state->page_factor++);
-		result = _jit_memory_start_function(state->gen.context, state->func);
+		_jit_memory_extend_limit(context, state->page_factor++);
+		result = _jit_memory_start_function(context, state->func);
 	}
+
+	/* Move on to a larger space up front if the code is not going to
+	   fit, rather than generating all of it again when it runs out of
+	   space.  Code generation still restarts if the estimate is short */
+	size = estimate_code_size(state);
+	while(result == JIT_MEMORY_OK && state->page_factor < JIT_CODE_MAX_EXTEND
+	      && (jit_ulong) ((char *) _jit_memory_get_limit(context)
+			      - (char *) _jit_memory_get_break(context)) < size)
+	{
+		_jit_memory_end_function(context, JIT_MEMORY_RESTART);
+		_jit_memory_extend_limit(context, state->page_factor++);
+		result = _jit_memory_start_function(context, state->func);
+	}
+
 	if(result != JIT_MEMORY_OK)
 	{
 		/* Failed to allocate any space */
@@ -540,6 +682,10 @@ memory_flush(_jit_compile_t *state)
 			}
 		}
 
+		/* Learn the code size for the estimates of the next functions */
+		state->gen.context->code_bytes += state->gen.code_end - state->gen.code_start;
+		state->gen.context->code_insns += state->num_insns;
+
 #ifndef JIT_BACKEND_INTERP
 		/* On success perform a CPU cache flush, to make the code executable */
 		_jit_flush_exec(state->gen.code_start,
@@ -552,6 +698,38 @@ memory_flush(_jit_compile_t *state)
 			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
 		}
 		state->func->bytecode_offset = _jit_varint_get_data(&state->gen.offset_encoder);
+
+		/* Tell perf about the new code */
+		_jit_perf_record(state->func, state->gen.code_start,
+				 state->gen.code_end, state->gen.mem_start);
+
+		/* Keep the relocations for the ELF writer */
+		jit_free(state->func->reloc_table);
+		state->func->reloc_table = state->gen.reloc_table;
+		state->gen.reloc_table = 0;
+
+#ifdef JIT_USE_EXCEPTION_TABLES
+		/* Let the unwinder find the catcher of the new code */
+		state->func->catch_table = state->catch_table;
+		if(state->catch_table)
+		{
+			_jit_unwind_add_context(state->func->context);
+		}
+#endif
+
+#ifdef JIT_USE_UNWIND_INFO
+		/* Describe the frame of the new code to the system unwinder.
+		   The exception tables are found with it, so every function
+		   between a throw and a catcher needs it */
+		if(jit_context_get_meta_numeric(state->func->context,
+						JIT_OPTION_UNWIND_INFO)
+		   || jit_context_get_meta_numeric(state->func->context,
+						   JIT_OPTION_EXCEPTION_TABLES))
+		{
+			_jit_unwind_register(state->func,
+					     _jit_gen_unwind_info(&state->gen, state->func));
+		}
+#endif
 	}
 }
 
@@ -603,6 +781,8 @@ memory_realloc(_jit_compile_t *state)
 static void
 codegen_prepare(_jit_compile_t *state)
 {
+	jit_ulong time;
+
 	/* Intuit "nothrow" and "noreturn" flags for this function */
 	if(!state->func->builder->may_throw)
 	{
@@ -613,15 +793,97 @@ codegen_prepare(_jit_compile_t *state)
 		state->func->no_return = 1;
 	}
 
+	/* Lay out the instructions next to each other for the passes below */
+	_jit_block_compact_insns(state->func);
+
 	/* Compute liveness and "next use" information for this function */
+	time = get_time(state);
 	_jit_function_compute_liveness(state->func);
+	state->stats.liveness_time = get_time(state) - time;
 
 	/* Allocate global registers to variables within the function */
 #ifndef JIT_BACKEND_INTERP
+	time = get_time(state);
 	_jit_regs_alloc_global(&state->gen, state->func);
+	state->stats.regalloc_time = get_time(state) - time;
 #endif
 }
 
+/*
+ * Record the statistics of a successful compilation in the function
+ * and add them to the totals of the context.  The memory context is
+ * locked at this point.
+ */
+static void
+record_stats(_jit_compile_t *state, jit_ulong start_time)
+{
+	jit_function_t func = state->func;
+	jit_compile_stats_t *stats = &state->stats;
+	jit_compile_stats_t *total = &func->context->compile_stats;
+	jit_block_t block;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+
+	stats->num_functions = 1;
+	block = 0;
+	while((block = jit_block_next(func, block)) != 0)
+	{
+		++(stats->num_blocks);
+		jit_insn_iter_init(&iter, block);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			if(insn->opcode != JIT_OP_NOP)
+			{
+				++(stats->num_insns);
+			}
+		}
+	}
+	stats->code_size = state->gen.code_end - state->gen.code_start;
+	stats->num_spills = state->gen.num_spills;
+	stats->num_reloads = state->gen.num_reloads;
+	stats->total_time = get_time(state) - start_time;
+
+	if(!func->compile_stats)
+	{
+		func->compile_stats = jit_new(jit_compile_stats_t);
+	}
+	if(func->compile_stats)
+	{
+		*(func->compile_stats) = *stats;
+	}
+
+	total->num_functions += stats->num_functions;
+	total->num_restarts += stats->num_restarts;
+	total->num_blocks += stats->num_blocks;
+	total->num_insns += stats->num_insns;
+	total->code_size += stats->code_size;
+	total->num_spills += stats->num_spills;
+	total->num_reloads += stats->num_reloads;
+	total->optimize_time += stats->optimize_time;
+	total->liveness_time += stats->liveness_time;
+	total->regalloc_time += stats->regalloc_time;
+	total->codegen_time += stats->codegen_time;
+	total->total_time += stats->total_time;
+}
+
+#ifndef JIT_BACKEND_INTERP
+/*
+ * Determine if the register state at the end of a block can be passed
+ * on to the next block.  This needs the control flow graph to tell that
+ * the next block is only reached by falling through from this one.
+ */
+static int
+can_carry_registers(jit_function_t func, jit_block_t block)
+{
+	/* Exception handlers expect all the values in the frame */
+	if(func->has_try || !block->next)
+	{
+		return 0;
+	}
+	return _jit_block_is_fallthrough_only(block->next);
+}
+#endif
+
 /*
  * Run codegen.
  */
@@ -631,11 +893,43 @@ codegen(_jit_compile_t *state)
 	jit_function_t func = state->func;
 	struct jit_gencode *gen = &state->gen;
 	jit_block_t block;
+#ifndef JIT_BACKEND_INTERP
+	int carry = 0;
+#endif
 
 	/* Remember the start code address (due to alignment it may differ from
 	   the available space start - gen->start) */
 	gen->code_start = gen->ptr;
 
+#ifndef JIT_BACKEND_INTERP
+	/* Record the places in the code that the ELF writer relocates */
+	if(jit_context_get_meta_numeric(func->context, JIT_OPTION_PRE_COMPILE))
+	{
+		if(!gen->reloc_table)
+		{
+			gen->reloc_table = jit_cnew(struct _jit_reloc_table);
+			if(!gen->reloc_table)
+			{
+				jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+			}
+			gen->reloc_table->max_relocs = 1;
+		}
+		gen->reloc_table->data_start = 0;
+		gen->reloc_table->data_end = 0;
+		gen->reloc_table->num_relocs = 0;
+	}
+#endif
+
+#ifdef JIT_USE_EXCEPTION_TABLES
+	/* The unwinder stores the location of a throw into "thrown_pc",
+	   so it needs a place in the frame even if it is never used */
+	state->catch_table = 0;
+	if(func->builder->catch_by_table)
+	{
+		_jit_gen_fix_value(func->builder->thrown_pc);
+	}
+#endif
+
 #ifdef JIT_PROLOG_SIZE
 	/* Output space for the function prolog */
 	_jit_gen_check_space(gen, JIT_PROLOG_SIZE);
@@ -650,16 +944,30 @@ codegen(_jit_compile_t *state)
 		_jit_gen_start_block(gen, block);
 
 #ifndef JIT_BACKEND_INTERP
-		/* Clear the local register assignments */
-		_jit_regs_init_for_block(gen);
+		/* Clear the local register assignments unless the previous
+		   block passed them on */
+		if(!carry)
+		{
+			_jit_regs_init_for_block(gen);
+		}
 #endif
 
 		/* Generate the block's code */
 		compile_block(gen, func, block);
 
 #ifndef JIT_BACKEND_INTERP
-		/* Spill all live register values back to their frame positions */
-		_jit_regs_spill_all(gen);
+		/* Keep the register assignments for the next block if it can
+		   only be reached from here.  Otherwise spill all live register
+		   values back to their frame positions */
+		carry = can_carry_registers(func, block);
+		if(carry)
+		{
+			_jit_regs_carry_over(gen);
+		}
+		else
+		{
+			_jit_regs_spill_all(gen);
+		}
 #endif
 
 		/* Notify the back end that the block is finished */
@@ -677,6 +985,13 @@ codegen(_jit_compile_t *state)
 	gen->code_start = _jit_gen_prolog(gen, func, gen->code_start);
 #endif
 
+#ifdef JIT_USE_EXCEPTION_TABLES
+	if(func->builder->catch_by_table)
+	{
+		state->catch_table = _jit_gen_catch_table(gen, func);
+	}
+#endif
+
 #if !defined(JIT_BACKEND_INTERP) && (!defined(jit_redirector_size) || !defined(jit_indirector_size))
 	/* If the function is recompilable, then we need an extra entry
 	   point to properly redirect previous references to the function */
@@ -697,11 +1012,15 @@ compile(_jit_compile_t *state, jit_function_t func)
 {
 	jit_exception_func handler;
 	jit_jmp_buf jbuf;
+	jit_ulong start_time, time;
 	int result;
 
 	/* Initialize compilation state */
 	jit_memzero(state, sizeof(_jit_compile_t));
 	state->func = func;
+	state->collect_stats = (jit_context_get_meta_numeric
+				(func->context, JIT_OPTION_COMPILE_STATS) != 0);
+	start_time = get_time(state);
 
 	/* Replace user's exception handler with internal handler */
 	handler = jit_exception_set_handler(internal_exception_handler);
@@ -720,6 +1039,7 @@ compile(_jit_compile_t *state, jit_function_t func)
 		{
 			/* Restart code generation after the memory full condition */
 			state->restart = 1;
+			++(state->stats.num_restarts);
 			goto restart;
 		}
 
@@ -733,7 +1053,9 @@ compile(_jit_compile_t *state, jit_function_t func)
 		/* Start compilation */
 
 		/* Perform machine-independent optimizations */
+		time = get_time(state);
 		optimize(state->func);
+		state->stats.optimize_time = get_time(state) - time;
 
 		/* Prepare data needed for code generation */
 		codegen_prepare(state);
@@ -772,7 +1094,14 @@ compile(_jit_compile_t *state, jit_function_t func)
 	jit_extra_gen_init(&state->gen);
 #endif
 
-	/* Perform code generation */
+	/* Perform code generation.  The time of the attempts that were
+	   restarted is included */
+	if(state->stats.num_restarts == 0)
+	{
+		state->codegen_start = get_time(state);
+	}
+	state->gen.num_spills = 0;
+	state->gen.num_reloads = 0;
 	codegen(state);
 
 #ifdef jit_extra_gen_cleanup
@@ -782,14 +1111,22 @@ compile(_jit_compile_t *state, jit_function_t func)
 
 	/* End the function's output process */
 	memory_flush(state);
+	state->stats.codegen_time = get_time(state) - state->codegen_start;
 
 	/* Compilation done, no exceptions occurred */
+	if(state->collect_stats)
+	{
+		record_stats(state, start_time);
+	}
 	result = JIT_RESULT_OK;
 
  exit:
 	/* Release the memory context */
 	memory_release(state);
 
+	/* Free the relocations if the compilation failed */
+	jit_free(state->gen.reloc_table);
+
 	/* Restore the "setjmp" context */
 	_jit_unwind_pop_setjmp();
 
@@ -827,6 +1164,12 @@ jit_compile(jit_function_t func)
 		return JIT_RESULT_NULL_FUNCTION;
 	}
 
+	/* A copy that is built for inlining keeps its instructions */
+	if(func->inline_depth)
+	{
+		return JIT_RESULT_OK;
+	}
+
 	/* Bail out if there is nothing to do here */
 	if(!func->builder)
 	{
@@ -843,6 +1186,7 @@ jit_compile(jit_function_t func)
 	}
 
 	/* Compile and record the entry point */
+	claim_builder(func);
 	result = compile(&state, func);
 	if(result == JIT_RESULT_OK)
 	{
@@ -885,6 +1229,12 @@ jit_compile_entry(jit_function_t func, void **entry_point)
 		return JIT_RESULT_NULL_FUNCTION;
 	}
 
+	/* A copy that is built for inlining keeps its instructions */
+	if(func->inline_depth)
+	{
+		return JIT_RESULT_OK;
+	}
+
 	/* Bail out if there is nothing to do here */
 	if(!func->builder)
 	{
@@ -902,6 +1252,7 @@ jit_compile_entry(jit_function_t func, void **entry_point)
 	}
 
 	/* Compile and return the entry point */
+	claim_builder(func);
 	result = compile(&state, func);
 	if(result == JIT_RESULT_OK)
 	{
@@ -972,47 +1323,151 @@ jit_function_compile_entry(jit_function_t func, void **entry_point)
 	return (JIT_RESULT_OK == jit_compile_entry(func, entry_point));
 }
 
+/*
+ * Build the function with the user's on-demand compiler and compile it.
+ */
+static int
+compile_on_demand(jit_function_t func)
+{
+	_jit_compile_t state;
+	unsigned int level;
+	int result, tiered;
+
+	if(!func->on_demand)
+	{
+		/* Bail out with an error if the user didn't supply an
+		   on-demand compiler */
+		return JIT_RESULT_COMPILE_ERROR;
+	}
+
+	/* Compile quickly at first if tiered compilation is enabled */
+	level = func->optimization_level;
+	tiered = _jit_tier_begin(func);
+
+	/* Call the user's on-demand compiler. */
+	result = (func->on_demand)(func);
+	if(result == JIT_RESULT_OK && !func->is_compiled)
+	{
+		if(tiered)
+		{
+			_jit_tier_count_back_edges(func);
+			_jit_tier_count_branches(func);
+		}
+
+		/* Compile the function if the user didn't do so */
+		result = compile(&state, func);
+		if(result == JIT_RESULT_OK)
+		{
+			func->entry_point = state.gen.code_start;
+			func->is_compiled = 1;
+		}
+	}
+	_jit_function_free_builder(func);
+
+	if(tiered)
+	{
+		_jit_tier_end(func, level, result);
+	}
+
+	return result;
+}
+
+/*
+ * Lock a function for on-demand compilation.  Returns zero if the
+ * function was compiled by another thread while we were waiting.
+ *
+ * With JIT_OPTION_CONCURRENT_COMPILE the whole context is not locked.
+ * Only threads that need the same function wait for each other, the
+ * code cache is protected by the memory lock during code generation.
+ */
+static int
+lock_function(jit_function_t func, int concurrent, int recompile)
+{
+	jit_context_t context = func->context;
+
+	if(!concurrent)
+	{
+		/* Lock down the context */
+		jit_context_build_start(context);
+
+		/* Check again if some other thread has beaten us to it */
+		if(func->is_compiled && !recompile)
+		{
+			jit_context_build_end(context);
+			return 0;
+		}
+		return 1;
+	}
+
+	/* Wait if some other thread is already compiling this function */
+	jit_monitor_lock(&context->compile_monitor);
+	while(func->is_compiling && !(func->is_compiled && !recompile))
+	{
+		if(!jit_monitor_wait(&context->compile_monitor, -1))
+		{
+			break;
+		}
+	}
+
+	/* Fast return if the other thread has compiled the function */
+	if(func->is_compiled && !recompile)
+	{
+		jit_monitor_unlock(&context->compile_monitor);
+		return 0;
+	}
+
+	/* Claim the function for this thread */
+	func->is_compiling = 1;
+	jit_monitor_unlock(&context->compile_monitor);
+	return 1;
+}
+
+/*
+ * Unlock a function locked with "lock_function".
+ */
+static void
+unlock_function(jit_function_t func, int concurrent)
+{
+	jit_context_t context = func->context;
+
+	if(!concurrent)
+	{
+		/* Unlock the context */
+		jit_context_build_end(context);
+		return;
+	}
+
+	/* Wake up the threads that are waiting for this function */
+	jit_monitor_lock(&context->compile_monitor);
+	func->is_compiling = 0;
+	jit_monitor_signal_all(&context->compile_monitor);
+	jit_monitor_unlock(&context->compile_monitor);
+}
+
 void *
 _jit_function_compile_on_demand(jit_function_t func)
 {
-	_jit_compile_t state;
+	int concurrent;
 	int result;
 
-	/* Lock down the context */
-	jit_context_build_start(func->context);
-
 	/* Fast return if we are already compiled */
 	if(func->is_compiled)
 	{
-		jit_context_build_end(func->context);
 		return func->entry_point;
 	}
 
-	if(!func->on_demand)
+	concurrent = (int) jit_context_get_meta_numeric(func->context, JIT_OPTION_CONCURRENT_COMPILE);
+	if(lock_function(func, concurrent, 0))
 	{
-		/* Bail out with an error if the user didn't supply an
-		   on-demand compiler */
-		result = JIT_RESULT_COMPILE_ERROR;
+		result = compile_on_demand(func);
+		unlock_function(func, concurrent);
 	}
 	else
 	{
-		/* Call the user's on-demand compiler. */
-		result = (func->on_demand)(func);
-		if(result == JIT_RESULT_OK && !func->is_compiled)
-		{
-			/* Compile the function if the user didn't do so */
-			result = compile(&state, func);
-			if(result == JIT_RESULT_OK)
-			{
-				func->entry_point = state.gen.code_start;
-				func->is_compiled = 1;
-			}
-		}
-		_jit_function_free_builder(func);
+		result = JIT_RESULT_OK;
 	}
 
-	/* Unlock the context and report the result */
-	jit_context_build_end(func->context);
+	/* Report the result */
 	if(result != JIT_RESULT_OK)
 	{
 		jit_exception_builtin(result);
@@ -1023,6 +1478,46 @@ _jit_function_compile_on_demand(jit_function_t func)
 	return func->entry_point;
 }
 
+int
+_jit_function_recompile(jit_function_t func)
+{
+	_jit_compile_t state;
+	int concurrent;
+	int result;
+
+	if(!func->on_demand || !func->is_compiled)
+	{
+		return JIT_RESULT_COMPILE_ERROR;
+	}
+
+	concurrent = (int) jit_context_get_meta_numeric(func->context, JIT_OPTION_CONCURRENT_COMPILE);
+	lock_function(func, concurrent, 1);
+
+	/* Leave the function alone if somebody is rebuilding it by hand */
+	if(func->builder)
+	{
+		unlock_function(func, concurrent);
+		return JIT_RESULT_COMPILE_ERROR;
+	}
+
+	/* Rebuild the function and switch over to the new code.  The old
+	   code stays in place for the threads that are still running it */
+	result = (func->on_demand)(func);
+	if(result == JIT_RESULT_OK && func->builder)
+	{
+		_jit_tier_use_branch_profile(func);
+		result = compile(&state, func);
+		if(result == JIT_RESULT_OK)
+		{
+			func->entry_point = state.gen.code_start;
+		}
+	}
+	_jit_function_free_builder(func);
+
+	unlock_function(func, concurrent);
+	return result;
+}
+
 #define	JIT_CACHE_NO_OFFSET		(~((unsigned long)0))
 
 unsigned long
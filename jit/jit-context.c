@@ -50,6 +50,19 @@ once the function has been fully compiled.
 You can compile multiple functions during the one build process
 if you wish, which is the normal case when compiling a class.
 
+If the @code{JIT_OPTION_CONCURRENT_COMPILE} option is set on the
+context, then the lock may be omitted as long as every function is
+built by only one thread at a time.  In this mode functions in the
+same context are built, optimized, and prepared for code generation
+in parallel.  Only writing the code to the function cache is
+serialized.  The default on-demand compiler also stops locking the
+context in this mode.  Instead threads that try to invoke the same
+uncompiled function wait for the one that compiles it.
+
+With the @code{JIT_OPTION_TIERED_COMPILE} option the library starts
+a background thread of its own that recompiles hot functions.  The
+thread is stopped by @code{jit_context_destroy}.
+
 It is usually a good idea to suspend the finalization of
 garbage-collected objects while function building is in progress.
 Otherwise you may get a deadlock when the finalizer thread tries
@@ -88,10 +101,13 @@ jit_context_create(void)
 	/* Initialize the context and return it */
 	jit_mutex_create(&context->memory_lock);
 	jit_mutex_create(&context->builder_lock);
+	jit_monitor_create(&context->compile_monitor);
+	jit_monitor_create(&context->tier_monitor);
 	context->functions = 0;
 	context->last_function = 0;
 	context->on_demand_driver = _jit_function_compile_on_demand;
 	context->memory_manager = jit_default_memory_manager();
+	context->memory_stats = _jit_default_memory_stats;
 	return context;
 }
 
@@ -112,6 +128,12 @@ jit_context_destroy(jit_context_t context)
 		return;
 	}
 
+	/* Stop the background compiler before the functions go away */
+	_jit_tier_shutdown(context);
+
+	/* The unwinder must not look for catchers in this context anymore */
+	_jit_unwind_remove_context(context);
+
 	for(sym = 0; sym < context->num_registered_symbols; ++sym)
 	{
 		jit_free(context->registered_symbols[sym]);
@@ -127,6 +149,8 @@ jit_context_destroy(jit_context_t context)
 
 	jit_mutex_destroy(&context->memory_lock);
 	jit_mutex_destroy(&context->builder_lock);
+	jit_monitor_destroy(&context->compile_monitor);
+	jit_monitor_destroy(&context->tier_monitor);
 
 	jit_free(context);
 }
@@ -169,6 +193,8 @@ jit_context_build_end(jit_context_t context)
  * @enumerate
  * @item
  * The context is locked by calling @code{jit_context_build_start}.
+ * With the @code{JIT_OPTION_CONCURRENT_COMPILE} option only the function
+ * being compiled is locked.
  *
  * @item
  * If the function has already been compiled, @code{libjit} unlocks
@@ -216,7 +242,8 @@ jit_context_set_on_demand_driver(jit_context_t context, jit_on_demand_driver_fun
 
 /*@
  * @deftypefun void jit_context_set_memory_manager (jit_context_t @var{context}, jit_memory_manager_t @var{manager})
- * Specify the memory manager plug-in.
+ * Specify the memory manager plug-in.  A custom memory manager provides
+ * no statistics until @code{jit_context_set_memory_stats_func} is called.
  * @end deftypefun
 @*/
 void
@@ -229,16 +256,153 @@ jit_context_set_memory_manager(jit_context_t context, jit_memory_manager_t manag
 	}
 
 	/* Set the context memory manager */
-	if (manager)
+	if (manager && manager != jit_default_memory_manager())
 	{
 		context->memory_manager = manager;
+		context->memory_stats = 0;
 	}
 	else
 	{
 		context->memory_manager = jit_default_memory_manager();
+		context->memory_stats = _jit_default_memory_stats;
 	}
 }
 
+/*@
+ * @deftypefun void jit_context_set_memory_stats_func (jit_context_t @var{context}, jit_memory_stats_func @var{get_stats})
+ * Specify the function that fills in the statistics of a custom memory
+ * manager for @code{jit_context_get_memory_stats}.  It is called with
+ * the memory context of the manager and a structure that is cleared
+ * beforehand.  Call this after @code{jit_context_set_memory_manager}.
+ * @end deftypefun
+@*/
+void
+jit_context_set_memory_stats_func(jit_context_t context, jit_memory_stats_func get_stats)
+{
+	if (context)
+	{
+		context->memory_stats = get_stats;
+	}
+}
+
+/*@
+ * @deftypefun int jit_context_get_memory_stats (jit_context_t @var{context}, jit_memory_stats_t *@var{stats})
+ * Get the code memory usage statistics of the context.  The @var{stats}
+ * structure has the following fields:
+ *
+ * @table @code
+ * @item total_size
+ * The amount of memory taken from the system for code and data.
+ *
+ * @item used_size
+ * The amount of memory in use by functions, trampolines, and closures.
+ *
+ * @item free_size
+ * The amount of memory that is available for reuse.  This includes
+ * the space left by destroyed functions.
+ *
+ * @item free_blocks
+ * The number of separate free blocks.
+ *
+ * @item largest_free
+ * The size of the largest free block.  Comparing it with @code{free_size}
+ * shows how fragmented the memory is.
+ *
+ * @item released_size
+ * The amount of memory that has been given back to the system after
+ * all the functions using it were destroyed.
+ * @end table
+ *
+ * Returns zero if the memory manager does not provide the statistics.
+ * @end deftypefun
+@*/
+int
+jit_context_get_memory_stats(jit_context_t context, jit_memory_stats_t *stats)
+{
+	if(!context || !stats)
+	{
+		return 0;
+	}
+	jit_memzero(stats, sizeof(jit_memory_stats_t));
+
+	if(!context->memory_stats)
+	{
+		return 0;
+	}
+
+	_jit_memory_lock(context);
+	if(context->memory_context)
+	{
+		context->memory_stats(context->memory_context, stats);
+	}
+	_jit_memory_unlock(context);
+
+	return 1;
+}
+
+/*@
+ * @deftypefun int jit_context_get_compile_stats (jit_context_t @var{context}, jit_compile_stats_t *@var{stats})
+ * Get the totals of the compile statistics of all the functions that
+ * were compiled in the context while @code{JIT_OPTION_COMPILE_STATS}
+ * was set.  The @var{stats} structure has the following fields:
+ *
+ * @table @code
+ * @item num_functions
+ * The number of compilations.  A function that is recompiled is counted
+ * each time.
+ *
+ * @item num_restarts
+ * The number of times that code generation was started again because
+ * the code did not fit in the space that was set aside for it.
+ * The space is sized up front from the amount of code per instruction
+ * of the functions compiled before, so this only happens when a function
+ * comes out much larger than the average.
+ *
+ * @item num_blocks
+ * @itemx num_insns
+ * The number of basic blocks and instructions after optimization.
+ *
+ * @item code_size
+ * The number of bytes of the generated code.
+ *
+ * @item num_spills
+ * @itemx num_reloads
+ * The number of times the register allocator stored a value to the
+ * stack frame, and loaded a value back from it.
+ *
+ * @item optimize_time
+ * @itemx liveness_time
+ * @itemx regalloc_time
+ * @itemx codegen_time
+ * @itemx total_time
+ * The time in nanoseconds that is spent in the optimizer, in the liveness
+ * analysis, in the global register allocation, in code generation, which
+ * includes any restarts, and in the whole compilation.
+ *
+ * @item memory
+ * The code memory usage as @code{jit_context_get_memory_stats} reports it.
+ * @end table
+ *
+ * Returns zero if @code{JIT_OPTION_COMPILE_STATS} is not set.
+ * @end deftypefun
+@*/
+int
+jit_context_get_compile_stats(jit_context_t context, jit_compile_stats_t *stats)
+{
+	if(!context || !stats)
+	{
+		return 0;
+	}
+
+	_jit_memory_lock(context);
+	*stats = context->compile_stats;
+	_jit_memory_unlock(context);
+
+	jit_context_get_memory_stats(context, &(stats->memory));
+
+	return (jit_context_get_meta_numeric(context, JIT_OPTION_COMPILE_STATS) != 0);
+}
+
 /*@
  * @deftypefun int jit_context_set_meta (jit_context_t @var{context}, int @var{type}, void *@var{data}, jit_meta_free_func @var{free_data})
  * Tag a context with some metadata.  Returns zero if out of memory.
@@ -298,7 +462,132 @@ jit_context_set_meta(jit_context_t context, int type, void *data, jit_meta_free_
  * @item JIT_OPTION_POSITION_INDEPENDENT
  * A numeric option that forces generation of position-independent code (PIC)
  * if it is set to a non-zero value. This may be mainly useful for pre-compiled
- * contexts.
+ * contexts.  Native code must be position-independent to be written with
+ * @code{jit_writeelf_add_function}.
+ *
+ * @vindex JIT_OPTION_CONCURRENT_COMPILE
+ * @item JIT_OPTION_CONCURRENT_COMPILE
+ * A numeric option that allows different functions of the context to be
+ * compiled by different threads at the same time if it is set to a non-zero
+ * value.  The default on-demand compiler then locks only the function being
+ * compiled rather than the whole context.  This option should be set before
+ * any function of the context is compiled.
+ *
+ * @vindex JIT_OPTION_TIERED_COMPILE
+ * @item JIT_OPTION_TIERED_COMPILE
+ * A numeric option that enables tiered compilation of functions that have
+ * an on-demand compiler if it is set to a non-zero value.  Such functions
+ * are first compiled quickly without optimization.  The baseline code
+ * counts invocations and loop iterations, and once the count reaches the
+ * value of the option a background thread calls the on-demand compiler
+ * again and compiles the function with its normal optimization level.
+ * The on-demand compiler must therefore be safe to call from another
+ * thread.  Nested functions are not tiered.
+ *
+ * @vindex JIT_OPTION_INLINE_CACHE
+ * @item JIT_OPTION_INLINE_CACHE
+ * A numeric option that gives the number of targets that each indirect
+ * call site remembers.  A call site compares the target with the ones
+ * it has seen before and calls a matching target directly.  New targets
+ * are added as they are called, until the site runs out of entries and
+ * falls back to a plain indirect call.  The value is limited by the
+ * back end, and zero, the default, disables inline caches.  Only native
+ * back ends that support patching their own code use this option.
+ *
+ * @vindex JIT_OPTION_INLINE_LIMIT
+ * @item JIT_OPTION_INLINE_LIMIT
+ * A numeric option that gives the largest number of instructions of
+ * a function that @code{jit_insn_call} copies into callers which are built
+ * at @code{JIT_OPTLEVEL_AGGRESSIVE}.  Functions that are already compiled
+ * are built again with their on-demand compiler for this, so the on-demand
+ * compiler may be called more than once.  Such copies share the metadata
+ * of the function, and @code{jit_function_compile} leaves them alone.
+ * Functions that are still being built are copied only once they are
+ * marked with @code{jit_function_set_complete}.  Functions that have
+ * @code{try} blocks are never copied, nor are functions that may throw
+ * exceptions into callers that have @code{try} blocks, since the catch
+ * blocks would not know about the calls that were copied.
+ * Zero, the default, disables inlining.
+ *
+ * @vindex JIT_OPTION_COMPILE_STATS
+ * @item JIT_OPTION_COMPILE_STATS
+ * A numeric option that enables the compile statistics if it is non-zero.
+ * See @code{jit_context_get_compile_stats} and
+ * @code{jit_function_get_compile_stats}.  The default is zero.
+ *
+ * @vindex JIT_OPTION_PERF
+ * @item JIT_OPTION_PERF
+ * A numeric option with flags that describe every compiled function to
+ * the Linux @code{perf} profiler.  With @code{JIT_PERF_MAP} a line with
+ * the address, size and name of the function is added to
+ * @file{/tmp/perf-<pid>.map}, which @code{perf report} reads to name the
+ * samples in the generated code.  With @code{JIT_PERF_JITDUMP} a copy of
+ * the code is written to @file{/tmp/jit-<pid>.dump} in the jitdump format
+ * for @code{perf inject --jit}, with the native addresses of the bytecode
+ * offsets marked by @code{jit_insn_mark_offset} as line numbers.  The names
+ * come from @code{jit_function_set_name}.  The default is zero, and the
+ * option is ignored by the interpreter and on other systems.
+ *
+ * @vindex JIT_OPTION_BUILDER_ARENA
+ * @item JIT_OPTION_BUILDER_ARENA
+ * A numeric option that makes the builders of new functions take all
+ * of their memory, such as the blocks, instructions, values and edges,
+ * from a bump allocator instead of allocating every item on its own.
+ * When the function is compiled or abandoned the allocator is reset
+ * rather than freed, and is kept by the thread for the next function
+ * that it builds.  This is faster when many small functions are built.
+ * The default is zero.
+ *
+ * @vindex JIT_OPTION_EXCEPTION_TABLES
+ * @item JIT_OPTION_EXCEPTION_TABLES
+ * A numeric option that makes functions with a @code{catch} clause
+ * record where their catcher block is instead of calling @code{setjmp}
+ * on entry and storing the program counter before every call.  The code
+ * that does not throw then runs as fast as in a function without a
+ * @code{try}.  When an exception is thrown, @code{jit_exception_throw}
+ * walks up the stack to the nearest such function with the unwinder of
+ * the GNU runtime and resumes it in its catcher, with the registers that
+ * it had at the throw.  Every function that is compiled with the option
+ * describes its frame to the unwinder as with @code{JIT_OPTION_UNWIND_INFO},
+ * and the native functions in between need the usual unwind tables.  The
+ * default is zero, and the option is ignored by back ends other than
+ * x86-64, by the interpreter and if the runtime lacks
+ * @code{__register_frame}.
+ *
+ * @vindex JIT_OPTION_UNWIND_INFO
+ * @item JIT_OPTION_UNWIND_INFO
+ * A numeric option that describes the frame of every compiled function
+ * to the unwinder of the GNU runtime in the @code{.eh_frame} format, with
+ * @code{__register_frame}.  Native code that calls into the JIT, such as
+ * C++ code that throws exceptions across the generated code, and
+ * profilers that use @code{libunwind} can then unwind through the frames
+ * of compiled functions.  The information is dropped when the function
+ * is destroyed.  The default is zero, and the option is ignored by back
+ * ends other than x86-64 and by the interpreter.
+ *
+ * @vindex JIT_OPTION_BRANCH_PROFILE
+ * @item JIT_OPTION_BRANCH_PROFILE
+ * A numeric option that makes the baseline code of
+ * @code{JIT_OPTION_TIERED_COMPILE} count how often each conditional
+ * branch is taken.  When the function is promoted, branches that went
+ * the same way most of the time are marked as likely or unlikely, as with
+ * @code{jit_insn_branch_if_hint}, and the optimizer lays out the blocks
+ * to keep the common path straight and to move the rarely run blocks
+ * to the end of the function.  The on-demand compiler must build the
+ * same branches in the same order each time.  The default is zero.
+ *
+ * @vindex JIT_OPTION_CACHE_HUGE_PAGES
+ * @item JIT_OPTION_CACHE_HUGE_PAGES
+ * A numeric option that gives the size in bytes of a contiguous region
+ * that the function cache reserves up front and takes its pages from.
+ * The region is rounded up to a multiple of the huge page size and is
+ * backed by 2 MiB pages where the system allows it, so that the code of
+ * many functions shares a few iTLB entries.  The cache goes on with
+ * normal pages once the region is used up or if it cannot be reserved.
+ * Pages of the region are kept by the cache rather than given back to
+ * the system when their functions are destroyed.  The option must be
+ * set before the first function of the context is compiled.  The
+ * default is zero, which disables the region.
  * @end table
  *
  * Metadata type values of 10000 or greater are reserved for internal use.
@@ -22,15 +22,18 @@
 
 #include "jit-cpuid-x86.h"
 
-#if defined(__i386) || defined(__i386__) || defined(_M_IX86)
+#if defined(__i386) || defined(__i386__) || defined(_M_IX86) || \
+	defined(__x86_64) || defined(__x86_64__)
 
 /*
  * Determine if the "cpuid" instruction is present by twiddling
- * bit 21 of the EFLAGS register.
+ * bit 21 of the EFLAGS register.  It is always present on x86-64.
  */
 static int cpuid_present(void)
 {
-#if defined(__GNUC__)
+#if defined(__x86_64) || defined(__x86_64__)
+	return 1;
+#elif defined(__GNUC__)
 	int result;
 	__asm__ __volatile__ (
 		"\tpushfl\n"
@@ -55,29 +58,37 @@ static int cpuid_present(void)
 /*
  * Issue a "cpuid" query and get the result.
  */
-static void cpuid_query(unsigned int index, jit_cpuid_x86_t *info)
+static void cpuid_query(unsigned int index, unsigned int subleaf,
+						jit_cpuid_x86_t *info)
 {
-#if defined(__GNUC__)
+#if defined(__x86_64) || defined(__x86_64__)
+	__asm__ __volatile__ (
+		"\tcpuid\n"
+		: "=a"(info->eax), "=b"(info->ebx), "=c"(info->ecx), "=d"(info->edx)
+		: "a"(index), "c"(subleaf)
+	);
+#elif defined(__GNUC__)
 	__asm__ __volatile__ (
 		"\tmovl %0, %%eax\n"
+		"\tmovl %1, %%ecx\n"
 		"\tpushl %%ebx\n"
 		"\txorl %%ebx, %%ebx\n"
-		"\txorl %%ecx, %%ecx\n"
 		"\txorl %%edx, %%edx\n"
 		"\t.byte 0x0F\n"			/* cpuid, safe against old assemblers */
 		"\t.byte 0xA2\n"
-		"\tmovl %1, %%esi\n"
+		"\tmovl %2, %%esi\n"
 		"\tmovl %%eax, (%%esi)\n"
 		"\tmovl %%ebx, 4(%%esi)\n"
 		"\tmovl %%ecx, 8(%%esi)\n"
 		"\tmovl %%edx, 12(%%esi)\n"
 		"\tpopl %%ebx\n"
-		: : "m"(index), "m"(info) : "eax", "ecx", "edx", "esi"
+		: : "m"(index), "m"(subleaf), "m"(info) : "eax", "ecx", "edx", "esi"
 	);
 #endif
 }
 
-int _jit_cpuid_x86_get(unsigned int index, jit_cpuid_x86_t *info)
+int _jit_cpuid_x86_get_subleaf(unsigned int index, unsigned int subleaf,
+							   jit_cpuid_x86_t *info)
 {
 	/* Determine if this cpu has the "cpuid" instruction */
 	if(!cpuid_present())
@@ -88,11 +99,11 @@ int _jit_cpuid_x86_get(unsigned int index, jit_cpuid_x86_t *info)
 	/* Validate the index */
 	if((index & 0x80000000) == 0)
 	{
-		cpuid_query(0, info);
+		cpuid_query(0, 0, info);
 	}
 	else
 	{
-		cpuid_query(0x80000000, info);
+		cpuid_query(0x80000000, 0, info);
 	}
 	if(index > info->eax)
 	{
@@ -100,10 +111,15 @@ int _jit_cpuid_x86_get(unsigned int index, jit_cpuid_x86_t *info)
 	}
 
 	/* Execute the actual requested query */
-	cpuid_query(index, info);
+	cpuid_query(index, subleaf, info);
 	return 1;
 }
 
+int _jit_cpuid_x86_get(unsigned int index, jit_cpuid_x86_t *info)
+{
+	return _jit_cpuid_x86_get_subleaf(index, 0, info);
+}
+
 int _jit_cpuid_x86_has_feature(unsigned int feature)
 {
 	jit_cpuid_x86_t info;
@@ -128,4 +144,4 @@ unsigned int _jit_cpuid_x86_line_size(void)
 	return ((info.ebx & 0x0000FF00) >> 5);
 }
 
-#endif /* i386 */
+#endif /* i386 || x86_64 */
@@ -45,6 +45,8 @@ typedef struct
 #define	JIT_X86CPUID_FEATURES			1
 #define	JIT_X86CPUID_CACHE_TLB			2
 #define	JIT_X86CPUID_SERIAL_NUMBER		3
+#define	JIT_X86CPUID_EXT_FEATURES		7
+#define	JIT_X86CPUID_EXT_INFO			0x80000001
 
 /*
  * Feature information.
@@ -82,12 +84,41 @@ typedef struct
 #define	JIT_X86FEATURE_RESERVED_4		0x40000000
 #define	JIT_X86FEATURE_RESERVED_5		0x80000000
 
+/*
+ * Additional feature information, returned in ecx.
+ */
+#define	JIT_X86FEATURE2_SSE3			0x00000001
+#define	JIT_X86FEATURE2_SSSE3			0x00000200
+#define	JIT_X86FEATURE2_SSE4_1			0x00080000
+#define	JIT_X86FEATURE2_SSE4_2			0x00100000
+#define	JIT_X86FEATURE2_POPCNT			0x00800000
+
+/*
+ * Structured extended feature information, returned in ebx
+ * by the JIT_X86CPUID_EXT_FEATURES query.
+ */
+#define	JIT_X86FEATURE7_BMI1			0x00000008
+#define	JIT_X86FEATURE7_BMI2			0x00000100
+
+/*
+ * Extended processor information, returned in ecx by the
+ * JIT_X86CPUID_EXT_INFO query.
+ */
+#define	JIT_X86FEATUREX_LZCNT			0x00000020
+
 /*
  * Get CPU identification information.  Returns zero if the requested
  * information is not available.
  */
 int _jit_cpuid_x86_get(unsigned int index, jit_cpuid_x86_t *info);
 
+/*
+ * Get CPU identification information for queries that take a
+ * sub-leaf index in ecx, such as JIT_X86CPUID_EXT_FEATURES.
+ */
+int _jit_cpuid_x86_get_subleaf(unsigned int index, unsigned int subleaf,
+							   jit_cpuid_x86_t *info);
+
 /*
  * Determine if the CPU has a particular feature.
  */
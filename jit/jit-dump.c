@@ -539,6 +539,59 @@ void jit_dump_insn(FILE *stream, jit_function_t func, jit_insn_t insn)
 
 #if defined(JIT_BACKEND_INTERP)
 
+/*
+ * Dump the arguments of an opcode that takes its operands from
+ * frame slots.  Locals are shown as "lN" and arguments as "aN".
+ */
+static void **dump_interp_slots(FILE *stream, int flags, void **pc)
+{
+	jit_nint slot;
+	int num_slots;
+	int index;
+
+	switch(flags & JIT_OPCODE_INTERP_ARGS_MASK)
+	{
+		case JIT_OPCODE_SLOT_ARGS_1:
+		case JIT_OPCODE_SLOT_ARGS_1_IMM:
+		{
+			num_slots = 1;
+		}
+		break;
+
+		case JIT_OPCODE_SLOT_ARGS_2:
+		case JIT_OPCODE_SLOT_ARGS_2_IMM:
+		{
+			num_slots = 2;
+		}
+		break;
+
+		default:
+		{
+			num_slots = 3;
+		}
+		break;
+	}
+	for(index = 0; index < num_slots; ++index)
+	{
+		slot = (jit_nint)(*pc++);
+		fprintf(stream, "%s%c%ld", (index ? ", " : " "),
+				((slot & 1) ? 'a' : 'l'),
+				(long)((slot >> 1) / (jit_nint)sizeof(jit_item)));
+	}
+	if((flags & JIT_OPCODE_INTERP_ARGS_MASK) == JIT_OPCODE_SLOT_ARGS_1_IMM ||
+	   (flags & JIT_OPCODE_INTERP_ARGS_MASK) == JIT_OPCODE_SLOT_ARGS_2_IMM)
+	{
+		fprintf(stream, ", %ld", (long)(jit_nint)(*pc++));
+	}
+	if((flags & JIT_OPCODE_IS_BRANCH) != 0)
+	{
+		fprintf(stream, ", %08lX",
+				(long)(jit_nint)((pc - 1) + (jit_nint)(*pc)));
+		++pc;
+	}
+	return pc;
+}
+
 /*
  * Dump the interpreted bytecode representation of a function.
  */
@@ -635,6 +688,16 @@ static void dump_interp_code(FILE *stream, void **pc, void **end)
 			}
 			break;
 
+			case JIT_OPCODE_SLOT_ARGS_1:
+			case JIT_OPCODE_SLOT_ARGS_2:
+			case JIT_OPCODE_SLOT_ARGS_3:
+			case JIT_OPCODE_SLOT_ARGS_1_IMM:
+			case JIT_OPCODE_SLOT_ARGS_2_IMM:
+			{
+				pc = dump_interp_slots(stream, info->flags, pc);
+			}
+			break;
+
 			default:
 			{
 				if((info->flags & (JIT_OPCODE_IS_BRANCH |
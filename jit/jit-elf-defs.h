@@ -2131,6 +2131,12 @@ typedef Elf32_Addr Elf32_Conflict;
 
 #define R_X86_64_NUM		16
 
+/* libjit interpreter ("Lj") relocations.  */
+#define R_LJ_DIRECT		1	/* Direct word, plus addend */
+#define R_LJ_FUNCTION		2	/* Function object bound to the code */
+
+#define R_LJ_NUM		3
+
 #ifdef __cplusplus
 };
 #endif
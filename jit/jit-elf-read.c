@@ -23,6 +23,9 @@
 #include "jit-internal.h"
 #include "jit-rules.h"
 #include "jit-elf-defs.h"
+#if defined(JIT_BACKEND_INTERP)
+	#include "jit-interp.h"
+#endif
 #ifdef JIT_WIN32_PLATFORM
 	#ifdef HAVE_SYS_TYPES_H
 		#include <sys/types.h>
@@ -1227,6 +1230,61 @@ void *jit_readelf_get_symbol(jit_readelf_t readelf, const char *name)
 	return 0;
 }
 
+#if defined(JIT_BACKEND_INTERP)
+/* Imported from "jit-rules-interp.c" */
+unsigned int _jit_interp_calculate_arg_size
+		(jit_function_t func, jit_type_t signature);
+#endif
+
+/*@
+ * @deftypefun jit_function_t jit_readelf_get_function (jit_readelf_t @var{readelf}, jit_context_t @var{context}, const char *@var{name}, jit_type_t @var{signature})
+ * Create a function in @var{context} whose code is the symbol @var{name}
+ * in the ELF binary represented by @var{readelf}.  The code must have
+ * been written with @code{jit_writeelf_add_function}, and @var{signature}
+ * must be the signature that the original function was compiled with.
+ * The new function is already compiled and can be called straight away.
+ * Returns NULL if the symbol is not present, if the signature does not
+ * match the code, or if out of memory.
+ *
+ * Calls between the functions in an ELF binary refer to the function
+ * objects that this creates.  So you should create all of the functions
+ * that you need before calling @code{jit_readelf_resolve_all}, and you
+ * must not close @var{readelf} while the functions are still in use.
+ * @end deftypefun
+@*/
+jit_function_t jit_readelf_get_function
+	(jit_readelf_t readelf, jit_context_t context,
+	 const char *name, jit_type_t signature)
+{
+	void *code;
+	jit_function_t func;
+	if(!context || !signature)
+	{
+		return 0;
+	}
+	code = jit_readelf_get_symbol(readelf, name);
+	if(!code)
+	{
+		return 0;
+	}
+	func = jit_function_create(context, signature);
+	if(!func)
+	{
+		return 0;
+	}
+#if defined(JIT_BACKEND_INTERP)
+	if(((jit_function_interp_t)code)->args_size !=
+			_jit_interp_calculate_arg_size(func, signature))
+	{
+		_jit_function_destroy(func);
+		return 0;
+	}
+	((jit_function_interp_t)code)->func = func;
+#endif
+	jit_function_setup_entry(func, code);
+	return func;
+}
+
 /*@
  * @deftypefun {void *} jit_readelf_get_section (jit_readelf_t @var{readelf}, const char *@var{name}, jit_nuint *@var{size})
  * Get the address and size of a particular section from an ELF binary.
@@ -1961,15 +2019,75 @@ static int arm_reloc(jit_readelf_t readelf, void *address, int type,
 
 #endif /* arm */
 
+#if defined(__x86_64) || defined(__x86_64__)
+
+/*
+ * Apply relocations for x86-64 platforms.
+ */
+static int x86_64_reloc(jit_readelf_t readelf, void *address, int type,
+						jit_nuint value, int has_addend, jit_nuint addend)
+{
+	jit_nint offset;
+	if(type == R_X86_64_64)
+	{
+		if(has_addend)
+		{
+			*((jit_nuint *)address) = value + addend;
+		}
+		else
+		{
+			*((jit_nuint *)address) += value;
+		}
+		return 1;
+	}
+	else if(type == R_X86_64_PC32)
+	{
+		offset = (jit_nint)(value - (jit_nuint)address);
+		if(has_addend)
+		{
+			offset += (jit_nint)addend;
+		}
+		else
+		{
+			offset += *((jit_int *)address);
+		}
+		if(offset < jit_min_int || offset > jit_max_int)
+		{
+			/* The target is too far away from the code */
+			return 0;
+		}
+		*((jit_int *)address) = (jit_int)offset;
+		return 1;
+	}
+	return 0;
+}
+
+#endif /* x86_64 */
+
 /*
  * Apply relocations for the interpreted platform.
  */
 static int interp_reloc(jit_readelf_t readelf, void *address, int type,
 						jit_nuint value, int has_addend, jit_nuint addend)
 {
-	/* We only have one type of relocation for the interpreter: direct */
-	if(type == 1)
+	if(type == R_LJ_DIRECT)
 	{
+		if(has_addend)
+		{
+			value += addend;
+		}
+		*((jit_nuint *)address) = value;
+		return 1;
+	}
+	else if(type == R_LJ_FUNCTION)
+	{
+		/* The code starts with a pointer to the function object,
+		   which is set by "jit_readelf_get_function" */
+		value = *((jit_nuint *)value);
+		if(!value)
+		{
+			return 0;
+		}
 		*((jit_nuint *)address) = value;
 		return 1;
 	}
@@ -1995,6 +2113,12 @@ static jit_reloc_func get_reloc(unsigned int machine)
 	{
 		return arm_reloc;
 	}
+#endif
+#if defined(__x86_64) || defined(__x86_64__)
+	if(machine == EM_X86_64)
+	{
+		return x86_64_reloc;
+	}
 #endif
 	if(machine == 0x4C6A)		/* "Lj" for the libjit interpreter */
 	{
@@ -23,6 +23,10 @@
 #include "jit-internal.h"
 #include "jit-elf-defs.h"
 #include "jit-rules.h"
+#if defined(JIT_BACKEND_INTERP)
+# include "jit-interp.h"
+#endif
+#include <stdio.h>
 
 /*@
 
@@ -44,6 +48,11 @@
 	typedef Elf32_Off   Elf_Off;
 	typedef Elf32_Dyn   Elf_Dyn;
 	typedef Elf32_Sym   Elf_Sym;
+	typedef Elf32_Rela  Elf_Rela;
+	#define ELF_R_SYM(val)			ELF32_R_SYM((val))
+	#define ELF_R_TYPE(val)			ELF32_R_TYPE((val))
+	#define ELF_R_INFO(sym,type)	ELF32_R_INFO((sym), (type))
+	#define ELF_ST_INFO(bind,type)	ELF32_ST_INFO((bind), (type))
 #else
 	typedef Elf64_Ehdr  Elf_Ehdr;
 	typedef Elf64_Shdr  Elf_Shdr;
@@ -55,6 +64,45 @@
 	typedef Elf64_Off   Elf_Off;
 	typedef Elf64_Dyn   Elf_Dyn;
 	typedef Elf64_Sym   Elf_Sym;
+	typedef Elf64_Rela  Elf_Rela;
+	#define ELF_R_SYM(val)			ELF64_R_SYM((val))
+	#define ELF_R_TYPE(val)			ELF64_R_TYPE((val))
+	#define ELF_R_INFO(sym,type)	ELF64_R_INFO((sym), (type))
+	#define ELF_ST_INFO(bind,type)	ELF64_ST_INFO((bind), (type))
+#endif
+
+/*
+ * The binary has a single loadable segment and a dynamic segment.
+ * The ".text" section is always placed directly after the program
+ * headers, so function symbols and relocations can be given their
+ * final virtual addresses as soon as the code is added.  Virtual
+ * addresses are the same as file offsets throughout.
+ */
+#define	JIT_ELF_NUM_PHDRS		2
+#define	JIT_ELF_TEXT_ALIGN		16
+#define	JIT_ELF_TEXT_VADDR		\
+			((sizeof(Elf_Ehdr) + JIT_ELF_NUM_PHDRS * sizeof(Elf_Phdr) + \
+			  JIT_ELF_TEXT_ALIGN - 1) & ~(JIT_ELF_TEXT_ALIGN - 1))
+
+/*
+ * Section flags for the code.  Interpreted code is patched in place
+ * by relocations, but never executed directly.
+ */
+#if defined(JIT_BACKEND_INTERP)
+	#define	JIT_ELF_TEXT_FLAGS		(SHF_ALLOC | SHF_WRITE)
+	#define	JIT_ELF_SEGMENT_FLAGS	(PF_R | PF_W)
+#else
+	#define	JIT_ELF_TEXT_FLAGS		(SHF_ALLOC | SHF_WRITE | SHF_EXECINSTR)
+	#define	JIT_ELF_SEGMENT_FLAGS	(PF_R | PF_W | PF_X)
+#endif
+
+/*
+ * Relocation types for the addresses that native code generators
+ * record (see _jit_reloc_table).
+ */
+#if defined(JIT_BACKEND_X86_64)
+	#define	JIT_ELF_RELOC_REL32		R_X86_64_PC32
+	#define	JIT_ELF_RELOC_ABS		R_X86_64_64
 #endif
 
 /*
@@ -68,6 +116,16 @@ struct jit_section
 	unsigned int		data_len;
 };
 
+/*
+ * A function that has been added, and the index of its symbol.
+ */
+typedef struct
+{
+	jit_function_t		func;
+	Elf_Word			symbol;
+
+} jit_writeelf_func_t;
+
 /*
  * Control structure for writing an ELF binary.
  */
@@ -78,6 +136,8 @@ struct jit_writeelf
 	int					num_sections;
 	int					regular_string_section;
 	int					dynamic_string_section;
+	jit_writeelf_func_t *functions;
+	int					num_functions;
 };
 
 /*
@@ -293,6 +353,620 @@ static int add_dyn_info
 	return add_to_section(section, &dyn, sizeof(dyn));
 }
 
+/*
+ * Compute the ELF hash of a symbol name.  This must agree with
+ * the lookup code in "jit_readelf_get_symbol".
+ */
+static unsigned long elf_hash(const char *name)
+{
+	unsigned long hash = 0;
+	unsigned long temp;
+	while(*name != 0)
+	{
+		hash = (hash << 4) + (unsigned long)(*name & 0xFF);
+		temp = (hash & 0xF0000000);
+		if(temp != 0)
+		{
+			hash ^= temp | (temp >> 24);
+		}
+		++name;
+	}
+	return hash;
+}
+
+/*
+ * Get the dynamic symbol table, creating it if necessary.
+ * The first entry is always the undefined symbol.
+ */
+static jit_section_t get_symbol_table(jit_writeelf_t writeelf)
+{
+	jit_section_t section;
+	Elf_Sym sym;
+	section = get_section(writeelf, ".dynsym", SHT_DYNSYM, SHF_ALLOC,
+						  sizeof(Elf_Sym), sizeof(Elf_Addr));
+	if(!section)
+	{
+		return 0;
+	}
+	if(!(section->data_len))
+	{
+		jit_memzero(&sym, sizeof(sym));
+		if(!add_to_section(section, &sym, sizeof(sym)))
+		{
+			return 0;
+		}
+	}
+	return section;
+}
+
+/*
+ * Find the symbol index of a function that has already been added.
+ * Returns zero if the function has not been added.
+ */
+static Elf_Word find_function(jit_writeelf_t writeelf, jit_function_t func)
+{
+	int index;
+	for(index = 0; index < writeelf->num_functions; ++index)
+	{
+		if(writeelf->functions[index].func == func)
+		{
+			return writeelf->functions[index].symbol;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Add a relocation against "symbol" at the virtual address "offset".
+ */
+static int add_relocation
+	(jit_writeelf_t writeelf, Elf_Addr offset, Elf_Word symbol,
+	 int type, jit_nint addend)
+{
+	jit_section_t section;
+	Elf_Rela rela;
+	section = get_section(writeelf, ".rela.dyn", SHT_RELA, SHF_ALLOC,
+						  sizeof(Elf_Rela), sizeof(Elf_Addr));
+	if(!section)
+	{
+		return 0;
+	}
+	jit_memzero(&rela, sizeof(rela));
+	rela.r_offset = offset;
+	rela.r_info = ELF_R_INFO(symbol, type);
+	rela.r_addend = addend;
+	return add_to_section(section, &rela, sizeof(rela));
+}
+
+#if defined(JIT_BACKEND_INTERP)
+
+/*
+ * Walk the interpreted code between "start" and "end", looking for the
+ * words that contain absolute addresses.  If "copy" is NULL, then we
+ * only check that the code can be written.  Otherwise, the code has been
+ * copied to "copy" at "offset" within the ".text" section under "symbol",
+ * and we add a relocation for each address and clear it within the copy.
+ *
+ * Jump table entries become relocations against the function's own
+ * symbol.  Calls to other functions become relocations against the
+ * callee's symbol, which is not known until the binary is written.
+ * Until then, we store the callee in the addend.
+ */
+static int scan_interp_code
+	(jit_writeelf_t writeelf, void **start, void **end,
+	 void **copy, Elf_Word symbol, unsigned int offset)
+{
+	void **pc = (void **)jit_function_interp_entry_pc(start);
+	const jit_opcode_info_t *info;
+	jit_nint opcode;
+	jit_nint num_labels;
+	void *target;
+	Elf_Addr address;
+	int words;
+
+	while(pc < end)
+	{
+		/* Fetch the next opcode and get its information */
+		opcode = (jit_nint)(*pc++);
+		if(opcode < 0 || opcode >= JIT_INTERP_OP_END_MARKER)
+		{
+			return 0;
+		}
+		if(opcode < JIT_OP_NUM_OPCODES)
+		{
+			info = &(jit_opcodes[opcode]);
+		}
+		else
+		{
+			info = &(_jit_interp_opcodes[opcode - JIT_OP_NUM_OPCODES]);
+		}
+
+		/* Skip the arguments, and relocate the ones that are addresses */
+		words = 0;
+		switch(info->flags & JIT_OPCODE_INTERP_ARGS_MASK)
+		{
+			case JIT_OPCODE_NINT_ARG:
+			case JIT_OPCODE_SLOT_ARGS_1:
+			{
+				words = 1;
+			}
+			break;
+
+			case JIT_OPCODE_NINT_ARG_TWO:
+			case JIT_OPCODE_SLOT_ARGS_2:
+			case JIT_OPCODE_SLOT_ARGS_1_IMM:
+			{
+				words = 2;
+			}
+			break;
+
+			case JIT_OPCODE_SLOT_ARGS_3:
+			case JIT_OPCODE_SLOT_ARGS_2_IMM:
+			{
+				words = 3;
+			}
+			break;
+
+			case JIT_OPCODE_CONST_LONG:
+			{
+				words = (sizeof(jit_long) + sizeof(void *) - 1) /
+						sizeof(void *);
+			}
+			break;
+
+			case JIT_OPCODE_CONST_FLOAT32:
+			{
+				words = (sizeof(jit_float32) + sizeof(void *) - 1) /
+						sizeof(void *);
+			}
+			break;
+
+			case JIT_OPCODE_CONST_FLOAT64:
+			{
+				words = (sizeof(jit_float64) + sizeof(void *) - 1) /
+						sizeof(void *);
+			}
+			break;
+
+			case JIT_OPCODE_CONST_NFLOAT:
+			{
+				words = (sizeof(jit_nfloat) + sizeof(void *) - 1) /
+						sizeof(void *);
+			}
+			break;
+
+			case JIT_OPCODE_CALL_INDIRECT_ARGS:
+			{
+				/* The signature type is only valid in this process */
+				return 0;
+			}
+			/* Not reached */
+
+			default:
+			{
+				if((info->flags & JIT_OPCODE_IS_CALL_EXTERNAL) != 0)
+				{
+					/* Native functions and their signatures
+					   are only valid in this process */
+					return 0;
+				}
+				else if((info->flags & JIT_OPCODE_IS_CALL) != 0)
+				{
+					if(copy)
+					{
+						address = JIT_ELF_TEXT_VADDR + offset +
+							(Elf_Addr)((pc - start) * sizeof(void *));
+						if(!add_relocation(writeelf, address, 0,
+										   R_LJ_FUNCTION, (jit_nint)(*pc)))
+						{
+							return 0;
+						}
+						copy[pc - start] = 0;
+					}
+					words = 1;
+				}
+				else if((info->flags & JIT_OPCODE_IS_JUMP_TABLE) != 0)
+				{
+					num_labels = (jit_nint)(*pc++);
+					while(num_labels > 0 && pc < end)
+					{
+						target = *pc;
+						if((void **)target < start || (void **)target >= end)
+						{
+							return 0;
+						}
+						if(copy)
+						{
+							address = JIT_ELF_TEXT_VADDR + offset +
+								(Elf_Addr)((pc - start) * sizeof(void *));
+							if(!add_relocation
+									(writeelf, address, symbol, R_LJ_DIRECT,
+									 (unsigned char *)target -
+									 (unsigned char *)start))
+							{
+								return 0;
+							}
+							copy[pc - start] = 0;
+						}
+						++pc;
+						--num_labels;
+					}
+				}
+				else if((info->flags & (JIT_OPCODE_IS_BRANCH |
+								   JIT_OPCODE_IS_ADDROF_LABEL)) != 0)
+				{
+					/* Branch targets are relative to the program counter */
+					words = 1;
+				}
+			}
+			break;
+		}
+		if((info->flags & JIT_OPCODE_IS_BRANCH) != 0 &&
+		   (info->flags & JIT_OPCODE_INTERP_ARGS_MASK) >=
+				JIT_OPCODE_SLOT_ARGS_1)
+		{
+			/* Slot branches have the target after the slots */
+			++words;
+		}
+		pc += words;
+	}
+	return 1;
+}
+
+#endif /* JIT_BACKEND_INTERP */
+
+#if defined(JIT_BACKEND_X86_64)
+
+/*
+ * Import the internal symbol table from "jit-symbol.c".
+ */
+typedef struct
+{
+	const char *name;
+	void       *value;
+
+} jit_internalsym;
+extern jit_internalsym const _jit_internal_symbols[];
+extern int const _jit_num_internal_symbols;
+
+/*
+ * Get the name of a function within libjit from its address.
+ */
+static const char *get_internal_name(void *address)
+{
+	int index;
+	for(index = 0; index < _jit_num_internal_symbols; ++index)
+	{
+		if(_jit_internal_symbols[index].value == address)
+		{
+			return _jit_internal_symbols[index].name;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Get the undefined symbol for "name", adding it if necessary.
+ * The reader resolves it by name when the binary is loaded.
+ */
+static Elf_Word get_external_symbol(jit_writeelf_t writeelf, const char *name)
+{
+	jit_section_t symtab;
+	Elf_Sym *symbols;
+	Elf_Sym sym;
+	Elf_Word num_symbols;
+	Elf_Word symbol;
+
+	symtab = get_symbol_table(writeelf);
+	if(!symtab)
+	{
+		return 0;
+	}
+	symbols = (Elf_Sym *)(symtab->data);
+	num_symbols = (Elf_Word)(symtab->data_len / sizeof(Elf_Sym));
+	for(symbol = 1; symbol < num_symbols; ++symbol)
+	{
+		if(symbols[symbol].st_shndx == SHN_UNDEF &&
+		   !jit_strcmp(get_dyn_string(writeelf, symbols[symbol].st_name),
+		   			   name))
+		{
+			return symbol;
+		}
+	}
+	jit_memzero(&sym, sizeof(sym));
+	sym.st_name = add_dyn_string(writeelf, name);
+	if(!(sym.st_name))
+	{
+		return 0;
+	}
+	sym.st_info = ELF_ST_INFO(STB_GLOBAL, STT_FUNC);
+	if(!add_to_section(symtab, &sym, sizeof(sym)))
+	{
+		return 0;
+	}
+	return num_symbols;
+}
+
+/*
+ * Check the addresses that the code generator recorded for "func",
+ * whose code lies between "start" and "end".  If "copy" is NULL, then
+ * we only check that the code can be written.  Otherwise, the code has
+ * been copied to "copy" at "offset" within the ".text" section under
+ * "symbol", and its constants have been copied after it, at "data_offset".
+ *
+ * Offsets from the code to its constants are adjusted within the copy,
+ * and offsets within the code are left as they are.  Everything else
+ * becomes a relocation and is cleared within the copy.  As with the
+ * interpreter, the callee of a call is stored in the addend until the
+ * binary is written.
+ */
+static int scan_native_code
+	(jit_writeelf_t writeelf, jit_function_t func,
+	 unsigned char *start, unsigned char *end, unsigned char *copy,
+	 Elf_Word symbol, unsigned int offset, unsigned int data_offset)
+{
+	_jit_reloc_table_t table = func->reloc_table;
+	_jit_reloc_t *reloc;
+	unsigned char *target;
+	const char *name;
+	unsigned int field;
+	unsigned int num;
+	jit_nint addend;
+	Elf_Word target_symbol;
+
+	for(num = 0; num < table->num_relocs; ++num)
+	{
+		reloc = &(table->relocs[num]);
+		target = (unsigned char *)(reloc->target);
+		if(reloc->field < start || reloc->field >= end)
+		{
+			return 0;
+		}
+		field = (unsigned int)(reloc->field - start);
+
+		/* Get the addend from the field, so that the relocation
+		   produces the same value as the original code */
+		if(reloc->type == JIT_RELOC_REL32)
+		{
+			addend = *((jit_int *)(reloc->field)) -
+				(target - reloc->field);
+		}
+		else
+		{
+			addend = *((jit_nint *)(reloc->field)) - (jit_nint)target;
+		}
+
+		if(reloc->callee)
+		{
+			/* The callee must also be added, maybe later on */
+			if(copy)
+			{
+				if(!add_relocation
+						(writeelf, JIT_ELF_TEXT_VADDR + offset + field, 0,
+						 reloc->type == JIT_RELOC_REL32 ?
+						 	JIT_ELF_RELOC_REL32 : JIT_ELF_RELOC_ABS,
+						 (jit_nint)(reloc->callee)))
+				{
+					return 0;
+				}
+			}
+			target_symbol = 0;
+		}
+		else if(target >= start && target < end)
+		{
+			/* The target is within the code, which keeps its layout */
+			if(reloc->type == JIT_RELOC_REL32)
+			{
+				continue;
+			}
+			target_symbol = symbol;
+			addend += target - start;
+		}
+		else if(target >= table->data_start && target < table->data_end)
+		{
+			/* The constants are moved to just after the code */
+			addend += data_offset - offset + (target - table->data_start);
+			if(reloc->type == JIT_RELOC_REL32)
+			{
+				if(copy)
+				{
+					*((jit_int *)(copy + field)) = (jit_int)(addend - field);
+				}
+				continue;
+			}
+			target_symbol = symbol;
+		}
+		else
+		{
+			/* The target must be a function within libjit, such as
+			   "jit_exception_builtin" or an intrinsic */
+			name = get_internal_name(target);
+			if(!name)
+			{
+				return 0;
+			}
+			target_symbol = 0;
+			if(copy)
+			{
+				target_symbol = get_external_symbol(writeelf, name);
+				if(!target_symbol)
+				{
+					return 0;
+				}
+			}
+		}
+
+		if(copy)
+		{
+			if(target_symbol &&
+			   !add_relocation
+			   		(writeelf, JIT_ELF_TEXT_VADDR + offset + field,
+					 target_symbol,
+					 reloc->type == JIT_RELOC_REL32 ?
+					 	JIT_ELF_RELOC_REL32 : JIT_ELF_RELOC_ABS,
+					 addend))
+			{
+				return 0;
+			}
+			if(reloc->type == JIT_RELOC_REL32)
+			{
+				*((jit_int *)(copy + field)) = 0;
+			}
+			else
+			{
+				*((jit_nint *)(copy + field)) = 0;
+			}
+		}
+	}
+	return 1;
+}
+
+#endif /* JIT_BACKEND_X86_64 */
+
+/*
+ * Resolve the calls between functions and build the symbol hash table.
+ * Returns zero if a function calls another that was not added.
+ */
+static int resolve_functions(jit_writeelf_t writeelf)
+{
+	jit_section_t symtab;
+	jit_section_t section;
+	Elf_Sym *symbols;
+	Elf_Rela *rela;
+	Elf_Word *hash;
+	Elf_Word num_symbols;
+	Elf_Word num_buckets;
+	Elf_Word symbol;
+	unsigned int num;
+
+	/* Point calls at the symbols of the functions that they call */
+	section = get_section(writeelf, ".rela.dyn", SHT_RELA, SHF_ALLOC,
+						  sizeof(Elf_Rela), sizeof(Elf_Addr));
+	if(!section)
+	{
+		return 0;
+	}
+	rela = (Elf_Rela *)(section->data);
+	for(num = section->data_len / sizeof(Elf_Rela); num > 0; --num)
+	{
+		if(!ELF_R_SYM(rela->r_info))
+		{
+			symbol = find_function
+				(writeelf, (jit_function_t)(jit_nint)(rela->r_addend));
+			if(!symbol)
+			{
+				return 0;
+			}
+			rela->r_info = ELF_R_INFO(symbol, ELF_R_TYPE(rela->r_info));
+			rela->r_addend = 0;
+#if defined(JIT_BACKEND_X86_64)
+			/* The offset in a call is relative to the end of the
+			   instruction, which is also the end of the offset */
+			if(ELF_R_TYPE(rela->r_info) == JIT_ELF_RELOC_REL32)
+			{
+				rela->r_addend = -4;
+			}
+#endif
+		}
+		++rela;
+	}
+
+	/* Rebuild the hash table from scratch, in the "SysV" format */
+	symtab = get_symbol_table(writeelf);
+	section = get_section(writeelf, ".hash", SHT_HASH, SHF_ALLOC,
+						  sizeof(Elf_Word), sizeof(Elf_Word));
+	if(!symtab || !section)
+	{
+		return 0;
+	}
+	num_symbols = (Elf_Word)(symtab->data_len / sizeof(Elf_Sym));
+	num_buckets = (num_symbols / 2) + 1;
+	hash = (Elf_Word *)jit_calloc
+		(2 + num_buckets + num_symbols, sizeof(Elf_Word));
+	if(!hash)
+	{
+		return 0;
+	}
+	hash[0] = num_buckets;
+	hash[1] = num_symbols;
+	symbols = (Elf_Sym *)(symtab->data);
+	for(symbol = 1; symbol < num_symbols; ++symbol)
+	{
+		num = (unsigned int)(elf_hash(get_dyn_string
+			(writeelf, symbols[symbol].st_name)) % num_buckets);
+		hash[2 + num_buckets + symbol] = hash[2 + num];
+		hash[2 + num] = symbol;
+	}
+	jit_free(section->data);
+	section->data = (char *)hash;
+	section->data_len = (2 + num_buckets + num_symbols) * sizeof(Elf_Word);
+	return 1;
+}
+
+/*
+ * Get the ELF section header index for a section, which is one
+ * more than our own index because of the null section at the start.
+ */
+static Elf_Word section_index(jit_writeelf_t writeelf, const char *name)
+{
+	int index;
+	for(index = 0; index < writeelf->num_sections; ++index)
+	{
+		if(!jit_strcmp(get_string
+				(writeelf, writeelf->sections[index].shdr.sh_name), name))
+		{
+			return (Elf_Word)(index + 1);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Determine the order of the sections within the file.  The ".text"
+ * section comes first, then the other sections that are loaded into
+ * memory, and then the rest.
+ */
+static void order_sections(jit_writeelf_t writeelf, int *order)
+{
+	int index, posn = 0;
+	int text = (int)section_index(writeelf, ".text") - 1;
+	if(text >= 0)
+	{
+		order[posn++] = text;
+	}
+	for(index = 0; index < writeelf->num_sections; ++index)
+	{
+		if((writeelf->sections[index].shdr.sh_flags & SHF_ALLOC) != 0 &&
+		   index != text)
+		{
+			order[posn++] = index;
+		}
+	}
+	for(index = 0; index < writeelf->num_sections; ++index)
+	{
+		if((writeelf->sections[index].shdr.sh_flags & SHF_ALLOC) == 0)
+		{
+			order[posn++] = index;
+		}
+	}
+}
+
+/*
+ * Write zero bytes to pad "file" from "posn" up to "offset".
+ */
+static int write_padding(FILE *file, Elf_Off posn, Elf_Off offset)
+{
+	while(posn < offset)
+	{
+		if(putc(0, file) == EOF)
+		{
+			return 0;
+		}
+		++posn;
+	}
+	return 1;
+}
+
 /*@
  * @deftypefun jit_writeelf_t jit_writeelf_create (const char *@var{library_name})
  * Create an object to assist with the process of writing an ELF binary.
@@ -303,6 +977,7 @@ static int add_dyn_info
 jit_writeelf_t jit_writeelf_create(const char *library_name)
 {
 	jit_writeelf_t writeelf;
+	jit_section_t section;
 	Elf_Word name_index;
 	union
 	{
@@ -329,14 +1004,16 @@ jit_writeelf_t jit_writeelf_create(const char *library_name)
 		return 0;
 	}
 
-	/* Create the dynamic string section, for dynamic linking symbols */
-	if(!get_section(writeelf, ".dynstr", SHT_STRTAB, SHF_ALLOC, 0, 0))
+	/* Create the dynamic string section, for dynamic linking symbols.
+	   The empty string is always first, at index zero */
+	section = get_section(writeelf, ".dynstr", SHT_STRTAB, SHF_ALLOC, 0, 0);
+	if(!section)
 	{
 		jit_writeelf_destroy(writeelf);
 		return 0;
 	}
 	writeelf->dynamic_string_section = writeelf->num_sections - 1;
-	if(!add_dyn_string(writeelf, ""))
+	if(!add_to_section(section, "", 1))
 	{
 		jit_writeelf_destroy(writeelf);
 		return 0;
@@ -412,19 +1089,190 @@ void jit_writeelf_destroy(jit_writeelf_t writeelf)
 		jit_free(writeelf->sections[index].data);
 	}
 	jit_free(writeelf->sections);
+	jit_free(writeelf->functions);
 	jit_free(writeelf);
 }
 
 /*@
  * @deftypefun int jit_writeelf_write (jit_writeelf_t @var{writeelf}, const char *@var{filename})
  * Write a fully-built ELF binary to @var{filename}.  Returns zero
- * if an error occurred (reason in @code{errno}).
+ * if an error occurred (reason in @code{errno}), or if one of the
+ * functions calls a function that was not added to @var{writeelf}.
+ *
+ * The binary can be written more than once, and more functions can
+ * be added in between.
  * @end deftypefun
 @*/
 int jit_writeelf_write(jit_writeelf_t writeelf, const char *filename)
 {
-	/* TODO */
-	return 1;
+	FILE *file;
+	jit_section_t section;
+	Elf_Ehdr ehdr;
+	Elf_Phdr phdrs[JIT_ELF_NUM_PHDRS];
+	Elf_Shdr shdr;
+	Elf_Off offset;
+	Elf_Off load_end;
+	Elf_Xword align;
+	Elf_Word dynsym, dynstr;
+	int *order;
+	int index, ok;
+
+	if(!writeelf || !filename)
+	{
+		return 0;
+	}
+
+	/* Resolve calls, build the hash table, and make sure that the
+	   dynamic section refers to all of the tables, ending with DT_NULL */
+	if(!resolve_functions(writeelf))
+	{
+		return 0;
+	}
+	section = get_section(writeelf, ".dynamic", SHT_DYNAMIC,
+						  SHF_WRITE | SHF_ALLOC,
+						  sizeof(Elf_Dyn), sizeof(Elf_Dyn));
+	if(!section)
+	{
+		return 0;
+	}
+	if(section->data_len >= sizeof(Elf_Dyn) &&
+	   ((Elf_Dyn *)(section->data + section->data_len))[-1].d_tag == DT_NULL)
+	{
+		section->data_len -= sizeof(Elf_Dyn);
+	}
+	if(!add_dyn_info(writeelf, DT_HASH, 0, 1) ||
+	   !add_dyn_info(writeelf, DT_STRTAB, 0, 1) ||
+	   !add_dyn_info(writeelf, DT_SYMTAB, 0, 1) ||
+	   !add_dyn_info(writeelf, DT_STRSZ, 0, 1) ||
+	   !add_dyn_info(writeelf, DT_SYMENT, sizeof(Elf_Sym), 1) ||
+	   !add_dyn_info(writeelf, DT_RELA, 0, 1) ||
+	   !add_dyn_info(writeelf, DT_RELASZ, 0, 1) ||
+	   !add_dyn_info(writeelf, DT_RELAENT, sizeof(Elf_Rela), 1) ||
+	   !add_dyn_info(writeelf, DT_NULL, 0, 0))
+	{
+		return 0;
+	}
+
+	/* Lay out the sections, with virtual addresses equal to file offsets */
+	order = (int *)jit_malloc(writeelf->num_sections * sizeof(int));
+	if(!order)
+	{
+		return 0;
+	}
+	order_sections(writeelf, order);
+	offset = sizeof(Elf_Ehdr) + JIT_ELF_NUM_PHDRS * sizeof(Elf_Phdr);
+	load_end = offset;
+	for(index = 0; index < writeelf->num_sections; ++index)
+	{
+		section = &(writeelf->sections[order[index]]);
+		align = section->shdr.sh_addralign;
+		if(align > 1 && (offset % align) != 0)
+		{
+			offset += align - (offset % align);
+		}
+		section->shdr.sh_offset = offset;
+		section->shdr.sh_size = section->data_len;
+		if((section->shdr.sh_flags & SHF_ALLOC) != 0)
+		{
+			section->shdr.sh_addr = offset;
+			load_end = offset + section->data_len;
+		}
+		offset += section->data_len;
+	}
+	if((offset % sizeof(Elf_Addr)) != 0)
+	{
+		offset += sizeof(Elf_Addr) - (offset % sizeof(Elf_Addr));
+	}
+
+	/* Link the dynamic tables together and fill in their addresses */
+	dynsym = section_index(writeelf, ".dynsym");
+	dynstr = section_index(writeelf, ".dynstr");
+	writeelf->sections[dynsym - 1].shdr.sh_link = dynstr;
+	writeelf->sections[dynsym - 1].shdr.sh_info = 1;
+	writeelf->sections[section_index(writeelf, ".hash") - 1].shdr.sh_link =
+		dynsym;
+	writeelf->sections[section_index(writeelf, ".rela.dyn") - 1].shdr.sh_link =
+		dynsym;
+	writeelf->sections[section_index(writeelf, ".dynamic") - 1].shdr.sh_link =
+		dynstr;
+	add_dyn_info(writeelf, DT_HASH, writeelf->sections
+		[section_index(writeelf, ".hash") - 1].shdr.sh_addr, 1);
+	add_dyn_info(writeelf, DT_STRTAB,
+				 writeelf->sections[dynstr - 1].shdr.sh_addr, 1);
+	add_dyn_info(writeelf, DT_STRSZ,
+				 writeelf->sections[dynstr - 1].shdr.sh_size, 1);
+	add_dyn_info(writeelf, DT_SYMTAB,
+				 writeelf->sections[dynsym - 1].shdr.sh_addr, 1);
+	section = &(writeelf->sections[section_index(writeelf, ".rela.dyn") - 1]);
+	add_dyn_info(writeelf, DT_RELA, section->shdr.sh_addr, 1);
+	add_dyn_info(writeelf, DT_RELASZ, section->shdr.sh_size, 1);
+
+	/* Build the ELF header and the program headers */
+	ehdr = writeelf->ehdr;
+	ehdr.e_type = ET_DYN;
+	ehdr.e_phoff = sizeof(Elf_Ehdr);
+	ehdr.e_shoff = offset;
+	ehdr.e_phentsize = sizeof(Elf_Phdr);
+	ehdr.e_phnum = JIT_ELF_NUM_PHDRS;
+	ehdr.e_shentsize = sizeof(Elf_Shdr);
+	ehdr.e_shnum = (Elf_Half)(writeelf->num_sections + 1);
+	ehdr.e_shstrndx = (Elf_Half)(writeelf->regular_string_section + 1);
+	jit_memzero(phdrs, sizeof(phdrs));
+	phdrs[0].p_type = PT_LOAD;
+	phdrs[0].p_flags = JIT_ELF_SEGMENT_FLAGS;
+	phdrs[0].p_filesz = load_end;
+	phdrs[0].p_memsz = load_end;
+	phdrs[0].p_align = (Elf_Xword)jit_vmem_page_size();
+	section = &(writeelf->sections[section_index(writeelf, ".dynamic") - 1]);
+	phdrs[1].p_type = PT_DYNAMIC;
+	phdrs[1].p_flags = JIT_ELF_SEGMENT_FLAGS;
+	phdrs[1].p_offset = section->shdr.sh_offset;
+	phdrs[1].p_vaddr = section->shdr.sh_addr;
+	phdrs[1].p_paddr = section->shdr.sh_addr;
+	phdrs[1].p_filesz = section->shdr.sh_size;
+	phdrs[1].p_memsz = section->shdr.sh_size;
+	phdrs[1].p_align = sizeof(Elf_Addr);
+
+	/* Write the headers, the section contents, and the section table */
+	file = fopen(filename, "wb");
+	if(!file)
+	{
+		jit_free(order);
+		return 0;
+	}
+	ok = (fwrite(&ehdr, sizeof(ehdr), 1, file) == 1 &&
+		  fwrite(phdrs, sizeof(phdrs), 1, file) == 1);
+	offset = sizeof(Elf_Ehdr) + JIT_ELF_NUM_PHDRS * sizeof(Elf_Phdr);
+	for(index = 0; ok && index < writeelf->num_sections; ++index)
+	{
+		section = &(writeelf->sections[order[index]]);
+		ok = write_padding(file, offset, section->shdr.sh_offset);
+		if(ok && section->data_len > 0)
+		{
+			ok = (fwrite(section->data, section->data_len, 1, file) == 1);
+		}
+		offset = section->shdr.sh_offset + section->data_len;
+	}
+	if(ok)
+	{
+		ok = write_padding(file, offset, ehdr.e_shoff);
+		jit_memzero(&shdr, sizeof(shdr));
+		if(ok)
+		{
+			ok = (fwrite(&shdr, sizeof(shdr), 1, file) == 1);
+		}
+	}
+	for(index = 0; ok && index < writeelf->num_sections; ++index)
+	{
+		ok = (fwrite(&(writeelf->sections[index].shdr),
+					 sizeof(Elf_Shdr), 1, file) == 1);
+	}
+	jit_free(order);
+	if(fclose(file) != 0)
+	{
+		ok = 0;
+	}
+	return ok;
 }
 
 /*@
@@ -434,13 +1282,180 @@ int jit_writeelf_write(jit_writeelf_t writeelf, const char *filename)
  * context must have the @code{JIT_OPTION_PRE_COMPILE} option set
  * to a non-zero value.  Returns zero if out of memory or the
  * parameters are invalid.
+ *
+ * The function is later reloaded with @code{jit_readelf_get_function}.
+ * Calls to other functions are allowed if those functions are also
+ * added to @var{writeelf} before it is written.  The function cannot
+ * contain calls to native functions other than the intrinsics of
+ * @code{libjit}, indirect calls, or @code{try} blocks, because these
+ * refer to objects that only exist in the current process.  Constant
+ * pointers are written as-is, so the function should not use them to
+ * refer to process-specific data.
+ *
+ * Native code can only be written on x86-64, and its context must
+ * also have the @code{JIT_OPTION_POSITION_INDEPENDENT} option set to
+ * a non-zero value.  The code generator then records the addresses
+ * in the code, which become relocations in the ELF binary.
  * @end deftypefun
 @*/
 int jit_writeelf_add_function
 	(jit_writeelf_t writeelf, jit_function_t func, const char *name)
 {
-	/* TODO */
-	return 1;
+#if defined(JIT_BACKEND_INTERP) || defined(JIT_BACKEND_X86_64)
+	static unsigned char const padding[JIT_ELF_TEXT_ALIGN];
+	jit_section_t text;
+	jit_section_t symtab;
+	jit_writeelf_func_t *functions;
+	void *info;
+	void **start;
+	void **end;
+	unsigned int offset;
+	unsigned int size;
+#if defined(JIT_BACKEND_X86_64)
+	unsigned int data_offset;
+#endif
+	Elf_Word symbol;
+	Elf_Sym sym;
+
+	/* Validate the parameters */
+	if(!writeelf || !func || !name || !(func->is_compiled) ||
+	   find_function(writeelf, func) ||
+	   !jit_context_get_meta_numeric(func->context, JIT_OPTION_PRE_COMPILE))
+	{
+		return 0;
+	}
+
+	/* Functions that catch exceptions or that share their frames with
+	   nested functions depend upon state that we do not write out */
+	if(func->has_try || func->nested_parent)
+	{
+		return 0;
+	}
+#if defined(JIT_BACKEND_INTERP)
+	if(func->arguments_pointer_offset != 0)
+	{
+		return 0;
+	}
+#endif
+
+	/* Find the code and make sure that we can relocate all of it */
+	start = (void **)(func->entry_point);
+	info = _jit_memory_find_function_info(func->context, start);
+	if(!info)
+	{
+		return 0;
+	}
+	end = (void **)_jit_memory_get_function_end(func->context, info);
+#if defined(JIT_BACKEND_INTERP)
+	if(!scan_interp_code(writeelf, start, end, 0, 0, 0))
+	{
+		return 0;
+	}
+#else
+	/* Only position-independent code has no addresses other than
+	   the ones that the code generator recorded */
+	if(!(func->reloc_table) ||
+	   !jit_context_get_meta_numeric
+			(func->context, JIT_OPTION_POSITION_INDEPENDENT) ||
+	   !scan_native_code(writeelf, func, (unsigned char *)start,
+						 (unsigned char *)end, 0, 0, 0, 0))
+	{
+		return 0;
+	}
+#endif
+
+	/* Get the sections that we need.  Creating a section moves the
+	   others, so the symbol table is fetched again after the code */
+	if(!get_symbol_table(writeelf))
+	{
+		return 0;
+	}
+	text = get_section(writeelf, ".text", SHT_PROGBITS, JIT_ELF_TEXT_FLAGS,
+					   0, JIT_ELF_TEXT_ALIGN);
+	if(!text)
+	{
+		return 0;
+	}
+	symtab = get_symbol_table(writeelf);
+	functions = (jit_writeelf_func_t *)jit_realloc
+		(writeelf->functions,
+		 (writeelf->num_functions + 1) * sizeof(jit_writeelf_func_t));
+	if(!functions)
+	{
+		return 0;
+	}
+	writeelf->functions = functions;
+
+	/* Copy the code into the ".text" section */
+	offset = text->data_len % JIT_ELF_TEXT_ALIGN;
+	if(offset != 0 &&
+	   !add_to_section(text, padding, JIT_ELF_TEXT_ALIGN - offset))
+	{
+		return 0;
+	}
+	offset = text->data_len;
+	size = (unsigned int)((unsigned char *)end - (unsigned char *)start);
+	if(!add_to_section(text, start, size))
+	{
+		return 0;
+	}
+#if defined(JIT_BACKEND_INTERP)
+	/* The copy does not point back at "func"; that is set when the
+	   code is loaded again */
+	((jit_function_interp_t)(text->data + offset))->func = 0;
+#else
+	/* Copy the constants of the code after it */
+	data_offset = text->data_len % JIT_ELF_TEXT_ALIGN;
+	if(data_offset != 0 &&
+	   !add_to_section(text, padding, JIT_ELF_TEXT_ALIGN - data_offset))
+	{
+		return 0;
+	}
+	data_offset = text->data_len;
+	if(func->reloc_table->data_end > func->reloc_table->data_start &&
+	   !add_to_section(text, func->reloc_table->data_start,
+					   (unsigned int)(func->reloc_table->data_end -
+									  func->reloc_table->data_start)))
+	{
+		return 0;
+	}
+#endif
+
+	/* Add the symbol for the function */
+	jit_memzero(&sym, sizeof(sym));
+	sym.st_name = add_dyn_string(writeelf, name);
+	if(!(sym.st_name))
+	{
+		return 0;
+	}
+	sym.st_info = ELF_ST_INFO(STB_GLOBAL, STT_FUNC);
+	sym.st_shndx = (Elf_Half)section_index(writeelf, ".text");
+	sym.st_value = JIT_ELF_TEXT_VADDR + offset;
+	sym.st_size = size;
+	symbol = (Elf_Word)(symtab->data_len / sizeof(Elf_Sym));
+	if(!add_to_section(symtab, &sym, sizeof(sym)))
+	{
+		return 0;
+	}
+	writeelf->functions[writeelf->num_functions].func = func;
+	writeelf->functions[writeelf->num_functions].symbol = symbol;
+	++(writeelf->num_functions);
+
+	/* Relocate the absolute addresses within the copied code */
+#if defined(JIT_BACKEND_INTERP)
+	return scan_interp_code
+		(writeelf, start, end, (void **)(text->data + offset),
+		 symbol, offset);
+#else
+	return scan_native_code
+		(writeelf, func, (unsigned char *)start, (unsigned char *)end,
+		 (unsigned char *)(text->data + offset), symbol, offset, data_offset);
+#endif
+#else
+	/* Only the x86-64 code generator records the absolute addresses
+	   in the code, so other native code cannot be relocated */
+	return 0;
+#endif
 }
 
 /*@
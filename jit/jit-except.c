@@ -129,6 +129,7 @@ void jit_exception_throw(void *object)
 	if(control)
 	{
 		control->last_exception = object;
+		_jit_unwind_catch(0);
 		if(control->setjmp_head)
 		{
 			control->backtrace_head = control->setjmp_head->trace;
@@ -545,3 +546,18 @@ void _jit_unwind_pop_and_rethrow(void)
 	_jit_unwind_pop_setjmp();
 	jit_exception_throw(jit_exception_get_last());
 }
+
+void _jit_unwind_rethrow(void *object)
+{
+	jit_thread_control_t control = _jit_thread_get_control();
+	if(control)
+	{
+		control->last_exception = object;
+		_jit_unwind_catch(1);
+		if(control->setjmp_head)
+		{
+			control->backtrace_head = control->setjmp_head->trace;
+			longjmp(control->setjmp_head->buf, 1);
+		}
+	}
+}
@@ -84,9 +84,6 @@ jit_function_create(jit_context_t context, jit_type_t signature)
 # endif
 #endif /* !defined(JIT_BACKEND_INTERP) && (defined(jit_redirector_size) || defined(jit_indirector_size)) */
 
-	/* Release the memory context */
-	_jit_memory_unlock(context);
-
 	/* Initialize the function block */
 	func->context = context;
 	func->signature = jit_type_copy(signature);
@@ -119,6 +116,9 @@ jit_function_create(jit_context_t context, jit_type_t signature)
 	}
 	context->last_function = func;
 
+	/* Release the memory context */
+	_jit_memory_unlock(context);
+
 	/* Return the function to the caller */
 	return func;
 }
@@ -149,6 +149,8 @@ jit_function_t jit_function_create_nested
 
 int _jit_function_ensure_builder(jit_function_t func)
 {
+	_jit_arena_t arena;
+
 	/* Handle the easy cases first */
 	if(!func)
 	{
@@ -160,10 +162,28 @@ int _jit_function_ensure_builder(jit_function_t func)
 	}
 
 	/* Allocate memory for the builder and clear it */
-	func->builder = jit_cnew(struct _jit_builder);
-	if(!(func->builder))
+	if(jit_context_get_meta_numeric(func->context, JIT_OPTION_BUILDER_ARENA))
 	{
-		return 0;
+		arena = _jit_arena_acquire();
+		if(!arena)
+		{
+			return 0;
+		}
+		func->builder = _jit_arena_calloc(arena, 1, sizeof(struct _jit_builder));
+		if(!(func->builder))
+		{
+			_jit_arena_release(arena);
+			return 0;
+		}
+		func->builder->arena = arena;
+	}
+	else
+	{
+		func->builder = jit_cnew(struct _jit_builder);
+		if(!(func->builder))
+		{
+			return 0;
+		}
 	}
 
 	/* Cache the value of the JIT_OPTION_POSITION_INDEPENDENT option */
@@ -175,6 +195,9 @@ int _jit_function_ensure_builder(jit_function_t func)
 	jit_memory_pool_init(&(func->builder->value_pool), struct _jit_value);
 	jit_memory_pool_init(&(func->builder->edge_pool), struct _jit_edge);
 	jit_memory_pool_init(&(func->builder->meta_pool), struct _jit_meta);
+	func->builder->value_pool.arena = func->builder->arena;
+	func->builder->edge_pool.arena = func->builder->arena;
+	func->builder->meta_pool.arena = func->builder->arena;
 
 	/* Create the entry block */
 	if(!_jit_block_init(func))
@@ -208,15 +231,27 @@ int _jit_function_ensure_builder(jit_function_t func)
 
 void _jit_function_free_builder(jit_function_t func)
 {
+	_jit_arena_t arena;
+
 	if(func->builder)
 	{
 		_jit_block_free(func);
 		jit_memory_pool_free(&(func->builder->edge_pool), 0);
 		jit_memory_pool_free(&(func->builder->value_pool), _jit_value_free);
 		jit_memory_pool_free(&(func->builder->meta_pool), _jit_meta_free_one);
-		jit_free(func->builder->param_values);
-		jit_free(func->builder->label_info);
-		jit_free(func->builder);
+		arena = func->builder->arena;
+		if(arena)
+		{
+			/* Everything else is in the arena */
+			_jit_arena_release(arena);
+		}
+		else
+		{
+			jit_free(func->builder->param_values);
+			jit_free(func->builder->label_info);
+			jit_free(func->builder->insns);
+			jit_free(func->builder);
+		}
 		func->builder = 0;
 		func->is_optimized = 0;
 	}
@@ -233,6 +268,18 @@ _jit_function_destroy(jit_function_t func)
 	}
 
 	context = func->context;
+
+	_jit_function_free_builder(func);
+	_jit_varint_free_data(func->bytecode_offset);
+	jit_free(func->compile_stats);
+	jit_free(func->reloc_table);
+	jit_free(func->branch_counts);
+	jit_meta_destroy(&func->meta);
+	jit_type_free(func->signature);
+	_jit_unwind_deregister(func);
+
+	_jit_memory_lock(context);
+
 	if(func->next)
 	{
 		func->next->prev = func->prev;
@@ -250,13 +297,6 @@ _jit_function_destroy(jit_function_t func)
 		context->functions = func->next;
 	}
 
-	_jit_function_free_builder(func);
-	_jit_varint_free_data(func->bytecode_offset);
-	jit_meta_destroy(&func->meta);
-	jit_type_free(func->signature);
-
-	_jit_memory_lock(context);
-
 #if !defined(JIT_BACKEND_INTERP) && (defined(jit_redirector_size) || defined(jit_indirector_size))
 # if defined(jit_redirector_size)
 	_jit_memory_free_trampoline(context, func->redirector);
@@ -297,6 +337,26 @@ void jit_function_abandon(jit_function_t func)
 	}
 }
 
+/*@
+ * @deftypefun void jit_function_destroy (jit_function_t @var{func})
+ * Destroy a function, whether it was compiled or not, and give the memory
+ * of its code back to the context for reuse.  The caller must make sure
+ * that the function is not running and that it cannot be called anymore,
+ * either directly or from other functions and closures.
+ *
+ * Use @code{jit_context_get_memory_stats} to check how much memory
+ * is available for reuse.
+ * @end deftypefun
+@*/
+void
+jit_function_destroy(jit_function_t func)
+{
+	if(func && _jit_tier_forget(func))
+	{
+		_jit_function_destroy(func);
+	}
+}
+
 /*@
  * @deftypefun jit_context_t jit_function_get_context (jit_function_t @var{func})
  * Get the context associated with a function.
@@ -599,6 +659,27 @@ int jit_function_is_recompilable(jit_function_t func)
 	}
 }
 
+/*@
+ * @deftypefun void jit_function_set_complete (jit_function_t @var{func})
+ * Mark the body of @var{func} as complete.  A function that is still
+ * being built is copied into its callers by @code{jit_insn_call} only
+ * once it is marked this way, because the callers would otherwise get
+ * the instructions that were built so far.  Functions with an on-demand
+ * compiler do not need this, as they are built again for inlining.
+ * No instructions may be added to @var{func} after this call.  The
+ * instructions are no longer copied once @code{jit_optimize} or
+ * @code{jit_function_compile} is called on @var{func}, which may be done
+ * by another thread while the callers are being built.
+ * @end deftypefun
+@*/
+void jit_function_set_complete(jit_function_t func)
+{
+	if(func)
+	{
+		func->is_complete = 1;
+	}
+}
+
 #ifdef JIT_BACKEND_INTERP
 
 /*
@@ -681,6 +762,9 @@ jit_function_from_closure(jit_context_t context, void *closure)
  * Also return the address of the @code{catch} handler for the same location.
  * Returns NULL if the program counter does not correspond to a function
  * under the control of @var{context}.
+ *
+ * The default memory manager performs the lookup without locking, so this
+ * may be called from any thread while other threads compile functions.
  * @end deftypefun
 @*/
 jit_function_t
@@ -810,6 +894,9 @@ jit_function_from_vtable_pointer(jit_context_t context, void *vtable_pointer)
  * @enumerate
  * @item
  * The context is locked by calling @code{jit_context_build_start}.
+ * If the @code{JIT_OPTION_CONCURRENT_COMPILE} option is set on the
+ * context then only the function itself is locked, so that other
+ * functions can be compiled by other threads at the same time.
  *
  * @item
  * If the function has already been compiled, @code{libjit} unlocks
@@ -912,6 +999,8 @@ int jit_function_apply_vararg
 {
 	struct jit_backtrace call_trace;
 	void *entry;
+	void (*stub)(void *entry, void **args, void *return_area);
+	jit_long return_buffer;
 	jit_jmp_buf jbuf;
 
 	/* Establish a "setjmp" point here so that we can unwind the
@@ -957,8 +1046,20 @@ int jit_function_apply_vararg
 	/* Clear the exception state */
 	jit_exception_clear_last();
 
-	/* Apply the function.  If it returns, then there is no exception */
-	jit_apply(signature, entry, args, jit_type_num_params(func->signature), return_area);
+	/* Apply the function.  If it returns, then there is no exception.
+	   Calls with the function's own signature go through the stub
+	   that is specialized for it, if there is one */
+	stub = (signature == func->signature)
+		? _jit_apply_get_stub(signature, 0) : 0;
+	if(stub)
+	{
+		(*stub)(entry, args, return_area ? return_area : &return_buffer);
+	}
+	else
+	{
+		jit_apply(signature, entry, args,
+			  jit_type_num_params(func->signature), return_area);
+	}
 
 	/* Restore the backtrace and "setjmp" contexts and exit */
 	_jit_unwind_pop_setjmp();
@@ -974,6 +1075,18 @@ int jit_function_apply_vararg
  * generate better code for this function.  Usually you would increase
  * this value just before forcing @var{func} to recompile.
  *
+ * At @code{JIT_OPTLEVEL_NONE} the instructions are translated as they are.
+ * @code{JIT_OPTLEVEL_NORMAL} builds the control flow graph, removes
+ * useless branches and allocates global registers.
+ * @code{JIT_OPTLEVEL_AGGRESSIVE} additionally converts the function to
+ * the static single assignment form to propagate constants and copies
+ * across blocks, resolve branches with a known outcome and remove
+ * dead code.  It also moves loop invariant code out of the loops,
+ * replaces multiplications of induction variables with additions and
+ * removes redundant null pointer checks within the loops.  If the
+ * @code{JIT_OPTION_INLINE_LIMIT} option is set, small functions that
+ * are called with @code{jit_insn_call} are inlined at this level.
+ *
  * When the optimization level reaches the value returned by
  * @code{jit_function_get_max_optimization_level()}, there is usually
  * little point in continuing to recompile the function because
@@ -1025,7 +1138,79 @@ jit_function_get_optimization_level(jit_function_t func)
 unsigned int
 jit_function_get_max_optimization_level(void)
 {
-	return JIT_OPTLEVEL_NORMAL;
+	return JIT_OPTLEVEL_AGGRESSIVE;
+}
+
+/*@
+ * @deftypefun int jit_function_get_compile_stats (jit_function_t @var{func}, jit_compile_stats_t *@var{stats})
+ * Get the compile statistics of the last compilation of @var{func}.
+ * The fields are the same as for @code{jit_context_get_compile_stats},
+ * except that @code{memory} is left zero.  Returns zero if @var{func}
+ * was not compiled while @code{JIT_OPTION_COMPILE_STATS} was set.
+ * @end deftypefun
+@*/
+int
+jit_function_get_compile_stats(jit_function_t func, jit_compile_stats_t *stats)
+{
+	if(!func || !stats)
+	{
+		return 0;
+	}
+	jit_memzero(stats, sizeof(jit_compile_stats_t));
+
+	_jit_memory_lock(func->context);
+	if(func->compile_stats)
+	{
+		*stats = *(func->compile_stats);
+	}
+	_jit_memory_unlock(func->context);
+
+	return (stats->num_functions != 0);
+}
+
+/*@
+ * @deftypefun int jit_function_set_name (jit_function_t @var{func}, const char *@var{name})
+ * Set the name of @var{func} that is used by the profiling support
+ * of @code{JIT_OPTION_PERF}.  A copy of @var{name} is kept with the
+ * function.  Returns zero if out of memory.
+ * @end deftypefun
+@*/
+int
+jit_function_set_name(jit_function_t func, const char *name)
+{
+	char *copy;
+
+	if(!func || !name)
+	{
+		return 0;
+	}
+	copy = jit_strdup(name);
+	if(!copy)
+	{
+		return 0;
+	}
+	if(!jit_meta_set(&(func->meta), JIT_META_FUNCTION_NAME, copy,
+			 jit_free, 0))
+	{
+		jit_free(copy);
+		return 0;
+	}
+	return 1;
+}
+
+/*@
+ * @deftypefun {const char *} jit_function_get_name (jit_function_t @var{func})
+ * Get the name of @var{func}, or NULL if it does not have one.
+ * @end deftypefun
+@*/
+const char *
+jit_function_get_name(jit_function_t func)
+{
+	if(!func)
+	{
+		return 0;
+	}
+	return (const char *) jit_meta_get(func->meta, JIT_META_FUNCTION_NAME);
 }
 
 /*@
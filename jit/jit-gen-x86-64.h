@@ -120,6 +120,45 @@ typedef enum
 	XMM_XORP		= 0x57
 } X86_64_XMM_PLOP;
 
+/*
+ * Opcodes used with packed values.  The floating point
+ * opcodes work on single precision values without a prefix and on
+ * double precision values with the 0x66 prefix.  The integer opcodes
+ * always need the 0x66 prefix.
+ */
+typedef enum
+{
+	XMM_PSQRT		= 0x51,
+	XMM_PADD		= 0x58,
+	XMM_PMUL		= 0x59,
+	XMM_PSUB		= 0x5C,
+	XMM_PMIN		= 0x5D,
+	XMM_PDIV		= 0x5E,
+	XMM_PMAX		= 0x5F,
+	XMM_PUNPCKLDQ	= 0x62,
+	XMM_PCMPGTB		= 0x64,
+	XMM_PCMPGTD		= 0x66,
+	XMM_PSHUFD		= 0x70,
+	XMM_PCMPEQB		= 0x74,
+	XMM_PCMPEQD		= 0x76,
+	XMM_PCMP		= 0xC2,
+	XMM_PMULUDQ		= 0xF4,
+	XMM_PSUBB		= 0xF8,
+	XMM_PSUBD		= 0xFA,
+	XMM_PADDB		= 0xFC,
+	XMM_PADDD		= 0xFE
+} X86_64_XMM_POP;
+
+/*
+ * Predicates for XMM_PCMP (cmpps and cmppd).
+ */
+typedef enum
+{
+	XMM_CMP_EQ		= 0,
+	XMM_CMP_LT		= 1,
+	XMM_CMP_LE		= 2
+} X86_64_XMM_CMP;
+
 /*
  * Rounding modes for xmm rounding instructions, the mxcsr register and
  * the fpu control word.
@@ -2257,6 +2296,38 @@ typedef union
 		x86_64_shift_memindex_size((inst), 7, (basereg), (disp), (indexreg), (shift), (size)); \
 	} while(0)
 
+/*
+ * BMI2 shifts by a count in any register: shlx, sarx and shrx.
+ * These use a three byte VEX prefix where the count register is
+ * encoded (inverted) in the vvvv field. The flags are not modified.
+ * pp selects the operation (1 = shlx, 2 = sarx, 3 = shrx).
+ */
+#define x86_64_shiftx_reg_reg_reg_size(inst, pp, dreg, sreg, creg, size) \
+	do { \
+		*(inst)++ = (unsigned char)0xc4; \
+		*(inst)++ = (unsigned char)((((dreg) & 8) ? 0 : 0x80) | 0x40 | \
+									(((sreg) & 8) ? 0 : 0x20) | 0x02); \
+		*(inst)++ = (unsigned char)(((size) == 8 ? 0x80 : 0) | \
+									((~(creg) & 0x0f) << 3) | (pp)); \
+		*(inst)++ = (unsigned char)0xf7; \
+		x86_64_reg_emit((inst), (dreg), (sreg)); \
+	} while(0)
+
+#define x86_64_shlx_reg_reg_reg_size(inst, dreg, sreg, creg, size) \
+	do { \
+		x86_64_shiftx_reg_reg_reg_size((inst), 1, (dreg), (sreg), (creg), (size)); \
+	} while(0)
+
+#define x86_64_sarx_reg_reg_reg_size(inst, dreg, sreg, creg, size) \
+	do { \
+		x86_64_shiftx_reg_reg_reg_size((inst), 2, (dreg), (sreg), (creg), (size)); \
+	} while(0)
+
+#define x86_64_shrx_reg_reg_reg_size(inst, dreg, sreg, creg, size) \
+	do { \
+		x86_64_shiftx_reg_reg_reg_size((inst), 3, (dreg), (sreg), (creg), (size)); \
+	} while(0)
+
 /*
  * test: and tha values and set sf, zf and pf according to the result
  */
@@ -4917,6 +4988,24 @@ typedef union
 		x86_64_p1_xmm2_reg_memindex_size((inst), 0x66, 0x0f, 0x57, (dreg), (basereg), (disp), (indexreg), (shift), 0); \
 	} while(0)
 
+/*
+ * pshufd: Shuffle the packed doublewords of sreg into dreg
+ */
+#define x86_64_pshufd_reg_reg(inst, dreg, sreg, order) \
+	do { \
+		x86_64_plopd_reg_reg((inst), XMM_PSHUFD, (dreg), (sreg)); \
+		*(inst)++ = (unsigned char)(order); \
+	} while(0)
+
+/*
+ * psrlq: Shift the packed quadwords right
+ */
+#define x86_64_psrlq_reg_imm(inst, reg, imm) \
+	do { \
+		x86_64_plopd_reg_reg((inst), 0x73, 2, (reg)); \
+		*(inst)++ = (unsigned char)(imm); \
+	} while(0)
+
 /*
  * maxsd: Maximum value
  */
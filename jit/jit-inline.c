@@ -0,0 +1,637 @@
+/*
+ * jit-inline.c - Inlining of calls between functions.
+ *
+ * Copyright (C) 2026  Free Software Foundation
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+
+/*
+ * When JIT_OPTION_INLINE_LIMIT is set, "jit_insn_call" copies the
+ * instructions of small functions into callers that are built at
+ * JIT_OPTLEVEL_AGGRESSIVE instead of calling them.  The instructions are
+ * taken from the callee's builder if the callee is still being built.
+ * Otherwise the callee's on-demand compiler builds them again into a
+ * temporary copy of the function that is never compiled.
+ *
+ * The parameters of the callee are replaced by the arguments, or by new
+ * values that are set from the arguments if the callee changes them or
+ * takes their address.  Each block of the callee gets a label in the
+ * caller, and the returns become stores to the result value followed by
+ * a branch past the copied code.  Constant arguments are then folded by
+ * the usual optimization passes of the caller.
+ */
+
+/*
+ * Maximum nesting of functions that are rebuilt for inlining.
+ */
+#define	JIT_INLINE_MAX_DEPTH		3
+
+/*
+ * State of the copy of a function's instructions.
+ */
+typedef struct
+{
+	jit_function_t		func;
+	jit_function_t		callee;
+	jit_function_t		source;
+	jit_value_t		*from;
+	jit_value_t		*to;
+	unsigned int		num_values;
+	unsigned int		max_values;
+	jit_label_t		*labels;
+} _jit_inline_t;
+
+/*
+ * Determine if the parameters and the result of a signature are simple
+ * enough to be passed in values of the caller.
+ */
+static int
+is_simple_signature(jit_type_t signature)
+{
+	unsigned int num_params, param;
+	jit_type_t type;
+
+	if(jit_type_get_abi(signature) == jit_abi_vararg)
+	{
+		return 0;
+	}
+	type = jit_type_normalize(jit_type_get_return(signature));
+	if(jit_type_is_struct(type) || jit_type_is_union(type))
+	{
+		return 0;
+	}
+	num_params = jit_type_num_params(signature);
+	for(param = 0; param < num_params; ++param)
+	{
+		type = jit_type_normalize(jit_type_get_param(signature, param));
+		if(jit_type_is_struct(type) || jit_type_is_union(type))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Determine if a value of the source function can be copied.
+ */
+static int
+is_copyable_value(jit_value_t value)
+{
+	if(!value || !value->is_constant)
+	{
+		return 1;
+	}
+	return !value->free_address
+		&& jit_value_get_constant(value).type != jit_type_void;
+}
+
+/*
+ * Check the instructions of "source" and number its blocks.  Returns
+ * zero if the instructions cannot be copied into "func" or if there
+ * are more than "limit" of them.
+ */
+static int
+can_inline_body(jit_function_t func, jit_function_t source, jit_nuint limit)
+{
+	jit_builder_t builder = source->builder;
+	jit_block_t block;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	jit_nuint count;
+	int index;
+
+	/* Exception handlers, structure returns and nested functions
+	   depend on the frame of the function itself */
+	if(source->has_try || builder->setjmp_value || builder->thrown_exception
+	   || builder->struct_return || builder->parent_frame
+	   || builder->has_tail_call)
+	{
+		return 0;
+	}
+
+	/* The "catch" blocks of the caller only know about the calls
+	   that the caller makes by itself */
+	if(builder->may_throw && (func->has_try || func->builder->setjmp_value))
+	{
+		return 0;
+	}
+
+	count = 0;
+	index = 0;
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		block->index = index++;
+		jit_insn_iter_init(&iter, block);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			switch(insn->opcode)
+			{
+			case JIT_OP_INCOMING_REG:
+			case JIT_OP_INCOMING_FRAME_POSN:
+				/* Parameters are replaced by the arguments */
+				if(!insn->value1->is_parameter)
+				{
+					return 0;
+				}
+				continue;
+
+			case JIT_OP_RETURN_SMALL_STRUCT:
+			case JIT_OP_IMPORT:
+			case JIT_OP_RETHROW:
+			case JIT_OP_LOAD_PC:
+			case JIT_OP_LOAD_EXCEPTION_PC:
+			case JIT_OP_ENTER_FINALLY:
+			case JIT_OP_LEAVE_FINALLY:
+			case JIT_OP_CALL_FINALLY:
+			case JIT_OP_ENTER_FILTER:
+			case JIT_OP_LEAVE_FILTER:
+			case JIT_OP_CALL_FILTER:
+			case JIT_OP_CALL_FILTER_RETURN:
+			case JIT_OP_ADDRESS_OF_LABEL:
+			case JIT_OP_RETRIEVE_FRAME_POINTER:
+			case JIT_OP_ALLOCA:
+			case JIT_OP_JUMP_TABLE:
+				return 0;
+			}
+
+			if((insn->flags & JIT_INSN_DEST_IS_LABEL) != 0)
+			{
+				if(!jit_block_from_label(source, (jit_label_t) insn->dest))
+				{
+					return 0;
+				}
+			}
+			else if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0
+				&& !is_copyable_value(insn->dest))
+			{
+				return 0;
+			}
+			if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0
+			   && !is_copyable_value(insn->value1))
+			{
+				return 0;
+			}
+			if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0
+			   && !is_copyable_value(insn->value2))
+			{
+				return 0;
+			}
+
+			if(++count > limit)
+			{
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/*
+ * Determine if the source function changes one of its parameters.
+ */
+static int
+is_param_changed(jit_function_t source, jit_value_t param)
+{
+	jit_block_t block;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+
+	if(param->is_addressable || param->is_volatile)
+	{
+		return 1;
+	}
+	for(block = source->builder->entry_block; block; block = block->next)
+	{
+		jit_insn_iter_init(&iter, block);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			if(insn->dest == param
+			   && (insn->flags & (JIT_INSN_DEST_OTHER_FLAGS
+					      | JIT_INSN_DEST_IS_VALUE)) == 0
+			   && insn->opcode != JIT_OP_INCOMING_REG
+			   && insn->opcode != JIT_OP_INCOMING_FRAME_POSN)
+			{
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Record that "value" of the source function is "new_value" in the caller.
+ */
+static int
+add_value(_jit_inline_t *state, jit_value_t value, jit_value_t new_value)
+{
+	jit_value_t *from, *to;
+	unsigned int max_values;
+
+	if(state->num_values == state->max_values)
+	{
+		max_values = state->max_values ? state->max_values * 2 : 16;
+		from = (jit_value_t *) jit_realloc(state->from,
+						   max_values * sizeof(jit_value_t));
+		if(!from)
+		{
+			return 0;
+		}
+		state->from = from;
+		to = (jit_value_t *) jit_realloc(state->to,
+						 max_values * sizeof(jit_value_t));
+		if(!to)
+		{
+			return 0;
+		}
+		state->to = to;
+		state->max_values = max_values;
+	}
+	state->from[state->num_values] = value;
+	state->to[state->num_values] = new_value;
+	++(state->num_values);
+	return 1;
+}
+
+/*
+ * Get the caller's value for a value of the source function and
+ * reference it from the current block.  Returns NULL if out of memory.
+ */
+static jit_value_t
+map_value(_jit_inline_t *state, jit_value_t value)
+{
+	jit_value_t new_value;
+	jit_constant_t constant;
+	unsigned int index;
+
+	for(index = 0; index < state->num_values; ++index)
+	{
+		if(state->from[index] == value)
+		{
+			new_value = state->to[index];
+			jit_value_ref(state->func, new_value);
+			return new_value;
+		}
+	}
+
+	if(value->is_constant)
+	{
+		constant = jit_value_get_constant(value);
+		return jit_value_create_constant(state->func, &constant);
+	}
+
+	/* Create a value of the same kind on first use */
+	new_value = jit_value_create(state->func, value->type);
+	if(!new_value)
+	{
+		return 0;
+	}
+	new_value->is_temporary = value->is_temporary;
+	new_value->is_local = value->is_local;
+	new_value->is_volatile = value->is_volatile;
+	new_value->is_addressable = value->is_addressable;
+	new_value->global_candidate = value->global_candidate;
+	if(!add_value(state, value, new_value))
+	{
+		return 0;
+	}
+	jit_value_ref(state->func, new_value);
+	return new_value;
+}
+
+/*
+ * Get the caller's label for the block of a label of the source function.
+ */
+static jit_label_t
+map_label(_jit_inline_t *state, jit_label_t label)
+{
+	jit_block_t block = jit_block_from_label(state->source, label);
+	if(state->labels[block->index] == jit_label_undefined)
+	{
+		state->labels[block->index] = jit_function_reserve_label(state->func);
+	}
+	return state->labels[block->index];
+}
+
+/*
+ * Copy an instruction of the source function to the current block of
+ * the caller.  Returns zero if out of memory.
+ */
+static int
+copy_insn(_jit_inline_t *state, jit_insn_t insn)
+{
+	jit_value_t dest, value1, value2;
+	jit_insn_t new_insn;
+
+	if((insn->flags & JIT_INSN_DEST_IS_LABEL) != 0)
+	{
+		dest = (jit_value_t) map_label(state, (jit_label_t) insn->dest);
+	}
+	else if((insn->flags & JIT_INSN_DEST_IS_FUNCTION) != 0)
+	{
+		/* Calls to the temporary copy go to the function itself */
+		dest = insn->dest;
+		if(dest == (jit_value_t) state->source)
+		{
+			dest = (jit_value_t) state->callee;
+		}
+	}
+	else if((insn->flags & JIT_INSN_DEST_IS_NATIVE) != 0 || !insn->dest)
+	{
+		dest = insn->dest;
+	}
+	else if(!(dest = map_value(state, insn->dest)))
+	{
+		return 0;
+	}
+
+	if((insn->flags & JIT_INSN_VALUE1_IS_NAME) != 0 || !insn->value1)
+	{
+		value1 = insn->value1;
+	}
+	else if(!(value1 = map_value(state, insn->value1)))
+	{
+		return 0;
+	}
+
+	if((insn->flags & JIT_INSN_VALUE2_IS_SIGNATURE) != 0)
+	{
+		value2 = (jit_value_t) jit_type_copy((jit_type_t) insn->value2);
+	}
+	else if(!insn->value2)
+	{
+		value2 = 0;
+	}
+	else if(!(value2 = map_value(state, insn->value2)))
+	{
+		return 0;
+	}
+
+	new_insn = _jit_block_add_insn(state->func->builder->current_block);
+	if(!new_insn)
+	{
+		return 0;
+	}
+	new_insn->opcode = insn->opcode;
+	new_insn->flags = insn->flags & ~JIT_INSN_LIVENESS_FLAGS;
+	new_insn->dest = dest;
+	new_insn->value1 = value1;
+	new_insn->value2 = value2;
+	return 1;
+}
+
+/*
+ * Copy the instructions of the source function into the caller.
+ * Returns the value holding the result, or NULL if out of memory.
+ */
+static jit_value_t
+inline_body(_jit_inline_t *state, jit_type_t signature,
+	    jit_value_t *args, unsigned int num_args)
+{
+	jit_function_t func = state->func;
+	jit_builder_t builder = state->source->builder;
+	jit_value_t result, param, value;
+	jit_label_t end_label;
+	jit_block_t block;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	unsigned int index;
+
+	result = jit_value_create(func, jit_type_get_return(signature));
+	if(!result)
+	{
+		return 0;
+	}
+
+	/* Pass the arguments directly unless the callee changes the
+	   parameters or may see changes through a pointer */
+	for(index = 0; index < num_args; ++index)
+	{
+		param = builder->param_values ? builder->param_values[index] : 0;
+		if(!param)
+		{
+			continue;
+		}
+		value = args[index];
+		if(is_param_changed(state->source, param)
+		   || (!value->is_constant
+		       && (value->is_addressable || value->is_volatile)))
+		{
+			value = jit_value_create(func, param->type);
+			if(!value || !jit_insn_store(func, value, args[index]))
+			{
+				return 0;
+			}
+		}
+		if(!add_value(state, param, value))
+		{
+			return 0;
+		}
+	}
+
+	end_label = jit_label_undefined;
+	for(block = builder->entry_block; block != builder->exit_block;
+	    block = block->next)
+	{
+		if(!jit_insn_label_tight(func, &state->labels[block->index]))
+		{
+			return 0;
+		}
+
+		jit_insn_iter_init(&iter, block);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			switch(insn->opcode)
+			{
+			case JIT_OP_INCOMING_REG:
+			case JIT_OP_INCOMING_FRAME_POSN:
+				break;
+
+			case JIT_OP_RETURN_INT:
+			case JIT_OP_RETURN_LONG:
+			case JIT_OP_RETURN_FLOAT32:
+			case JIT_OP_RETURN_FLOAT64:
+			case JIT_OP_RETURN_NFLOAT:
+				value = map_value(state, insn->value1);
+				if(!value || !jit_insn_store(func, result, value))
+				{
+					return 0;
+				}
+				/* Fall through */
+
+			case JIT_OP_RETURN:
+				if(!jit_insn_branch(func, &end_label))
+				{
+					return 0;
+				}
+				break;
+
+			default:
+				if(!copy_insn(state, insn))
+				{
+					return 0;
+				}
+				break;
+			}
+		}
+
+		/* Returns have already started a new block */
+		if(block->ends_in_dead
+		   && _jit_block_get_last(func->builder->current_block))
+		{
+			func->builder->current_block->ends_in_dead = 1;
+		}
+	}
+
+	if(!jit_insn_label_tight(func, &end_label))
+	{
+		return 0;
+	}
+
+	/* The caller now makes the calls of the callee */
+	if(builder->non_leaf)
+	{
+		func->builder->non_leaf = 1;
+	}
+	if(builder->may_throw)
+	{
+		func->builder->may_throw = 1;
+	}
+	if(builder->param_area_size > func->builder->param_area_size)
+	{
+		func->builder->param_area_size = builder->param_area_size;
+	}
+	return result;
+}
+
+/*
+ * Build the instructions of "callee" with its on-demand compiler into
+ * a temporary copy that shares the callee's metadata.
+ */
+static jit_function_t
+rebuild_callee(jit_function_t func, jit_function_t callee)
+{
+	jit_function_t copy;
+	int result;
+
+	copy = jit_function_create(func->context, callee->signature);
+	if(!copy)
+	{
+		return 0;
+	}
+	copy->meta = callee->meta;
+	copy->optimization_level = callee->optimization_level;
+	copy->inline_depth = func->inline_depth + 1;
+
+	result = (callee->on_demand)(copy);
+	if(result != JIT_RESULT_OK || !copy->builder)
+	{
+		copy->meta = 0;
+		_jit_function_destroy(copy);
+		return 0;
+	}
+	return copy;
+}
+
+int
+_jit_function_inline(jit_function_t func, jit_function_t callee,
+		     jit_type_t signature, jit_value_t *args,
+		     unsigned int num_args, jit_value_t *return_value)
+{
+	_jit_inline_t state;
+	jit_function_t source;
+	jit_nuint limit;
+	int num_blocks, index, inlined, locked;
+
+	/* Check that inlining is enabled and that the call is simple enough */
+	limit = jit_context_get_meta_numeric(func->context, JIT_OPTION_INLINE_LIMIT);
+	if(!limit || func->optimization_level < JIT_OPTLEVEL_AGGRESSIVE
+	   || callee == func || callee->context != func->context
+	   || callee->nested_parent || signature != callee->signature
+	   || num_args != jit_type_num_params(signature)
+	   || !is_simple_signature(signature))
+	{
+		return 0;
+	}
+
+	/* Find the instructions of the callee.  A callee that is still being
+	   built is used only once its body is marked as complete.  Its
+	   builder is copied under the compile monitor, because another thread
+	   may compile the callee and then clears the flag under the monitor
+	   before it optimizes and frees the builder */
+	locked = 0;
+	if(!callee->on_demand)
+	{
+		jit_monitor_lock(&func->context->compile_monitor);
+		if(!callee->builder || !callee->is_complete)
+		{
+			jit_monitor_unlock(&func->context->compile_monitor);
+			return 0;
+		}
+		locked = 1;
+		source = callee;
+	}
+	else if(func->inline_depth < JIT_INLINE_MAX_DEPTH)
+	{
+		source = rebuild_callee(func, callee);
+		if(!source)
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		return 0;
+	}
+
+	inlined = 0;
+	if(can_inline_body(func, source, limit))
+	{
+		inlined = 1;
+		*return_value = 0;
+
+		num_blocks = source->builder->exit_block->index + 1;
+		jit_memzero(&state, sizeof(state));
+		state.func = func;
+		state.callee = callee;
+		state.source = source;
+		state.labels = (jit_label_t *) jit_malloc(num_blocks * sizeof(jit_label_t));
+		if(state.labels)
+		{
+			for(index = 0; index < num_blocks; ++index)
+			{
+				state.labels[index] = jit_label_undefined;
+			}
+			*return_value = inline_body(&state, signature, args, num_args);
+		}
+		jit_free(state.labels);
+		jit_free(state.from);
+		jit_free(state.to);
+	}
+
+	if(locked)
+	{
+		jit_monitor_unlock(&func->context->compile_monitor);
+	}
+	else
+	{
+		source->meta = 0;
+		_jit_function_destroy(source);
+	}
+	return inlined;
+}
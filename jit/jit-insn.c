@@ -585,6 +585,11 @@ apply_intrinsic(jit_function_t func, const jit_opcode_descr *descr,
 	}
 }
 
+static jit_value_t apply_vector(jit_function_t func,
+				const jit_opcode_descr *descr,
+				jit_value_t value1, jit_value_t value2,
+				int is_compare);
+
 /*
  * Apply a unary arithmetic operator, after coercing the
  * argument to a suitable numeric type.
@@ -594,6 +599,11 @@ apply_unary_arith(jit_function_t func, const jit_opcode_descr *descr,
 		  jit_value_t value, int int_only, int float_only,
 		  int overflow_check)
 {
+	if(jit_type_is_vector(value->type))
+	{
+		return apply_vector(func, descr, value, 0, 0);
+	}
+
 	jit_type_t type = common_binary(value->type, value->type, int_only, float_only);
 
 	int oper;
@@ -665,6 +675,11 @@ apply_arith(jit_function_t func, const jit_opcode_descr *descr,
 	    jit_value_t value1, jit_value_t value2,
 	    int int_only, int float_only, int overflow_check)
 {
+	if(jit_type_is_vector(value1->type) || jit_type_is_vector(value2->type))
+	{
+		return apply_vector(func, descr, value1, value2, 0);
+	}
+
 	jit_type_t type = common_binary(value1->type, value2->type, int_only, float_only);
 
 	int oper;
@@ -792,6 +807,11 @@ static jit_value_t
 apply_compare(jit_function_t func, const jit_opcode_descr *descr,
 	      jit_value_t value1, jit_value_t value2, int float_only)
 {
+	if(jit_type_is_vector(value1->type) || jit_type_is_vector(value2->type))
+	{
+		return apply_vector(func, descr, value1, value2, 1);
+	}
+
 	jit_type_t type = common_binary(value1->type, value2->type, 0, float_only);
 
 	int oper;
@@ -843,6 +863,213 @@ apply_compare(jit_function_t func, const jit_opcode_descr *descr,
 	return apply_binary(func, oper, value1, value2, jit_type_int);
 }
 
+/*
+ * Vector opcodes for the scalar "int" opcodes, or the "float64" opcode
+ * if there is no "int" version, with sbyte, int, float32 and float64
+ * elements.  A zero entry means that there is no such vector operation.
+ */
+static unsigned short const vector_opcodes[][5] = {
+	{JIT_OP_IADD, JIT_OP_VBADD, JIT_OP_VIADD, JIT_OP_VFADD, JIT_OP_VDADD},
+	{JIT_OP_ISUB, JIT_OP_VBSUB, JIT_OP_VISUB, JIT_OP_VFSUB, JIT_OP_VDSUB},
+	{JIT_OP_IMUL, 0, JIT_OP_VIMUL, JIT_OP_VFMUL, JIT_OP_VDMUL},
+	{JIT_OP_IDIV, 0, 0, JIT_OP_VFDIV, JIT_OP_VDDIV},
+	{JIT_OP_IMIN, 0, 0, JIT_OP_VFMIN, JIT_OP_VDMIN},
+	{JIT_OP_IMAX, 0, 0, JIT_OP_VFMAX, JIT_OP_VDMAX},
+	{JIT_OP_DSQRT, 0, 0, JIT_OP_VFSQRT, JIT_OP_VDSQRT},
+	{JIT_OP_IAND, JIT_OP_VAND, JIT_OP_VAND, JIT_OP_VAND, JIT_OP_VAND},
+	{JIT_OP_IOR, JIT_OP_VOR, JIT_OP_VOR, JIT_OP_VOR, JIT_OP_VOR},
+	{JIT_OP_IXOR, JIT_OP_VXOR, JIT_OP_VXOR, JIT_OP_VXOR, JIT_OP_VXOR},
+	{JIT_OP_IEQ, JIT_OP_VBEQ, JIT_OP_VIEQ, JIT_OP_VFEQ, JIT_OP_VDEQ},
+	{JIT_OP_ILT, 0, 0, JIT_OP_VFLT, JIT_OP_VDLT},
+	{JIT_OP_ILE, 0, 0, JIT_OP_VFLE, JIT_OP_VDLE},
+	{JIT_OP_IGT, JIT_OP_VBGT, JIT_OP_VIGT, 0, 0},
+};
+
+/*
+ * Find the vector opcode for a scalar opcode.
+ */
+static int
+find_vector_opcode(int oper, jit_type_t elem)
+{
+	unsigned int index;
+	int column;
+
+	switch(elem->kind)
+	{
+	case JIT_TYPE_SBYTE:	column = 1; break;
+	case JIT_TYPE_INT:	column = 2; break;
+	case JIT_TYPE_FLOAT32:	column = 3; break;
+	case JIT_TYPE_FLOAT64:	column = 4; break;
+	default:		return 0;
+	}
+	for(index = 0; index < sizeof(vector_opcodes) / sizeof(vector_opcodes[0]); ++index)
+	{
+		if(vector_opcodes[index][0] == oper)
+		{
+			return vector_opcodes[index][column];
+		}
+	}
+	return 0;
+}
+
+/*
+ * Get the integer type that has the same size as a vector element.
+ * Bitwise operations and comparison masks use this type.
+ */
+static jit_type_t
+vector_lane_int_type(jit_type_t elem)
+{
+	switch(jit_type_get_size(elem))
+	{
+	case 1:
+		return jit_type_sbyte;
+	case 4:
+		return jit_type_int;
+	default:
+		return jit_type_long;
+	}
+}
+
+/*
+ * Perform a vector operation one element at a time, for back ends
+ * that do not support the vector opcode.
+ */
+static jit_value_t
+scalarize_vector(jit_function_t func, const jit_opcode_descr *descr, int oper,
+		 jit_value_t value1, jit_value_t value2, int is_compare)
+{
+	jit_type_t type = jit_value_get_type(value1);
+	jit_type_t elem = jit_type_get_vector_element(type);
+	jit_type_t lane_type;
+	jit_value_t result, dest_addr, addr1, addr2;
+	jit_value_t elem1, elem2, elem_result;
+	jit_nint size, offset;
+
+	if(oper == JIT_OP_VAND || oper == JIT_OP_VOR || oper == JIT_OP_VXOR)
+	{
+		lane_type = vector_lane_int_type(elem);
+	}
+	else
+	{
+		lane_type = elem;
+	}
+
+	result = jit_value_create(func, type);
+	if(!result)
+	{
+		return 0;
+	}
+	dest_addr = jit_insn_address_of(func, result);
+	addr1 = jit_insn_address_of(func, value1);
+	addr2 = value2 ? jit_insn_address_of(func, value2) : 0;
+	if(!dest_addr || !addr1 || (value2 && !addr2))
+	{
+		return 0;
+	}
+
+	size = jit_type_get_size(elem);
+	for(offset = 0; offset < JIT_VECTOR_SIZE; offset += size)
+	{
+		elem1 = jit_insn_load_relative(func, addr1, offset, lane_type);
+		if(!elem1)
+		{
+			return 0;
+		}
+		if(value2)
+		{
+			elem2 = jit_insn_load_relative(func, addr2, offset, lane_type);
+			if(!elem2)
+			{
+				return 0;
+			}
+			if(is_compare)
+			{
+				/* Turn the 0 or 1 result into an all-bits mask */
+				elem_result = apply_compare(func, descr, elem1, elem2, 0);
+				if(elem_result)
+				{
+					elem_result = jit_insn_neg(func, elem_result);
+				}
+				lane_type = vector_lane_int_type(elem);
+			}
+			else
+			{
+				elem_result = apply_arith(func, descr, elem1, elem2, 0, 0, 0);
+			}
+		}
+		else
+		{
+			elem_result = apply_unary_arith(func, descr, elem1, 0, 0, 0);
+		}
+		if(!elem_result)
+		{
+			return 0;
+		}
+		elem_result = jit_insn_convert(func, elem_result, lane_type, 0);
+		if(!elem_result
+		   || !jit_insn_store_relative(func, dest_addr, offset, elem_result))
+		{
+			return 0;
+		}
+	}
+	return result;
+}
+
+/*
+ * Apply an arithmetic, bitwise or comparison operator to vectors with
+ * the same element type.  Comparisons produce a vector of masks, with
+ * all bits of an element set if the comparison is true.
+ */
+static jit_value_t
+apply_vector(jit_function_t func, const jit_opcode_descr *descr,
+	     jit_value_t value1, jit_value_t value2, int is_compare)
+{
+	jit_type_t elem;
+	jit_value_t temp;
+	int oper;
+
+	elem = jit_type_get_vector_element(value1->type);
+	if(!elem || (value2 && jit_type_get_vector_element(value2->type) != elem))
+	{
+		return 0;
+	}
+
+	oper = find_vector_opcode(descr->ioper ? descr->ioper : descr->doper, elem);
+	if(!oper)
+	{
+		/* There is only one of "less than" and "greater than" for
+		   each element type, so swap the operands for the other */
+		if(descr->ioper == JIT_OP_IGT)
+		{
+			oper = find_vector_opcode(JIT_OP_ILT, elem);
+		}
+		else if(descr->ioper == JIT_OP_ILT)
+		{
+			oper = find_vector_opcode(JIT_OP_IGT, elem);
+		}
+		if(!oper)
+		{
+			return 0;
+		}
+		if(!_jit_opcode_is_supported(oper))
+		{
+			return scalarize_vector(func, descr, oper, value1, value2, 1);
+		}
+		temp = value1;
+		value1 = value2;
+		value2 = temp;
+	}
+	if(!_jit_opcode_is_supported(oper))
+	{
+		return scalarize_vector(func, descr, oper, value1, value2, is_compare);
+	}
+	if(value2)
+	{
+		return apply_binary(func, oper, value1, value2, value1->type);
+	}
+	return apply_unary(func, oper, value1, value1->type);
+}
+
 /*
  * Apply a unary test to a floating point value.
  */
@@ -1836,6 +2063,24 @@ _jit_insn_check_is_redundant(const jit_insn_iter_t *iter)
 	return 0;
 }
 
+jit_value_t
+_jit_insn_get_def(jit_insn_t insn)
+{
+	switch(insn->opcode)
+	{
+	case JIT_OP_INCOMING_REG:
+	case JIT_OP_INCOMING_FRAME_POSN:
+	case JIT_OP_RETURN_REG:
+		/* These load the value from a register or the frame */
+		return insn->value1;
+	}
+	if((insn->flags & (JIT_INSN_DEST_OTHER_FLAGS | JIT_INSN_DEST_IS_VALUE)) == 0)
+	{
+		return insn->dest;
+	}
+	return 0;
+}
+
 /*@
  * @deftypefun jit_value_t jit_insn_add (jit_function_t @var{func}, jit_value_t @var{value1}, jit_value_t @var{value2})
  * Add two values together and return the result in a new temporary value.
@@ -3404,6 +3649,152 @@ jit_insn_max(jit_function_t func, jit_value_t value1, jit_value_t value2)
 	return apply_arith(func, &max_descr, value1, value2, 0, 0, 0);
 }
 
+/*@
+ * @deftypefun jit_value_t jit_insn_vector_splat (jit_function_t @var{func}, jit_type_t @var{type}, jit_value_t @var{value})
+ * Create a value of the vector @var{type} with all of its elements set
+ * to @var{value}, after converting it to the element type.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_vector_splat(jit_function_t func, jit_type_t type, jit_value_t value)
+{
+	jit_type_t elem = jit_type_get_vector_element(type);
+	jit_value_t result, addr;
+	jit_nint size, offset;
+
+	if(!elem)
+	{
+		return 0;
+	}
+	value = jit_insn_convert(func, value, elem, 0);
+	if(!value)
+	{
+		return 0;
+	}
+	result = jit_value_create(func, type);
+	if(!result)
+	{
+		return 0;
+	}
+	addr = jit_insn_address_of(func, result);
+	if(!addr)
+	{
+		return 0;
+	}
+	size = jit_type_get_size(elem);
+	for(offset = 0; offset < JIT_VECTOR_SIZE; offset += size)
+	{
+		if(!jit_insn_store_relative(func, addr, offset, value))
+		{
+			return 0;
+		}
+	}
+	return result;
+}
+
+/*@
+ * @deftypefun jit_value_t jit_insn_vector_extract (jit_function_t @var{func}, jit_value_t @var{value}, unsigned int @var{index})
+ * Get the element at @var{index} of the vector @var{value}.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_vector_extract(jit_function_t func, jit_value_t value, unsigned int index)
+{
+	jit_type_t elem = jit_type_get_vector_element(value->type);
+	jit_value_t addr;
+
+	if(!elem || index >= jit_type_num_fields(value->type))
+	{
+		return 0;
+	}
+	addr = jit_insn_address_of(func, value);
+	if(!addr)
+	{
+		return 0;
+	}
+	return jit_insn_load_relative(func, addr, index * jit_type_get_size(elem), elem);
+}
+
+/*@
+ * @deftypefun jit_value_t jit_insn_vector_shuffle (jit_function_t @var{func}, jit_value_t @var{value}, const unsigned int *@var{lanes})
+ * Rearrange the elements of the vector @var{value}.  Element @var{i} of
+ * the result is element @code{@var{lanes}[@var{i}]} of @var{value}.
+ * There must be as many entries in @var{lanes} as there are elements
+ * in the vector.  Only vectors with 2 or 4 elements can be shuffled.
+ * @end deftypefun
+@*/
+jit_value_t
+jit_insn_vector_shuffle(jit_function_t func, jit_value_t value, const unsigned int *lanes)
+{
+	jit_type_t type = jit_value_get_type(value);
+	jit_type_t elem = jit_type_get_vector_element(type);
+	jit_value_t mask, result, addr, dest_addr, temp;
+	unsigned int num_lanes, lane;
+	jit_nint size, bits;
+
+	if(!elem)
+	{
+		return 0;
+	}
+	num_lanes = jit_type_num_fields(type);
+	if(num_lanes != 2 && num_lanes != 4)
+	{
+		return 0;
+	}
+
+	/* Build the selector for the 32-bit parts of the vector */
+	bits = 0;
+	for(lane = 0; lane < num_lanes; ++lane)
+	{
+		if(lanes[lane] >= num_lanes)
+		{
+			return 0;
+		}
+		if(num_lanes == 4)
+		{
+			bits |= ((jit_nint)lanes[lane]) << (lane * 2);
+		}
+		else
+		{
+			bits |= ((jit_nint)(lanes[lane] * 2)) << (lane * 4);
+			bits |= ((jit_nint)(lanes[lane] * 2 + 1)) << (lane * 4 + 2);
+		}
+	}
+
+	if(_jit_opcode_is_supported(JIT_OP_VSHUFFLE))
+	{
+		mask = jit_value_create_nint_constant(func, jit_type_int, bits);
+		if(!mask)
+		{
+			return 0;
+		}
+		return apply_binary(func, JIT_OP_VSHUFFLE, value, mask, type);
+	}
+
+	/* Move the elements one at a time */
+	result = jit_value_create(func, type);
+	if(!result)
+	{
+		return 0;
+	}
+	dest_addr = jit_insn_address_of(func, result);
+	addr = jit_insn_address_of(func, value);
+	if(!dest_addr || !addr)
+	{
+		return 0;
+	}
+	size = jit_type_get_size(elem);
+	for(lane = 0; lane < num_lanes; ++lane)
+	{
+		temp = jit_insn_load_relative(func, addr, lanes[lane] * size, elem);
+		if(!temp || !jit_insn_store_relative(func, dest_addr, lane * size, temp))
+		{
+			return 0;
+		}
+	}
+	return result;
+}
+
 jit_value_t
 jit_insn_sign(jit_function_t func, jit_value_t value)
 {
@@ -3945,6 +4336,92 @@ add_block:
 	return jit_insn_new_block(func);
 }
 
+/*
+ * Record a hint on the conditional branch to "label" that ends "block",
+ * if "jit_insn_branch_if" or "jit_insn_branch_if_not" ended the block
+ * with one.  Nothing is done if the branch was folded away or made
+ * unconditional.
+ */
+static void
+set_branch_hint(jit_function_t func, jit_block_t block, jit_label_t label, int hint)
+{
+	jit_insn_t insn;
+
+	if(block == func->builder->current_block)
+	{
+		return;
+	}
+	insn = _jit_block_get_last(block);
+	if(!insn || insn->opcode <= JIT_OP_BR || insn->opcode > JIT_OP_BR_NFGE_INV
+	   || (jit_label_t) insn->dest != label)
+	{
+		return;
+	}
+	insn->flags &= ~(JIT_INSN_BRANCH_LIKELY | JIT_INSN_BRANCH_UNLIKELY);
+	if(hint == JIT_BRANCH_LIKELY)
+	{
+		insn->flags |= JIT_INSN_BRANCH_LIKELY;
+	}
+	else if(hint == JIT_BRANCH_UNLIKELY)
+	{
+		insn->flags |= JIT_INSN_BRANCH_UNLIKELY;
+	}
+}
+
+/*@
+ * @deftypefun int jit_insn_branch_if_hint (jit_function_t @var{func}, jit_value_t @var{value}, jit_label_t *@var{label}, int @var{hint})
+ * @deftypefunx int jit_insn_branch_if_not_hint (jit_function_t @var{func}, jit_value_t @var{value}, jit_label_t *@var{label}, int @var{hint})
+ * Like @code{jit_insn_branch_if} and @code{jit_insn_branch_if_not}, with
+ * a hint on how often the branch is taken.  The @var{hint} is
+ * @code{JIT_BRANCH_LIKELY} if the branch to @var{label} is usually taken,
+ * @code{JIT_BRANCH_UNLIKELY} if it is rarely taken, or zero if nothing
+ * is known about it.
+ *
+ * The optimizer places the blocks so that the likely path falls through
+ * and the blocks that are only reached by unlikely branches come at the
+ * end of the function, out of the way of the hot code.  Front ends can
+ * use this for the error paths of null and range checks.  The hints are
+ * ignored at @code{JIT_OPTLEVEL_NONE}.
+ * @end deftypefun
+@*/
+int
+jit_insn_branch_if_hint(jit_function_t func, jit_value_t value, jit_label_t *label,
+			int hint)
+{
+	jit_block_t block;
+
+	if(!_jit_function_ensure_builder(func))
+	{
+		return 0;
+	}
+	block = func->builder->current_block;
+	if(!jit_insn_branch_if(func, value, label))
+	{
+		return 0;
+	}
+	set_branch_hint(func, block, *label, hint);
+	return 1;
+}
+
+int
+jit_insn_branch_if_not_hint(jit_function_t func, jit_value_t value, jit_label_t *label,
+			    int hint)
+{
+	jit_block_t block;
+
+	if(!_jit_function_ensure_builder(func))
+	{
+		return 0;
+	}
+	block = func->builder->current_block;
+	if(!jit_insn_branch_if_not(func, value, label))
+	{
+		return 0;
+	}
+	set_branch_hint(func, block, *label, hint);
+	return 1;
+}
+
 /*@
  * @deftypefun int jit_insn_jump_table (jit_function_t @var{func}, jit_value_t @var{value}, jit_label_t *@var{labels}, unsigned int @var{num_labels})
  * Branch to a label from the @var{labels} table. The @var{value} is the
@@ -5064,7 +5541,8 @@ setup_eh_frame_for_call(jit_function_t func, int flags)
 	jit_insn_t insn;
 
 	/* If "tail" is set, then we need to pop the "setjmp" context */
-	if((flags & JIT_CALL_TAIL) != 0 && func->has_try)
+	if((flags & JIT_CALL_TAIL) != 0 && func->has_try
+	   && !func->builder->catch_by_table)
 	{
 		type = jit_type_create_signature(jit_abi_cdecl, jit_type_void, 0, 0, 1);
 		if(!type)
@@ -5471,6 +5949,15 @@ handle_return(jit_function_t func,
  * If @var{jit_func} has already been compiled, then @code{jit_insn_call}
  * may be able to intuit some of the above flags for itself.  Otherwise
  * it is up to the caller to determine when the flags may be appropriate.
+ *
+ * If the @code{JIT_OPTION_INLINE_LIMIT} option is set and @var{func} is
+ * built at @code{JIT_OPTLEVEL_AGGRESSIVE}, then the instructions of
+ * a small @var{jit_func} may be copied into @var{func} instead of calling
+ * it.  This needs either the instructions of a @var{jit_func} that is
+ * still being built, or an on-demand compiler that builds them again.
+ * Tail calls, calls with another @var{signature} and functions that use
+ * exception handlers, @code{alloca}, jump tables or structure values
+ * are never inlined.
  * @end deftypefun
 @*/
 jit_value_t
@@ -5553,6 +6040,14 @@ jit_insn_call(jit_function_t func, const char *name, jit_function_t jit_func,
 		flags |= JIT_CALL_NORETURN;
 	}
 
+	/* Copy the instructions of small functions in place of the call */
+	if((flags & JIT_CALL_TAIL) == 0 && !is_nested
+	   && _jit_function_inline(func, jit_func, signature, new_args, num_args,
+				   &return_value))
+	{
+		return return_value;
+	}
+
 	/* Set up exception frame information for the call */
 	if(!setup_eh_frame_for_call(func, flags))
 	{
@@ -6772,7 +7267,7 @@ jit_insn_return(jit_function_t func, jit_value_t value)
 
 #if !defined(JIT_BACKEND_INTERP)
 	/* We need to pop the "setjmp" context */
-	if(func->has_try)
+	if(func->has_try && !func->builder->catch_by_table)
 	{
 		jit_type_t type = jit_type_create_signature(jit_abi_cdecl, jit_type_void, 0, 0, 1);
 		if(!type)
@@ -6919,7 +7414,7 @@ jit_insn_return_ptr(jit_function_t func, jit_value_t value, jit_type_t type)
 
 #if !defined(JIT_BACKEND_INTERP)
 	/* We need to pop the "setjmp" context */
-	if(func->has_try)
+	if(func->has_try && !func->builder->catch_by_table)
 	{
 		type = jit_type_create_signature(jit_abi_cdecl, jit_type_void, 0, 0, 1);
 		if(!type)
@@ -7138,6 +7633,10 @@ jit_insn_thrown_exception(jit_function_t func)
  * Native back ends are responsible for outputting a call to the function
  * "_jit_unwind_pop_setjmp()" just before "return" instructions if the
  * "has_try" flag is set on the function.
+ *
+ * Back ends that define "JIT_USE_EXCEPTION_TABLES" leave all of this out
+ * with JIT_OPTION_EXCEPTION_TABLES.  The catcher is then found through
+ * the exception table of the function (see "_jit_unwind_catch").
  */
 static int
 initialize_setjmp_block(jit_function_t func)
@@ -7157,6 +7656,24 @@ initialize_setjmp_block(jit_function_t func)
 	}
 	func->builder->catcher_label = jit_label_undefined;
 
+#ifdef JIT_USE_EXCEPTION_TABLES
+	/* With an exception table the unwinder enters the catcher directly
+	   and stores the location of the throw into "thrown_pc" in the frame,
+	   so there is nothing to do on entry to the function */
+	if(jit_context_get_meta_numeric(func->context, JIT_OPTION_EXCEPTION_TABLES)
+	   && _jit_unwind_is_available())
+	{
+		func->builder->thrown_pc = jit_value_create(func, jit_type_void_ptr);
+		if(!func->builder->thrown_pc)
+		{
+			return 0;
+		}
+		jit_value_set_volatile(func->builder->thrown_pc);
+		func->builder->catch_by_table = 1;
+		return 1;
+	}
+#endif
+
 	/* Force the start of a new block to mark the start of the init code */
 	if(!jit_insn_label_tight(func, &start_label))
 	{
@@ -7397,6 +7914,16 @@ jit_insn_start_catcher(jit_function_t func)
 	{
 		return 0;
 	}
+	if(func->builder->catch_by_table)
+	{
+		/* The unwinder takes the address of the catcher, so the block
+		   must be kept even if nothing branches to it */
+		if(!_jit_block_record_label_flags(func, func->builder->catcher_label,
+						  JIT_LABEL_ADDRESS_OF))
+		{
+			return 0;
+		}
+	}
 	jit_value_t value = jit_insn_thrown_exception(func);
 	if(!value)
 	{
@@ -7525,28 +8052,47 @@ jit_insn_rethrow_unhandled(jit_function_t func)
 
 #else /* !JIT_BACKEND_INTERP */
 
-	/* Call "_jit_unwind_pop_setjmp" to remove the current exception catcher */
-	jit_type_t type = jit_type_create_signature(jit_abi_cdecl, jit_type_void, 0, 0, 1);
-	if(!type)
+	jit_type_t type;
+	if(func->builder->catch_by_table)
 	{
-		return 0;
+		/* Call "_jit_unwind_rethrow" to throw the exception past the
+		   exception table of the current function */
+		type = jit_type_void_ptr;
+		type = jit_type_create_signature(jit_abi_cdecl, jit_type_void, &type, 1, 1);
+		if(!type)
+		{
+			return 0;
+		}
+		jit_insn_call_native(func, "_jit_unwind_rethrow",
+				     (void *) _jit_unwind_rethrow, type, &value, 1,
+				     JIT_CALL_NOTHROW | JIT_CALL_NORETURN);
+		jit_type_free(type);
 	}
-	jit_insn_call_native(func, "_jit_unwind_pop_setjmp",
-			     (void *) _jit_unwind_pop_setjmp, type, 0, 0,
-			     JIT_CALL_NOTHROW);
-	jit_type_free(type);
-
-	/* Call the "jit_exception_throw" function to effect the rethrow */
-	type = jit_type_void_ptr;
-	type = jit_type_create_signature(jit_abi_cdecl, jit_type_void, &type, 1, 1);
-	if(!type)
+	else
 	{
-		return 0;
+		/* Call "_jit_unwind_pop_setjmp" to remove the current exception catcher */
+		type = jit_type_create_signature(jit_abi_cdecl, jit_type_void, 0, 0, 1);
+		if(!type)
+		{
+			return 0;
+		}
+		jit_insn_call_native(func, "_jit_unwind_pop_setjmp",
+				     (void *) _jit_unwind_pop_setjmp, type, 0, 0,
+				     JIT_CALL_NOTHROW);
+		jit_type_free(type);
+
+		/* Call the "jit_exception_throw" function to effect the rethrow */
+		type = jit_type_void_ptr;
+		type = jit_type_create_signature(jit_abi_cdecl, jit_type_void, &type, 1, 1);
+		if(!type)
+		{
+			return 0;
+		}
+		jit_insn_call_native(func, "jit_exception_throw",
+				     (void *) jit_exception_throw, type, &value, 1,
+				     JIT_CALL_NOTHROW | JIT_CALL_NORETURN);
+		jit_type_free(type);
 	}
-	jit_insn_call_native(func, "jit_exception_throw",
-			     (void *) jit_exception_throw, type, &value, 1,
-			     JIT_CALL_NOTHROW | JIT_CALL_NORETURN);
-	jit_type_free(type);
 
 #endif /* !JIT_BACKEND_INTERP */
 
@@ -144,6 +144,73 @@ _JIT_ALIGN_CHECK_TYPE(jit_nfloat, nfloat);
 #define	JIT_ALIGN_NFLOAT		_JIT_ALIGN_FOR_TYPE(nfloat)
 #define	JIT_ALIGN_PTR			_JIT_ALIGN_FOR_TYPE(ptr)
 
+/*
+ * Bump allocator for the memory of a function builder.  Nothing is
+ * freed until the builder is done, and then the arena is reset and
+ * cached by the thread for the next builder.  See the option
+ * JIT_OPTION_BUILDER_ARENA.
+ */
+typedef struct _jit_arena_chunk *_jit_arena_chunk_t;
+struct _jit_arena_chunk
+{
+	_jit_arena_chunk_t	next;
+	unsigned int		size;
+};
+typedef struct _jit_arena *_jit_arena_t;
+struct _jit_arena
+{
+	_jit_arena_chunk_t	chunks;
+	char			*posn;
+	char			*limit;
+	void			*last;
+};
+
+/*
+ * Get the arena that is cached by the current thread, or a new one.
+ */
+_jit_arena_t _jit_arena_acquire(void);
+
+/*
+ * Reset an arena and cache it for the next builder of the current
+ * thread.  The arena is destroyed if the thread has one already.
+ */
+void _jit_arena_release(_jit_arena_t arena);
+
+/*
+ * Free an arena along with all of its memory.
+ */
+void _jit_arena_destroy(_jit_arena_t arena);
+
+/*
+ * Allocate, resize and free memory in an arena.  Only the most recent
+ * allocation is really freed or grown in place.
+ */
+void *_jit_arena_alloc(_jit_arena_t arena, unsigned int size);
+void *_jit_arena_calloc(_jit_arena_t arena, unsigned int num, unsigned int size);
+void *_jit_arena_realloc(_jit_arena_t arena, void *ptr, unsigned int size);
+void _jit_arena_free(_jit_arena_t arena, void *ptr);
+
+/*
+ * Allocate memory that lives as long as the builder of a function.
+ * It comes from the arena of the builder if it has one.
+ */
+#define	_jit_builder_malloc(builder,size)	\
+			((builder)->arena \
+			 ? _jit_arena_alloc((builder)->arena, (size)) \
+			 : jit_malloc((size)))
+#define	_jit_builder_calloc(builder,num,size)	\
+			((builder)->arena \
+			 ? _jit_arena_calloc((builder)->arena, (num), (size)) \
+			 : jit_calloc((num), (size)))
+#define	_jit_builder_realloc(builder,ptr,size)	\
+			((builder)->arena \
+			 ? _jit_arena_realloc((builder)->arena, (ptr), (size)) \
+			 : jit_realloc((ptr), (size)))
+#define	_jit_builder_free(builder,ptr)	\
+			((builder)->arena \
+			 ? _jit_arena_free((builder)->arena, (ptr)) \
+			 : jit_free((ptr)))
+
 /*
  * Structure of a memory pool.
  */
@@ -160,6 +227,7 @@ typedef struct
 	unsigned int		elems_in_last;
 	jit_pool_block_t	blocks;
 	void			*free_list;
+	_jit_arena_t		arena;
 
 } jit_memory_pool;
 
@@ -248,11 +316,22 @@ struct _jit_block
 	_jit_edge_t		*preds;
 	int			num_preds;
 
+	/* Position of the block in the linear block list.  This is only
+	   valid within the passes that number the blocks before use */
+	int			index;
+
+	/* Immediate dominator, valid after _jit_block_compute_dominators() */
+	jit_block_t		idom;
+
 	/* Control flow flags */
 	unsigned		visited : 1;
 	unsigned		ends_in_dead : 1;
 	unsigned		address_of : 1;
 
+	/* The instructions are in the array of "_jit_block_compact_insns"
+	   and are not freed on their own */
+	unsigned		insns_shared : 1;
+
 	/* Metadata */
 	jit_meta_t		meta;
 
@@ -269,6 +348,7 @@ struct _jit_value
 {
 	jit_block_t		block;
 	jit_type_t		type;
+	jit_nint		address;
 	unsigned		is_temporary : 1;
 	unsigned		is_local : 1;
 	unsigned		is_volatile : 1;
@@ -289,9 +369,8 @@ struct _jit_value
 	unsigned		has_global_register : 1;
 	short			reg;
 	short			global_reg;
-	jit_nint		address;
-	jit_nint		frame_offset;
-	jit_nuint		usage_count;
+	jit_int			frame_offset;
+	jit_uint		usage_count;
 	int			index;
 };
 #define	JIT_INVALID_FRAME_OFFSET	((jit_nint)0x7FFFFFFF)
@@ -340,6 +419,8 @@ struct _jit_insn
 #define	JIT_INSN_VALUE2_IS_SIGNATURE	0x0800
 #define	JIT_INSN_VALUE2_OTHER_FLAGS	0x0800
 #define	JIT_INSN_DEST_IS_VALUE		0x1000
+#define	JIT_INSN_BRANCH_LIKELY		0x2000
+#define	JIT_INSN_BRANCH_UNLIKELY	0x4000
 
 /*
  * Information about each label associated with a function.
@@ -390,6 +471,11 @@ struct _jit_builder
 	jit_block_t		*block_order;
 	int			num_block_order;
 
+	/* The array that holds the instructions of all blocks one after
+	   another once "_jit_block_compact_insns" is done */
+	jit_insn_t		insns;
+	int			num_insns;
+
 	/* The next block label to be allocated */
 	jit_label_t		next_label;
 
@@ -419,6 +505,13 @@ struct _jit_builder
 	/* Generate position-independent code */
 	unsigned		position_independent : 1;
 
+	/* The catcher is found through the exception table of the function
+	   rather than a "setjmp" (see JIT_OPTION_EXCEPTION_TABLES) */
+	unsigned		catch_by_table : 1;
+
+	/* Arena that all the memory of the builder comes from, if any */
+	_jit_arena_t		arena;
+
 	/* Memory pools that contain values, instructions, and metadata blocks */
 	jit_memory_pool		value_pool;
 	jit_memory_pool		edge_pool;
@@ -483,6 +576,17 @@ struct _jit_function
 	/* Debug information for this function */
 	jit_varint_data_t	bytecode_offset;
 
+	/* Exception table of the compiled code (see _jit_catch_table) */
+	struct _jit_catch_table	*catch_table;
+
+	/* Unwind information that is registered with the system unwinder
+	   for each version of the compiled code (see _jit_unwind_info) */
+	struct _jit_unwind_info	*unwind_info;
+
+	/* Places in the compiled code that refer to other addresses, if the
+	   context has JIT_OPTION_PRE_COMPILE (see _jit_reloc_table) */
+	struct _jit_reloc_table	*reloc_table;
+
 	/* Cookie value for this function */
 	void			*cookie;
 
@@ -492,17 +596,39 @@ struct _jit_function
 	unsigned		no_throw : 1;
 	unsigned		no_return : 1;
 	unsigned		has_try : 1;
+	unsigned		is_complete : 1;
 	unsigned		optimization_level : 8;
 
+	/* Non-zero in a temporary copy of a function that is rebuilt by its
+	   on-demand compiler for inlining.  Gives the depth of the inlining */
+	unsigned		inline_depth : 8;
+
 	/* Flag set once the function is compiled */
 	int volatile		is_compiled;
 
+	/* Flag set while a thread compiles the function on-demand
+	   with JIT_OPTION_CONCURRENT_COMPILE */
+	int volatile		is_compiling;
+
+	/* Tiered compilation state and the invocation counter that is
+	   updated by the baseline code (see JIT_OPTION_TIERED_COMPILE) */
+	int volatile		tier;
+	jit_uint volatile	tier_count;
+
+	/* Counts of the runs and the fall throughs of each conditional
+	   branch of the baseline code, with JIT_OPTION_BRANCH_PROFILE */
+	jit_uint		*branch_counts;
+	unsigned int		num_branches;
+
 	/* The entry point for the function's compiled code */
 	void * volatile		entry_point;
 
 	/* The function to call to perform on-demand compilation */
 	jit_on_demand_func	on_demand;
 
+	/* Statistics of the last compilation with JIT_OPTION_COMPILE_STATS */
+	jit_compile_stats_t	*compile_stats;
+
 #ifndef JIT_BACKEND_INTERP
 # ifdef jit_redirector_size
 	/* Buffer that contains the redirector for this function.
@@ -538,11 +664,101 @@ void _jit_function_destroy(jit_function_t func);
  */
 void _jit_function_compute_liveness(jit_function_t func);
 
+/*
+ * Propagate constants and copies and eliminate dead code in the
+ * static single assignment form.  Returns non-zero if the code changed.
+ */
+int _jit_function_optimize_ssa(jit_function_t func);
+
+/*
+ * Hoist loop invariant code, reduce the strength of induction variable
+ * multiplications and remove redundant null checks in loops.
+ */
+void _jit_function_optimize_loops(jit_function_t func);
+
+/*
+ * Order the blocks of a function so that the likely successor of each
+ * block follows it, and move the blocks that are rarely run to the end.
+ */
+void _jit_function_layout_blocks(jit_function_t func);
+
+/*
+ * Copy the instructions of "callee" into "func" in place of a call with
+ * the converted arguments "args".  Returns zero if the call should be
+ * made normally.  Otherwise "return_value" is set to the value holding
+ * the result, or to NULL if out of memory.
+ */
+int _jit_function_inline(jit_function_t func, jit_function_t callee,
+			 jit_type_t signature, jit_value_t *args,
+			 unsigned int num_args, jit_value_t *return_value);
+
 /*
  * Compile a function on-demand.  Returns the entry point.
  */
 void *_jit_function_compile_on_demand(jit_function_t func);
 
+/*
+ * Rebuild and compile an already compiled function with its on-demand
+ * compiler and switch the entry point to the new code.
+ */
+int _jit_function_recompile(jit_function_t func);
+
+/*
+ * Tiered compilation states of a function.
+ */
+#define	_JIT_TIER_NONE		0	/* Not tiered */
+#define	_JIT_TIER_BASELINE	1	/* Running baseline code */
+#define	_JIT_TIER_PROMOTING	2	/* Queued for optimized recompilation */
+#define	_JIT_TIER_OPTIMIZED	3	/* Running optimized code */
+#define	_JIT_TIER_DESTROYED	4	/* Destroyed while queued for recompilation */
+
+/*
+ * Prepare a function for baseline compilation if tiered compilation
+ * is enabled.  Returns non-zero if the function will be tiered.
+ */
+int _jit_tier_begin(jit_function_t func);
+
+/*
+ * Add invocation counter updates to the loop back edges of a function
+ * that is about to be compiled as baseline code.
+ */
+void _jit_tier_count_back_edges(jit_function_t func);
+
+/*
+ * Add counters for the conditional branches of a function that is about
+ * to be compiled as baseline code, if JIT_OPTION_BRANCH_PROFILE is set.
+ */
+void _jit_tier_count_branches(jit_function_t func);
+
+/*
+ * Turn the branch counts of the baseline code into hints on the branches
+ * of the function that is about to be compiled as optimized code.
+ */
+void _jit_tier_use_branch_profile(jit_function_t func);
+
+/*
+ * Finish baseline compilation of a function.
+ */
+void _jit_tier_end(jit_function_t func, unsigned int level, int result);
+
+/*
+ * Called by baseline code when the invocation counter of a function
+ * reaches the tiering threshold.
+ */
+void _jit_function_request_tier_up(jit_function_t func);
+
+/*
+ * Take a function that is about to be destroyed out of tiered compilation.
+ * Returns zero if the background thread is busy with the function and is
+ * going to destroy it later.
+ */
+int _jit_tier_forget(jit_function_t func);
+
+/*
+ * Stop the background compilation thread of a context.
+ */
+void _jit_tier_shutdown(jit_context_t context);
+
 /*
  * Get the bytecode offset that is associated with a native
  * offset within a method.  Returns JIT_CACHE_NO_OFFSET
@@ -569,11 +785,22 @@ struct _jit_context
 	/* The context's memory control */
 	jit_memory_manager_t	memory_manager;
 	jit_memory_context_t	memory_context;
+	jit_memory_stats_func	memory_stats;
 	jit_mutex_t		memory_lock;
 
 	/* Lock that controls access to the building process */
 	jit_mutex_t		builder_lock;
 
+	/* Monitor for threads waiting on concurrent on-demand compilation */
+	jit_monitor_t		compile_monitor;
+
+	/* Background compilation thread for tiered compilation */
+	jit_monitor_t		tier_monitor;
+	jit_thread_id_t		tier_thread;
+	int			tier_started;
+	int			tier_pending;
+	int			tier_shutdown;
+
 	/* List of functions that are currently registered with the context */
 	jit_function_t		functions;
 	jit_function_t		last_function;
@@ -594,6 +821,21 @@ struct _jit_context
 
 	/* On-demand compilation driver */
 	jit_on_demand_driver_func	on_demand_driver;
+
+	/* Totals of the compile statistics, protected by "memory_lock"
+	   (see JIT_OPTION_COMPILE_STATS) */
+	jit_compile_stats_t	compile_stats;
+
+	/* Bytes of code and number of instructions of the functions that
+	   were compiled, for estimating the code size of the next function,
+	   protected by "memory_lock" */
+	jit_ulong		code_bytes;
+	jit_ulong		code_insns;
+
+	/* Link in the list of contexts that have functions with exception
+	   tables, protected by "_jit_global_lock" */
+	jit_context_t		unwind_next;
+	int			unwind_listed;
 };
 
 void *_jit_malloc_exec(unsigned int size);
@@ -625,6 +867,11 @@ void *_jit_memory_alloc_closure(jit_context_t context);
 void _jit_memory_free_closure(jit_context_t context, void *ptr);
 void *_jit_memory_alloc_data(jit_context_t context, jit_size_t size, jit_size_t align);
 
+/*
+ * Get the statistics of the default memory manager.
+ */
+void _jit_default_memory_stats(jit_memory_context_t memctx, jit_memory_stats_t *stats);
+
 /*
  * Backtrace control structure, for managing stack traces.
  * These structures must be allocated on the stack.
@@ -654,6 +901,95 @@ void _jit_backtrace_pop(void);
  */
 void _jit_backtrace_set(jit_backtrace_t trace);
 
+/*
+ * Exception table of a function that is compiled with
+ * JIT_OPTION_EXCEPTION_TABLES.  It is stored with the data of the
+ * function in the code cache.  When an exception is thrown out of a call
+ * between "start" and "end", the frame of the function is resumed at
+ * "catcher" with the stack pointer "stack_size" bytes below the frame
+ * pointer and the callee-saved registers that the function had at the
+ * throw, after the location of the throw is stored at "thrown_pc_offset"
+ * in the frame.
+ */
+typedef struct _jit_catch_table *_jit_catch_table_t;
+struct _jit_catch_table
+{
+	unsigned char		*start;
+	unsigned char		*end;
+	void			*catcher;
+	jit_int			stack_size;
+	jit_int			thrown_pc_offset;
+};
+
+/*
+ * Places in the code of a function in a JIT_OPTION_PRE_COMPILE context
+ * that refer to addresses outside of the code.  Native back ends record
+ * them so that the ELF writer can relocate the code.  A call to another
+ * function also records the function as "callee", because the address
+ * that is called changes when the callee is compiled.  The constants of
+ * the code are allocated between "data_start" and "data_end".
+ */
+#define	JIT_RELOC_REL32		1	/* 32-bit offset from the program counter */
+#define	JIT_RELOC_ABS		2	/* Pointer-sized absolute address */
+typedef struct _jit_reloc _jit_reloc_t;
+struct _jit_reloc
+{
+	unsigned char		*field;
+	int			type;
+	void			*target;
+	jit_function_t		callee;
+};
+typedef struct _jit_reloc_table *_jit_reloc_table_t;
+struct _jit_reloc_table
+{
+	unsigned char		*data_start;
+	unsigned char		*data_end;
+	unsigned int		num_relocs;
+	unsigned int		max_relocs;
+	_jit_reloc_t		relocs[1];
+};
+
+/*
+ * Add a context to the list that the unwinder searches for exception
+ * tables, or remove it from the list.
+ */
+void _jit_unwind_add_context(jit_context_t context);
+void _jit_unwind_remove_context(jit_context_t context);
+
+/*
+ * Walk up the stack from the caller with the system unwinder and resume
+ * the first function that has an exception table, unless a "setjmp"
+ * catcher is closer.  The first "skip" functions with exception tables
+ * are passed over.  Returns if there is no such function.
+ */
+void _jit_unwind_catch(int skip);
+
+/*
+ * Unwind information in the ".eh_frame" format that describes the
+ * frame of one version of the code of a function with JIT_OPTION_UNWIND_INFO.
+ * The "eh_frame" data holds a CIE, an FDE and the terminating zero word.
+ */
+typedef struct _jit_unwind_info *_jit_unwind_info_t;
+struct _jit_unwind_info
+{
+	_jit_unwind_info_t	next;
+	jit_ulong		eh_frame[1];
+};
+
+/*
+ * Register unwind information for the latest code of a function with
+ * the system unwinder, or deregister all the information of a function
+ * when it is destroyed.
+ */
+void _jit_unwind_register(jit_function_t func, _jit_unwind_info_t info);
+void _jit_unwind_deregister(jit_function_t func);
+
+/*
+ * Determine if unwind information can be registered with the system
+ * unwinder.  The exception tables depend on it.
+ */
+int _jit_unwind_is_available(void);
+
 /*
  * Control information that is associated with a thread.
  */
@@ -663,6 +999,16 @@ struct jit_thread_control
 	jit_exception_func	exception_handler;
 	jit_backtrace_t		backtrace_head;
 	struct jit_jmp_buf	*setjmp_head;
+	_jit_arena_t		builder_arena;
+
+	/* Hazard pointers to the lookup table of the code cache that the
+	   thread searches and the node that it found last, which are not
+	   freed while they are set (see _jit_thread_is_hazard) */
+	void * volatile		hazard_table;
+	void * volatile		hazard_node;
+
+	/* Next control object in the list of all the threads */
+	jit_thread_control_t	next;
 };
 
 /*
@@ -691,6 +1037,47 @@ void _jit_block_clean_cfg(jit_function_t func);
  */
 int _jit_block_compute_postorder(jit_function_t func);
 
+/*
+ * Compute the immediate dominators of the reachable blocks.  The blocks
+ * are numbered in postorder, unreachable blocks get the number -1.
+ */
+int _jit_block_compute_dominators(jit_function_t func);
+
+/*
+ * Determine if the block "dom" dominates the block "block".  This
+ * requires the dominators to be computed.
+ */
+int _jit_block_dominates(jit_block_t dom, jit_block_t block);
+
+/*
+ * Replace the conditional branch at the end of a block with an
+ * unconditional branch if it is always taken or remove it if it
+ * is never taken, and drop the edge that is no longer used.
+ */
+void _jit_block_resolve_branch(jit_function_t func, jit_block_t block, int taken);
+
+/*
+ * Insert a new empty block between a block and the previous block that
+ * falls through to it.  Returns the new block, or NULL if the block is
+ * not entered by falling through.
+ */
+jit_block_t _jit_block_split_fallthru(jit_function_t func, jit_block_t block);
+
+/*
+ * Make a block that falls through to the next block branch there from
+ * a new block that is inserted right after it instead.  Returns the new
+ * block, or NULL if the block does not fall through.
+ */
+jit_block_t _jit_block_add_jump(jit_function_t func, jit_block_t block);
+
+/*
+ * Invert the condition of the branch at the end of a block, so that it
+ * branches to the block it used to fall through to and the other way
+ * around.  Returns zero if the block does not end with a conditional
+ * branch.
+ */
+int _jit_block_invert_branch(jit_function_t func, jit_block_t block);
+
 /*
  * Create a new block and associate it with a function.
  */
@@ -731,17 +1118,36 @@ int _jit_block_record_label_flags(jit_function_t func, jit_label_t label, int fl
  */
 jit_insn_t _jit_block_add_insn(jit_block_t block);
 
+/*
+ * Move the instructions of all blocks into a single array in block
+ * order, without room to spare.  The blocks are still free to grow
+ * afterwards, in which case they get an array of their own again.
+ */
+void _jit_block_compact_insns(jit_function_t func);
+
 /*
  * Get the last instruction in a block.  NULL if the block is empty.
  */
 jit_insn_t _jit_block_get_last(jit_block_t block);
 
+/*
+ * Insert a new instruction at the specified position in a block.
+ * The instructions from that position on are moved up by one.
+ */
+jit_insn_t _jit_block_insert_insn(jit_block_t block, int posn);
+
 /*
  * The block goes just before the function end possibly excluding
  * some empty blocks.
  */
 int _jit_block_is_final(jit_block_t block);
 
+/*
+ * The block is only reached by falling through from the previous block.
+ * This requires the control flow graph, otherwise it returns zero.
+ */
+int _jit_block_is_fallthrough_only(jit_block_t block);
+
 /*
  * Free one element in a metadata list.
  */
@@ -754,6 +1160,11 @@ void _jit_meta_free_one(void *meta);
  */
 int _jit_insn_check_is_redundant(const jit_insn_iter_t *iter);
 
+/*
+ * Get the value that an instruction assigns, or NULL if there is none.
+ */
+jit_value_t _jit_insn_get_def(jit_insn_t insn);
+
 /*
  * Get the correct opcode to use for a "load" instruction,
  * starting at a particular opcode base.  We assume that the
@@ -796,6 +1207,9 @@ struct _jit_type
 	jit_nuint		alignment;
 	jit_type_t		sub_type;
 	unsigned int		num_components;
+	/* Specialized stubs for signatures, see "jit-apply.c" */
+	void			*apply_stub;
+	void			*closure_stub;
 	struct jit_component	components[1];
 };
 struct jit_tagged_type
@@ -825,6 +1239,26 @@ extern struct _jit_type const _jit_type_float64_def;
 extern struct _jit_type const _jit_type_nfloat_def;
 extern struct _jit_type const _jit_type_void_ptr_def;
 
+/*
+ * Function metadata that is reserved for internal use.
+ */
+#define	JIT_META_FUNCTION_NAME		10000
+
+/*
+ * Describe the code of a newly compiled function to Linux perf if
+ * JIT_OPTION_PERF is set.  "offset_base" is the address that the
+ * native offsets of the bytecode offset data are relative to.
+ */
+void _jit_perf_record(jit_function_t func, unsigned char *code_start,
+		      unsigned char *code_end, unsigned char *offset_base);
+
+/*
+ * Get the cached apply or closure stub of a signature, and free
+ * the stubs when the signature is freed.
+ */
+void *_jit_apply_get_stub(jit_type_t signature, int closure);
+void _jit_apply_free_stubs(jit_type_t signature);
+
 /*
  * Intrinsic signatures.
  *
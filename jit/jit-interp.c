@@ -43,13 +43,19 @@ straight vanilla ANSI C.
 	#endif
 #endif
 #include "jit-setjmp.h"
+#if defined(JIT_INTERP_PROFILE)
+	#include <stdio.h>
+#endif
 
 #if defined(JIT_BACKEND_INTERP)
 
 /*
- * Determine what kind of interpreter dispatch to use.
+ * Determine what kind of interpreter dispatch to use.  Profiling
+ * needs every dispatch to go through the top of the switch loop.
  */
-#ifdef HAVE_COMPUTED_GOTO
+#if defined(JIT_INTERP_PROFILE)
+	#define	JIT_INTERP_SWITCH			1
+#elif defined(HAVE_COMPUTED_GOTO)
 	#if defined(PIC) && defined(HAVE_PIC_COMPUTED_GOTO)
 		#define	JIT_INTERP_TOKEN_PIC	1
 	#elif defined(PIC)
@@ -184,6 +190,33 @@ straight vanilla ANSI C.
 #define	VM_STORE_ELEM(type,value)	\
 			(*(((type *)VM_R0_PTR) + VM_R1_NINT) = (type)(value))
 
+/*
+ * Apply an operation to each element of the vectors that R1 and R2
+ * point to, and store the results into the vector that R0 points to.
+ * The operation refers to the elements as "x" and "y".
+ */
+#define	VM_VECTOR_BINARY(type,rtype,expr)	\
+			do { \
+				int vindex; \
+				for(vindex = 0; vindex < (int)(JIT_VECTOR_SIZE / sizeof(type)); \
+				    ++vindex) \
+				{ \
+					type x = ((type *)VM_R1_PTR)[vindex]; \
+					type y = ((type *)VM_R2_PTR)[vindex]; \
+					((rtype *)VM_R0_PTR)[vindex] = (rtype)(expr); \
+				} \
+			} while (0)
+#define	VM_VECTOR_UNARY(type,expr)	\
+			do { \
+				int vindex; \
+				for(vindex = 0; vindex < (int)(JIT_VECTOR_SIZE / sizeof(type)); \
+				    ++vindex) \
+				{ \
+					type x = ((type *)VM_R1_PTR)[vindex]; \
+					((type *)VM_R0_PTR)[vindex] = (type)(expr); \
+				} \
+			} while (0)
+
 /*
  * Get the address of an argument or local variable at a particular offset.
  */
@@ -192,6 +225,18 @@ straight vanilla ANSI C.
 #define	VM_LOC(type)		\
 			((type *)(((jit_item *)frame) + VM_NINT_ARG))
 
+/*
+ * Get the address of the frame slot in argument "n" of a three-address
+ * opcode, or the immediate value in that argument.  A slot holds a byte
+ * offset shifted left by one, and its low bit selects the arguments
+ * instead of the local variables.
+ */
+#define	VM_SLOT(n)	\
+			((void *)(slot_base[((jit_nint *)(pc))[(n)] & 1] + \
+					  (((jit_nint *)(pc))[(n)] >> 1)))
+#define	VM_IMM(type,n)	\
+			((type)(((jit_nint *)(pc))[(n)]))
+
 /*
  * Handle the return value from a function that reports a builtin exception.
  */
@@ -224,6 +269,110 @@ straight vanilla ANSI C.
 				goto restart_tail; \
 			}
 
+#if defined(JIT_INTERP_PROFILE)
+
+/*
+ * Number of times that each pair of opcodes was executed in sequence.
+ * The counts are not protected by a lock, so they are only approximate
+ * when several threads run interpreted code at the same time.
+ */
+static jit_ulong pair_counts[JIT_INTERP_OP_END_MARKER][JIT_INTERP_OP_END_MARKER];
+#define	NUM_PAIRS	(JIT_INTERP_OP_END_MARKER * JIT_INTERP_OP_END_MARKER)
+
+/*
+ * Count the opcode at "pc" as following the previous one.
+ */
+#define	VMPROFILE(pc)	\
+			do { \
+				int __opcode = VMFETCH((pc)); \
+				if(profile_prev >= 0) \
+				{ \
+					++(pair_counts[profile_prev][__opcode]); \
+				} \
+				profile_prev = __opcode; \
+			} while (0)
+
+/*
+ * Get the name of an opcode.
+ */
+static const char *opcode_name(int opcode)
+{
+	if(opcode < JIT_OP_NUM_OPCODES)
+	{
+		return jit_opcodes[opcode].name;
+	}
+	return _jit_interp_opcodes[opcode - JIT_OP_NUM_OPCODES].name;
+}
+
+/*
+ * Compare two pair counts, for sorting them in descending order.
+ */
+static int compare_pairs(const void *e1, const void *e2)
+{
+	jit_ulong count1 = *(*((const jit_ulong **)e1));
+	jit_ulong count2 = *(*((const jit_ulong **)e2));
+	if(count1 > count2)
+	{
+		return -1;
+	}
+	else if(count1 < count2)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+void _jit_interp_write_profile(void)
+{
+	const char *filename;
+	FILE *stream;
+	jit_ulong **pairs;
+	jit_ulong *count;
+	int num_pairs;
+	int index;
+
+	/* Collect the pairs that were executed at least once */
+	pairs = (jit_ulong **)jit_malloc(sizeof(jit_ulong *) * NUM_PAIRS);
+	if(!pairs)
+	{
+		return;
+	}
+	num_pairs = 0;
+	for(index = 0; index < NUM_PAIRS; ++index)
+	{
+		count = &(pair_counts[0][0]) + index;
+		if(*count != 0)
+		{
+			pairs[num_pairs++] = count;
+		}
+	}
+	qsort(pairs, num_pairs, sizeof(jit_ulong *), compare_pairs);
+
+	/* Write them to the file named by "JIT_INTERP_PROFILE", or stderr */
+	filename = getenv("JIT_INTERP_PROFILE");
+	stream = (filename ? fopen(filename, "w") : stderr);
+	if(stream)
+	{
+		fprintf(stream, "# count first second\n");
+		for(index = 0; index < num_pairs; ++index)
+		{
+			count = pairs[index];
+			fprintf(stream, "%llu %s %s\n", (unsigned long long)(*count),
+				opcode_name((int)((count - &(pair_counts[0][0]))
+						  / JIT_INTERP_OP_END_MARKER)),
+				opcode_name((int)((count - &(pair_counts[0][0]))
+						  % JIT_INTERP_OP_END_MARKER)));
+		}
+		if(stream != stderr)
+		{
+			fclose(stream);
+		}
+	}
+	jit_free(pairs);
+}
+
+#endif /* JIT_INTERP_PROFILE */
+
 /*
  * Call "jit_apply" from the interpreter, to invoke a native function.
  */
@@ -304,6 +453,8 @@ void _jit_run_function(jit_function_interp_t func, jit_item *args,
 	jit_item *frame;
 	jit_item *stacktop;
 	jit_item r0, r1, r2;
+	unsigned char *slot_base[2];
+	void *slot_dest;
 	void **pc;
 	jit_int builtin_exception;
 	jit_nint temparg;
@@ -318,6 +469,9 @@ void _jit_run_function(jit_function_interp_t func, jit_item *args,
 	void *handler;
 	jit_jmp_buf *jbuf;
 	jit_nint current_frame_size;
+#if defined(JIT_INTERP_PROFILE)
+	int profile_prev = -1;
+#endif
 
 	/* Define the label table for computed goto dispatch */
 	#include "jit-interp-labels.h"
@@ -331,6 +485,8 @@ void _jit_run_function(jit_function_interp_t func, jit_item *args,
 	/* Get the initial program counter */
 restart_tail:
 	pc = jit_function_interp_entry_pc(func);
+	slot_base[0] = (unsigned char *)frame;
+	slot_base[1] = (unsigned char *)args;
 
 	/* Create a "setjmp" point if this function has a "try" block.
 	   This is used to catch exceptions on their way up the stack */
@@ -4083,6 +4239,281 @@ restart_tail:
 		}
 		VMBREAK;
 
+		/******************************************************************
+		 * Vector operations.
+		 ******************************************************************/
+
+		VMCASE(JIT_OP_VBADD):
+		{
+			/* Add two vectors of bytes */
+			VM_VECTOR_BINARY(jit_sbyte, jit_sbyte, (jit_ubyte)x + (jit_ubyte)y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VBSUB):
+		{
+			/* Subtract two vectors of bytes */
+			VM_VECTOR_BINARY(jit_sbyte, jit_sbyte, (jit_ubyte)x - (jit_ubyte)y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VBEQ):
+		{
+			/* Compare two vectors of bytes for equality */
+			VM_VECTOR_BINARY(jit_sbyte, jit_sbyte, (x == y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VBGT):
+		{
+			/* Compare two vectors of bytes for greater than */
+			VM_VECTOR_BINARY(jit_sbyte, jit_sbyte, (x > y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VIADD):
+		{
+			/* Add two vectors of integers */
+			VM_VECTOR_BINARY(jit_int, jit_int, (jit_uint)x + (jit_uint)y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VISUB):
+		{
+			/* Subtract two vectors of integers */
+			VM_VECTOR_BINARY(jit_int, jit_int, (jit_uint)x - (jit_uint)y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VIMUL):
+		{
+			/* Multiply two vectors of integers */
+			VM_VECTOR_BINARY(jit_int, jit_int, (jit_uint)x * (jit_uint)y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VIEQ):
+		{
+			/* Compare two vectors of integers for equality */
+			VM_VECTOR_BINARY(jit_int, jit_int, (x == y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VIGT):
+		{
+			/* Compare two vectors of integers for greater than */
+			VM_VECTOR_BINARY(jit_int, jit_int, (x > y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFADD):
+		{
+			/* Add two vectors of 32-bit floats */
+			VM_VECTOR_BINARY(jit_float32, jit_float32, x + y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFSUB):
+		{
+			/* Subtract two vectors of 32-bit floats */
+			VM_VECTOR_BINARY(jit_float32, jit_float32, x - y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFMUL):
+		{
+			/* Multiply two vectors of 32-bit floats */
+			VM_VECTOR_BINARY(jit_float32, jit_float32, x * y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFDIV):
+		{
+			/* Divide two vectors of 32-bit floats */
+			VM_VECTOR_BINARY(jit_float32, jit_float32, x / y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFMIN):
+		{
+			/* Get the minimum of two vectors of 32-bit floats */
+			VM_VECTOR_BINARY(jit_float32, jit_float32, (x < y) ? x : y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFMAX):
+		{
+			/* Get the maximum of two vectors of 32-bit floats */
+			VM_VECTOR_BINARY(jit_float32, jit_float32, (x > y) ? x : y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFSQRT):
+		{
+			/* Get the square roots of a vector of 32-bit floats */
+			VM_VECTOR_UNARY(jit_float32, jit_float32_sqrt(x));
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFEQ):
+		{
+			/* Compare two vectors of 32-bit floats for equality */
+			VM_VECTOR_BINARY(jit_float32, jit_int, (x == y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFLT):
+		{
+			/* Compare two vectors of 32-bit floats for less than */
+			VM_VECTOR_BINARY(jit_float32, jit_int, (x < y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VFLE):
+		{
+			/* Compare two vectors of 32-bit floats for less than or equal */
+			VM_VECTOR_BINARY(jit_float32, jit_int, (x <= y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDADD):
+		{
+			/* Add two vectors of 64-bit floats */
+			VM_VECTOR_BINARY(jit_float64, jit_float64, x + y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDSUB):
+		{
+			/* Subtract two vectors of 64-bit floats */
+			VM_VECTOR_BINARY(jit_float64, jit_float64, x - y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDMUL):
+		{
+			/* Multiply two vectors of 64-bit floats */
+			VM_VECTOR_BINARY(jit_float64, jit_float64, x * y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDDIV):
+		{
+			/* Divide two vectors of 64-bit floats */
+			VM_VECTOR_BINARY(jit_float64, jit_float64, x / y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDMIN):
+		{
+			/* Get the minimum of two vectors of 64-bit floats */
+			VM_VECTOR_BINARY(jit_float64, jit_float64, (x < y) ? x : y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDMAX):
+		{
+			/* Get the maximum of two vectors of 64-bit floats */
+			VM_VECTOR_BINARY(jit_float64, jit_float64, (x > y) ? x : y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDSQRT):
+		{
+			/* Get the square roots of a vector of 64-bit floats */
+			VM_VECTOR_UNARY(jit_float64, jit_float64_sqrt(x));
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDEQ):
+		{
+			/* Compare two vectors of 64-bit floats for equality */
+			VM_VECTOR_BINARY(jit_float64, jit_long, (x == y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDLT):
+		{
+			/* Compare two vectors of 64-bit floats for less than */
+			VM_VECTOR_BINARY(jit_float64, jit_long, (x < y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VDLE):
+		{
+			/* Compare two vectors of 64-bit floats for less than or equal */
+			VM_VECTOR_BINARY(jit_float64, jit_long, (x <= y) ? -1 : 0);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VAND):
+		{
+			/* Bitwise AND of two vectors */
+			VM_VECTOR_BINARY(jit_ulong, jit_ulong, x & y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VOR):
+		{
+			/* Bitwise OR of two vectors */
+			VM_VECTOR_BINARY(jit_ulong, jit_ulong, x | y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VXOR):
+		{
+			/* Bitwise XOR of two vectors */
+			VM_VECTOR_BINARY(jit_ulong, jit_ulong, x ^ y);
+			VM_MODIFY_PC(1);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_OP_VSHUFFLE):
+		{
+			/* Rearrange the 32-bit parts of a vector */
+			jit_uint vtemp[JIT_VECTOR_SIZE / sizeof(jit_uint)];
+			int vindex;
+			jit_memcpy(vtemp, VM_R1_PTR, JIT_VECTOR_SIZE);
+			for(vindex = 0; vindex < 4; ++vindex)
+			{
+				((jit_uint *)VM_R0_PTR)[vindex] =
+					vtemp[(VM_NINT_ARG >> (vindex * 2)) & 3];
+			}
+			VM_MODIFY_PC(2);
+		}
+		VMBREAK;
+
 		/******************************************************************
 		 * Allocate memory from the stack.
 		 ******************************************************************/
@@ -4961,6 +5392,44 @@ restart_tail:
 		}
 		VMBREAK;
 
+		/******************************************************************
+		 * Superinstructions, which execute the bodies of two of the
+		 * opcodes above in sequence.  Generated by "gen-ops -S".
+		 ******************************************************************/
+
+		#include "jit-interp-super.h"
+
+		/******************************************************************
+		 * Three-address opcodes, which take their operands from frame
+		 * slots.  Generated by "gen-ops -L", apart from the copies.
+		 ******************************************************************/
+
+		#include "jit-interp-slots.h"
+
+		VMCASE(JIT_INTERP_OP_COPY_SLOTS):
+		{
+			/* Copy a value from one frame slot to another */
+			*((jit_item *)VM_SLOT(1)) = *((jit_item *)VM_SLOT(2));
+			VM_MODIFY_PC(3);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_INTERP_OP_COPY_SLOTS_IMM_INT):
+		{
+			/* Copy an immediate 32-bit integer to a frame slot */
+			*((jit_int *)VM_SLOT(1)) = VM_IMM(jit_int, 2);
+			VM_MODIFY_PC(3);
+		}
+		VMBREAK;
+
+		VMCASE(JIT_INTERP_OP_COPY_SLOTS_IMM_LONG):
+		{
+			/* Copy an immediate 64-bit integer to a frame slot */
+			*((jit_long *)VM_SLOT(1)) = VM_IMM(jit_long, 2);
+			VM_MODIFY_PC(3);
+		}
+		VMBREAK;
+
 		/******************************************************************
 		 * Opcodes that aren't used by the interpreter.  These are replaced
 		 * by more specific instructions during function compilation.
@@ -4982,7 +5451,6 @@ restart_tail:
 		VMCASE(JIT_OP_INCOMING_REG):
 		VMCASE(JIT_OP_INCOMING_FRAME_POSN):
 		VMCASE(JIT_OP_OUTGOING_REG):
-		VMCASE(JIT_OP_OUTGOING_FRAME_POSN):
 		VMCASE(JIT_OP_RETURN_REG):
 		VMCASE(JIT_OP_SET_PARAM_INT):
 		VMCASE(JIT_OP_SET_PARAM_LONG):
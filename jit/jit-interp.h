@@ -90,6 +90,16 @@ struct jit_function_interp
 #define	jit_function_interp_entry_pc(info)	\
 			((void **)(((unsigned char *)(info)) + jit_function_interp_size))
 
+#if defined(JIT_INTERP_PROFILE)
+
+/*
+ * Write the counts of the opcode pairs that the interpreter has
+ * executed.  This is registered with "atexit" on initialization.
+ */
+void _jit_interp_write_profile(void);
+
+#endif
+
 #ifdef	__cplusplus
 };
 #endif
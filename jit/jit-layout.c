@@ -0,0 +1,595 @@
+/*
+ * jit-layout.c - Placement of the basic blocks in the generated code.
+ *
+ * Copyright (C) 2026  Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+#include "jit-rules.h"
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+/*
+ * The code of the blocks is generated in the order of the block list,
+ * which is the order in which the front end built them.  This pass
+ * changes the order when there is something to go by: the "likely" and
+ * "unlikely" hints of the conditional branches, that come either from
+ * the front end or from the branch profile of the baseline code, and
+ * the blocks that end with a "throw" or a call that does not return.
+ *
+ * The blocks that are only reached through unlikely branches or only
+ * lead to a throw are cold.  The others are hot.  The blocks are put
+ * into chains with the Pettis-Hansen "bottom-up" algorithm: the edges
+ * are taken from the most to the least likely one and each joins the
+ * chain that ends with its source to the chain that starts with its
+ * destination.  Loop back edges are left alone, and hot and cold blocks
+ * are never chained together.  The chain with the entry block comes
+ * first, then the other hot chains and then the cold chains, each in
+ * the original order of their first block.
+ *
+ * The edges that are no longer between neighbours are fixed up at the
+ * end: a conditional branch to the next block is inverted, a branch to
+ * the next block is removed, and a block that used to fall through to
+ * a block that is elsewhere now is followed by a new block that branches
+ * there.
+ */
+
+/*
+ * The percentage of the runs of a block that take each way out of a
+ * conditional branch.
+ */
+#define	JIT_LAYOUT_LIKELY	90
+#define	JIT_LAYOUT_UNLIKELY	10
+#define	JIT_LAYOUT_EVEN		50
+#define	JIT_LAYOUT_ALWAYS	100
+
+/*
+ * An edge that may join two chains.
+ */
+typedef struct
+{
+	int			src;
+	int			dst;
+	int			weight;
+	int			fallthru;
+
+} _jit_layout_edge_t;
+
+/*
+ * The state of the pass.  The blocks are numbered in their original
+ * order, and each chain is known by the number of one of its blocks.
+ */
+typedef struct
+{
+	jit_block_t		*blocks;
+	int			num_blocks;
+	char			*cold;
+	int			*next;
+	int			*prev;
+	int			*chain;
+	int			*head;
+	int			*tail;
+	int			*size;
+	_jit_layout_edge_t	*edges;
+	int			num_edges;
+
+} _jit_layout_t;
+
+static int
+is_cond_branch(jit_insn_t insn)
+{
+	return (insn && insn->opcode > JIT_OP_BR && insn->opcode <= JIT_OP_BR_NFGE_INV);
+}
+
+/*
+ * Determine if a block ends with a throw or a call that does not return.
+ */
+static int
+ends_in_throw(jit_block_t block)
+{
+	jit_insn_t insn;
+
+	insn = _jit_block_get_last(block);
+	if(!insn)
+	{
+		return 0;
+	}
+	switch(insn->opcode)
+	{
+	case JIT_OP_THROW:
+	case JIT_OP_RETHROW:
+		return 1;
+
+	case JIT_OP_CALL:
+	case JIT_OP_CALL_INDIRECT:
+	case JIT_OP_CALL_VTABLE_PTR:
+	case JIT_OP_CALL_EXTERNAL:
+		return block->ends_in_dead;
+	}
+	return 0;
+}
+
+/*
+ * Get the percentage of the runs of the source block that take an edge.
+ */
+static int
+edge_weight(_jit_edge_t edge)
+{
+	jit_insn_t insn;
+	int taken;
+
+	insn = _jit_block_get_last(edge->src);
+	if(!is_cond_branch(insn))
+	{
+		return JIT_LAYOUT_ALWAYS;
+	}
+	if(insn->flags & JIT_INSN_BRANCH_LIKELY)
+	{
+		taken = JIT_LAYOUT_LIKELY;
+	}
+	else if(insn->flags & JIT_INSN_BRANCH_UNLIKELY)
+	{
+		taken = JIT_LAYOUT_UNLIKELY;
+	}
+	else
+	{
+		taken = JIT_LAYOUT_EVEN;
+	}
+	if(edge->flags == _JIT_EDGE_BRANCH)
+	{
+		return taken;
+	}
+	return JIT_LAYOUT_ALWAYS - taken;
+}
+
+/*
+ * Determine if an edge is between two blocks of the function, as opposed
+ * to a return or an exception edge.
+ */
+static int
+is_flow_edge(jit_function_t func, _jit_edge_t edge)
+{
+	return ((edge->flags == _JIT_EDGE_FALLTHRU || edge->flags == _JIT_EDGE_BRANCH)
+		&& edge->dst != func->builder->exit_block);
+}
+
+/*
+ * Number the blocks and check that they can be moved around.  Returns
+ * zero if the pass has nothing to do.
+ */
+static int
+collect_blocks(jit_function_t func, _jit_layout_t *layout)
+{
+	jit_block_t block;
+	int index, num_blocks, num_edges, hints, throws;
+
+	num_blocks = 0;
+	num_edges = 0;
+	hints = 0;
+	throws = 0;
+	for(block = func->builder->entry_block;
+	    block != func->builder->exit_block;
+	    block = block->next)
+	{
+		for(index = 0; index < block->num_succs; index++)
+		{
+			/* The code that falls off the end of the function
+			   has to stay at the end */
+			if(block->succs[index]->flags == _JIT_EDGE_FALLTHRU
+			   && block->succs[index]->dst == func->builder->exit_block)
+			{
+				return 0;
+			}
+		}
+		if(is_cond_branch(_jit_block_get_last(block))
+		   && (_jit_block_get_last(block)->flags
+		       & (JIT_INSN_BRANCH_LIKELY | JIT_INSN_BRANCH_UNLIKELY)) != 0)
+		{
+			hints = 1;
+		}
+		if(ends_in_throw(block))
+		{
+			throws = 1;
+		}
+		block->index = num_blocks++;
+		num_edges += block->num_succs;
+	}
+	if(num_blocks < 3 || (!hints && !throws))
+	{
+		return 0;
+	}
+
+	layout->num_blocks = num_blocks;
+	layout->blocks = jit_malloc(num_blocks * sizeof(jit_block_t));
+	layout->cold = jit_calloc(num_blocks, sizeof(char));
+	layout->next = jit_malloc(num_blocks * sizeof(int));
+	layout->prev = jit_malloc(num_blocks * sizeof(int));
+	layout->chain = jit_malloc(num_blocks * sizeof(int));
+	layout->head = jit_malloc(num_blocks * sizeof(int));
+	layout->tail = jit_malloc(num_blocks * sizeof(int));
+	layout->size = jit_malloc(num_blocks * sizeof(int));
+	layout->edges = jit_malloc((num_edges + 1) * sizeof(_jit_layout_edge_t));
+	if(!layout->blocks || !layout->cold || !layout->next || !layout->prev
+	   || !layout->chain || !layout->head || !layout->tail || !layout->size
+	   || !layout->edges)
+	{
+		return 0;
+	}
+
+	for(block = func->builder->entry_block;
+	    block != func->builder->exit_block;
+	    block = block->next)
+	{
+		index = block->index;
+		layout->blocks[index] = block;
+		layout->next[index] = -1;
+		layout->prev[index] = -1;
+		layout->chain[index] = index;
+		layout->head[index] = index;
+		layout->tail[index] = index;
+		layout->size[index] = 1;
+	}
+	return 1;
+}
+
+static void
+free_layout(_jit_layout_t *layout)
+{
+	jit_free(layout->blocks);
+	jit_free(layout->cold);
+	jit_free(layout->next);
+	jit_free(layout->prev);
+	jit_free(layout->chain);
+	jit_free(layout->head);
+	jit_free(layout->tail);
+	jit_free(layout->size);
+	jit_free(layout->edges);
+}
+
+/*
+ * Find the cold blocks.  The hot blocks are the ones that are reached
+ * from the entry, or from a block whose address is taken, without going
+ * through an unlikely edge or a block that throws, and that can get
+ * somewhere else than to a cold block.
+ */
+static void
+find_cold_blocks(jit_function_t func, _jit_layout_t *layout)
+{
+	jit_block_t block, dst;
+	_jit_edge_t edge;
+	int *stack;
+	int top, index, count, changed;
+
+	stack = (int *) layout->next;
+	top = 0;
+	for(index = 0; index < layout->num_blocks; index++)
+	{
+		block = layout->blocks[index];
+		layout->cold[index] = 1;
+		if(index == 0 || block->address_of)
+		{
+			layout->cold[index] = 0;
+			stack[top++] = index;
+		}
+	}
+	while(top > 0)
+	{
+		block = layout->blocks[stack[--top]];
+		for(index = 0; index < block->num_succs; index++)
+		{
+			edge = block->succs[index];
+			if(!is_flow_edge(func, edge)
+			   || edge_weight(edge) <= JIT_LAYOUT_UNLIKELY)
+			{
+				continue;
+			}
+			dst = edge->dst;
+			if(layout->cold[dst->index] && !ends_in_throw(dst))
+			{
+				layout->cold[dst->index] = 0;
+				stack[top++] = dst->index;
+			}
+		}
+	}
+	for(index = 0; index < layout->num_blocks; index++)
+	{
+		layout->next[index] = -1;
+	}
+
+	do
+	{
+		changed = 0;
+		for(index = layout->num_blocks - 1; index > 0; index--)
+		{
+			block = layout->blocks[index];
+			if(layout->cold[index] || block->address_of)
+			{
+				continue;
+			}
+			count = 0;
+			for(top = 0; top < block->num_succs; top++)
+			{
+				edge = block->succs[top];
+				if(edge->flags == _JIT_EDGE_RETURN
+				   || edge->dst == func->builder->exit_block
+				   || (is_flow_edge(func, edge) && !layout->cold[edge->dst->index]))
+				{
+					break;
+				}
+				if(is_flow_edge(func, edge))
+				{
+					++count;
+				}
+			}
+			if(top == block->num_succs && count > 0)
+			{
+				layout->cold[index] = 1;
+				changed = 1;
+			}
+		}
+	}
+	while(changed);
+}
+
+/*
+ * Collect the edges that may make their destination follow their source.
+ */
+static void
+collect_edges(jit_function_t func, _jit_layout_t *layout)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	_jit_edge_t edge;
+	_jit_layout_edge_t *entry;
+	int index, src, dst;
+
+	layout->num_edges = 0;
+	for(src = 0; src < layout->num_blocks; src++)
+	{
+		block = layout->blocks[src];
+		insn = _jit_block_get_last(block);
+		if(block->num_succs == 2
+		   && block->succs[0]->dst == block->succs[1]->dst)
+		{
+			continue;
+		}
+		for(index = 0; index < block->num_succs; index++)
+		{
+			edge = block->succs[index];
+			if(!is_flow_edge(func, edge))
+			{
+				continue;
+			}
+
+			/* Only a plain or conditional branch can be turned into
+			   a fall through */
+			if(edge->flags == _JIT_EDGE_BRANCH
+			   && (!insn || (insn->opcode != JIT_OP_BR && !is_cond_branch(insn))))
+			{
+				continue;
+			}
+
+			/* The entry stays first, the loops stay as they are,
+			   and the cold blocks stay out of the hot chains */
+			dst = edge->dst->index;
+			if(dst <= src || layout->cold[src] != layout->cold[dst])
+			{
+				continue;
+			}
+
+			entry = &layout->edges[layout->num_edges++];
+			entry->src = src;
+			entry->dst = dst;
+			entry->weight = edge_weight(edge);
+			entry->fallthru = (edge->flags == _JIT_EDGE_FALLTHRU);
+		}
+	}
+}
+
+static int
+compare_edges(const void *e1, const void *e2)
+{
+	const _jit_layout_edge_t *edge1 = (const _jit_layout_edge_t *) e1;
+	const _jit_layout_edge_t *edge2 = (const _jit_layout_edge_t *) e2;
+
+	/* The most likely edges come first, and the fall throughs come
+	   before the branches so that the original order is kept when
+	   there is nothing better to do */
+	if(edge1->weight != edge2->weight)
+	{
+		return edge2->weight - edge1->weight;
+	}
+	if(edge1->fallthru != edge2->fallthru)
+	{
+		return edge2->fallthru - edge1->fallthru;
+	}
+	if(edge1->src != edge2->src)
+	{
+		return edge1->src - edge2->src;
+	}
+	return edge1->dst - edge2->dst;
+}
+
+/*
+ * Join the chain that ends with "src" to the chain that starts with "dst".
+ * The blocks of the shorter chain are moved over to the longer one.
+ */
+static void
+join_chains(_jit_layout_t *layout, int src, int dst)
+{
+	int from, to, index;
+
+	from = layout->chain[src];
+	to = layout->chain[dst];
+	if(from == to || layout->tail[from] != src || layout->head[to] != dst)
+	{
+		return;
+	}
+
+	layout->next[src] = dst;
+	layout->prev[dst] = src;
+	if(layout->size[from] >= layout->size[to])
+	{
+		for(index = dst; index >= 0; index = layout->next[index])
+		{
+			layout->chain[index] = from;
+		}
+		layout->tail[from] = layout->tail[to];
+		layout->size[from] += layout->size[to];
+	}
+	else
+	{
+		for(index = layout->head[from]; index != dst; index = layout->next[index])
+		{
+			layout->chain[index] = to;
+		}
+		layout->head[to] = layout->head[from];
+		layout->size[to] += layout->size[from];
+	}
+}
+
+/*
+ * Put the blocks into the block list in the order of the chains.
+ */
+static void
+relink_blocks(jit_function_t func, _jit_layout_t *layout)
+{
+	jit_block_t last;
+	int entry, cold, index, member;
+
+	/* The chain of the entry block goes first */
+	last = layout->blocks[0];
+	for(member = layout->next[0]; member >= 0; member = layout->next[member])
+	{
+		last->next = layout->blocks[member];
+		layout->blocks[member]->prev = last;
+		last = layout->blocks[member];
+	}
+
+	/* Then the other hot chains and then the cold ones */
+	entry = layout->chain[0];
+	for(cold = 0; cold < 2; cold++)
+	{
+		for(index = 1; index < layout->num_blocks; index++)
+		{
+			if(layout->chain[index] == entry
+			   || layout->head[layout->chain[index]] != index
+			   || layout->cold[index] != cold)
+			{
+				continue;
+			}
+			for(member = index; member >= 0; member = layout->next[member])
+			{
+				last->next = layout->blocks[member];
+				layout->blocks[member]->prev = last;
+				last = layout->blocks[member];
+			}
+		}
+	}
+	last->next = func->builder->exit_block;
+	func->builder->exit_block->prev = last;
+}
+
+/*
+ * Make the control flow right for the new order of the blocks.
+ */
+static void
+fix_edges(jit_function_t func)
+{
+	jit_block_t block, next;
+	jit_insn_t insn;
+	_jit_edge_t branch, fallthru;
+	int index;
+
+	for(block = func->builder->entry_block;
+	    block != func->builder->exit_block;
+	    block = next)
+	{
+		next = block->next;
+		insn = _jit_block_get_last(block);
+		branch = 0;
+		fallthru = 0;
+		for(index = 0; index < block->num_succs; index++)
+		{
+			if(block->succs[index]->flags == _JIT_EDGE_BRANCH)
+			{
+				branch = block->succs[index];
+			}
+			else if(block->succs[index]->flags == _JIT_EDGE_FALLTHRU)
+			{
+				fallthru = block->succs[index];
+			}
+		}
+
+		if(insn && insn->opcode == JIT_OP_BR && branch && branch->dst == next)
+		{
+			/* Replace the branch to the next block with a NOP */
+			insn->opcode = JIT_OP_NOP;
+			branch->flags = _JIT_EDGE_FALLTHRU;
+			block->ends_in_dead = 0;
+			continue;
+		}
+		if(!fallthru || fallthru->dst == next)
+		{
+			continue;
+		}
+		if(is_cond_branch(insn) && branch && branch->dst == next
+		   && _jit_block_invert_branch(func, block))
+		{
+			continue;
+		}
+		_jit_block_add_jump(func, block);
+	}
+}
+
+void
+_jit_function_layout_blocks(jit_function_t func)
+{
+	_jit_layout_t layout;
+	int index;
+
+	/* The exception handlers look for the throws by the address ranges
+	   of the code, which must not be changed */
+	if(func->has_try)
+	{
+		return;
+	}
+
+	jit_memzero(&layout, sizeof(layout));
+	if(!collect_blocks(func, &layout))
+	{
+		free_layout(&layout);
+		return;
+	}
+
+	find_cold_blocks(func, &layout);
+
+	collect_edges(func, &layout);
+	qsort(layout.edges, layout.num_edges, sizeof(_jit_layout_edge_t), compare_edges);
+	for(index = 0; index < layout.num_edges; index++)
+	{
+		join_chains(&layout, layout.edges[index].src, layout.edges[index].dst);
+	}
+
+	relink_blocks(func, &layout);
+	free_layout(&layout);
+
+	fix_edges(func);
+}
@@ -562,9 +562,61 @@ reset_liveness_flags(jit_block_t block, int reset_all)
 	}
 }
 
+/*
+ * Mark the values that are read by the block before they are written
+ * as having a next use.  This is done for the block that follows the
+ * current one if the code generator can keep the values in registers
+ * when it falls through to that block (see _jit_regs_carry_over).
+ * Otherwise the last use of a value in the current block would free
+ * its register.
+ */
+static void
+seed_next_use(jit_block_t block)
+{
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	int flags;
+
+	if(block->func->has_try || !_jit_block_is_fallthrough_only(block))
+	{
+		return;
+	}
+
+	jit_insn_iter_init_last(&iter, block);
+	while((insn = jit_insn_iter_previous(&iter)) != 0)
+	{
+		if(insn->opcode == JIT_OP_NOP)
+		{
+			continue;
+		}
+		flags = insn->flags;
+		if((flags & JIT_INSN_DEST_OTHER_FLAGS) == 0
+		   && insn->dest && !insn->dest->is_constant)
+		{
+			insn->dest->next_use = ((flags & JIT_INSN_DEST_IS_VALUE) != 0);
+		}
+		if((flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0
+		   && insn->value1 && !insn->value1->is_constant)
+		{
+			insn->value1->next_use = 1;
+		}
+		if((flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0
+		   && insn->value2 && !insn->value2->is_constant)
+		{
+			insn->value2->next_use = 1;
+		}
+	}
+}
+
 void _jit_function_compute_liveness(jit_function_t func)
 {
-	jit_block_t block = func->builder->entry_block;
+	/* Process the blocks in reverse order so that the next block
+	   is already final when its values are used to seed the flags */
+	jit_block_t block = func->builder->exit_block;
+	while(block->next != 0)
+	{
+		block = block->next;
+	}
 	while(block != 0)
 	{
 #ifdef USE_FORWARD_PROPAGATION
@@ -574,6 +626,10 @@ void _jit_function_compute_liveness(jit_function_t func)
 
 		/* Reset the liveness flags for the next block */
 		reset_liveness_flags(block, 0);
+		if(block->next)
+		{
+			seed_next_use(block->next);
+		}
 
 		/* Compute the liveness flags for the block */
 		compute_liveness_for_block(block);
@@ -584,11 +640,15 @@ void _jit_function_compute_liveness(jit_function_t func)
 		{
 			/* Reset the liveness flags and compute them again */
 			reset_liveness_flags(block, 1);
+			if(block->next)
+			{
+				seed_next_use(block->next);
+			}
 			compute_liveness_for_block(block);
 		}
 #endif
 
-		/* Move on to the next block in the function */
-		block = block->next;
+		/* Move on to the previous block in the function */
+		block = block->prev;
 	}
 }
@@ -0,0 +1,1287 @@
+/*
+ * jit-loop.c - Loop optimizations.
+ *
+ * Copyright (C) 2026  Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+#include "jit-rules.h"
+
+/*
+ * The natural loops are found from the back edges of the control flow
+ * graph, that is the edges that go to a block that dominates their
+ * source.  The loops are processed from the innermost to the outermost
+ * one, so the code hoisted out of an inner loop can be hoisted further
+ * out of the enclosing loop.  For every loop the pass:
+ *
+ *  - removes the "check_null" instructions that are dominated by
+ *    another check of the same value within the loop, if the loop
+ *    does not change the value,
+ *  - moves the pure computations that only depend on values that the
+ *    loop does not change to the loop preheader,
+ *  - replaces the multiplications of an induction variable by a
+ *    constant with a new value that is initialized in the preheader
+ *    and incremented along with the induction variable.
+ *
+ * The preheader is the only block outside of the loop that enters the
+ * loop header.  If the block that enters the loop also goes elsewhere
+ * then a new block is inserted in between.
+ */
+
+typedef struct _jit_loop _jit_loop_t;
+struct _jit_loop
+{
+	jit_block_t		header;
+	jit_block_t		preheader;
+	jit_block_t		*blocks;
+	int			num_blocks;
+	int			max_blocks;
+};
+
+/*
+ * Information about a value that is assigned within the loop.
+ */
+typedef struct _jit_loop_def _jit_loop_def_t;
+struct _jit_loop_def
+{
+	jit_value_t		value;
+
+	/* Number of instructions in the loop that assign the value */
+	int			count;
+
+	/* The assignment if there is only one */
+	jit_block_t		block;
+	int			posn;
+
+	/* The value is used where the only assignment does not reach */
+	int			used_before;
+};
+
+/*
+ * Value created by strength reduction for the product of
+ * an induction variable and a constant.
+ */
+typedef struct _jit_loop_product _jit_loop_product_t;
+struct _jit_loop_product
+{
+	jit_value_t		var;
+	jit_value_t		factor;
+	jit_value_t		value;
+
+	/* The opcode that extends "var" before the multiplication, or zero */
+	int			extend;
+};
+
+typedef struct _jit_loop_pass _jit_loop_pass_t;
+struct _jit_loop_pass
+{
+	jit_function_t		func;
+
+	/* All the loops sorted by size, the inner loops come first */
+	_jit_loop_t		*loops;
+	int			num_loops;
+
+	/* The number of the loop each block is in while the loop is
+	   processed, indexed by the block number */
+	int			*in_loop;
+	int			num_block_indexes;
+	int			max_block_indexes;
+
+	/* The values assigned within the current loop */
+	_jit_loop_def_t		*defs;
+	int			num_defs;
+
+	/* The blocks that leave the current loop */
+	jit_block_t		*exits;
+	int			num_exits;
+
+	/* The strength reduced products of the current loop */
+	_jit_loop_product_t	*products;
+	int			num_products;
+	int			max_products;
+};
+
+/*
+ * Check if the instruction computes its result from the operands
+ * without side effects and without throwing exceptions.
+ */
+static int
+is_pure(jit_insn_t insn)
+{
+	switch(insn->opcode)
+	{
+	case JIT_OP_TRUNC_SBYTE:
+	case JIT_OP_TRUNC_UBYTE:
+	case JIT_OP_TRUNC_SHORT:
+	case JIT_OP_TRUNC_USHORT:
+	case JIT_OP_TRUNC_INT:
+	case JIT_OP_TRUNC_UINT:
+	case JIT_OP_LOW_WORD:
+	case JIT_OP_EXPAND_INT:
+	case JIT_OP_EXPAND_UINT:
+	case JIT_OP_IADD:
+	case JIT_OP_ISUB:
+	case JIT_OP_IMUL:
+	case JIT_OP_INEG:
+	case JIT_OP_LADD:
+	case JIT_OP_LSUB:
+	case JIT_OP_LMUL:
+	case JIT_OP_LNEG:
+	case JIT_OP_FADD:
+	case JIT_OP_FSUB:
+	case JIT_OP_FMUL:
+	case JIT_OP_FNEG:
+	case JIT_OP_DADD:
+	case JIT_OP_DSUB:
+	case JIT_OP_DMUL:
+	case JIT_OP_DNEG:
+	case JIT_OP_NFADD:
+	case JIT_OP_NFSUB:
+	case JIT_OP_NFMUL:
+	case JIT_OP_NFNEG:
+	case JIT_OP_IAND:
+	case JIT_OP_IOR:
+	case JIT_OP_IXOR:
+	case JIT_OP_INOT:
+	case JIT_OP_ISHL:
+	case JIT_OP_ISHR:
+	case JIT_OP_ISHR_UN:
+	case JIT_OP_LAND:
+	case JIT_OP_LOR:
+	case JIT_OP_LXOR:
+	case JIT_OP_LNOT:
+	case JIT_OP_LSHL:
+	case JIT_OP_LSHR:
+	case JIT_OP_LSHR_UN:
+	case JIT_OP_IEQ:
+	case JIT_OP_INE:
+	case JIT_OP_ILT:
+	case JIT_OP_ILT_UN:
+	case JIT_OP_ILE:
+	case JIT_OP_ILE_UN:
+	case JIT_OP_IGT:
+	case JIT_OP_IGT_UN:
+	case JIT_OP_IGE:
+	case JIT_OP_IGE_UN:
+	case JIT_OP_LEQ:
+	case JIT_OP_LNE:
+	case JIT_OP_LLT:
+	case JIT_OP_LLT_UN:
+	case JIT_OP_LLE:
+	case JIT_OP_LLE_UN:
+	case JIT_OP_LGT:
+	case JIT_OP_LGT_UN:
+	case JIT_OP_LGE:
+	case JIT_OP_LGE_UN:
+	case JIT_OP_ADD_RELATIVE:
+	case JIT_OP_COPY_INT:
+	case JIT_OP_COPY_LONG:
+	case JIT_OP_COPY_FLOAT32:
+	case JIT_OP_COPY_FLOAT64:
+	case JIT_OP_COPY_NFLOAT:
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Check if the value may be changed behind the scenes.
+ */
+static int
+is_aliased(jit_function_t func, jit_value_t value)
+{
+	return (value->is_volatile || value->is_addressable
+		|| value == func->builder->struct_return
+		|| value == func->builder->parent_frame
+		|| value == func->parent_frame
+		|| value == func->cached_parent_frame);
+}
+
+/*
+ * Check if the value is the same on every iteration of the loop.
+ */
+static int
+is_invariant(_jit_loop_pass_t *pass, jit_value_t value)
+{
+	if(!value || value->is_constant)
+	{
+		return 1;
+	}
+	if(is_aliased(pass->func, value))
+	{
+		return 0;
+	}
+	return (value->index < 0 || pass->defs[value->index].count == 0);
+}
+
+static int
+in_loop(_jit_loop_pass_t *pass, int loop, jit_block_t block)
+{
+	return (block->index >= 0 && pass->in_loop[block->index] == loop);
+}
+
+static void
+free_loops(_jit_loop_pass_t *pass)
+{
+	int index;
+
+	for(index = 0; index < pass->num_loops; index++)
+	{
+		jit_free(pass->loops[index].blocks);
+	}
+	jit_free(pass->loops);
+	jit_free(pass->in_loop);
+	jit_free(pass->defs);
+	jit_free(pass->exits);
+	jit_free(pass->products);
+}
+
+static int
+add_block(_jit_loop_t *loop, jit_block_t block)
+{
+	jit_block_t *blocks;
+
+	if(loop->num_blocks == loop->max_blocks)
+	{
+		loop->max_blocks = loop->max_blocks ? loop->max_blocks * 2 : 8;
+		blocks = jit_realloc(loop->blocks, loop->max_blocks * sizeof(jit_block_t));
+		if(!blocks)
+		{
+			return 0;
+		}
+		loop->blocks = blocks;
+	}
+	loop->blocks[loop->num_blocks++] = block;
+	return 1;
+}
+
+/*
+ * Collect the blocks of the loop by walking backwards from the
+ * sources of its back edges up to the header.
+ */
+static int
+collect_loop(_jit_loop_pass_t *pass, _jit_loop_t *loop, int number)
+{
+	jit_block_t block, pred;
+	jit_block_t *stack;
+	int top, index, edge;
+
+	stack = jit_malloc(pass->num_block_indexes * sizeof(jit_block_t));
+	if(!stack)
+	{
+		return 0;
+	}
+
+	pass->in_loop[loop->header->index] = number;
+	if(!add_block(loop, loop->header))
+	{
+		jit_free(stack);
+		return 0;
+	}
+
+	top = 0;
+	for(edge = 0; edge < loop->header->num_preds; edge++)
+	{
+		block = loop->header->preds[edge]->src;
+		if(block->index >= 0 && pass->in_loop[block->index] != number
+		   && _jit_block_dominates(loop->header, block))
+		{
+			pass->in_loop[block->index] = number;
+			if(!add_block(loop, block))
+			{
+				jit_free(stack);
+				return 0;
+			}
+			stack[top++] = block;
+		}
+	}
+	while(top > 0)
+	{
+		block = stack[--top];
+		for(index = 0; index < block->num_preds; index++)
+		{
+			pred = block->preds[index]->src;
+			if(pred->index < 0 || pass->in_loop[pred->index] == number)
+			{
+				continue;
+			}
+			pass->in_loop[pred->index] = number;
+			if(!add_block(loop, pred))
+			{
+				jit_free(stack);
+				return 0;
+			}
+			stack[top++] = pred;
+		}
+	}
+
+	jit_free(stack);
+	return 1;
+}
+
+/*
+ * Find the natural loops.  The loops with the same header are merged.
+ */
+static int
+find_loops(_jit_loop_pass_t *pass)
+{
+	jit_builder_t builder = pass->func->builder;
+	jit_block_t block, header;
+	_jit_loop_t loop;
+	int index, edge, posn;
+
+	pass->max_block_indexes = 2 * builder->num_block_order;
+	pass->num_block_indexes = builder->num_block_order;
+	pass->in_loop = jit_malloc(pass->max_block_indexes * sizeof(int));
+	pass->loops = jit_calloc(builder->num_block_order, sizeof(_jit_loop_t));
+	if(!pass->in_loop || !pass->loops)
+	{
+		return 0;
+	}
+	for(index = 0; index < pass->max_block_indexes; index++)
+	{
+		pass->in_loop[index] = -1;
+	}
+
+	/* A block is a loop header if it dominates one of its predecessors */
+	for(index = builder->num_block_order - 1; index >= 0; index--)
+	{
+		header = builder->block_order[index];
+		for(edge = 0; edge < header->num_preds; edge++)
+		{
+			block = header->preds[edge]->src;
+			if(block->index >= 0 && _jit_block_dominates(header, block))
+			{
+				break;
+			}
+		}
+		if(edge < header->num_preds)
+		{
+			pass->loops[pass->num_loops].header = header;
+			if(!collect_loop(pass, &pass->loops[pass->num_loops], pass->num_loops))
+			{
+				++(pass->num_loops);
+				return 0;
+			}
+			++(pass->num_loops);
+		}
+	}
+
+	/* Sort the loops so that the inner loops come first */
+	for(index = 1; index < pass->num_loops; index++)
+	{
+		loop = pass->loops[index];
+		for(posn = index; posn > 0; posn--)
+		{
+			if(pass->loops[posn - 1].num_blocks <= loop.num_blocks)
+			{
+				break;
+			}
+			pass->loops[posn] = pass->loops[posn - 1];
+		}
+		pass->loops[posn] = loop;
+	}
+	for(index = 0; index < pass->max_block_indexes; index++)
+	{
+		pass->in_loop[index] = -1;
+	}
+	return 1;
+}
+
+/*
+ * Mark the blocks of a loop and find the blocks that leave it.
+ */
+static int
+mark_loop(_jit_loop_pass_t *pass, int number)
+{
+	_jit_loop_t *loop = &pass->loops[number];
+	jit_block_t block;
+	int index, edge;
+
+	jit_free(pass->exits);
+	pass->exits = jit_malloc(loop->num_blocks * sizeof(jit_block_t));
+	if(!pass->exits)
+	{
+		return 0;
+	}
+	pass->num_exits = 0;
+
+	for(index = 0; index < loop->num_blocks; index++)
+	{
+		pass->in_loop[loop->blocks[index]->index] = number;
+	}
+	for(index = 0; index < loop->num_blocks; index++)
+	{
+		block = loop->blocks[index];
+		for(edge = 0; edge < block->num_succs; edge++)
+		{
+			if(!in_loop(pass, number, block->succs[edge]->dst))
+			{
+				pass->exits[pass->num_exits++] = block;
+				break;
+			}
+		}
+	}
+	return 1;
+}
+
+/*
+ * Find the values assigned within the loop, and check if their uses
+ * are reached by the assignment when there is only one.
+ */
+static int
+collect_defs(_jit_loop_pass_t *pass, _jit_loop_t *loop)
+{
+	_jit_loop_def_t *def;
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_value_t value;
+	jit_value_t uses[3];
+	int index, posn, num_insns, use;
+
+	num_insns = 0;
+	for(index = 0; index < loop->num_blocks; index++)
+	{
+		num_insns += loop->blocks[index]->num_insns;
+	}
+	jit_free(pass->defs);
+	pass->defs = jit_malloc((num_insns ? num_insns : 1) * sizeof(_jit_loop_def_t));
+	if(!pass->defs)
+	{
+		return 0;
+	}
+
+	pass->num_defs = 0;
+	for(index = 0; index < loop->num_blocks; index++)
+	{
+		block = loop->blocks[index];
+		for(posn = 0; posn < block->num_insns; posn++)
+		{
+			insn = &block->insns[posn];
+			if(insn->opcode == JIT_OP_NOP)
+			{
+				continue;
+			}
+			value = _jit_insn_get_def(insn);
+			if(!value || value->is_constant)
+			{
+				continue;
+			}
+			if(value->index < 0)
+			{
+				value->index = pass->num_defs++;
+				def = &pass->defs[value->index];
+				def->value = value;
+				def->count = 0;
+				def->block = block;
+				def->posn = posn;
+				def->used_before = 0;
+			}
+			++(pass->defs[value->index].count);
+		}
+	}
+
+	for(index = 0; index < loop->num_blocks; index++)
+	{
+		block = loop->blocks[index];
+		for(posn = 0; posn < block->num_insns; posn++)
+		{
+			insn = &block->insns[posn];
+			if(insn->opcode == JIT_OP_NOP)
+			{
+				continue;
+			}
+			uses[0] = 0;
+			uses[1] = 0;
+			uses[2] = 0;
+			if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0
+			   && (insn->flags & JIT_INSN_DEST_IS_VALUE) != 0)
+			{
+				uses[0] = insn->dest;
+			}
+			if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0
+			   && insn->value1 != _jit_insn_get_def(insn))
+			{
+				uses[1] = insn->value1;
+			}
+			if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0)
+			{
+				uses[2] = insn->value2;
+			}
+			for(use = 0; use < 3; use++)
+			{
+				value = uses[use];
+				if(!value || value->is_constant || value->index < 0)
+				{
+					continue;
+				}
+				def = &pass->defs[value->index];
+				if(def->block == block
+				   ? posn <= def->posn
+				   : !_jit_block_dominates(def->block, block))
+				{
+					def->used_before = 1;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+static void
+forget_defs(_jit_loop_pass_t *pass)
+{
+	int index;
+
+	for(index = 0; index < pass->num_defs; index++)
+	{
+		pass->defs[index].value->index = -1;
+	}
+	pass->num_defs = 0;
+}
+
+/*
+ * Remove the null checks that are dominated by another check
+ * of the same value.
+ */
+static void
+remove_null_checks(_jit_loop_pass_t *pass, _jit_loop_t *loop)
+{
+	jit_block_t block, other;
+	jit_insn_t insn, check;
+	int index, posn, other_index, other_posn, found;
+
+	for(index = 0; index < loop->num_blocks; index++)
+	{
+		block = loop->blocks[index];
+		for(posn = 0; posn < block->num_insns; posn++)
+		{
+			insn = &block->insns[posn];
+			if(insn->opcode != JIT_OP_CHECK_NULL || !is_invariant(pass, insn->value1))
+			{
+				continue;
+			}
+
+			found = 0;
+			for(other_index = 0; !found && other_index < loop->num_blocks; other_index++)
+			{
+				other = loop->blocks[other_index];
+				if(other != block && !_jit_block_dominates(other, block))
+				{
+					continue;
+				}
+				for(other_posn = 0; other_posn < other->num_insns; other_posn++)
+				{
+					if(other == block && other_posn >= posn)
+					{
+						break;
+					}
+					check = &other->insns[other_posn];
+					if(check->opcode == JIT_OP_CHECK_NULL
+					   && check->value1 == insn->value1)
+					{
+						found = 1;
+						break;
+					}
+				}
+			}
+			if(found)
+			{
+				insn->opcode = JIT_OP_NOP;
+			}
+		}
+	}
+}
+
+/*
+ * Add a block that was inserted in front of the header of a loop
+ * to the enclosing loops.
+ */
+static void
+add_preheader(_jit_loop_pass_t *pass, int number, jit_block_t preheader)
+{
+	_jit_loop_t *loop;
+	int index, posn;
+
+	for(index = number + 1; index < pass->num_loops; index++)
+	{
+		loop = &pass->loops[index];
+		for(posn = 0; posn < loop->num_blocks; posn++)
+		{
+			if(loop->blocks[posn] == pass->loops[number].header)
+			{
+				if(!add_block(loop, preheader))
+				{
+					jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+				}
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Get the preheader of the loop, inserting it if necessary.
+ */
+static jit_block_t
+get_preheader(_jit_loop_pass_t *pass, int number)
+{
+	_jit_loop_t *loop = &pass->loops[number];
+	jit_block_t header, block;
+	jit_insn_t last;
+	_jit_edge_t entry;
+	int index, count;
+
+	if(loop->preheader)
+	{
+		return loop->preheader;
+	}
+
+	header = loop->header;
+	entry = 0;
+	count = 0;
+	for(index = 0; index < header->num_preds; index++)
+	{
+		if(!in_loop(pass, number, header->preds[index]->src))
+		{
+			entry = header->preds[index];
+			++count;
+		}
+	}
+	if(count != 1)
+	{
+		return 0;
+	}
+
+	block = entry->src;
+	if(block->num_succs == 1)
+	{
+		last = _jit_block_get_last(block);
+		if(entry->flags == _JIT_EDGE_FALLTHRU
+		   || (entry->flags == _JIT_EDGE_BRANCH && last && last->opcode == JIT_OP_BR))
+		{
+			loop->preheader = block;
+		}
+	}
+	else if(entry->flags == _JIT_EDGE_FALLTHRU
+		&& pass->num_block_indexes < pass->max_block_indexes)
+	{
+		block = _jit_block_split_fallthru(pass->func, header);
+		block->index = pass->num_block_indexes++;
+		block->idom = header->idom;
+		header->idom = block;
+		add_preheader(pass, number, block);
+		loop->preheader = block;
+	}
+	return loop->preheader;
+}
+
+/*
+ * Get the position in the preheader to add instructions at.
+ */
+static int
+get_preheader_posn(jit_block_t preheader)
+{
+	jit_insn_t last;
+
+	last = _jit_block_get_last(preheader);
+	if(last && last->opcode == JIT_OP_BR)
+	{
+		return preheader->num_insns - 1;
+	}
+	return preheader->num_insns;
+}
+
+/*
+ * Turn a temporary value into a local value because it is now
+ * used outside of the block it was computed in.
+ */
+static void
+make_local(jit_value_t value)
+{
+	if(value->is_temporary)
+	{
+		value->is_temporary = 0;
+		value->is_local = 1;
+		if(_jit_gen_is_global_candidate(value->type))
+		{
+			value->global_candidate = 1;
+		}
+	}
+}
+
+/*
+ * Check if an instruction can be moved to the loop preheader.
+ */
+static int
+is_hoistable(_jit_loop_pass_t *pass, jit_block_t block, jit_insn_t insn)
+{
+	_jit_loop_def_t *def;
+	jit_value_t dest;
+	int index;
+
+	if(!is_pure(insn))
+	{
+		return 0;
+	}
+
+	dest = _jit_insn_get_def(insn);
+	if(!dest || dest->index < 0 || is_aliased(pass->func, dest))
+	{
+		return 0;
+	}
+	def = &pass->defs[dest->index];
+	if(def->count != 1 || def->used_before)
+	{
+		return 0;
+	}
+	if(!is_invariant(pass, insn->value1) || !is_invariant(pass, insn->value2))
+	{
+		return 0;
+	}
+
+	/* If the value is used after the loop then it must be assigned
+	   on all the paths that leave the loop */
+	if(!dest->is_temporary)
+	{
+		for(index = 0; index < pass->num_exits; index++)
+		{
+			if(!_jit_block_dominates(block, pass->exits[index]))
+			{
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/*
+ * Move the loop invariant computations to the preheader.
+ */
+static void
+hoist_invariants(_jit_loop_pass_t *pass, int number)
+{
+	_jit_loop_t *loop = &pass->loops[number];
+	jit_block_t block, preheader;
+	jit_insn_t insn, new_insn;
+	struct _jit_insn saved;
+	int index, posn, changed;
+
+	do
+	{
+		changed = 0;
+		for(index = 0; index < loop->num_blocks; index++)
+		{
+			block = loop->blocks[index];
+			for(posn = 0; posn < block->num_insns; posn++)
+			{
+				insn = &block->insns[posn];
+				if(insn->opcode == JIT_OP_NOP || !is_hoistable(pass, block, insn))
+				{
+					continue;
+				}
+				preheader = get_preheader(pass, number);
+				if(!preheader)
+				{
+					return;
+				}
+
+				saved = *insn;
+				new_insn = _jit_block_insert_insn(preheader, get_preheader_posn(preheader));
+				if(!new_insn)
+				{
+					jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+				}
+				*new_insn = saved;
+				insn = &block->insns[posn];
+				insn->opcode = JIT_OP_NOP;
+
+				pass->defs[saved.dest->index].count = 0;
+				make_local(saved.dest);
+				changed = 1;
+			}
+		}
+	}
+	while(changed);
+}
+
+/*
+ * Get the constant that an assignment in the loop adds to an
+ * induction variable.  The assignment is either "var = var + step"
+ * or "var = temp" where "temp = var + step" comes earlier in the
+ * same block.  Returns zero if this is not such an assignment.
+ */
+static int
+get_increment(jit_block_t block, int posn, jit_value_t var, jit_long *step)
+{
+	jit_insn_t insn;
+	jit_value_t temp;
+
+	insn = &block->insns[posn];
+	switch(insn->opcode)
+	{
+	case JIT_OP_COPY_INT:
+	case JIT_OP_COPY_LONG:
+		temp = insn->value1;
+		if(!temp->is_temporary || temp->is_constant)
+		{
+			return 0;
+		}
+		while(--posn >= 0)
+		{
+			insn = &block->insns[posn];
+			if(insn->opcode == JIT_OP_NOP)
+			{
+				continue;
+			}
+			if(_jit_insn_get_def(insn) == temp)
+			{
+				break;
+			}
+			if(_jit_insn_get_def(insn) == var)
+			{
+				return 0;
+			}
+		}
+		if(posn < 0)
+		{
+			return 0;
+		}
+		break;
+	}
+
+	switch(insn->opcode)
+	{
+	case JIT_OP_IADD:
+	case JIT_OP_ISUB:
+		if(insn->value1 != var || !insn->value2->is_constant)
+		{
+			return 0;
+		}
+		*step = jit_value_get_nint_constant(insn->value2);
+		break;
+
+	case JIT_OP_LADD:
+	case JIT_OP_LSUB:
+		if(insn->value1 != var || !insn->value2->is_constant)
+		{
+			return 0;
+		}
+		*step = jit_value_get_long_constant(insn->value2);
+		break;
+
+	default:
+		return 0;
+	}
+	if(insn->opcode == JIT_OP_ISUB || insn->opcode == JIT_OP_LSUB)
+	{
+		*step = -*step;
+	}
+	return 1;
+}
+
+/*
+ * Check if all the assignments to a value in the loop increment
+ * it by a constant.
+ */
+static int
+is_induction_variable(_jit_loop_t *loop, jit_value_t var)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_long step;
+	int index, posn;
+
+	for(index = 0; index < loop->num_blocks; index++)
+	{
+		block = loop->blocks[index];
+		for(posn = 0; posn < block->num_insns; posn++)
+		{
+			insn = &block->insns[posn];
+			if(insn->opcode != JIT_OP_NOP && _jit_insn_get_def(insn) == var
+			   && !get_increment(block, posn, var, &step))
+			{
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/*
+ * Create a constant of the type of a multiplication.
+ */
+static jit_value_t
+create_product_constant(jit_function_t func, jit_type_t type, int opcode,
+			jit_value_t factor, jit_long step)
+{
+	jit_ulong product;
+
+	if(opcode == JIT_OP_IMUL)
+	{
+		product = (jit_ulong) jit_value_get_nint_constant(factor) * (jit_ulong) step;
+		return jit_value_create_nint_constant(func, type, (jit_int) product);
+	}
+	product = (jit_ulong) jit_value_get_long_constant(factor) * (jit_ulong) step;
+	return jit_value_create_long_constant(func, type, (jit_long) product);
+}
+
+/*
+ * Find the value that holds "var * factor" within the loop.
+ */
+static jit_value_t
+find_product(_jit_loop_pass_t *pass, jit_value_t var, int extend, jit_value_t factor)
+{
+	int index;
+
+	for(index = 0; index < pass->num_products; index++)
+	{
+		if(pass->products[index].var == var
+		   && pass->products[index].extend == extend
+		   && jit_value_get_long_constant(pass->products[index].factor)
+		      == jit_value_get_long_constant(factor))
+		{
+			return pass->products[index].value;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Compute "value = var * factor" in the preheader and increment
+ * the value after every assignment to the induction variable.
+ * If "extend" is not zero then "var" is extended to the type of
+ * the value with that opcode first.
+ */
+static void
+add_product(_jit_loop_pass_t *pass, _jit_loop_t *loop, int opcode,
+	    jit_value_t value, jit_value_t var, int extend, jit_value_t factor)
+{
+	jit_function_t func = pass->func;
+	jit_value_t increment, wide;
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_long step;
+	int index, posn;
+
+	block = loop->preheader;
+	wide = var;
+	if(extend)
+	{
+		wide = jit_value_create(func, value->type);
+		if(!wide)
+		{
+			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+		}
+		insn = _jit_block_insert_insn(block, get_preheader_posn(block));
+		if(!insn)
+		{
+			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+		}
+		insn->opcode = (short) extend;
+		insn->dest = wide;
+		insn->value1 = var;
+		wide->usage_count += 2;
+	}
+	insn = _jit_block_insert_insn(block, get_preheader_posn(block));
+	if(!insn)
+	{
+		jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+	}
+	insn->opcode = (short) opcode;
+	insn->dest = value;
+	insn->value1 = wide;
+	insn->value2 = factor;
+	value->usage_count += 2;
+
+	for(index = 0; index < loop->num_blocks; index++)
+	{
+		block = loop->blocks[index];
+		for(posn = 0; posn < block->num_insns; posn++)
+		{
+			insn = &block->insns[posn];
+			if(insn->opcode == JIT_OP_NOP || _jit_insn_get_def(insn) != var)
+			{
+				continue;
+			}
+			get_increment(block, posn, var, &step);
+			increment = create_product_constant(func, value->type, opcode, factor, step);
+			if(!increment)
+			{
+				jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+			}
+
+			++posn;
+			insn = _jit_block_insert_insn(block, posn);
+			if(!insn)
+			{
+				jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+			}
+			insn->opcode = (opcode == JIT_OP_IMUL) ? JIT_OP_IADD : JIT_OP_LADD;
+			insn->dest = value;
+			insn->value1 = value;
+			insn->value2 = increment;
+			value->usage_count += 2;
+		}
+	}
+
+	pass->products[pass->num_products].var = var;
+	pass->products[pass->num_products].factor = factor;
+	pass->products[pass->num_products].value = value;
+	pass->products[pass->num_products].extend = extend;
+	++(pass->num_products);
+}
+
+/*
+ * Check if the temporary value used at the position in the block is
+ * the sign or zero extension of another value earlier in the block,
+ * and that value is not changed in between.  This is how the indexes
+ * of the type jit_int are converted to jit_nint for the address
+ * arithmetic.  Returns the extended value or NULL.
+ */
+static jit_value_t
+get_extended_value(jit_block_t block, int posn, jit_value_t value, int *extend)
+{
+	jit_insn_t insn;
+	jit_value_t var;
+	int def_posn;
+
+	if(!value->is_temporary || value->is_constant)
+	{
+		return 0;
+	}
+	for(def_posn = posn - 1; def_posn >= 0; def_posn--)
+	{
+		insn = &block->insns[def_posn];
+		if(insn->opcode != JIT_OP_NOP && _jit_insn_get_def(insn) == value)
+		{
+			break;
+		}
+	}
+	if(def_posn < 0)
+	{
+		return 0;
+	}
+	insn = &block->insns[def_posn];
+	if(insn->opcode != JIT_OP_EXPAND_INT && insn->opcode != JIT_OP_EXPAND_UINT)
+	{
+		return 0;
+	}
+	var = insn->value1;
+	*extend = insn->opcode;
+	while(++def_posn < posn)
+	{
+		insn = &block->insns[def_posn];
+		if(insn->opcode != JIT_OP_NOP && _jit_insn_get_def(insn) == var)
+		{
+			return 0;
+		}
+	}
+	return var;
+}
+
+/*
+ * Check if the instruction multiplies an induction variable of the loop
+ * by a constant, or the extension of an induction variable to the type
+ * of the multiplication.  In the latter case the product is only
+ * incremented along with the variable, so the variable is assumed not
+ * to wrap around within the loop, as usual for an index.  Returns the
+ * induction variable or NULL.
+ */
+static jit_value_t
+get_multiplied_variable(_jit_loop_pass_t *pass, _jit_loop_t *loop, jit_block_t block,
+			int posn, jit_value_t *factor, int *extend)
+{
+	jit_insn_t insn;
+	jit_value_t var;
+	jit_type_t type;
+
+	insn = &block->insns[posn];
+	if(insn->opcode != JIT_OP_IMUL && insn->opcode != JIT_OP_LMUL)
+	{
+		return 0;
+	}
+	if(insn->value2->is_constant)
+	{
+		var = insn->value1;
+		*factor = insn->value2;
+	}
+	else if(insn->value1->is_constant)
+	{
+		var = insn->value2;
+		*factor = insn->value1;
+	}
+	else
+	{
+		return 0;
+	}
+
+	type = jit_type_normalize(var->type);
+	if(type != jit_type_normalize(insn->dest->type)
+	   || type != jit_type_normalize((*factor)->type))
+	{
+		return 0;
+	}
+
+	*extend = 0;
+	if(var->is_temporary && insn->opcode == JIT_OP_LMUL)
+	{
+		var = get_extended_value(block, posn, var, extend);
+		if(!var)
+		{
+			return 0;
+		}
+	}
+
+	if(var->is_constant || var->is_temporary || var->index < 0
+	   || is_aliased(pass->func, var))
+	{
+		return 0;
+	}
+	if(!is_induction_variable(loop, var))
+	{
+		return 0;
+	}
+	return var;
+}
+
+/*
+ * Replace the multiplications of induction variables by constants.
+ */
+static void
+reduce_strength(_jit_loop_pass_t *pass, int number)
+{
+	_jit_loop_t *loop = &pass->loops[number];
+	_jit_loop_product_t *products;
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_value_t var, factor, value;
+	int index, posn, opcode, extend, changed;
+
+	pass->num_products = 0;
+	do
+	{
+		/* The instructions move when the increments are added,
+		   so start over after every new product */
+		changed = 0;
+		for(index = 0; !changed && index < loop->num_blocks; index++)
+		{
+			block = loop->blocks[index];
+			for(posn = 0; posn < block->num_insns; posn++)
+			{
+				var = get_multiplied_variable(pass, loop, block, posn,
+							      &factor, &extend);
+				if(!var || !get_preheader(pass, number))
+				{
+					continue;
+				}
+
+				insn = &block->insns[posn];
+				opcode = insn->opcode;
+				value = find_product(pass, var, extend, factor);
+				if(!value)
+				{
+					if(pass->num_products == pass->max_products)
+					{
+						pass->max_products = pass->max_products
+							? pass->max_products * 2 : 4;
+						products = jit_realloc(pass->products,
+								       pass->max_products
+								       * sizeof(_jit_loop_product_t));
+						if(!products)
+						{
+							return;
+						}
+						pass->products = products;
+					}
+					value = jit_value_create(pass->func, insn->dest->type);
+					if(!value)
+					{
+						return;
+					}
+					make_local(value);
+					changed = 1;
+				}
+
+				insn->opcode = (opcode == JIT_OP_IMUL) ? JIT_OP_COPY_INT : JIT_OP_COPY_LONG;
+				insn->value1 = value;
+				insn->value2 = 0;
+				++(value->usage_count);
+
+				if(changed)
+				{
+					add_product(pass, loop, opcode, value, var, extend, factor);
+					break;
+				}
+			}
+		}
+	}
+	while(changed);
+}
+
+void
+_jit_function_optimize_loops(jit_function_t func)
+{
+	_jit_loop_pass_t pass;
+	jit_block_t block;
+	int number;
+
+	/* The exception handlers and the indirect jumps are not
+	   in the control flow graph */
+	if(func->has_try)
+	{
+		return;
+	}
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		if(block->address_of)
+		{
+			return;
+		}
+	}
+
+	if(!_jit_block_compute_dominators(func))
+	{
+		return;
+	}
+
+	jit_memzero(&pass, sizeof(pass));
+	pass.func = func;
+	if(find_loops(&pass))
+	{
+		for(number = 0; number < pass.num_loops; number++)
+		{
+			if(!mark_loop(&pass, number))
+			{
+				break;
+			}
+			if(!collect_defs(&pass, &pass.loops[number]))
+			{
+				break;
+			}
+			remove_null_checks(&pass, &pass.loops[number]);
+			hoist_invariants(&pass, number);
+			reduce_strength(&pass, number);
+			forget_defs(&pass);
+		}
+	}
+
+	forget_defs(&pass);
+	free_loops(&pass);
+}
@@ -52,18 +52,107 @@ extern	"C" {
 #endif
 
 /*
- * Method information block, organised as a red-black tree node.
- * There may be more than one such block associated with a method
- * if the method contains exception regions.
+ * Limit on the size of the huge page region of the cache.
+ */
+#ifndef	JIT_CACHE_MAX_REGION_SIZE
+#define	JIT_CACHE_MAX_REGION_SIZE	((jit_nuint) 1 << 31)
+#endif
+
+/*
+ * Tune the initial number of entries in the lookup table.
+ */
+#ifndef	JIT_CACHE_TABLE_SIZE
+#define	JIT_CACHE_TABLE_SIZE		64
+#endif
+
+/*
+ * Tune the number of destroyed functions that are kept in the lookup
+ * table before their memory is actually reclaimed.
+ */
+#ifndef	JIT_CACHE_PURGE_COUNT
+#define	JIT_CACHE_PURGE_COUNT		32
+#endif
+
+/*
+ * Estimated amount of code per instruction.  It is used to pick a free
+ * block that is likely big enough for a function.
+ */
+#ifndef	JIT_CACHE_INSN_SIZE
+#define	JIT_CACHE_INSN_SIZE		(4 * sizeof(void *))
+#endif
+#define	JIT_CACHE_FUNCTION_SIZE		256
+
+/*
+ * Number of size classes of the free blocks.  Class "n" holds the
+ * blocks of 2^n up to 2^(n+1)-1 bytes, and the last class holds all
+ * the larger blocks too.
+ */
+#define	JIT_CACHE_NUM_BINS		32
+
+/*
+ * Where the next function is placed.  A function that does not fit into
+ * the free block it was given is restarted in the current free region,
+ * and only if it does not fit there either a new page is allocated.
+ */
+#define	JIT_CACHE_USE_BLOCK		0	/* Try a free block first */
+#define	JIT_CACHE_USE_REGION		1	/* The block was too small */
+#define	JIT_CACHE_USE_PAGE		2	/* The free region was too small */
+
+/*
+ * Method information block.  There may be more than one such block
+ * associated with a method if it was recompiled.
  */
 typedef struct jit_cache_node *jit_cache_node_t;
 struct jit_cache_node
 {
-	jit_cache_node_t	left;		/* Left sub-tree and red/black bit */
-	jit_cache_node_t	right;		/* Right sub-tree */
 	unsigned char		*start;		/* Start of the cache region */
 	unsigned char		*end;		/* End of the cache region */
-	jit_function_t		func;		/* Function info block slot */
+	unsigned char		*data;		/* Start of the method data */
+	unsigned char		*data_end;	/* End of the method data */
+	jit_function_t volatile	func;		/* Function info block slot */
+	jit_cache_node_t	next;		/* Next block of the same method */
+};
+
+/*
+ * Lookup table of method information blocks sorted by address.
+ */
+typedef struct jit_cache_table *jit_cache_table_t;
+struct jit_cache_table
+{
+	jit_cache_table_t	next;		/* Next table in the retired list */
+	unsigned long volatile	count;		/* Number of nodes in the table */
+	unsigned long		size;		/* Maximum number of nodes */
+	jit_cache_node_t	nodes[1];	/* Nodes sorted by start address */
+};
+
+/*
+ * Function structure together with the cache information.
+ */
+typedef struct jit_cache_function *jit_cache_function_t;
+struct jit_cache_function
+{
+	struct _jit_function	func;		/* Must be the first field */
+	jit_cache_node_t	nodes;		/* Method blocks of the function */
+};
+
+/*
+ * Free block of the cache memory.  Free blocks are kept in a list
+ * sorted by address, so that adjacent blocks can be merged, and in
+ * a list for their size class, so that a block of the right size is
+ * found without looking at all of them.  The list entries are not
+ * stored in the free blocks themselves so the pages are not touched
+ * until they are reused.
+ */
+typedef struct jit_cache_block *jit_cache_block_t;
+struct jit_cache_block
+{
+	jit_cache_block_t	next;		/* Next free block by address */
+	jit_cache_block_t	prev;		/* Previous free block by address */
+	jit_cache_block_t	next_in_bin;	/* Next block of the size class */
+	jit_cache_block_t	prev_in_bin;	/* Previous block of the size class */
+	unsigned char		*start;		/* Start of the free block */
+	unsigned char		*end;		/* End of the free block */
+	unsigned char		*page;		/* Page that contains the block */
 };
 
 /*
@@ -87,40 +176,77 @@ struct jit_cache
 	unsigned long		pageSize;	/* Default size of a page for allocation */
 	unsigned int		maxPageFactor;	/* Maximum page size factor */
 	long			pagesLeft;	/* Number of pages left to allocate */
+	unsigned long		releasedSize;	/* Size of the pages given back to the system */
+	unsigned char		*region;	/* Huge page region that pages are taken from */
+	unsigned long		regionSize;	/* Size of the huge page region */
+	unsigned long		regionUsed;	/* Size of the part of the region in pages */
 	unsigned char		*free_start;	/* Current start of the free region */
 	unsigned char		*free_end;	/* Current end of the free region */
 	unsigned char		*prev_start;	/* Previous start of the free region */
 	unsigned char		*prev_end;	/* Previous end of the free region */
+	unsigned char		*saved_start;	/* Free region saved while a free block is used */
+	unsigned char		*saved_end;	/* End of the saved free region */
 	jit_cache_node_t	node;		/* Information for the current function */
-	struct jit_cache_node	head;		/* Head of the lookup tree */
-	struct jit_cache_node	nil;		/* Nil pointer for the lookup tree */
+	jit_cache_block_t	block;		/* Free block used for the current function */
+	jit_cache_block_t	free_list;	/* Free blocks sorted by address */
+	jit_cache_block_t	bins[JIT_CACHE_NUM_BINS]; /* Free blocks by size class */
+	int			placement;	/* Where the next function is placed */
+	jit_cache_node_t	dead;		/* Nodes of destroyed functions */
+	unsigned long		numDead;	/* Number of nodes of destroyed functions */
+	jit_cache_node_t	retired_nodes;	/* Old nodes that may be in use */
+	jit_cache_table_t volatile table;	/* Current lookup table */
+	jit_cache_table_t	retired;	/* Old tables that may be in use */
 };
 
+void _jit_cache_destroy(jit_cache_t cache);
+void * _jit_cache_alloc_data(jit_cache_t cache, unsigned long size, unsigned long align);
+static void FreeBlock(jit_cache_t cache, unsigned char *start, unsigned char *end);
+
 /*
- * Get or set the sub-trees of a node.
+ * Determine if the memory at "ptr" is in the huge page region.
  */
-#define	GetLeft(node)	\
-	((jit_cache_node_t)(((jit_nuint)(node)->left) & ~((jit_nuint)1)))
-#define	GetRight(node)	\
-	((node)->right)
-#define	SetLeft(node,value)	\
-	((node)->left = (jit_cache_node_t)(((jit_nuint)value) | \
-						(((jit_nuint)(node)->left) & ((jit_nuint)1))))
-#define	SetRight(node,value)	\
-	((node)->right = (value))
+#define	IsInRegion(cache, ptr)	\
+	((cache)->region && (unsigned char *) (ptr) >= (cache)->region \
+	 && (unsigned char *) (ptr) < (cache)->region + (cache)->regionSize)
 
 /*
- * Get or set the red/black state of a node.
+ * Get the memory for a cache page.  It is taken from the huge page
+ * region while there is room left in it.
  */
-#define	GetRed(node)	\
-	((((jit_nuint)((node)->left)) & ((jit_nuint)1)) != 0)
-#define	SetRed(node)	\
-	((node)->left = (jit_cache_node_t)(((jit_nuint)(node)->left) | ((jit_nuint)1)))
-#define	SetBlack(node)	\
-	((node)->left = (jit_cache_node_t)(((jit_nuint)(node)->left) & ~((jit_nuint)1)))
+static unsigned char *
+AllocPageMemory(jit_cache_t cache, unsigned long size)
+{
+	unsigned char *ptr;
 
-void _jit_cache_destroy(jit_cache_t cache);
-void * _jit_cache_alloc_data(jit_cache_t cache, unsigned long size, unsigned long align);
+	if(cache->region && size <= cache->regionSize - cache->regionUsed)
+	{
+		ptr = cache->region + cache->regionUsed;
+		cache->regionUsed += size;
+		return ptr;
+	}
+	return (unsigned char *) _jit_malloc_exec((unsigned int) size);
+}
+
+/*
+ * Give back the memory of a cache page.  A page in the huge page region
+ * can only be given back if it is the last one taken from the region.
+ * Returns zero if the page has to stay.
+ */
+static int
+FreePageMemory(jit_cache_t cache, unsigned char *ptr, unsigned long size)
+{
+	if(IsInRegion(cache, ptr))
+	{
+		if(ptr + size != cache->region + cache->regionUsed)
+		{
+			return 0;
+		}
+		cache->regionUsed -= size;
+		return 1;
+	}
+	_jit_free_exec(ptr, size);
+	return 1;
+}
 
 /*
  * Allocate a cache page and add it to the cache.
@@ -132,6 +258,14 @@ AllocCachePage(jit_cache_t cache, int factor)
 	unsigned char *ptr;
 	struct jit_cache_page *list;
 
+	/* The rest of the current page becomes a free block */
+	if(cache->free_start && cache->free_start < cache->free_end)
+	{
+		FreeBlock(cache, cache->free_start, cache->free_end);
+	}
+	cache->free_start = 0;
+	cache->free_end = 0;
+
 	/* The minimum page factor is 1 */
 	if(factor <= 0)
 	{
@@ -151,7 +285,7 @@ AllocCachePage(jit_cache_t cache, int factor)
 	}
 
 	/* Try to allocate a physical page */
-	ptr = (unsigned char *) _jit_malloc_exec((unsigned int) cache->pageSize * factor);
+	ptr = AllocPageMemory(cache, cache->pageSize * factor);
 	if(!ptr)
 	{
 		goto failAlloc;
@@ -181,7 +315,7 @@ AllocCachePage(jit_cache_t cache, int factor)
 							     sizeof(struct jit_cache_page) * num);
 		if(!list)
 		{
-			_jit_free_exec(ptr, cache->pageSize * factor);
+			FreePageMemory(cache, ptr, cache->pageSize * factor);
 		failAlloc:
 			cache->free_start = 0;
 			cache->free_end = 0;
@@ -207,160 +341,510 @@ AllocCachePage(jit_cache_t cache, int factor)
 }
 
 /*
- * Compare a key against a node, being careful of sentinel nodes.
+ * Find the page that contains the specified address.
+ */
+static long
+FindCachePage(jit_cache_t cache, unsigned char *ptr)
+{
+	unsigned long page;
+	unsigned char *start;
+
+	for(page = 0; page < cache->numPages; ++page)
+	{
+		start = (unsigned char *) cache->pages[page].page;
+		if(ptr >= start && ptr < start + cache->pageSize * cache->pages[page].factor)
+		{
+			return (long) page;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Give a page back to the system if the given free block covers
+ * all of it.  Returns non-zero if the page was freed.
  */
 static int
-CacheCompare(jit_cache_t cache, unsigned char *key, jit_cache_node_t node)
+ReleaseCachePage(jit_cache_t cache, jit_cache_block_t block)
 {
-	if(node == &cache->nil || node == &cache->head)
+	long page;
+	unsigned long size;
+
+	/* The page that holds the current free region stays */
+	if(cache->free_start >= block->page && cache->free_start < block->end)
 	{
-		/* Every key is greater than the sentinel nodes */
-		return 1;
+		return 0;
+	}
+	if(cache->saved_start >= block->page && cache->saved_start < block->end)
+	{
+		return 0;
+	}
+
+	page = FindCachePage(cache, block->page);
+	if(page < 0)
+	{
+		return 0;
+	}
+	size = cache->pageSize * cache->pages[page].factor;
+	if(block->start != block->page || block->end != block->page + size)
+	{
+		return 0;
+	}
+
+	/* The pages of the huge page region stay mapped, so they are kept
+	   as free blocks for the functions that come later */
+	if(IsInRegion(cache, block->page))
+	{
+		return 0;
+	}
+
+	_jit_free_exec(block->page, size);
+	if(cache->pagesLeft >= 0)
+	{
+		cache->pagesLeft += cache->pages[page].factor;
+	}
+	cache->releasedSize += size;
+	--(cache->numPages);
+	jit_memmove(cache->pages + page, cache->pages + page + 1,
+		    (cache->numPages - page) * sizeof(struct jit_cache_page));
+	return 1;
+}
+
+/*
+ * Get the size class of a free block of the given size.
+ */
+static int
+GetBin(unsigned long size)
+{
+	int bin = 0;
+
+	while(bin < JIT_CACHE_NUM_BINS - 1 && (size >> (bin + 1)) != 0)
+	{
+		++bin;
+	}
+	return bin;
+}
+
+/*
+ * Add a free block to the list of its size class.
+ */
+static void
+AddToBin(jit_cache_t cache, jit_cache_block_t block)
+{
+	int bin = GetBin(block->end - block->start);
+
+	block->prev_in_bin = 0;
+	block->next_in_bin = cache->bins[bin];
+	if(block->next_in_bin)
+	{
+		block->next_in_bin->prev_in_bin = block;
+	}
+	cache->bins[bin] = block;
+}
+
+/*
+ * Remove a free block from the list of its size class.  The size
+ * must not have changed since the block was added to the list.
+ */
+static void
+RemoveFromBin(jit_cache_t cache, jit_cache_block_t block)
+{
+	if(block->prev_in_bin)
+	{
+		block->prev_in_bin->next_in_bin = block->next_in_bin;
+	}
+	else
+	{
+		cache->bins[GetBin(block->end - block->start)] = block->next_in_bin;
+	}
+	if(block->next_in_bin)
+	{
+		block->next_in_bin->prev_in_bin = block->prev_in_bin;
+	}
+}
+
+/*
+ * Remove a free block from the list sorted by address.
+ */
+static void
+UnlinkBlock(jit_cache_t cache, jit_cache_block_t block)
+{
+	if(block->prev)
+	{
+		block->prev->next = block->next;
+	}
+	else
+	{
+		cache->free_list = block->next;
+	}
+	if(block->next)
+	{
+		block->next->prev = block->prev;
+	}
+}
+
+/*
+ * Add a block of memory to the free list and merge it with adjacent
+ * free blocks on the same page.
+ */
+static void
+FreeBlock(jit_cache_t cache, unsigned char *start, unsigned char *end)
+{
+	jit_cache_block_t prev, next, block;
+	long page;
+
+	if(start >= end)
+	{
+		return;
+	}
+
+	/* Find the position in the list */
+	prev = 0;
+	next = cache->free_list;
+	while(next && next->start < start)
+	{
+		prev = next;
+		next = next->next;
+	}
+
+	page = FindCachePage(cache, start);
+	if(page < 0)
+	{
+		return;
+	}
+
+	/* Merge with the previous and the next blocks if possible.  The
+	   size class of the merged block is found again at the end */
+	if(prev && prev->end == start && prev->page == cache->pages[page].page)
+	{
+		block = prev;
+		RemoveFromBin(cache, block);
+		block->end = end;
 	}
 	else
 	{
-		/* Compare a regular node */
-		if(key < node->start)
+		block = jit_new(struct jit_cache_block);
+		if(!block)
 		{
-			return -1;
+			/* The memory is lost until the cache is destroyed */
+			return;
 		}
-		else if(key > node->start)
+		block->start = start;
+		block->end = end;
+		block->page = (unsigned char *) cache->pages[page].page;
+		block->prev = prev;
+		block->next = next;
+		if(prev)
 		{
-			return 1;
+			prev->next = block;
 		}
 		else
 		{
-			return 0;
+			cache->free_list = block;
+		}
+		if(next)
+		{
+			next->prev = block;
 		}
 	}
+	if(next && next->start == block->end && next->page == block->page)
+	{
+		RemoveFromBin(cache, next);
+		UnlinkBlock(cache, next);
+		block->end = next->end;
+		jit_free(next);
+	}
+
+	/* Give the page back if nothing uses it anymore */
+	if(ReleaseCachePage(cache, block))
+	{
+		UnlinkBlock(cache, block);
+		jit_free(block);
+		return;
+	}
+	AddToBin(cache, block);
 }
 
 /*
- * Rotate a sub-tree around a specific node.
+ * Find the smallest free block that can hold the requested amount
+ * of memory and remove it from the free list.  The size classes that
+ * are too small are skipped, and the first class with a block that
+ * fits has the smallest one.
  */
-static jit_cache_node_t
-CacheRotate(jit_cache_t cache, unsigned char *key, jit_cache_node_t around)
+static jit_cache_block_t
+TakeBlock(jit_cache_t cache, unsigned long size, unsigned long align)
 {
-	jit_cache_node_t child, grandChild;
-	int setOnLeft;
-	if(CacheCompare(cache, key, around) < 0)
+	jit_cache_block_t block, best;
+	unsigned char *ptr;
+	int bin;
+
+	for(bin = GetBin(size); bin < JIT_CACHE_NUM_BINS; ++bin)
 	{
-		child = GetLeft(around);
-		setOnLeft = 1;
+		best = 0;
+		for(block = cache->bins[bin]; block; block = block->next_in_bin)
+		{
+			ptr = (unsigned char *) (((jit_nuint) block->start + align - 1) & ~((jit_nuint) align - 1));
+			if(ptr + size <= block->end
+			   && (!best || (block->end - block->start) < (best->end - best->start)))
+			{
+				best = block;
+			}
+		}
+		if(best)
+		{
+			RemoveFromBin(cache, best);
+			UnlinkBlock(cache, best);
+			return best;
+		}
 	}
-	else
+	return 0;
+}
+
+/*
+ * Allocate memory from the free blocks.  Returns NULL if there
+ * is no free block big enough.
+ */
+static void *
+AllocFromBlock(jit_cache_t cache, unsigned long size, unsigned long align)
+{
+	jit_cache_block_t block;
+	unsigned char *ptr;
+
+	block = TakeBlock(cache, size, align);
+	if(!block)
 	{
-		child = GetRight(around);
-		setOnLeft = 0;
+		return 0;
 	}
-	if(CacheCompare(cache, key, child) < 0)
+
+	/* Give back the parts of the block that are not used */
+	ptr = (unsigned char *) (((jit_nuint) block->start + align - 1) & ~((jit_nuint) align - 1));
+	FreeBlock(cache, block->start, ptr);
+	FreeBlock(cache, ptr + size, block->end);
+	jit_free(block);
+
+	return ptr;
+}
+
+/*
+ * Estimate the amount of memory needed for a function.
+ */
+static unsigned long
+EstimateFunctionSize(jit_function_t func)
+{
+	jit_block_t block;
+	unsigned long size;
+
+	size = JIT_CACHE_FUNCTION_SIZE;
+	if(func->builder)
 	{
-		grandChild = GetLeft(child);
-		SetLeft(child, GetRight(grandChild));
-		SetRight(grandChild, child);
+		for(block = func->builder->entry_block; block; block = block->next)
+		{
+			size += block->num_insns * JIT_CACHE_INSN_SIZE;
+		}
 	}
-	else
+	return size;
+}
+
+/*
+ * Free the retired lookup tables and nodes that are not in the hazard
+ * pointers of a thread.  The others are kept for the next time, so there
+ * are at most two of them for each thread that looks up functions.
+ */
+static void
+FreeRetiredTables(jit_cache_t cache)
+{
+	jit_cache_table_t table, *prev_table;
+	jit_cache_node_t node, *prev_node;
+
+	prev_table = &cache->retired;
+	while((table = *prev_table) != 0)
 	{
-		grandChild = GetRight(child);
-		SetRight(child, GetLeft(grandChild));
-		SetLeft(grandChild, child);
+		if(_jit_thread_is_hazard(table))
+		{
+			prev_table = &table->next;
+		}
+		else
+		{
+			*prev_table = table->next;
+			jit_free(table);
+		}
 	}
-	if(setOnLeft)
+	prev_node = &cache->retired_nodes;
+	while((node = *prev_node) != 0)
 	{
-		SetLeft(around, grandChild);
+		if(_jit_thread_is_hazard(node))
+		{
+			prev_node = &node->next;
+		}
+		else
+		{
+			*prev_node = node->next;
+			jit_free(node);
+		}
 	}
-	else
+}
+
+/*
+ * Make a new lookup table with room for the given number of nodes.
+ */
+static jit_cache_table_t
+NewLookupTable(unsigned long size)
+{
+	jit_cache_table_t table;
+
+	table = (jit_cache_table_t) jit_malloc(sizeof(struct jit_cache_table)
+					       + (size - 1) * sizeof(jit_cache_node_t));
+	if(table)
 	{
-		SetRight(around, grandChild);
+		table->next = 0;
+		table->count = 0;
+		table->size = size;
 	}
-	return grandChild;
+	return table;
 }
 
 /*
- * Split a red-black tree at the current position.
+ * Publish a new lookup table and retire the old one.
  */
-#define	Split()								\
-	do {								\
-		SetRed(temp);						\
-		SetBlack(GetLeft(temp));				\
-		SetBlack(GetRight(temp));				\
-		if(GetRed(parent))					\
-		{							\
-			SetRed(grandParent);				\
-			if((CacheCompare(cache, key, grandParent) < 0) != \
-			   (CacheCompare(cache, key, parent) < 0))	\
-			{						\
-				parent = CacheRotate(cache, key, grandParent); \
-			}						\
-			temp = CacheRotate(cache, key, greatGrandParent); \
-			SetBlack(temp);					\
-		}							\
-	} while (0)
+static void
+PublishLookupTable(jit_cache_t cache, jit_cache_table_t copy)
+{
+	jit_cache_table_t table = cache->table;
+
+	jit_memory_barrier();
+	cache->table = copy;
+	if(table)
+	{
+		table->next = cache->retired;
+		cache->retired = table;
+	}
+	FreeRetiredTables(cache);
+}
 
 /*
- * Add a method region block to the red-black lookup tree
- * that is associated with a method cache.
+ * Add a method region block to the lookup table that is associated
+ * with a method cache.  The table is never changed in a way that can
+ * confuse concurrent lookups.  A node is either appended in place or
+ * the table is copied and the new copy is published.  Returns zero
+ * if out of memory.
  */
-static void
-AddToLookupTree(jit_cache_t cache, jit_cache_node_t method)
+static int
+AddToLookupTable(jit_cache_t cache, jit_cache_node_t method)
 {
-	unsigned char *key = method->start;
-	jit_cache_node_t temp;
-	jit_cache_node_t greatGrandParent;
-	jit_cache_node_t grandParent;
-	jit_cache_node_t parent;
-	jit_cache_node_t nil = &(cache->nil);
-	int cmp;
-
-	/* Search for the insert position */
-	temp = &(cache->head);
-	greatGrandParent = temp;
-	grandParent = temp;
-	parent = temp;
-	while(temp != nil)
-	{
-		/* Adjust our ancestor pointers */
-		greatGrandParent = grandParent;
-		grandParent = parent;
-		parent = temp;
-
-		/* Compare the key against the current node */
-		cmp = CacheCompare(cache, key, temp);
-		if(cmp == 0)
+	jit_cache_table_t table = cache->table;
+	jit_cache_table_t copy;
+	unsigned long count, size, low, high, middle;
+
+	/* Code is mostly allocated at increasing addresses, so usually
+	   the node just goes to the end of the table */
+	count = table ? table->count : 0;
+	if(table && count < table->size
+	   && (count == 0 || table->nodes[count - 1]->start < method->start))
+	{
+		table->nodes[count] = method;
+		jit_memory_barrier();
+		table->count = count + 1;
+		return 1;
+	}
+
+	/* Find the insert position */
+	low = 0;
+	high = count;
+	while(low < high)
+	{
+		middle = low + (high - low) / 2;
+		if(method->start < table->nodes[middle]->start)
 		{
-			/* This is a duplicate, which normally shouldn't happen.
-			   If it does happen, then ignore the node and bail out */
-			return;
+			high = middle;
 		}
-		else if(cmp < 0)
+		else if(method->start > table->nodes[middle]->start)
 		{
-			temp = GetLeft(temp);
+			low = middle + 1;
 		}
 		else
 		{
-			temp = GetRight(temp);
+			/* This is a duplicate, which normally shouldn't happen.
+			   If it does happen, then ignore the node and bail out */
+			return 1;
 		}
+	}
 
-		/* Do we need to split this node? */
-		if(GetRed(GetLeft(temp)) && GetRed(GetRight(temp)))
-		{
-			Split();
-		}
+	/* Make a new copy of the table with the node inserted */
+	size = table ? table->size : JIT_CACHE_TABLE_SIZE;
+	if(count >= size)
+	{
+		size *= 2;
+	}
+	copy = NewLookupTable(size);
+	if(!copy)
+	{
+		return 0;
+	}
+	if(low > 0)
+	{
+		jit_memcpy(copy->nodes, table->nodes, low * sizeof(jit_cache_node_t));
+	}
+	copy->nodes[low] = method;
+	if(low < count)
+	{
+		jit_memcpy(copy->nodes + low + 1, table->nodes + low,
+			   (count - low) * sizeof(jit_cache_node_t));
+	}
+	copy->count = count + 1;
+
+	PublishLookupTable(cache, copy);
+	return 1;
+}
+
+/*
+ * Remove the nodes of destroyed functions from the lookup table and
+ * reclaim their memory.  Until then the nodes stay in the table so
+ * that their address ranges are not reused while the table still
+ * refers to them.
+ */
+static void
+PurgeDeadNodes(jit_cache_t cache)
+{
+	jit_cache_table_t table = cache->table;
+	jit_cache_table_t copy;
+	jit_cache_node_t node;
+	unsigned long index;
+
+	if(!cache->dead)
+	{
+		return;
 	}
 
-	/* Insert the new node into the current position */
-	method->left = (jit_cache_node_t)(((jit_nuint)nil) | ((jit_nuint)1));
-	method->right = nil;
-	if(CacheCompare(cache, key, parent) < 0)
+	/* Make a new copy of the table without the dead nodes */
+	if(table)
 	{
-		SetLeft(parent, method);
+		copy = NewLookupTable(table->size);
+		if(!copy)
+		{
+			return;
+		}
+		for(index = 0; index < table->count; ++index)
+		{
+			if(table->nodes[index]->func)
+			{
+				copy->nodes[copy->count++] = table->nodes[index];
+			}
+		}
+		PublishLookupTable(cache, copy);
 	}
-	else
+
+	/* Now the memory of the dead nodes can be used again */
+	while(cache->dead)
 	{
-		SetRight(parent, method);
+		node = cache->dead;
+		cache->dead = node->next;
+		FreeBlock(cache, node->start, node->end);
+		FreeBlock(cache, node->data, node->data_end);
+		node->next = cache->retired_nodes;
+		cache->retired_nodes = node;
 	}
-	Split();
-	SetBlack(cache->head.right);
+	cache->numDead = 0;
+	FreeRetiredTables(cache);
 }
 
 jit_cache_t
@@ -369,7 +853,8 @@ _jit_cache_create(jit_context_t context)
 	jit_cache_t cache;
 	long limit, cache_page_size;
 	int max_page_factor;
-	unsigned long exec_page_size;
+	unsigned long exec_page_size, huge_page_size;
+	jit_nuint region_size;
 
 	limit = (long)
 		jit_context_get_meta_numeric(context, JIT_OPTION_CACHE_LIMIT);
@@ -377,9 +862,10 @@ _jit_cache_create(jit_context_t context)
 		jit_context_get_meta_numeric(context, JIT_OPTION_CACHE_PAGE_SIZE);
 	max_page_factor = (int)
 		jit_context_get_meta_numeric(context, JIT_OPTION_CACHE_MAX_PAGE_FACTOR);
+	region_size = jit_context_get_meta_numeric(context, JIT_OPTION_CACHE_HUGE_PAGES);
 
 	/* Allocate space for the cache control structure */
-	if((cache = (jit_cache_t) jit_malloc(sizeof(struct jit_cache))) == 0)
+	if((cache = (jit_cache_t) jit_cnew(struct jit_cache)) == 0)
 	{
 		return 0;
 	}
@@ -405,14 +891,9 @@ _jit_cache_create(jit_context_t context)
 		max_page_factor = JIT_CACHE_MAX_PAGE_FACTOR;
 	}
 
-	/* Initialize the rest of the cache fields */
-	cache->pages = 0;
-	cache->numPages = 0;
-	cache->maxNumPages = 0;
+	/* Initialize the rest of the cache fields, the others are zero */
 	cache->pageSize = cache_page_size;
 	cache->maxPageFactor = max_page_factor;
-	cache->free_start = 0;
-	cache->free_end = 0;
 	if(limit > 0)
 	{
 		cache->pagesLeft = limit / cache_page_size;
@@ -425,13 +906,24 @@ _jit_cache_create(jit_context_t context)
 	{
 		cache->pagesLeft = -1;
 	}
-	cache->node = 0;
-	cache->nil.left = &(cache->nil);
-	cache->nil.right = &(cache->nil);
-	cache->nil.func = 0;
-	cache->head.left = 0;
-	cache->head.right = &(cache->nil);
-	cache->head.func = 0;
+
+	/* Reserve the huge page region if asked to.  The cache falls back
+	   to normal pages if the region cannot be had */
+	if(region_size > 0)
+	{
+		huge_page_size = jit_vmem_huge_page_size();
+		region_size = (region_size + huge_page_size - 1) / huge_page_size * huge_page_size;
+		if(region_size <= JIT_CACHE_MAX_REGION_SIZE)
+		{
+			cache->region = (unsigned char *)
+				jit_vmem_reserve_huge((jit_uint) region_size,
+						      JIT_PROT_EXEC_READ_WRITE);
+		}
+		if(cache->region)
+		{
+			cache->regionSize = region_size;
+		}
+	}
 
 	/* Allocate the initial cache page */
 	AllocCachePage(cache, 0);
@@ -449,17 +941,63 @@ void
 _jit_cache_destroy(jit_cache_t cache)
 {
 	unsigned long page;
+	jit_cache_block_t block;
+	jit_cache_table_t table;
+	jit_cache_node_t node;
+	unsigned long index;
 
 	/* Free all of the cache pages */
 	for(page = 0; page < cache->numPages; ++page)
 	{
-		_jit_free_exec(cache->pages[page].page,
-			       cache->pageSize * cache->pages[page].factor);
+		if(!IsInRegion(cache, cache->pages[page].page))
+		{
+			_jit_free_exec(cache->pages[page].page,
+				       cache->pageSize * cache->pages[page].factor);
+		}
 	}
 	if(cache->pages)
 	{
 		jit_free(cache->pages);
 	}
+	if(cache->region)
+	{
+		jit_vmem_release(cache->region, cache->regionSize);
+	}
+
+	/* Free the free list */
+	while(cache->free_list)
+	{
+		block = cache->free_list;
+		cache->free_list = block->next;
+		jit_free(block);
+	}
+
+	/* Free the nodes and the lookup tables.  The dead nodes are in the
+	   table too, the nodes of the live functions are only there.  No
+	   lookups may be in progress, so the hazard pointers are stale */
+	cache->dead = 0;
+	if(cache->table)
+	{
+		for(index = 0; index < cache->table->count; ++index)
+		{
+			node = cache->table->nodes[index];
+			node->next = cache->retired_nodes;
+			cache->retired_nodes = node;
+		}
+		jit_free(cache->table);
+	}
+	while(cache->retired)
+	{
+		table = cache->retired;
+		cache->retired = table->next;
+		jit_free(table);
+	}
+	while(cache->retired_nodes)
+	{
+		node = cache->retired_nodes;
+		cache->retired_nodes = node->next;
+		jit_free(node);
+	}
 
 	/* Free the cache object itself */
 	jit_free(cache);
@@ -471,20 +1009,30 @@ _jit_cache_extend(jit_cache_t cache, int count)
 	/* Compute the page size factor */
 	int factor = 1 << count;
 
+	struct jit_cache_page *p;
+
 	/* Bail out if there is a started function */
 	if(cache->node)
 	{
 		return JIT_MEMORY_ERROR;
 	}
 
+	/* If the function did not fit into a free block then first
+	   try the current free region */
+	if(cache->placement == JIT_CACHE_USE_REGION)
+	{
+		cache->placement = JIT_CACHE_USE_PAGE;
+		return JIT_MEMORY_OK;
+	}
+
 	/* If we had a newly allocated page then it has to be freed
 	   to let allocate another new page of appropriate size. */
-	struct jit_cache_page *p = &cache->pages[cache->numPages - 1];
-	if((cache->free_start == ((unsigned char *)p->page))
-	   && (cache->free_end == (cache->free_start + cache->pageSize * p->factor)))
+	p = cache->numPages > 0 ? &cache->pages[cache->numPages - 1] : 0;
+	if(p
+	   && (cache->free_start == ((unsigned char *)p->page))
+	   && (cache->free_end == (cache->free_start + cache->pageSize * p->factor))
+	   && FreePageMemory(cache, p->page, cache->pageSize * p->factor))
 	{
-		_jit_free_exec(p->page, cache->pageSize * p->factor);
-
 		--(cache->numPages);
 		if(cache->pagesLeft >= 0)
 		{
@@ -511,13 +1059,40 @@ _jit_cache_extend(jit_cache_t cache, int count)
 jit_function_t
 _jit_cache_alloc_function(jit_cache_t cache)
 {
-	return jit_cnew(struct _jit_function);
+	jit_cache_function_t function;
+
+	function = jit_cnew(struct jit_cache_function);
+	if(!function)
+	{
+		return 0;
+	}
+	return &function->func;
 }
 
 void
 _jit_cache_free_function(jit_cache_t cache, jit_function_t func)
 {
-	jit_free(func);
+	jit_cache_function_t function = (jit_cache_function_t) func;
+	jit_cache_node_t node;
+
+	/* Lookups no longer find the function.  Its memory is reclaimed
+	   together with the other destroyed functions later */
+	while(function->nodes)
+	{
+		node = function->nodes;
+		function->nodes = node->next;
+		node->func = 0;
+		node->next = cache->dead;
+		cache->dead = node;
+		++(cache->numDead);
+	}
+	if(cache->numDead >= JIT_CACHE_PURGE_COUNT
+	   && (!cache->table || cache->numDead * 4 >= cache->table->count))
+	{
+		PurgeDeadNodes(cache);
+	}
+
+	jit_free(function);
 }
 
 int
@@ -528,6 +1103,22 @@ _jit_cache_start_function(jit_cache_t cache, jit_function_t func)
 	{
 		return JIT_MEMORY_ERROR;
 	}
+
+	/* Reuse a free block if there is one that looks big enough.  If it
+	   turns out to be too small then the function goes to the end of
+	   the cache on restart */
+	if(cache->placement == JIT_CACHE_USE_BLOCK)
+	{
+		cache->block = TakeBlock(cache, EstimateFunctionSize(func), 1);
+		if(cache->block)
+		{
+			cache->saved_start = cache->free_start;
+			cache->saved_end = cache->free_end;
+			cache->free_start = cache->block->start;
+			cache->free_end = cache->block->end;
+		}
+	}
+
 	/* Bail out if the cache is already full */
 	if(!cache->free_start)
 	{
@@ -539,19 +1130,25 @@ _jit_cache_start_function(jit_cache_t cache, jit_function_t func)
 	cache->prev_end = cache->free_end;
 
 	/* Allocate a new cache node */
-	cache->node = _jit_cache_alloc_data(
-		cache, sizeof(struct jit_cache_node), sizeof(void *));
+	cache->node = jit_cnew(struct jit_cache_node);
 	if(!cache->node)
 	{
-		return JIT_MEMORY_RESTART;
+		if(cache->block)
+		{
+			FreeBlock(cache, cache->block->start, cache->block->end);
+			jit_free(cache->block);
+			cache->block = 0;
+			cache->free_start = cache->saved_start;
+			cache->free_end = cache->saved_end;
+			cache->saved_start = 0;
+			cache->saved_end = 0;
+		}
+		return JIT_MEMORY_ERROR;
 	}
 	cache->node->func = func;
 
 	/* Initialize the function information */
 	cache->node->start = cache->free_start;
-	cache->node->end = 0;
-	cache->node->left = 0;
-	cache->node->right = 0;
 
 	return JIT_MEMORY_OK;
 }
@@ -559,27 +1156,66 @@ _jit_cache_start_function(jit_cache_t cache, jit_function_t func)
 int
 _jit_cache_end_function(jit_cache_t cache, int result)
 {
+	jit_cache_function_t function;
+	jit_cache_block_t block;
+	jit_cache_node_t node;
+
 	/* Bail out if there is no started function */
 	if(!cache->node)
 	{
 		return JIT_MEMORY_ERROR;
 	}
+	node = cache->node;
+	cache->node = 0;
+	block = cache->block;
+	cache->block = 0;
 
-	/* Determine if we ran out of space while writing the function */
-	if(result != JIT_MEMORY_OK)
+	/* Update the method region block */
+	node->end = cache->free_start;
+	node->data = cache->free_end;
+	node->data_end = cache->prev_end;
+
+	/* Determine if we ran out of space while writing the function
+	   or could not add it to the lookup table */
+	if(result != JIT_MEMORY_OK || !AddToLookupTable(cache, node))
 	{
 		/* Restore the saved cache position */
-		cache->free_start = cache->prev_start;
-		cache->free_end = cache->prev_end;
-		cache->node = 0;
+		if(block)
+		{
+			FreeBlock(cache, block->start, block->end);
+			jit_free(block);
+			cache->free_start = cache->saved_start;
+			cache->free_end = cache->saved_end;
+			cache->saved_start = 0;
+			cache->saved_end = 0;
+			cache->placement = JIT_CACHE_USE_REGION;
+		}
+		else
+		{
+			cache->free_start = cache->prev_start;
+			cache->free_end = cache->prev_end;
+		}
+		jit_free(node);
 
-		return JIT_MEMORY_RESTART;
+		return (result != JIT_MEMORY_OK) ? JIT_MEMORY_RESTART : JIT_MEMORY_ERROR;
 	}
 
-	/* Update the method region block and then add it to the lookup tree */
-	cache->node->end = cache->free_start;
-	AddToLookupTree(cache, cache->node);
-	cache->node = 0;
+	/* Give back the rest of the free block */
+	if(block)
+	{
+		FreeBlock(cache, cache->free_start, cache->free_end);
+		jit_free(block);
+		cache->free_start = cache->saved_start;
+		cache->free_end = cache->saved_end;
+		cache->saved_start = 0;
+		cache->saved_end = 0;
+	}
+	cache->placement = JIT_CACHE_USE_BLOCK;
+
+	/* Remember the node so that it can be freed with the function */
+	function = (jit_cache_function_t) node->func;
+	node->next = function->nodes;
+	function->nodes = node;
 
 	/* The method is ready to go */
 	return JIT_MEMORY_OK;
@@ -664,6 +1300,14 @@ alloc_code(jit_cache_t cache, unsigned int size, unsigned int align)
 	{
 		return 0;
 	}
+
+	/* Try to reuse some freed memory first */
+	ptr = AllocFromBlock(cache, size, align);
+	if(ptr)
+	{
+		return ptr;
+	}
+
 	/* Bail out if there is no cache available */
 	if(!cache->free_start)
 	{
@@ -674,7 +1318,7 @@ alloc_code(jit_cache_t cache, unsigned int size, unsigned int align)
 	ptr = cache->free_start;
 	if(align > 1)
 	{
-		jit_nuint p = ((jit_nuint) ptr + align - 1) & ~(align - 1);
+		jit_nuint p = ((jit_nuint) ptr + align - 1) & ~((jit_nuint) align - 1);
 		ptr = (unsigned char *) p;
 	}
 
@@ -694,7 +1338,7 @@ alloc_code(jit_cache_t cache, unsigned int size, unsigned int align)
 		ptr = cache->free_start;
 		if(align > 1)
 		{
-			jit_nuint p = ((jit_nuint) ptr + align - 1) & ~(align - 1);
+			jit_nuint p = ((jit_nuint) ptr + align - 1) & ~((jit_nuint) align - 1);
 			ptr = (unsigned char *) p;
 		}
 	}
@@ -715,7 +1359,11 @@ _jit_cache_alloc_trampoline(jit_cache_t cache)
 void
 _jit_cache_free_trampoline(jit_cache_t cache, void *trampoline)
 {
-	/* not supported yet */
+	if(trampoline)
+	{
+		FreeBlock(cache, (unsigned char *) trampoline,
+			  (unsigned char *) trampoline + jit_get_trampoline_size());
+	}
 }
 
 void *
@@ -729,7 +1377,44 @@ _jit_cache_alloc_closure(jit_cache_t cache)
 void
 _jit_cache_free_closure(jit_cache_t cache, void *closure)
 {
-	/* not supported yet */
+	if(closure)
+	{
+		FreeBlock(cache, (unsigned char *) closure,
+			  (unsigned char *) closure + jit_get_closure_size());
+	}
+}
+
+void
+_jit_cache_get_stats(jit_cache_t cache, jit_memory_stats_t *stats)
+{
+	jit_cache_block_t block;
+	unsigned long page, size;
+
+	/* Reclaim the memory of the destroyed functions first */
+	PurgeDeadNodes(cache);
+
+	stats->total_size = 0;
+	for(page = 0; page < cache->numPages; ++page)
+	{
+		stats->total_size += cache->pageSize * cache->pages[page].factor;
+	}
+
+	stats->free_size = cache->free_end - cache->free_start;
+	stats->free_blocks = stats->free_size ? 1 : 0;
+	stats->largest_free = stats->free_size;
+	for(block = cache->free_list; block; block = block->next)
+	{
+		size = block->end - block->start;
+		stats->free_size += size;
+		++(stats->free_blocks);
+		if(size > stats->largest_free)
+		{
+			stats->largest_free = size;
+		}
+	}
+
+	stats->used_size = stats->total_size - stats->free_size;
+	stats->released_size = cache->releasedSize;
 }
 
 #if 0
@@ -792,23 +1477,67 @@ _jit_cache_alloc_no_method(jit_cache_t cache, unsigned long size, unsigned long
 void *
 _jit_cache_find_function_info(jit_cache_t cache, void *pc)
 {
-	jit_cache_node_t node = cache->head.right;
-	while(node != &(cache->nil))
+	jit_thread_control_t control;
+	jit_cache_table_t table;
+	jit_cache_node_t node;
+	unsigned long low, high, middle;
+
+	/* This does not take the memory lock, and does not write to memory
+	   that other threads write.  The table is published in a hazard
+	   pointer of the thread so that it cannot be freed while it is
+	   searched, and so is the node that is found, which stays valid
+	   until the next lookup of the thread. */
+	control = _jit_thread_get_control();
+	if(!control)
 	{
-		if(((unsigned char *)pc) < node->start)
+		return 0;
+	}
+
+	for(;;)
+	{
+		/* The table may have been retired before the hazard pointer
+		   became visible, so check that it is still the current one */
+		table = cache->table;
+		control->hazard_table = table;
+		jit_memory_barrier();
+		if(table != cache->table)
 		{
-			node = GetLeft(node);
+			continue;
 		}
-		else if(((unsigned char *)pc) >= node->end)
+
+		low = 0;
+		high = table ? table->count : 0;
+		node = 0;
+		while(low < high)
 		{
-			node = GetRight(node);
+			middle = low + (high - low) / 2;
+			if(((unsigned char *)pc) < table->nodes[middle]->start)
+			{
+				high = middle;
+			}
+			else if(((unsigned char *)pc) >= table->nodes[middle]->end)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				node = table->nodes[middle];
+				break;
+			}
 		}
-		else
+
+		/* A node is only retired after a table without it is
+		   published, so the same check works for the node */
+		control->hazard_node = node;
+		jit_memory_barrier();
+		if(table == cache->table)
 		{
-			return node;
+			break;
 		}
 	}
-	return 0;
+
+	control->hazard_table = 0;
+	return node;
 }
 
 jit_function_t
@@ -909,6 +1638,12 @@ jit_default_memory_manager(void)
 	return &mm;
 }
 
+void
+_jit_default_memory_stats(jit_memory_context_t memctx, jit_memory_stats_t *stats)
+{
+	_jit_cache_get_stats((jit_cache_t) memctx, stats);
+}
+
 /*
 
 Using the cache
@@ -994,10 +1729,31 @@ with it.  These blocks indicate the start and end of regions within the
 method.  Normally these regions correspond to exception "try" blocks, or
 regular code between "try" blocks.
 
-The jit_cache_method blocks are organised into a red-black tree, which
+The jit_cache_method blocks are kept in a table sorted by address, which
 is used to perform fast lookups by address (_jit_cache_get_method).  These
 lookups are used when walking the stack during exceptions or security
-processing.
+processing, or by sampling profilers.  They do not take any locks.  A new
+block is appended to the current table in place when it goes to the end
+and there is room for it.  Otherwise a new copy of the table is made and
+published, and the old one is freed once no lookups are in progress.
+
+When a function is destroyed its blocks are marked dead, so that lookups
+do not find it anymore.  Once enough dead blocks have accumulated they
+are removed from the lookup table and their memory goes to the free list.
+The free list is sorted by address and adjacent free blocks on the same
+page are merged.  A page that becomes completely free is given back to
+the system.  Trampolines and closures are allocated from the free list
+with best fit.  A function is compiled into the smallest free block that
+is likely big enough judging by the number of its instructions.  If the
+code does not fit after all the function is compiled again at the end
+of the cache.
+
+With JIT_OPTION_CACHE_HUGE_PAGES the pages are cut one after the other
+from a single region that is reserved up front and backed by huge pages,
+so that the code of many functions takes few iTLB entries.  Pages of the
+region are never given back to the system, their free blocks are reused
+instead.  Once the region is used up the pages come from the system as
+usual.
 
 Each method can also have offset information associated with it, to map
 between native code addresses and offsets within the original bytecode.
@@ -59,28 +59,26 @@ _jit_memory_find_function_info(jit_context_t context, void *pc)
 	{
 		return 0;
 	}
-	/* TODO: read lock? */
+	/* No lock here, the lookups must be safe to run concurrently with
+	   the compilation of new functions, see jit_default_memory_manager */
 	return context->memory_manager->find_function_info(context->memory_context, pc);
 }
 
 jit_function_t
 _jit_memory_get_function(jit_context_t context, jit_function_info_t info)
 {
-	/* TODO: read lock? */
 	return context->memory_manager->get_function(context->memory_context, info);
 }
 
 void *
 _jit_memory_get_function_start(jit_context_t context, jit_function_info_t info)
 {
-	/* TODO: read lock? */
 	return context->memory_manager->get_function_start(context->memory_context, info);
 }
 
 void *
 _jit_memory_get_function_end(jit_context_t context, jit_function_info_t info)
 {
-	/* TODO: read lock? */
 	return context->memory_manager->get_function_end(context->memory_context, info);
 }
 
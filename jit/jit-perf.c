@@ -0,0 +1,368 @@
+/*
+ * jit-perf.c - Support for profiling the generated code with Linux perf.
+ *
+ * Copyright (C) 2026  Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+#include "jit-rules.h"
+#include <stdio.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#ifdef HAVE_TIME_H
+# include <time.h>
+#endif
+#if defined(__linux__)
+# include <sys/syscall.h>
+#endif
+
+/*
+ * With JIT_OPTION_PERF every compiled function is described to perf in
+ * two files that are shared by all the contexts of the process:
+ *
+ * "/tmp/perf-<pid>.map" has a line with the address, size and name of
+ * each function.  "perf report" reads it to name the samples inside
+ * the generated code.
+ *
+ * "/tmp/jit-<pid>.dump" is in the jitdump format.  It has a copy of the
+ * code of each function, and the native addresses of the bytecode
+ * offsets that were marked with "jit_insn_mark_offset", so that
+ * "perf inject --jit" can build an ELF image for every function and
+ * annotate it.  The file is mapped into memory once, which is how
+ * "perf record" notices it.  The offsets are given as line numbers of
+ * a source file that has the name of the function.
+ */
+
+#if defined(__linux__) && !defined(JIT_BACKEND_INTERP) && \
+	defined(HAVE_UNISTD_H) && defined(HAVE_FCNTL_H) && \
+	defined(HAVE_SYS_MMAN_H) && defined(CLOCK_MONOTONIC)
+
+/*
+ * Record types and layout of the jitdump format, version 1.
+ */
+#define JITDUMP_MAGIC		0x4A695444
+#define JITDUMP_VERSION		1
+#define JITDUMP_CODE_LOAD	0
+#define JITDUMP_CODE_DEBUG_INFO	2
+
+typedef struct
+{
+	jit_uint		magic;
+	jit_uint		version;
+	jit_uint		total_size;
+	jit_uint		elf_mach;
+	jit_uint		pad1;
+	jit_uint		pid;
+	jit_ulong		timestamp;
+	jit_ulong		flags;
+
+} jitdump_header_t;
+
+typedef struct
+{
+	jit_uint		id;
+	jit_uint		total_size;
+	jit_ulong		timestamp;
+
+} jitdump_record_t;
+
+typedef struct
+{
+	jitdump_record_t	record;
+	jit_uint		pid;
+	jit_uint		tid;
+	jit_ulong		vma;
+	jit_ulong		code_addr;
+	jit_ulong		code_size;
+	jit_ulong		code_index;
+
+} jitdump_code_load_t;
+
+typedef struct
+{
+	jitdump_record_t	record;
+	jit_ulong		code_addr;
+	jit_ulong		nr_entry;
+
+} jitdump_debug_info_t;
+
+typedef struct
+{
+	jit_ulong		addr;
+	jit_int			lineno;
+	jit_int			discrim;
+
+} jitdump_debug_entry_t;
+
+/*
+ * The files of the process, protected by "_jit_global_lock".  They are
+ * opened again in a child process after "fork".
+ */
+static int perf_pid;
+static FILE *perf_map;
+static FILE *perf_dump;
+static jit_ulong perf_code_index;
+
+static jit_ulong
+get_timestamp(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (jit_ulong) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static FILE *
+open_map(int pid)
+{
+	char path[64];
+
+	sprintf(path, "/tmp/perf-%d.map", pid);
+	return fopen(path, "a");
+}
+
+static FILE *
+open_dump(int pid)
+{
+	char path[64];
+	jitdump_header_t header;
+	jit_elf_info_t elf_info;
+	void *marker;
+	int fd;
+	FILE *file;
+
+	sprintf(path, "/tmp/jit-%d.dump", pid);
+	fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0666);
+	if(fd < 0)
+	{
+		return 0;
+	}
+
+	/* perf finds the file by the executable mapping of its first page */
+	marker = mmap(0, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC,
+		      MAP_PRIVATE, fd, 0);
+	if(marker == MAP_FAILED)
+	{
+		close(fd);
+		return 0;
+	}
+
+	file = fdopen(fd, "w");
+	if(!file)
+	{
+		close(fd);
+		return 0;
+	}
+
+	_jit_gen_get_elf_info(&elf_info);
+	jit_memzero(&header, sizeof(header));
+	header.magic = JITDUMP_MAGIC;
+	header.version = JITDUMP_VERSION;
+	header.total_size = sizeof(header);
+	header.elf_mach = elf_info.machine;
+	header.pid = pid;
+	header.timestamp = get_timestamp();
+	fwrite(&header, sizeof(header), 1, file);
+	fflush(file);
+	return file;
+}
+
+/*
+ * Write the native addresses of the marked bytecode offsets.
+ */
+static void
+write_debug_info(jit_function_t func, const char *name,
+		 unsigned char *code_start, unsigned char *offset_base)
+{
+	jitdump_debug_info_t info;
+	jitdump_debug_entry_t entry;
+	jit_varint_decoder_t decoder;
+	jit_ulong nr_entry;
+	jit_uint offset, native_offset;
+	int name_size;
+
+	if(!func->bytecode_offset)
+	{
+		return;
+	}
+
+	/* Count the entries first */
+	nr_entry = 0;
+	_jit_varint_init_decoder(&decoder, func->bytecode_offset);
+	for(;;)
+	{
+		_jit_varint_decode_uint(&decoder);
+		_jit_varint_decode_uint(&decoder);
+		if(_jit_varint_decode_end(&decoder))
+		{
+			break;
+		}
+		++nr_entry;
+	}
+	if(nr_entry == 0)
+	{
+		return;
+	}
+
+	name_size = jit_strlen(name) + 1;
+	info.record.id = JITDUMP_CODE_DEBUG_INFO;
+	info.record.total_size = sizeof(info)
+		+ nr_entry * (sizeof(entry) + name_size);
+	info.record.timestamp = get_timestamp();
+	info.code_addr = (jit_ulong) (jit_nuint) code_start;
+	info.nr_entry = nr_entry;
+	fwrite(&info, sizeof(info), 1, perf_dump);
+
+	_jit_varint_init_decoder(&decoder, func->bytecode_offset);
+	for(;;)
+	{
+		offset = _jit_varint_decode_uint(&decoder);
+		native_offset = _jit_varint_decode_uint(&decoder);
+		if(_jit_varint_decode_end(&decoder))
+		{
+			break;
+		}
+		entry.addr = (jit_ulong) (jit_nuint) (offset_base + native_offset);
+		entry.lineno = (jit_int) offset;
+		entry.discrim = 0;
+		fwrite(&entry, sizeof(entry), 1, perf_dump);
+		fwrite(name, name_size, 1, perf_dump);
+	}
+}
+
+/*
+ * Write the code of a function.
+ */
+static void
+write_code_load(int pid, const char *name,
+		unsigned char *code_start, unsigned char *code_end)
+{
+	jitdump_code_load_t load;
+	int name_size = jit_strlen(name) + 1;
+
+	load.record.id = JITDUMP_CODE_LOAD;
+	load.record.total_size = sizeof(load) + name_size
+		+ (code_end - code_start);
+	load.record.timestamp = get_timestamp();
+	load.pid = pid;
+#ifdef SYS_gettid
+	load.tid = (jit_uint) syscall(SYS_gettid);
+#else
+	load.tid = pid;
+#endif
+	load.vma = (jit_ulong) (jit_nuint) code_start;
+	load.code_addr = load.vma;
+	load.code_size = code_end - code_start;
+	load.code_index = perf_code_index++;
+	fwrite(&load, sizeof(load), 1, perf_dump);
+	fwrite(name, name_size, 1, perf_dump);
+	fwrite(code_start, code_end - code_start, 1, perf_dump);
+}
+
+void
+_jit_perf_record(jit_function_t func, unsigned char *code_start,
+		 unsigned char *code_end, unsigned char *offset_base)
+{
+	jit_nuint flags;
+	const char *name;
+	char buf[64];
+	int pid;
+
+	flags = jit_context_get_meta_numeric(func->context, JIT_OPTION_PERF);
+	if(!flags || code_end <= code_start)
+	{
+		return;
+	}
+
+	name = jit_function_get_name(func);
+	if(!name)
+	{
+		sprintf(buf, "jit_function_%p", (void *) code_start);
+		name = buf;
+	}
+
+	jit_mutex_lock(&_jit_global_lock);
+
+	/* Start new files in a child process */
+	pid = (int) getpid();
+	if(pid != perf_pid)
+	{
+		if(perf_map)
+		{
+			fclose(perf_map);
+			perf_map = 0;
+		}
+		if(perf_dump)
+		{
+			fclose(perf_dump);
+			perf_dump = 0;
+		}
+		perf_pid = pid;
+		perf_code_index = 0;
+	}
+
+	if((flags & JIT_PERF_MAP) != 0)
+	{
+		if(!perf_map)
+		{
+			perf_map = open_map(pid);
+		}
+		if(perf_map)
+		{
+			fprintf(perf_map, "%lx %lx %s\n",
+				(unsigned long) code_start,
+				(unsigned long) (code_end - code_start), name);
+			fflush(perf_map);
+		}
+	}
+
+	if((flags & JIT_PERF_JITDUMP) != 0)
+	{
+		if(!perf_dump)
+		{
+			perf_dump = open_dump(pid);
+		}
+		if(perf_dump)
+		{
+			/* The debug information goes before the code it is for */
+			write_debug_info(func, name, code_start, offset_base);
+			write_code_load(pid, name, code_start, code_end);
+			fflush(perf_dump);
+		}
+	}
+
+	jit_mutex_unlock(&_jit_global_lock);
+}
+
+#else /* !__linux__ */
+
+void
+_jit_perf_record(jit_function_t func, unsigned char *code_start,
+		 unsigned char *code_end, unsigned char *offset_base)
+{
+	/* perf support is only available on Linux with native code */
+}
+
+#endif /* !__linux__ */
@@ -29,6 +29,7 @@ void _jit_memory_pool_init(jit_memory_pool *pool, unsigned int elem_size)
 	pool->elems_in_last = pool->elems_per_block;
 	pool->blocks = 0;
 	pool->free_list = 0;
+	pool->arena = 0;
 }
 
 void _jit_memory_pool_free(jit_memory_pool *pool, jit_meta_free_func func)
@@ -46,7 +47,10 @@ void _jit_memory_pool_free(jit_memory_pool *pool, jit_meta_free_func func)
 				(*func)(block->data + pool->elems_in_last * pool->elem_size);
 			}
 		}
-		jit_free(block);
+		if(!pool->arena)
+		{
+			jit_free(block);
+		}
 		pool->elems_in_last = pool->elems_per_block;
 	}
 	pool->free_list = 0;
@@ -65,8 +69,17 @@ void *_jit_memory_pool_alloc(jit_memory_pool *pool)
 	}
 	if(pool->elems_in_last >= pool->elems_per_block)
 	{
-		data = (void *)jit_calloc(1, sizeof(struct jit_pool_block) +
-								  pool->elem_size * pool->elems_per_block - 1);
+		if(pool->arena)
+		{
+			data = _jit_arena_calloc(pool->arena, 1,
+						 sizeof(struct jit_pool_block) +
+						 pool->elem_size * pool->elems_per_block - 1);
+		}
+		else
+		{
+			data = (void *)jit_calloc(1, sizeof(struct jit_pool_block) +
+									  pool->elem_size * pool->elems_per_block - 1);
+		}
 		if(!data)
 		{
 			return 0;
@@ -22,6 +22,7 @@
 
 #include "jit-internal.h"
 #include "jit-reg-alloc.h"
+#include "jit-bitset.h"
 #include <jit/jit-dump.h>
 #include <stdio.h>
 #include <string.h>
@@ -1994,6 +1995,22 @@ exch_stack_top(jit_gencode_t gen, int reg, int pop)
 }
 #endif
 
+/*
+ * Load a value into the register.  Loads of values that are neither
+ * constant nor already in some register are counted as reloads from
+ * the frame for the compile statistics.
+ */
+static void
+load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value)
+{
+	if(!value->is_constant && !value->in_register
+	   && !(value->has_global_register && value->in_global_register))
+	{
+		++(gen->num_reloads);
+	}
+	_jit_gen_load_value(gen, reg, other_reg, value);
+}
+
 /*
  * Drop value from the register and optionally bind a temporary value in place of it.
  */
@@ -2078,6 +2095,7 @@ save_value(jit_gencode_t gen, jit_value_t value, int reg, int other_reg, int fre
 	}
 
 	/* Now really save the value into the frame. */
+	++(gen->num_spills);
 #ifdef JIT_REG_STACK
 	if(IS_STACK_REG(reg))
 	{
@@ -2283,6 +2301,46 @@ spill_clobbered_register(jit_gencode_t gen, _jit_regs_t *regs, int reg)
 	}
 }
 
+/*
+ * Save the values of the flat registers that are not clobbered by
+ * the instruction to the frame and leave them in the registers.
+ */
+static void
+save_all_registers(jit_gencode_t gen, _jit_regs_t *regs)
+{
+	int reg, other_reg, index;
+
+#ifdef JIT_REG_DEBUG
+	printf("save_all_registers()\n");
+#endif
+
+	for(reg = 0; reg < JIT_NUM_REGS; reg++)
+	{
+		if((jit_reg_flags(reg) & JIT_REG_FIXED) != 0
+		   || jit_reg_is_used(gen->permanent, reg)
+		   || jit_reg_is_used(regs->clobber, reg)
+		   || IS_STACK_REG(reg)
+		   || gen->contents[reg].is_long_end)
+		{
+			continue;
+		}
+
+		if(gen->contents[reg].is_long_start)
+		{
+			other_reg = jit_reg_other_reg(reg);
+		}
+		else
+		{
+			other_reg = -1;
+		}
+
+		for(index = gen->contents[reg].num_values - 1; index >= 0; --index)
+		{
+			save_value(gen, gen->contents[reg].values[index], reg, other_reg, 0);
+		}
+	}
+}
+
 static void
 update_age(jit_gencode_t gen, _jit_regdesc_t *desc)
 {
@@ -2401,7 +2459,7 @@ load_input_value(jit_gencode_t gen, _jit_regs_t *regs, int index)
 			update_age(gen, desc);
 			return;
 		}
-		_jit_gen_load_value(gen, desc->reg, desc->other_reg, desc->value);
+		load_value(gen, desc->reg, desc->other_reg, desc->value);
 	}
 	else if(desc->value->in_register)
 	{
@@ -2418,14 +2476,14 @@ load_input_value(jit_gencode_t gen, _jit_regs_t *regs, int index)
 #ifdef JIT_REG_STACK
 		if(IS_STACK_REG(desc->reg))
 		{
-			_jit_gen_load_value(gen, gen->reg_stack_top, -1, desc->value);
+			load_value(gen, gen->reg_stack_top, -1, desc->value);
 			desc->stack_reg = gen->reg_stack_top++;
 			bind_temporary(gen, desc->stack_reg, -1);
 		}
 		else
 #endif
 		{
-			_jit_gen_load_value(gen, desc->reg, desc->other_reg, desc->value);
+			load_value(gen, desc->reg, desc->other_reg, desc->value);
 			bind_temporary(gen, desc->reg, desc->other_reg);
 		}
 	}
@@ -2434,14 +2492,14 @@ load_input_value(jit_gencode_t gen, _jit_regs_t *regs, int index)
 #ifdef JIT_REG_STACK
 		if(IS_STACK_REG(desc->reg))
 		{
-			_jit_gen_load_value(gen, gen->reg_stack_top, -1, desc->value);
+			load_value(gen, gen->reg_stack_top, -1, desc->value);
 			desc->stack_reg = gen->reg_stack_top++;
 			bind_value(gen, desc->value, desc->stack_reg, -1, 1);
 		}
 		else
 #endif
 		{
-			_jit_gen_load_value(gen, desc->reg, desc->other_reg, desc->value);
+			load_value(gen, desc->reg, desc->other_reg, desc->value);
 			bind_value(gen, desc->value, desc->reg, desc->other_reg, 1);
 		}
 	}
@@ -2679,60 +2737,77 @@ _jit_regs_lookup(char *name)
 	return -1;
 }
 
-/*@
- * @deftypefun void _jit_regs_alloc_global (jit_gencode_t gen, jit_function_t func)
- * Perform global register allocation on the values in @code{func}.
- * This is called during function compilation just after variable
- * liveness has been computed.
- * @end deftypefun
-@*/
-void _jit_regs_alloc_global(jit_gencode_t gen, jit_function_t func)
-{
 #if JIT_NUM_GLOBAL_REGS != 0
+
+/*
+ * Live range of a global register candidate.  The positions number
+ * the instructions of the function in the block list order, which is
+ * the order the code is generated in.  A range is the hull of all the
+ * positions where the value is live, it is never split.
+ */
+typedef struct
+{
+	jit_value_t	value;
+	int		start;
+	int		end;
+	int		reg;
+
+} _jit_live_range_t;
+
+/*
+ * Check if a value may be placed into a global register.
+ */
+static int
+is_global_candidate(jit_value_t value)
+{
+	return (value->global_candidate && value->usage_count >= JIT_MIN_USED
+		&& !(value->is_addressable) && !(value->is_volatile));
+}
+
+/*
+ * Bind a global register to a value.
+ */
+static void
+assign_global_register(jit_gencode_t gen, jit_value_t value, int reg)
+{
+	value->has_global_register = 1;
+	value->in_global_register = 1;
+	value->global_reg = (short)reg;
+	jit_reg_set_used(gen->touched, reg);
+	jit_reg_set_used(gen->permanent, reg);
+}
+
+/*
+ * Give the global registers to the most used candidates.  Each value
+ * keeps its register for the whole function.  This is used when the
+ * function has no control flow graph to compute live ranges from.
+ */
+static void
+alloc_global_by_usage(jit_gencode_t gen, jit_function_t func)
+{
 	jit_value_t candidates[JIT_NUM_GLOBAL_REGS];
 	int num_candidates = 0;
 	int index, reg, posn, num;
 	jit_pool_block_t block;
 	jit_value_t value, temp;
 
-	/* If the function has a "try" block, then don't do global allocation
-	   as the "longjmp" for exception throws will wipe out global registers */
-	if(func->has_try)
-	{
-		return;
-	}
-
-	/* If the current function involves a tail call, then we don't do
-	   global register allocation and we also prevent the code generator
-	   from using any of the callee-saved registers.  This simplifies
-	   tail calls, which don't have to worry about restoring such registers */
-	if(func->builder->has_tail_call)
-	{
-		for(reg = 0; reg < JIT_NUM_REGS; ++reg)
-		{
-			if((jit_reg_flags(reg) & (JIT_REG_FIXED|JIT_REG_CALL_USED)) == 0)
-			{
-				jit_reg_set_used(gen->permanent, reg);
-			}
-		}
-		return;
-	}
-
-	/* Scan all values within the function, looking for the most used.
-	   We will replace this with a better allocation strategy later */
+	/* Scan all values within the function, looking for the most used */
 	block = func->builder->value_pool.blocks;
-	num = (int)(func->builder->value_pool.elems_per_block);
 	while(block != 0)
 	{
-		if(!(block->next))
+		/* New pool blocks are added at the head of the list */
+		if(block == func->builder->value_pool.blocks)
 		{
 			num = (int)(func->builder->value_pool.elems_in_last);
 		}
+		else
+		{
+			num = (int)(func->builder->value_pool.elems_per_block);
+		}
 		for(posn = 0; posn < num; ++posn)
 		{
 			value = (jit_value_t)(block->data + posn * sizeof(struct _jit_value));
-			if(value->global_candidate && value->usage_count >= JIT_MIN_USED &&
-			   !(value->is_addressable) && !(value->is_volatile))
+			if(is_global_candidate(value))
 			{
 				/* Insert this candidate into the list, ordered on count */
 				index = 0;
@@ -2767,15 +2842,435 @@ void _jit_regs_alloc_global(jit_gencode_t gen, jit_function_t func)
 		{
 			--reg;
 		}
-		candidates[index]->has_global_register = 1;
-		candidates[index]->in_global_register = 1;
-		candidates[index]->global_reg = (short)reg;
-		jit_reg_set_used(gen->touched, reg);
-		jit_reg_set_used(gen->permanent, reg);
+		assign_global_register(gen, candidates[index], reg);
 		--reg;
 	}
+}
+
+/*
+ * Collect the global register candidates of a function.  The candidates
+ * are numbered through their "index" field.  Returns NULL if there are
+ * no candidates, or if out of memory in which case the number of ranges
+ * is set to -1.
+ */
+static _jit_live_range_t *
+collect_candidates(jit_function_t func, int *num_ranges)
+{
+	_jit_live_range_t *ranges;
+	jit_pool_block_t block;
+	jit_value_t value;
+	int posn, num, count;
+
+	*num_ranges = 0;
+	count = 0;
+	ranges = 0;
+	for(;;)
+	{
+		block = func->builder->value_pool.blocks;
+		while(block != 0)
+		{
+			if(block == func->builder->value_pool.blocks)
+			{
+				num = (int)(func->builder->value_pool.elems_in_last);
+			}
+			else
+			{
+				num = (int)(func->builder->value_pool.elems_per_block);
+			}
+			for(posn = 0; posn < num; ++posn)
+			{
+				value = (jit_value_t)(block->data + posn * sizeof(struct _jit_value));
+				if(!is_global_candidate(value))
+				{
+					continue;
+				}
+				if(ranges)
+				{
+					value->index = *num_ranges;
+					ranges[*num_ranges].value = value;
+					ranges[*num_ranges].start = -1;
+					ranges[*num_ranges].end = -1;
+					ranges[*num_ranges].reg = -1;
+					++(*num_ranges);
+				}
+				else
+				{
+					++count;
+				}
+			}
+			block = block->next;
+		}
+
+		/* The first round counts, the second one fills the ranges */
+		if(ranges || count == 0)
+		{
+			return ranges;
+		}
+		ranges = jit_malloc(count * sizeof(_jit_live_range_t));
+		if(!ranges)
+		{
+			*num_ranges = -1;
+			return 0;
+		}
+	}
+}
+
+/*
+ * Extend a live range to include a position.
+ */
+static void
+extend_range(_jit_live_range_t *range, int posn)
+{
+	if(range->start < 0 || posn < range->start)
+	{
+		range->start = posn;
+	}
+	if(posn > range->end)
+	{
+		range->end = posn;
+	}
+}
+
+/*
+ * Get the candidate number of an instruction operand or -1.
+ */
+static int
+candidate_index(jit_function_t func, jit_value_t value)
+{
+	if(value && !(value->is_constant) && value->index >= 0
+	   && value->block && value->block->func == func)
+	{
+		return value->index;
+	}
+	return -1;
+}
+
+/*
+ * Record the use of a candidate within a block.
+ */
+static void
+record_use(_jit_live_range_t *ranges, _jit_bitset_t *sets, int index, int posn)
+{
+	if(index >= 0)
+	{
+		if(!_jit_bitset_test_bit(&sets[1], index))
+		{
+			_jit_bitset_set_bit(&sets[0], index);
+		}
+		extend_range(&ranges[index], posn);
+	}
+}
+
+/*
+ * Perform linear scan register allocation over the live ranges of the
+ * candidates.  The ranges are computed from the block liveness that is
+ * found by the usual backward data flow over the control flow graph.
+ * Returns zero if out of memory or if the control flow graph is not
+ * complete.
+ */
+static int
+alloc_global_linear_scan(jit_gencode_t gen, jit_function_t func)
+{
+	_jit_live_range_t *ranges;
+	_jit_live_range_t **sorted;
+	_jit_live_range_t *active[JIT_NUM_GLOBAL_REGS];
+	_jit_live_range_t *range;
+	int global_regs[JIT_NUM_GLOBAL_REGS];
+	int num_global_regs;
+	_jit_bitset_t *sets;
+	_jit_bitset_t temp;
+	int *bounds;
+	int num_ranges, num_blocks;
+	int index, posn, reg, free_index, victim, changed, ok;
+	jit_block_t block, last;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	jit_value_t dest;
+
+	/* Number the blocks.  Indirect jumps to blocks whose address was
+	   taken are not in the control flow graph, so give up on them */
+	num_blocks = 0;
+	last = 0;
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		if(block->address_of)
+		{
+			return 0;
+		}
+		block->index = num_blocks++;
+		last = block;
+	}
+
+	ranges = collect_candidates(func, &num_ranges);
+	if(!ranges)
+	{
+		return (num_ranges == 0);
+	}
+
+	/* Each block has four sets: use, def, live-in and live-out */
+	ok = 0;
+	sorted = 0;
+	_jit_bitset_init(&temp);
+	bounds = jit_malloc(2 * num_blocks * sizeof(int));
+	sets = jit_calloc(4 * num_blocks, sizeof(_jit_bitset_t));
+	if(!bounds || !sets || !_jit_bitset_allocate(&temp, num_ranges))
+	{
+		goto done;
+	}
+	for(index = 0; index < 4 * num_blocks; ++index)
+	{
+		if(!_jit_bitset_allocate(&sets[index], num_ranges))
+		{
+			goto done;
+		}
+	}
+
+	/* Number the instructions and compute the local use and def sets */
+	posn = 0;
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		bounds[2 * block->index] = posn++;
+		jit_insn_iter_init(&iter, block);
+		while((insn = jit_insn_iter_next(&iter)) != 0)
+		{
+			if(insn->opcode == JIT_OP_NOP)
+			{
+				continue;
+			}
+			if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0)
+			{
+				record_use(ranges, &sets[4 * block->index],
+					   candidate_index(func, insn->value1), posn);
+			}
+			if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0)
+			{
+				record_use(ranges, &sets[4 * block->index],
+					   candidate_index(func, insn->value2), posn);
+			}
+			if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0)
+			{
+				dest = insn->dest;
+				index = candidate_index(func, dest);
+				if((insn->flags & JIT_INSN_DEST_IS_VALUE) != 0)
+				{
+					record_use(ranges, &sets[4 * block->index], index, posn);
+				}
+				else if(index >= 0)
+				{
+					_jit_bitset_set_bit(&sets[4 * block->index + 1], index);
+					extend_range(&ranges[index], posn);
+				}
+			}
+			++posn;
+		}
+		bounds[2 * block->index + 1] = posn++;
+	}
+
+	/* Compute the live-in and live-out sets */
+	do
+	{
+		changed = 0;
+		for(block = last; block; block = block->prev)
+		{
+			for(index = 0; index < block->num_succs; ++index)
+			{
+				_jit_bitset_add(&sets[4 * block->index + 3],
+						&sets[4 * block->succs[index]->dst->index + 2]);
+			}
+			_jit_bitset_copy(&temp, &sets[4 * block->index + 3]);
+			_jit_bitset_sub(&temp, &sets[4 * block->index + 1]);
+			_jit_bitset_add(&temp, &sets[4 * block->index]);
+			if(_jit_bitset_copy(&sets[4 * block->index + 2], &temp))
+			{
+				changed = 1;
+			}
+		}
+	}
+	while(changed);
+
+	/* Stretch the ranges over the block boundaries where the values are
+	   live.  A value defined in a block may be left in a local register
+	   until the end of the block, so its range covers the rest of the
+	   block even if the value is dead there. */
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		for(index = 0; index < num_ranges; ++index)
+		{
+			if(_jit_bitset_test_bit(&sets[4 * block->index + 2], index))
+			{
+				extend_range(&ranges[index], bounds[2 * block->index]);
+			}
+			if(_jit_bitset_test_bit(&sets[4 * block->index + 3], index)
+			   || _jit_bitset_test_bit(&sets[4 * block->index + 1], index))
+			{
+				extend_range(&ranges[index], bounds[2 * block->index + 1]);
+			}
+		}
+	}
+
+	/* Sort the ranges on their start position */
+	sorted = jit_malloc(num_ranges * sizeof(_jit_live_range_t *));
+	if(!sorted)
+	{
+		goto done;
+	}
+	for(index = 0; index < num_ranges; ++index)
+	{
+		range = &ranges[index];
+		for(posn = index; posn > 0 && sorted[posn - 1]->start > range->start; --posn)
+		{
+			sorted[posn] = sorted[posn - 1];
+		}
+		sorted[posn] = range;
+	}
+
+	/* Collect the global registers from the top-most one in the allocation
+	   order, because some architectures like PPC require global registers
+	   to be saved top-down for efficiency */
+	num_global_regs = 0;
+	for(reg = JIT_NUM_REGS - 1; reg >= 0 && num_global_regs < JIT_NUM_GLOBAL_REGS; --reg)
+	{
+		if((jit_reg_flags(reg) & JIT_REG_GLOBAL) != 0)
+		{
+			active[num_global_regs] = 0;
+			global_regs[num_global_regs++] = reg;
+		}
+	}
+
+	/* Scan the ranges.  A register becomes free once the range that
+	   holds it ends strictly before the start of the next range.  When
+	   all the registers are busy, the less used of the active ranges
+	   and the new range loses, and it is left in the frame altogether. */
+	for(index = 0; index < num_ranges; ++index)
+	{
+		range = sorted[index];
+		if(range->end < 0)
+		{
+			continue;
+		}
+		free_index = -1;
+		victim = -1;
+		for(posn = 0; posn < num_global_regs; ++posn)
+		{
+			if(active[posn] && active[posn]->end < range->start)
+			{
+				active[posn] = 0;
+			}
+			if(!active[posn])
+			{
+				if(free_index < 0)
+				{
+					free_index = posn;
+				}
+			}
+			else if(victim < 0
+				|| active[posn]->value->usage_count < active[victim]->value->usage_count
+				|| (active[posn]->value->usage_count == active[victim]->value->usage_count
+				    && active[posn]->end > active[victim]->end))
+			{
+				victim = posn;
+			}
+		}
+		if(free_index < 0)
+		{
+			if(victim < 0
+			   || active[victim]->value->usage_count >= range->value->usage_count)
+			{
+				continue;
+			}
+			active[victim]->reg = -1;
+			free_index = victim;
+		}
+		active[free_index] = range;
+		range->reg = global_regs[free_index];
+	}
+
+	for(index = 0; index < num_ranges; ++index)
+	{
+		if(ranges[index].reg >= 0)
+		{
+			assign_global_register(gen, ranges[index].value, ranges[index].reg);
+		}
+	}
+	ok = 1;
+
+done:
+	for(index = 0; index < num_ranges; ++index)
+	{
+		ranges[index].value->index = -1;
+	}
+	if(sets)
+	{
+		for(index = 0; index < 4 * num_blocks; ++index)
+		{
+			_jit_bitset_free(&sets[index]);
+		}
+		jit_free(sets);
+	}
+	_jit_bitset_free(&temp);
+	jit_free(bounds);
+	jit_free(sorted);
+	jit_free(ranges);
+	return ok;
+}
 
 #endif
+
+/*@
+ * @deftypefun void _jit_regs_alloc_global (jit_gencode_t gen, jit_function_t func)
+ * Perform global register allocation on the values in @code{func}.
+ * This is called during function compilation just after variable
+ * liveness has been computed.
+ *
+ * If the function was optimized then its control flow graph is used
+ * to compute the live range of every candidate value and the registers
+ * are given out with a linear scan, so values whose ranges do not
+ * overlap may share a register.  Otherwise the most used values get
+ * a register each for the whole function.
+ * @end deftypefun
+@*/
+void _jit_regs_alloc_global(jit_gencode_t gen, jit_function_t func)
+{
+#if JIT_NUM_GLOBAL_REGS != 0
+	int reg;
+
+	/* If the function has a "try" block, then don't do global allocation
+	   as the "longjmp" for exception throws will wipe out global registers */
+	if(func->has_try)
+	{
+		/* The unwinder restores the callee-saved registers that the
+		   function had at the throw when it enters the catcher through
+		   an exception table.  The live ranges only know about some of
+		   the ways into the catcher, so each value keeps its register
+		   in the whole function */
+		if(func->builder->catch_by_table)
+		{
+			alloc_global_by_usage(gen, func);
+		}
+		return;
+	}
+
+	/* If the current function involves a tail call, then we don't do
+	   global register allocation and we also prevent the code generator
+	   from using any of the callee-saved registers.  This simplifies
+	   tail calls, which don't have to worry about restoring such registers */
+	if(func->builder->has_tail_call)
+	{
+		for(reg = 0; reg < JIT_NUM_REGS; ++reg)
+		{
+			if((jit_reg_flags(reg) & (JIT_REG_FIXED|JIT_REG_CALL_USED)) == 0)
+			{
+				jit_reg_set_used(gen->permanent, reg);
+			}
+		}
+		return;
+	}
+
+	if(!func->is_optimized || !alloc_global_linear_scan(gen, func))
+	{
+		alloc_global_by_usage(gen, func);
+	}
+#endif
 }
 
 /*@
@@ -2857,6 +3352,87 @@ _jit_regs_spill_all(jit_gencode_t gen)
 #endif
 }
 
+/*@
+ * @deftypefun void _jit_regs_carry_over (jit_gencode_t gen)
+ * Finish the register allocation for a block and pass the register
+ * state on to the next block.  This is used instead of
+ * @code{_jit_regs_spill_all} when the next block can only be reached
+ * by falling through from the current one.  Temporary values, values
+ * that have a global register and values that may be accessed through
+ * memory are written back as usual.  The other values stay
+ * in their registers, so the next block does not reload them.  Stack
+ * registers are always spilled.
+ * @end deftypefun
+@*/
+void
+_jit_regs_carry_over(jit_gencode_t gen)
+{
+	int reg, other_reg, index;
+	jit_value_t value;
+
+#ifdef JIT_REG_DEBUG
+	printf("enter _jit_regs_carry_over\n");
+#endif
+
+	for(reg = 0; reg < JIT_NUM_REGS; reg++)
+	{
+		/* Skip this register if it is permanent or fixed */
+		if(jit_reg_is_used(gen->permanent, reg)
+		   || (jit_reg_flags(reg) & JIT_REG_FIXED) != 0)
+		{
+			continue;
+		}
+
+#ifdef JIT_REG_STACK
+		if(IS_STACK_REG(reg))
+		{
+			if(gen->reg_stack_top > JIT_REG_STACK_START)
+			{
+				spill_register(gen, gen->reg_stack_top - 1);
+			}
+			continue;
+		}
+#endif
+
+		if(gen->contents[reg].is_long_end)
+		{
+			continue;
+		}
+		if(gen->contents[reg].is_long_start)
+		{
+			other_reg = jit_reg_other_reg(reg);
+		}
+		else
+		{
+			other_reg = -1;
+		}
+
+		for(index = gen->contents[reg].num_values - 1; index >= 0; --index)
+		{
+			value = gen->contents[reg].values[index];
+			if(value->is_constant)
+			{
+				free_value(gen, value, reg, other_reg, 0);
+			}
+			else if(value->is_temporary || value->has_global_register
+				|| value->is_addressable || value->is_volatile)
+			{
+				save_value(gen, value, reg, other_reg, 1);
+			}
+		}
+		gen->contents[reg].used_for_temp = 0;
+		if(other_reg >= 0)
+		{
+			gen->contents[other_reg].used_for_temp = 0;
+		}
+	}
+	gen->inhibit = jit_regused_init;
+
+#ifdef JIT_REG_DEBUG
+	printf("leave _jit_regs_carry_over\n\n");
+#endif
+}
+
 /*@
  * @deftypefun void _jit_regs_set_incoming (jit_gencode_t gen, int reg, jit_value_t value)
  * Set pseudo register @code{reg} to record that it currently holds the
@@ -2954,7 +3530,7 @@ _jit_regs_set_outgoing(jit_gencode_t gen, int reg, jit_value_t value)
 			spill_register(gen, other_reg);
 		}
 
-		_jit_gen_load_value(gen, reg, other_reg, value);
+		load_value(gen, reg, other_reg, value);
 	}
 
 	jit_reg_set_used(gen->inhibit, reg);
@@ -3138,7 +3714,7 @@ _jit_regs_load_value(jit_gencode_t gen, jit_value_t value, int destroy, int used
 			spill_register(gen, suitable_other_reg);
 		}
 
-		_jit_gen_load_value(gen, suitable_reg, suitable_other_reg, value);
+		load_value(gen, suitable_reg, suitable_other_reg, value);
 
 		if(!destroy && !used_again)
 		{
@@ -3352,6 +3928,15 @@ _jit_regs_clobber_all(jit_gencode_t gen, _jit_regs_t *regs)
 		{
 			continue;
 		}
+		if(regs->branch && !IS_STACK_REG(index))
+		{
+			/* A branch does not destroy the flat registers.  Their
+			   values only have to be in the frame for the branch
+			   target, so they may stay in the registers for the
+			   fall through path */
+			regs->save_all = 1;
+			continue;
+		}
 		jit_reg_set_used(regs->clobber, index);
 	}
 }
@@ -3497,6 +4082,7 @@ _jit_regs_gen(jit_gencode_t gen, _jit_regs_t *regs)
 				jit_exception_builtin(JIT_RESULT_COMPILE_ERROR);
 			}
 			_jit_gen_spill_global(gen, reg, 0);
+			++(gen->num_spills);
 			continue;
 		}
 
@@ -3531,6 +4117,12 @@ _jit_regs_gen(jit_gencode_t gen, _jit_regs_t *regs)
 		}
 	}
 
+	/* Save the values that the branch target expects in the frame */
+	if(regs->save_all)
+	{
+		save_all_registers(gen, regs);
+	}
+
 	/* Save input values if necessary and free the output value if it is in a register */
 	if(regs->ternary)
 	{
@@ -3763,6 +4355,7 @@ _jit_regs_commit(jit_gencode_t gen, _jit_regs_t *regs)
 			}
 #endif
 			_jit_gen_load_global(gen, reg, 0);
+			++(gen->num_reloads);
 		}
 	}
 
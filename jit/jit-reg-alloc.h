@@ -113,6 +113,7 @@ typedef struct
 	unsigned	copy : 1;
 	unsigned	commutative : 1;
 	unsigned	free_dest : 1;
+	unsigned	save_all : 1;
 
 #ifdef JIT_REG_STACK
 	unsigned	on_stack : 1;
@@ -144,6 +145,7 @@ int _jit_regs_lookup(char *name);
 void _jit_regs_alloc_global(jit_gencode_t gen, jit_function_t func);
 void _jit_regs_init_for_block(jit_gencode_t gen);
 void _jit_regs_spill_all(jit_gencode_t gen);
+void _jit_regs_carry_over(jit_gencode_t gen);
 void _jit_regs_set_incoming(jit_gencode_t gen, int reg, jit_value_t value);
 void _jit_regs_set_outgoing(jit_gencode_t gen, int reg, jit_value_t value);
 void _jit_regs_clear_all_outgoing(jit_gencode_t gen);
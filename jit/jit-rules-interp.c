@@ -27,6 +27,9 @@
 #if defined(JIT_BACKEND_INTERP)
 
 #include "jit-interp.h"
+#if defined(JIT_INTERP_PROFILE) && HAVE_STDLIB_H
+	#include <stdlib.h>
+#endif
 
 /*@
 
@@ -198,7 +201,7 @@ generation is complete.
  * Write an interpreter opcode to the cache.
  */
 #define	jit_cache_opcode(gen,opcode)	\
-			jit_cache_native((gen), (jit_nint)(opcode))
+			cache_opcode((gen), (opcode))
 
 /*
  * Write "n" bytes to the cache, rounded up to a multiple of "void *".
@@ -224,6 +227,86 @@ generation is complete.
 			} \
 		} while (0)
 
+#if !defined(JIT_INTERP_PROFILE)
+
+/*
+ * Get the number of words that follow an opcode with the given flags.
+ * This only needs to handle the opcodes that may start a superinstruction.
+ */
+static int
+opcode_args_size(int flags)
+{
+	switch(flags & JIT_OPCODE_INTERP_ARGS_MASK)
+	{
+	case JIT_OPCODE_NINT_ARG:
+		return 1;
+
+	case JIT_OPCODE_NINT_ARG_TWO:
+		return 2;
+
+	case JIT_OPCODE_CONST_LONG:
+		return (sizeof(jit_long) + sizeof(void *) - 1) / sizeof(void *);
+
+	case JIT_OPCODE_CONST_FLOAT32:
+		return (sizeof(jit_float32) + sizeof(void *) - 1) / sizeof(void *);
+
+	case JIT_OPCODE_CONST_FLOAT64:
+		return (sizeof(jit_float64) + sizeof(void *) - 1) / sizeof(void *);
+
+	case JIT_OPCODE_CONST_NFLOAT:
+		return (sizeof(jit_nfloat) + sizeof(void *) - 1) / sizeof(void *);
+	}
+	return 0;
+}
+
+#endif
+
+/*
+ * Write an interpreter opcode to the cache.  If the previous opcode
+ * directly precedes it and the two form a superinstruction, then the
+ * previous opcode is replaced with the superinstruction.  The opcode
+ * itself is still written because branches may lead to it.
+ */
+static void
+cache_opcode(jit_gencode_t gen, int opcode)
+{
+#if !defined(JIT_INTERP_PROFILE)
+	const jit_interp_super_t *super;
+	int size;
+
+	if(gen->last_opcode_ptr)
+	{
+		for(super = _jit_interp_supers; super->super; ++super)
+		{
+			if(super->first != gen->last_opcode || super->second != opcode)
+			{
+				continue;
+			}
+			size = opcode_args_size(_jit_interp_opcodes
+						[super->super - JIT_OP_NUM_OPCODES].flags);
+			if(gen->ptr == gen->last_opcode_ptr + (size + 1) * sizeof(void *))
+			{
+				*((jit_nint *)(gen->last_opcode_ptr)) = super->super;
+			}
+			break;
+		}
+	}
+#endif
+	gen->last_opcode_ptr = gen->ptr;
+	gen->last_opcode = opcode;
+	jit_cache_native(gen, (jit_nint)opcode);
+}
+
+#if defined(JIT_INTERP_SLOTS)
+
+/*
+ * The slot opcodes for each public opcode, indexed by whether value2
+ * is an immediate value.  Zero if there is no such slot opcode.
+ */
+static int slot_opcodes[JIT_OP_NUM_OPCODES][2];
+
+#endif
+
 /*@
  * @deftypefun void _jit_init_backend (void)
  * Initialize the backend.  This is normally used to configure registers
@@ -233,7 +316,18 @@ generation is complete.
 @*/
 void _jit_init_backend(void)
 {
-	/* Nothing to do here for the interpreter */
+#if defined(JIT_INTERP_SLOTS)
+	const jit_interp_slots_t *slots;
+
+	for(slots = _jit_interp_slots; slots->slots; ++slots)
+	{
+		slot_opcodes[slots->opcode][slots->imm] = slots->slots;
+	}
+#endif
+#if defined(JIT_INTERP_PROFILE)
+	/* Report the opcode pairs that were executed when the program exits */
+	atexit(_jit_interp_write_profile);
+#endif
 }
 
 /*@
@@ -1041,6 +1135,253 @@ store_value(jit_gencode_t gen, jit_value_t value)
 	jit_cache_native(gen, offset);
 }
 
+/*
+ * Output the target of a branch, relative to "pc".  If the target
+ * block has not been output yet, then "pc" is put on its fixup list.
+ */
+static void
+cache_branch_target(jit_gencode_t gen, jit_block_t block, void **pc)
+{
+	if(block->address)
+	{
+		/* We already know the address of the block */
+		jit_cache_native(gen, ((void **)(block->address)) - pc);
+	}
+	else
+	{
+		/* Record this position on the block's fixup list */
+		jit_cache_native(gen, block->fixup_list);
+		block->fixup_list = (void *)pc;
+	}
+}
+
+#if defined(JIT_INTERP_SLOTS)
+
+/*
+ * Get the frame slot of a value, for a three-address opcode.
+ */
+static jit_nint
+value_slot(jit_value_t value)
+{
+	jit_nint offset;
+
+	_jit_gen_fix_value(value);
+	if(value->frame_offset >= 0)
+	{
+		offset = value->frame_offset * (jit_nint)sizeof(jit_item);
+		return offset << 1;
+	}
+	offset = -(value->frame_offset + 1) * (jit_nint)sizeof(jit_item);
+	return (offset << 1) | 1;
+}
+
+/*
+ * Determine if a value has exactly the type of a slot opcode operand,
+ * which is given as one of the "JIT_OPCODE_DEST_*" flags.  Smaller
+ * types need the conversions in the register load and store opcodes.
+ */
+static int
+slot_type_matches(jit_value_t value, int flags)
+{
+	switch(jit_type_normalize(value->type)->kind)
+	{
+	case JIT_TYPE_INT:
+	case JIT_TYPE_UINT:
+		return (flags == JIT_OPCODE_DEST_INT);
+
+	case JIT_TYPE_LONG:
+	case JIT_TYPE_ULONG:
+		return (flags == JIT_OPCODE_DEST_LONG);
+
+	case JIT_TYPE_FLOAT32:
+		return (flags == JIT_OPCODE_DEST_FLOAT32);
+
+	case JIT_TYPE_FLOAT64:
+		return (flags == JIT_OPCODE_DEST_FLOAT64);
+
+	case JIT_TYPE_NFLOAT:
+		return (flags == JIT_OPCODE_DEST_NFLOAT);
+	}
+	return 0;
+}
+
+/*
+ * Get a constant as the immediate value of a slot opcode operand,
+ * if it fits in a word.
+ */
+static int
+slot_immediate(jit_value_t value, int flags, jit_nint *imm)
+{
+	jit_long long_value;
+
+	switch(jit_type_normalize(value->type)->kind)
+	{
+	case JIT_TYPE_SBYTE:
+	case JIT_TYPE_UBYTE:
+	case JIT_TYPE_SHORT:
+	case JIT_TYPE_USHORT:
+	case JIT_TYPE_INT:
+	case JIT_TYPE_UINT:
+		*imm = jit_value_get_nint_constant(value);
+		return (flags == JIT_OPCODE_DEST_INT);
+
+	case JIT_TYPE_LONG:
+	case JIT_TYPE_ULONG:
+		long_value = jit_value_get_long_constant(value);
+		*imm = (jit_nint)long_value;
+		return (flags == JIT_OPCODE_DEST_LONG &&
+			(jit_long)(*imm) == long_value);
+	}
+	return 0;
+}
+
+/*
+ * Output a copy between frame slots, or of an immediate value
+ * to a frame slot.
+ */
+static int
+gen_slots_copy(jit_gencode_t gen, jit_insn_t insn)
+{
+	int flags;
+	jit_nint imm;
+
+	flags = jit_opcodes[insn->opcode].flags & JIT_OPCODE_DEST_MASK;
+	if(!slot_type_matches(insn->dest, flags))
+	{
+		return 0;
+	}
+	if(!(insn->value1->is_constant))
+	{
+		if(!slot_type_matches(insn->value1, flags))
+		{
+			return 0;
+		}
+		jit_cache_opcode(gen, JIT_INTERP_OP_COPY_SLOTS);
+		jit_cache_native(gen, value_slot(insn->dest));
+		jit_cache_native(gen, value_slot(insn->value1));
+		return 1;
+	}
+	if(!slot_immediate(insn->value1, flags, &imm))
+	{
+		return 0;
+	}
+	if(flags == JIT_OPCODE_DEST_INT)
+	{
+		jit_cache_opcode(gen, JIT_INTERP_OP_COPY_SLOTS_IMM_INT);
+	}
+	else
+	{
+		jit_cache_opcode(gen, JIT_INTERP_OP_COPY_SLOTS_IMM_LONG);
+	}
+	jit_cache_native(gen, value_slot(insn->dest));
+	jit_cache_native(gen, imm);
+	return 1;
+}
+
+/*
+ * Output an instruction as a three-address opcode that takes its
+ * operands from frame slots.  Returns zero if there is no such opcode
+ * for the instruction, or if its operands do not fit the opcode.  The
+ * instruction is then output with the register opcodes instead.
+ */
+static int
+gen_slots_insn(jit_gencode_t gen, jit_function_t func, jit_insn_t insn)
+{
+	jit_block_t block;
+	jit_nint imm;
+	int opcode;
+	int flags;
+	int use_imm;
+
+	switch(insn->opcode)
+	{
+	case JIT_OP_COPY_INT:
+	case JIT_OP_COPY_LONG:
+	case JIT_OP_COPY_FLOAT32:
+	case JIT_OP_COPY_FLOAT64:
+	case JIT_OP_COPY_NFLOAT:
+		return gen_slots_copy(gen, insn);
+	}
+
+	opcode = slot_opcodes[insn->opcode][0];
+	if(!opcode || !(insn->value1) || insn->value1->is_constant)
+	{
+		return 0;
+	}
+	flags = _jit_interp_opcodes[opcode - JIT_OP_NUM_OPCODES].flags;
+	if((flags & JIT_OPCODE_IS_BRANCH) == 0 &&
+	   (!(insn->dest) || (insn->flags & JIT_INSN_DEST_IS_VALUE) != 0 ||
+	    !slot_type_matches(insn->dest, flags & JIT_OPCODE_DEST_MASK)))
+	{
+		return 0;
+	}
+	if(!slot_type_matches(insn->value1, (flags & JIT_OPCODE_SRC1_MASK) >> 4))
+	{
+		return 0;
+	}
+	use_imm = 0;
+	if((flags & JIT_OPCODE_SRC2_MASK) != 0)
+	{
+		if(!(insn->value2))
+		{
+			return 0;
+		}
+		if(insn->value2->is_constant)
+		{
+			opcode = slot_opcodes[insn->opcode][1];
+			if(!opcode || !slot_immediate(insn->value2,
+						      (flags & JIT_OPCODE_SRC2_MASK) >> 8,
+						      &imm))
+			{
+				return 0;
+			}
+			use_imm = 1;
+		}
+		else if(!slot_type_matches(insn->value2,
+					   (flags & JIT_OPCODE_SRC2_MASK) >> 8))
+		{
+			return 0;
+		}
+	}
+	if((flags & JIT_OPCODE_IS_BRANCH) != 0)
+	{
+		block = jit_block_from_label(func, (jit_label_t)(insn->dest));
+		if(!block)
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		block = 0;
+	}
+
+	/* Output the opcode, followed by the dest, value1 and value2
+	   operands that it has, and the branch target if any */
+	jit_cache_opcode(gen, opcode);
+	if(!block)
+	{
+		jit_cache_native(gen, value_slot(insn->dest));
+	}
+	jit_cache_native(gen, value_slot(insn->value1));
+	if(use_imm)
+	{
+		jit_cache_native(gen, imm);
+	}
+	else if((flags & JIT_OPCODE_SRC2_MASK) != 0)
+	{
+		jit_cache_native(gen, value_slot(insn->value2));
+	}
+	if(block)
+	{
+		/* The interpreter applies the target to the last operand */
+		cache_branch_target(gen, block, ((void **)(gen->ptr)) - 1);
+	}
+	return 1;
+}
+
+#endif /* JIT_INTERP_SLOTS */
+
 /*@
  * @deftypefun void _jit_gen_insn (jit_gencode_t @var{gen}, jit_function_t @var{func}, jit_block_t @var{block}, jit_insn_t @var{insn})
  * Generate native code for the specified @var{insn}.  This function should
@@ -1058,6 +1399,13 @@ void _jit_gen_insn(jit_gencode_t gen, jit_function_t func,
 	jit_nint offset;
 	jit_nint size;
 
+#if defined(JIT_INTERP_SLOTS)
+	if(gen_slots_insn(gen, func, insn))
+	{
+		return;
+	}
+#endif
+
 	switch(insn->opcode)
 	{
 	case JIT_OP_BR_IEQ:
@@ -1134,17 +1482,7 @@ void _jit_gen_insn(jit_gencode_t gen, jit_function_t func,
 		{
 			break;
 		}
-		if(block->address)
-		{
-			/* We already know the address of the block */
-			jit_cache_native(gen, ((void **)(block->address)) - pc);
-		}
-		else
-		{
-			/* Record this position on the block's fixup list */
-			jit_cache_native(gen, block->fixup_list);
-			block->fixup_list = (void *)pc;
-		}
+		cache_branch_target(gen, block, pc);
 		break;
 
 	case JIT_OP_CALL_FILTER:
@@ -1199,17 +1537,7 @@ void _jit_gen_insn(jit_gencode_t gen, jit_function_t func,
 		}
 		pc = (void **)(gen->ptr);
 		jit_cache_opcode(gen, insn->opcode);
-		if(block->address)
-		{
-			/* We already know the address of the block */
-			jit_cache_native(gen, ((void **)(block->address)) - pc);
-		}
-		else
-		{
-			/* Record this position on the block's fixup list */
-			jit_cache_native(gen, block->fixup_list);
-			block->fixup_list = (void *)pc;
-		}
+		cache_branch_target(gen, block, pc);
 		store_value(gen, insn->dest);
 		break;
 
@@ -1291,7 +1619,7 @@ void _jit_gen_insn(jit_gencode_t gen, jit_function_t func,
 
 			/* This will load the argument frame pointer into r1 */
 			load_value(gen, insn->value1, 1);
-			jit_cache_native(gen, JIT_OP_LOAD_RELATIVE_LONG);
+			jit_cache_opcode(gen, JIT_OP_LOAD_RELATIVE_LONG);
 			jit_cache_native(gen,
 				target_func->arguments_pointer_offset * sizeof(jit_item));
 
@@ -1573,6 +1901,56 @@ void _jit_gen_insn(jit_gencode_t gen, jit_function_t func,
 		}
 		break;
 
+	case JIT_OP_VBADD:
+	case JIT_OP_VBSUB:
+	case JIT_OP_VBEQ:
+	case JIT_OP_VBGT:
+	case JIT_OP_VIADD:
+	case JIT_OP_VISUB:
+	case JIT_OP_VIMUL:
+	case JIT_OP_VIEQ:
+	case JIT_OP_VIGT:
+	case JIT_OP_VFADD:
+	case JIT_OP_VFSUB:
+	case JIT_OP_VFMUL:
+	case JIT_OP_VFDIV:
+	case JIT_OP_VFMIN:
+	case JIT_OP_VFMAX:
+	case JIT_OP_VFSQRT:
+	case JIT_OP_VFEQ:
+	case JIT_OP_VFLT:
+	case JIT_OP_VFLE:
+	case JIT_OP_VDADD:
+	case JIT_OP_VDSUB:
+	case JIT_OP_VDMUL:
+	case JIT_OP_VDDIV:
+	case JIT_OP_VDMIN:
+	case JIT_OP_VDMAX:
+	case JIT_OP_VDSQRT:
+	case JIT_OP_VDEQ:
+	case JIT_OP_VDLT:
+	case JIT_OP_VDLE:
+	case JIT_OP_VAND:
+	case JIT_OP_VOR:
+	case JIT_OP_VXOR:
+		/* Vector operations work on the addresses of the operands */
+		load_value(gen, insn->dest, 0);
+		load_value(gen, insn->value1, 1);
+		if(insn->value2)
+		{
+			load_value(gen, insn->value2, 2);
+		}
+		jit_cache_opcode(gen, insn->opcode);
+		break;
+
+	case JIT_OP_VSHUFFLE:
+		/* Rearrange the elements of a vector */
+		load_value(gen, insn->dest, 0);
+		load_value(gen, insn->value1, 1);
+		jit_cache_opcode(gen, insn->opcode);
+		jit_cache_native(gen, jit_value_get_nint_constant(insn->value2));
+		break;
+
 	case JIT_OP_MARK_BREAKPOINT:
 		/* Mark the current location as a potential breakpoint */
 		jit_cache_opcode(gen, insn->opcode);
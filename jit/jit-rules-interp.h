@@ -70,12 +70,16 @@ extern	"C" {
 #define	jit_extra_gen_state	\
 			int working_area; \
 			int max_working_area; \
-			int extra_working_space
+			int extra_working_space; \
+			unsigned char *last_opcode_ptr; \
+			int last_opcode
 #define	jit_extra_gen_init(gen)	\
 			do { \
 				(gen)->working_area = 0; \
 				(gen)->max_working_area = 0; \
 				(gen)->extra_working_space = 0; \
+				(gen)->last_opcode_ptr = 0; \
+				(gen)->last_opcode = 0; \
 			} while (0)
 #define	jit_extra_gen_cleanup(gen)	do { ; } while (0)
 
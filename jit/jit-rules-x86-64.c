@@ -29,7 +29,12 @@
 #include "jit-gen-x86-64.h"
 #include "jit-reg-alloc.h"
 #include "jit-setjmp.h"
+#include "jit-cpuid-x86.h"
 #include <stdio.h>
+#include <stddef.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
 
 /*
  * Pseudo register numbers for the x86_64 registers. These are not the
@@ -104,15 +109,18 @@
 #define HAVE_RED_ZONE 1
 
 /*
- * Some declarations that should be replaced by querying the cpuinfo
- * if generating code for the current cpu.
+ * Optional instruction set extensions that the rules may use.
+ * The features of the host cpu are queried once by _jit_init_backend.
  */
-/*
-#define HAVE_X86_SSE_4_1 0
-#define HAVE_X86_SSE_4 0
-#define HAVE_X86_SSE_3 0
-#define HAVE_X86_FISTTP 0
-*/
+#define X86_64_FEATURE_SSE4_1	0x0001
+#define X86_64_FEATURE_POPCNT	0x0002
+#define X86_64_FEATURE_LZCNT	0x0004
+#define X86_64_FEATURE_BMI1		0x0008
+#define X86_64_FEATURE_BMI2		0x0010
+
+static unsigned int x86_64_features;
+
+static void x86_64_create_inline_cache_stubs(void);
 
 #define	TODO() \
 do { \
@@ -195,9 +203,107 @@ static _jit_regclass_t *x86_64_sreg;	/* general purpose registers that can*/
 static _jit_regclass_t *x86_64_freg;	/* X86_64 fpu registers */
 static _jit_regclass_t *x86_64_xreg;	/* X86_64 xmm registers */
 
+/*
+ * Names of the optional features for the "JIT_X86_64_ISA" environment
+ * variable.
+ */
+static struct
+{
+	const char *name;
+	unsigned int feature;
+
+} const x86_64_feature_names[] = {
+	{"sse4.1", X86_64_FEATURE_SSE4_1},
+	{"popcnt", X86_64_FEATURE_POPCNT},
+	{"lzcnt", X86_64_FEATURE_LZCNT},
+	{"bmi1", X86_64_FEATURE_BMI1},
+	{"bmi2", X86_64_FEATURE_BMI2}
+};
+#define	x86_64_num_feature_names	\
+	(sizeof(x86_64_feature_names) / sizeof(x86_64_feature_names[0]))
+
+/*
+ * Determine the optional features supported by the host cpu.
+ *
+ * The "JIT_X86_64_ISA" environment variable restricts the features
+ * to a comma separated list of names, so that the generated code
+ * does not depend on the host.  "baseline" selects plain SSE2 code.
+ */
+static unsigned int
+x86_64_detect_features(void)
+{
+	jit_cpuid_x86_t info;
+	unsigned int features = 0;
+	unsigned int allowed;
+	const char *isa;
+	unsigned int len;
+	unsigned int index;
+
+	if(_jit_cpuid_x86_get(JIT_X86CPUID_FEATURES, &info))
+	{
+		if(info.ecx & JIT_X86FEATURE2_SSE4_1)
+		{
+			features |= X86_64_FEATURE_SSE4_1;
+		}
+		if(info.ecx & JIT_X86FEATURE2_POPCNT)
+		{
+			features |= X86_64_FEATURE_POPCNT;
+		}
+	}
+	if(_jit_cpuid_x86_get_subleaf(JIT_X86CPUID_EXT_FEATURES, 0, &info))
+	{
+		if(info.ebx & JIT_X86FEATURE7_BMI1)
+		{
+			features |= X86_64_FEATURE_BMI1;
+		}
+		if(info.ebx & JIT_X86FEATURE7_BMI2)
+		{
+			features |= X86_64_FEATURE_BMI2;
+		}
+	}
+	if(_jit_cpuid_x86_get(JIT_X86CPUID_EXT_INFO, &info))
+	{
+		if(info.ecx & JIT_X86FEATUREX_LZCNT)
+		{
+			features |= X86_64_FEATURE_LZCNT;
+		}
+	}
+
+	isa = getenv("JIT_X86_64_ISA");
+	if(!isa)
+	{
+		return features;
+	}
+	allowed = 0;
+	while(*isa != '\0')
+	{
+		for(len = 0; isa[len] != '\0' && isa[len] != ','; ++len)
+		{
+			/* Find the end of the name */
+		}
+		for(index = 0; index < x86_64_num_feature_names; ++index)
+		{
+			if(jit_strlen(x86_64_feature_names[index].name) == len &&
+			   !jit_strncmp(x86_64_feature_names[index].name, isa, len))
+			{
+				allowed |= x86_64_feature_names[index].feature;
+			}
+		}
+		isa += len;
+		if(*isa == ',')
+		{
+			++isa;
+		}
+	}
+	return (features & allowed);
+}
+
 void
 _jit_init_backend(void)
 {
+	x86_64_features = x86_64_detect_features();
+	x86_64_create_inline_cache_stubs();
+
 	x86_64_reg = _jit_regclass_create(
 		"reg", JIT_REG_WORD | JIT_REG_LONG, 14,
 		X86_64_REG_RAX, X86_64_REG_RCX,
@@ -311,6 +417,7 @@ _jit_xmm1_reg_imm_size_float32(jit_gencode_t gen, unsigned char **inst_ptr,
 		/* We can use RIP relative addressing here */
 		x86_64_xmm1_reg_membase(inst, opc, reg,
 									 X86_64_RIP, offset, 0);
+		_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 	}
 	else if(((jit_nint)ptr >= jit_min_int) &&
 			((jit_nint)ptr <= jit_max_int))
@@ -354,6 +461,7 @@ _jit_xmm1_reg_imm_size_float64(jit_gencode_t gen, unsigned char **inst_ptr,
 		/* We can use RIP relative addressing here */
 		x86_64_xmm1_reg_membase(inst, opc, reg,
 									 X86_64_RIP, offset, 1);
+		_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 	}
 	else if(((jit_nint)ptr >= jit_min_int) &&
 			((jit_nint)ptr <= jit_max_int))
@@ -396,6 +504,7 @@ _jit_plops_reg_imm(jit_gencode_t gen, unsigned char **inst_ptr,
 	{
 		/* We can use RIP relative addressing here */
 		x86_64_plops_reg_membase(inst, opc, reg, X86_64_RIP, offset);
+		_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 		*inst_ptr = inst;
 		return 1;
 	}
@@ -438,6 +547,7 @@ _jit_plopd_reg_imm(jit_gencode_t gen, unsigned char **inst_ptr,
 	{
 		/* We can use RIP relative addressing here */
 		x86_64_plopd_reg_membase(inst, opc, reg, X86_64_RIP, offset);
+		_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 		*inst_ptr = inst;
 		return 1;
 	}
@@ -553,10 +663,12 @@ static unsigned char *
 x86_64_rounds_reg_reg(unsigned char *inst, int dreg, int sreg,
 					  int scratch_reg, X86_64_ROUNDMODE mode)
 {
+	if(x86_64_features & X86_64_FEATURE_SSE4_1)
+	{
+		x86_64_roundss_reg_reg(inst, dreg, sreg, mode);
+		return inst;
+	}
 #ifdef HAVE_RED_ZONE
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundss_reg_reg(inst, dreg, sreg, mode);
-#else
 	/* Copy the xmm register to the stack */
 	x86_64_movss_membase_reg(inst, X86_64_RSP, -16, sreg);
 	/* Set the fpu round mode */
@@ -570,10 +682,6 @@ x86_64_rounds_reg_reg(unsigned char *inst, int dreg, int sreg,
 	/* and move st(0) to the destination register */
 	x86_64_fstp_membase_size(inst, X86_64_RSP, -16, 4);
 	x86_64_movss_reg_membase(inst, dreg, X86_64_RSP, -16);
-#endif
-#else
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundss_reg_reg(inst, dreg, sreg, mode);
 #else
 	/* allocate space on the stack for two ints and one long value */
 	x86_64_sub_reg_imm_size(inst, X86_64_RSP, 16, 8);
@@ -592,7 +700,6 @@ x86_64_rounds_reg_reg(unsigned char *inst, int dreg, int sreg,
 	x86_64_movss_reg_regp(inst, dreg, X86_64_RSP);
 	/* restore the stack pointer */
 	x86_64_add_reg_imm_size(inst, X86_64_RSP, 16, 8);
-#endif
 #endif
 	return inst;
 }
@@ -601,10 +708,12 @@ static unsigned char *
 x86_64_rounds_reg_membase(unsigned char *inst, int dreg, int offset,
 						  int scratch_reg, X86_64_ROUNDMODE mode)
 {
+	if(x86_64_features & X86_64_FEATURE_SSE4_1)
+	{
+		x86_64_roundss_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
+		return inst;
+	}
 #ifdef HAVE_RED_ZONE
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundss_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
-#else
 	/* Load the value to the fpu */
 	x86_64_fld_membase_size(inst, X86_64_RBP, offset, 4);
 	/* Set the fpu round mode */
@@ -616,10 +725,6 @@ x86_64_rounds_reg_membase(unsigned char *inst, int dreg, int offset,
 	/* and move st(0) to the destination register */
 	x86_64_fstp_membase_size(inst, X86_64_RSP, -16, 4);
 	x86_64_movss_reg_membase(inst, dreg, X86_64_RSP, -16);
-#endif
-#else
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundss_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
 #else
 	/* allocate space on the stack for two ints and one long value */
 	x86_64_sub_reg_imm_size(inst, X86_64_RSP, 16, 8);
@@ -636,7 +741,6 @@ x86_64_rounds_reg_membase(unsigned char *inst, int dreg, int offset,
 	x86_64_movss_reg_regp(inst, dreg, X86_64_RSP);
 	/* restore the stack pointer */
 	x86_64_add_reg_imm_size(inst, X86_64_RSP, 16, 8);
-#endif
 #endif
 	return inst;
 }
@@ -649,10 +753,12 @@ static unsigned char *
 x86_64_roundd_reg_reg(unsigned char *inst, int dreg, int sreg,
 					  int scratch_reg, X86_64_ROUNDMODE mode)
 {
+	if(x86_64_features & X86_64_FEATURE_SSE4_1)
+	{
+		x86_64_roundsd_reg_reg(inst, dreg, sreg, mode);
+		return inst;
+	}
 #ifdef HAVE_RED_ZONE
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundsd_reg_reg(inst, dreg, sreg, mode);
-#else
 	/* Copy the xmm register to the stack */
 	x86_64_movsd_membase_reg(inst, X86_64_RSP, -16, sreg);
 	/* Set the fpu round mode */
@@ -666,10 +772,6 @@ x86_64_roundd_reg_reg(unsigned char *inst, int dreg, int sreg,
 	/* and move st(0) to the destination register */
 	x86_64_fstp_membase_size(inst, X86_64_RSP, -16, 8);
 	x86_64_movsd_reg_membase(inst, dreg, X86_64_RSP, -16);
-#endif
-#else
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundsd_reg_reg(inst, dreg, sreg, mode);
 #else
 	/* allocate space on the stack for two ints and one long value */
 	x86_64_sub_reg_imm_size(inst, X86_64_RSP, 16, 8);
@@ -688,7 +790,6 @@ x86_64_roundd_reg_reg(unsigned char *inst, int dreg, int sreg,
 	x86_64_movsd_reg_regp(inst, dreg, X86_64_RSP);
 	/* restore the stack pointer */
 	x86_64_add_reg_imm_size(inst, X86_64_RSP, 16, 8);
-#endif
 #endif
 	return inst;
 }
@@ -697,10 +798,12 @@ static unsigned char *
 x86_64_roundd_reg_membase(unsigned char *inst, int dreg, int offset,
 						  int scratch_reg, X86_64_ROUNDMODE mode)
 {
+	if(x86_64_features & X86_64_FEATURE_SSE4_1)
+	{
+		x86_64_roundsd_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
+		return inst;
+	}
 #ifdef HAVE_RED_ZONE
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundsd_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
-#else
 	/* Load the value to the fpu */
 	x86_64_fld_membase_size(inst, X86_64_RBP, offset, 8);
 	/* Set the fpu round mode */
@@ -712,10 +815,6 @@ x86_64_roundd_reg_membase(unsigned char *inst, int dreg, int offset,
 	/* and move st(0) to the destination register */
 	x86_64_fstp_membase_size(inst, X86_64_RSP, -16, 8);
 	x86_64_movsd_reg_membase(inst, dreg, X86_64_RSP, -16);
-#endif
-#else
-#ifdef HAVE_X86_SSE_4_1
-	x86_64_roundsd_reg_membase(inst, dreg, X86_64_RBP, offset, mode);
 #else
 	/* allocate space on the stack for two ints and one long value */
 	x86_64_sub_reg_imm_size(inst, X86_64_RSP, 16, 8);
@@ -732,7 +831,6 @@ x86_64_roundd_reg_membase(unsigned char *inst, int dreg, int offset,
 	x86_64_movsd_reg_regp(inst, dreg, X86_64_RSP);
 	/* restore the stack pointer */
 	x86_64_add_reg_imm_size(inst, X86_64_RSP, 16, 8);
-#endif
 #endif
 	return inst;
 }
@@ -818,57 +916,305 @@ x86_64_nfloat_to_int(unsigned char *inst, int dreg, int scratch_reg, int size)
 }
 
 /*
- * Call a function
+ * Load an address into a register with an instruction that always has
+ * a 64-bit immediate, so that the address can be relocated.
  */
 static unsigned char *
-x86_64_call_code(unsigned char *inst, jit_nint func)
+x86_64_mov_reg_address(jit_gencode_t gen, unsigned char *inst, int reg,
+					   jit_nint address, jit_function_t callee)
+{
+	x86_64_rex_emit(inst, 8, 0, 0, reg);
+	*inst++ = (unsigned char)0xb8 + (reg & 0x7);
+	x86_64_imm_emit64(inst, address);
+	_jit_gen_add_reloc(gen, inst - 8, JIT_RELOC_ABS, (void *)address, callee);
+	return inst;
+}
+
+/*
+ * Call a function.  If "callee" is not NULL, then "func" is its closure.
+ * Pre-compiled code calls native functions through a register, because
+ * it may be loaded too far away from them for a 32-bit offset.
+ */
+static unsigned char *
+x86_64_call_code(jit_gencode_t gen, unsigned char *inst, jit_nint func,
+				 jit_function_t callee)
 {
 	jit_nint offset;
 
 	x86_64_mov_reg_imm_size(inst, X86_64_RAX, 8, 4);
 	offset = func - ((jit_nint)inst + 5);
-	if(offset >= jit_min_int && offset <= jit_max_int)
+	if(offset >= jit_min_int && offset <= jit_max_int &&
+	   (callee || !gen->reloc_table))
 	{
 		/* We can use the immediate call */
 		x86_64_call_imm(inst, offset);
+		_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32,
+						   (void *)func, callee);
 	}
 	else
 	{
 		/* We have to do a call via register */
-		x86_64_mov_reg_imm_size(inst, X86_64_SCRATCH, func, 8);
+		inst = x86_64_mov_reg_address(gen, inst, X86_64_SCRATCH, func, callee);
 		x86_64_call_reg(inst, X86_64_SCRATCH);
 	}
 	return inst;
 }
 
 /*
- * Jump to a function
+ * Jump to a function.  The arguments are the same as for
+ * "x86_64_call_code".
  */
 static unsigned char *
-x86_64_jump_to_code(unsigned char *inst, jit_nint func)
+x86_64_jump_to_code(jit_gencode_t gen, unsigned char *inst, jit_nint func,
+					jit_function_t callee)
 {
 	jit_nint offset;
 
 	offset = func - ((jit_nint)inst + 5);
-	if(offset >= jit_min_int && offset <= jit_max_int)
+	if(offset >= jit_min_int && offset <= jit_max_int &&
+	   (callee || !gen->reloc_table))
 	{
 		/* We can use the immediate call */
 		x86_64_jmp_imm(inst, offset);
+		_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32,
+						   (void *)func, callee);
 	}
 	else
 	{
 		/* We have to do a call via register */
-		x86_64_mov_reg_imm_size(inst, X86_64_SCRATCH, func, 8);
+		inst = x86_64_mov_reg_address(gen, inst, X86_64_SCRATCH, func, callee);
 		x86_64_jmp_reg(inst, X86_64_SCRATCH);
 	}
 	return inst;
 }
 
+/*
+ * Inline caches for indirect calls.
+ *
+ * With JIT_OPTION_INLINE_CACHE an indirect call site compares the target
+ * in the scratch register with the targets it has seen before and calls
+ * a matching one directly:
+ *
+ *		cmp		targets[0](%rip), %r11
+ *		jne		1f
+ *		call	target0
+ *		jmp		3f
+ *	1:	...
+ *		call	*handler(%rip)
+ *		jmp		3f
+ *	2:	jmp		*%r11
+ *	3:
+ *
+ * The handler is initially the miss stub.  It records the target in the
+ * next free entry and patches the direct call of that entry, which calls
+ * label 2 until then.  The direct call is patched before the target is
+ * stored, so other threads never see a half updated entry.  Once all
+ * entries are in use the handler is replaced by a stub that just jumps
+ * to the target.
+ */
+#define X86_64_INLINE_CACHE_MAX		4
+
+typedef struct
+{
+	void			*targets[X86_64_INLINE_CACHE_MAX];
+	void			*handler;
+	unsigned char	*calls[X86_64_INLINE_CACHE_MAX];
+	int				num_entries;
+	int				num_targets;
+
+} x86_64_inline_cache_t;
+
+static unsigned char *x86_64_inline_cache_miss_stub;
+static unsigned char *x86_64_inline_cache_jump_stub;
+
+/*
+ * Called by the miss stub with the return address of the call site,
+ * which directly follows the "call *handler(%rip)" instruction.
+ */
+static void
+x86_64_inline_cache_miss(unsigned char *return_address, void *target)
+{
+	x86_64_inline_cache_t *cache;
+	unsigned char *call;
+	jit_nint offset;
+	int index;
+
+	cache = (x86_64_inline_cache_t *)
+		(return_address + *((jit_int *)(return_address - 4))
+		 - offsetof(x86_64_inline_cache_t, handler));
+
+	jit_mutex_lock(&_jit_global_lock);
+	if(cache->handler == x86_64_inline_cache_miss_stub)
+	{
+		/* Another thread may have added the target already */
+		for(index = 0; index < cache->num_targets; ++index)
+		{
+			if(cache->targets[index] == target)
+			{
+				jit_mutex_unlock(&_jit_global_lock);
+				return;
+			}
+		}
+		if(cache->num_targets < cache->num_entries)
+		{
+			call = cache->calls[cache->num_targets];
+			offset = (jit_nint)target - ((jit_nint)call + 4);
+			if(offset >= jit_min_int && offset <= jit_max_int)
+			{
+				*((jit_int *)call) = (jit_int)offset;
+				_jit_flush_exec(call, 4);
+				*((void * volatile *)&(cache->targets[cache->num_targets]))
+					= target;
+				++(cache->num_targets);
+				jit_mutex_unlock(&_jit_global_lock);
+				return;
+			}
+		}
+
+		/* The site is megamorphic or the target is out of reach */
+		cache->handler = x86_64_inline_cache_jump_stub;
+	}
+	jit_mutex_unlock(&_jit_global_lock);
+}
+
+/*
+ * Create the stubs shared by all inline caches.  The miss stub is
+ * entered like the target itself, so it has to preserve all argument
+ * registers, %rax with the number of vector registers used, and %r11.
+ */
+static void
+x86_64_create_inline_cache_stubs(void)
+{
+	static const int word_regs[] = {X86_64_RDI, X86_64_RSI, X86_64_RDX,
+									X86_64_RCX, X86_64_R8, X86_64_R9,
+									X86_64_RAX, X86_64_SCRATCH};
+	unsigned char *inst;
+	int index;
+
+	inst = (unsigned char *)_jit_malloc_exec(256);
+	if(!inst)
+	{
+		return;
+	}
+
+	x86_64_inline_cache_jump_stub = inst;
+	x86_64_jmp_reg(inst, X86_64_SCRATCH);
+
+	inst = x86_64_inline_cache_jump_stub + 16;
+	x86_64_inline_cache_miss_stub = inst;
+	x86_64_push_reg_size(inst, X86_64_RBP, 8);
+	x86_64_mov_reg_reg_size(inst, X86_64_RBP, X86_64_RSP, 8);
+	x86_64_sub_reg_imm_size(inst, X86_64_RSP, 8 * 8 + 8 * 16, 8);
+	for(index = 0; index < 8; ++index)
+	{
+		x86_64_mov_membase_reg_size(inst, X86_64_RSP, index * 8,
+									word_regs[index], 8);
+		x86_64_movups_membase_reg(inst, X86_64_RSP, 64 + index * 16,
+								  X86_64_XMM0 + index);
+	}
+	x86_64_mov_reg_membase_size(inst, X86_64_RDI, X86_64_RBP, 8, 8);
+	x86_64_mov_reg_reg_size(inst, X86_64_RSI, X86_64_SCRATCH, 8);
+	x86_64_mov_reg_imm_size(inst, X86_64_SCRATCH,
+							(jit_nint)x86_64_inline_cache_miss, 8);
+	x86_64_call_reg(inst, X86_64_SCRATCH);
+	for(index = 0; index < 8; ++index)
+	{
+		x86_64_mov_reg_membase_size(inst, word_regs[index], X86_64_RSP,
+									index * 8, 8);
+		x86_64_movups_reg_membase(inst, X86_64_XMM0 + index, X86_64_RSP,
+								  64 + index * 16);
+	}
+	x86_64_mov_reg_reg_size(inst, X86_64_RSP, X86_64_RBP, 8);
+	x86_64_pop_reg_size(inst, X86_64_RBP, 8);
+	x86_64_jmp_reg(inst, X86_64_SCRATCH);
+
+	_jit_flush_exec(x86_64_inline_cache_jump_stub, 256);
+}
+
+/*
+ * Call the function whose address is in the scratch register, through
+ * an inline cache if the context asks for one.
+ */
+static unsigned char *
+x86_64_call_indirect(jit_gencode_t gen, unsigned char *inst,
+					 jit_function_t func)
+{
+	x86_64_inline_cache_t *cache;
+	unsigned char *done[X86_64_INLINE_CACHE_MAX + 1];
+	unsigned char *next;
+	unsigned char *handler;
+	jit_nint offset;
+	int entries;
+	int index;
+
+	x86_64_mov_reg_imm_size(inst, X86_64_RAX, 8, 4);
+
+	entries = (int)jit_context_get_meta_numeric(gen->context,
+												JIT_OPTION_INLINE_CACHE);
+	if(entries <= 0 || func->builder->position_independent
+	   || gen->reloc_table || !x86_64_inline_cache_miss_stub)
+	{
+		x86_64_call_reg(inst, X86_64_SCRATCH);
+		return inst;
+	}
+	if(entries > X86_64_INLINE_CACHE_MAX)
+	{
+		entries = X86_64_INLINE_CACHE_MAX;
+	}
+
+	cache = (x86_64_inline_cache_t *)
+		_jit_gen_alloc(gen, sizeof(x86_64_inline_cache_t));
+	_jit_gen_check_space(gen, (inst - gen->ptr) + 16 * entries + 32);
+	offset = (jit_nint)cache - (jit_nint)inst;
+	if(offset < jit_min_int / 2 || offset > jit_max_int / 2)
+	{
+		x86_64_call_reg(inst, X86_64_SCRATCH);
+		return inst;
+	}
+	jit_memzero(cache, sizeof(x86_64_inline_cache_t));
+	cache->handler = x86_64_inline_cache_miss_stub;
+	cache->num_entries = entries;
+
+	for(index = 0; index < entries; ++index)
+	{
+		x86_64_cmp_reg_membase_size(inst, X86_64_SCRATCH, X86_64_RIP, 0, 8);
+		*((jit_int *)(inst - 4)) =
+			(jit_int)((unsigned char *)&(cache->targets[index]) - inst);
+		next = inst;
+		x86_branch8(inst, X86_CC_NE, 0, 0);
+		x86_64_call_imm(inst, 0);
+		cache->calls[index] = inst - 4;
+		done[index] = inst;
+		x86_jump8(inst, 0);
+		x86_patch(next, inst);
+	}
+	x86_64_call_membase(inst, X86_64_RIP, 0);
+	*((jit_int *)(inst - 4)) =
+		(jit_int)((unsigned char *)&(cache->handler) - inst);
+	done[entries] = inst;
+	x86_jump8(inst, 0);
+
+	/* The direct calls go to the indirect jump until they are patched */
+	handler = inst;
+	x86_64_jmp_reg(inst, X86_64_SCRATCH);
+	for(index = 0; index < entries; ++index)
+	{
+		*((jit_int *)(cache->calls[index])) =
+			(jit_int)(handler - (cache->calls[index] + 4));
+	}
+	for(index = 0; index <= entries; ++index)
+	{
+		x86_patch(done[index], inst);
+	}
+	return inst;
+}
+
 /*
  * Throw a builtin exception.
  */
 static unsigned char *
-throw_builtin(unsigned char *inst, jit_function_t func, int type)
+throw_builtin(jit_gencode_t gen, unsigned char *inst, jit_function_t func,
+			  int type)
 {
 	/* We need to update "catch_pc" if we have a "try" block */
 	if(func->builder->setjmp_value != 0)
@@ -885,7 +1231,7 @@ throw_builtin(unsigned char *inst, jit_function_t func, int type)
 	x86_64_mov_reg_imm_size(inst, X86_64_RDI, type, 4);
 
 	/* Call the "jit_exception_builtin" function, which will never return */
-	return x86_64_call_code(inst, (jit_nint)jit_exception_builtin);
+	return x86_64_call_code(gen, inst, (jit_nint)jit_exception_builtin, 0);
 }
 
 /*
@@ -1409,10 +1755,12 @@ xmm_cmp_reg_imm(jit_gencode_t gen, unsigned char *inst, int xreg, void *imm,
 		if(is_double)
 		{
 			x86_64_ucomisd_reg_membase(inst, xreg, X86_64_RIP, offset);
+			_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 		}
 		else
 		{
 			x86_64_ucomiss_reg_membase(inst, xreg, X86_64_RIP, offset);
+			_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 		}
 	}
 	else if(((jit_nint)ptr >= jit_min_int) &&
@@ -1816,6 +2164,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 						{
 							/* We can use RIP relative addressing here */
 							x86_64_fld_membase_size(inst, X86_64_RIP, offset, 4);
+							_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 						}
 						else if(((jit_nint)ptr >= jit_min_int) &&
 								((jit_nint)ptr <= jit_max_int))
@@ -1885,6 +2234,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 						{
 							/* We can use RIP relative addressing here */
 							x86_64_fld_membase_size(inst, X86_64_RIP, offset, 8);
+							_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 						}
 						else if(((jit_nint)ptr >= jit_min_int) &&
 								((jit_nint)ptr <= jit_max_int))
@@ -1931,6 +2281,7 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 					{
 						/* We can use RIP relative addressing here */
 						x86_64_movsd_reg_membase(inst, xmm_reg, X86_64_RIP, offset);
+						_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 					}
 					else if(((jit_nint)ptr >= jit_min_int) &&
 							((jit_nint)ptr <= jit_max_int))
@@ -1968,10 +2319,12 @@ _jit_gen_load_value(jit_gencode_t gen, int reg, int other_reg, jit_value_t value
 							if(sizeof(jit_nfloat) == sizeof(jit_float64))
 							{
 								x86_64_fld_membase_size(inst, X86_64_RIP, offset, 8);
+								_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 							}
 							else
 							{
 								x86_64_fld_membase_size(inst, X86_64_RIP, offset, 10);
+								_jit_gen_add_reloc(gen, inst - 4, JIT_RELOC_REL32, ptr, 0);
 							}
 						}
 						else if(((jit_nint)ptr >= jit_min_int) &&
@@ -2390,22 +2743,17 @@ _jit_gen_get_elf_info(jit_elf_info_t *info)
 	info->abi_version = 0;
 }
 
-void *
-_jit_gen_prolog(jit_gencode_t gen, jit_function_t func, void *buf)
+/*
+ * Get the size of the frame that the prolog allocates with the first
+ * adjustment of the stack pointer, and the number of registers that are
+ * saved in it.
+ */
+static int
+get_frame_size(jit_gencode_t gen, jit_function_t func, int *regs_to_save)
 {
-	unsigned char prolog[JIT_PROLOG_SIZE];
-	unsigned char *inst = prolog;
 	int reg;
 	int frame_size = 0;
-	int regs_to_save = 0;
-
-	/* Push ebp onto the stack */
-	x86_64_push_reg_size(inst, X86_64_RBP, 8);
-
-	/* Initialize EBP for the current frame */
-	x86_64_mov_reg_reg_size(inst, X86_64_RBP, X86_64_RSP, 8);
 
-	/* Allocate space for the local variable frame */
 	if(func->builder->frame_size > 0)
 	{
 		/* Make sure that the framesize is a multiple of 8 bytes */
@@ -2413,23 +2761,24 @@ _jit_gen_prolog(jit_gencode_t gen, jit_function_t func, void *buf)
 	}
 
 	/* Get the number of registers we need to preserve */
+	*regs_to_save = 0;
 	for(reg = 0; reg < 14; ++reg)
 	{
 		if(jit_reg_is_used(gen->touched, reg) &&
 		   (_jit_reg_info[reg].flags & JIT_REG_CALL_USED) == 0)
 		{
-			++regs_to_save;
+			++(*regs_to_save);
 		}
 	}
 
 	/* add the register save area to the initial frame size */
-	frame_size += (regs_to_save << 3);
+	frame_size += (*regs_to_save << 3);
 
 #ifdef JIT_USE_PARAM_AREA
 	/* Add the param area to the frame_size if the additional offset
 	   doesnt cause the offsets in the register saves become 4 bytes */
 	if(func->builder->param_area_size > 0 &&
-	   (func->builder->param_area_size <= 0x50 || regs_to_save == 0))
+	   (func->builder->param_area_size <= 0x50 || *regs_to_save == 0))
 	{
 		frame_size += func->builder->param_area_size;
 	}
@@ -2437,8 +2786,26 @@ _jit_gen_prolog(jit_gencode_t gen, jit_function_t func, void *buf)
 
 	/* Make sure that the framesize is a multiple of 16 bytes */
 	/* so that the final RSP will be alligned on a 16byte boundary. */
-	frame_size = (frame_size + 0xf) & ~0xf;
+	return (frame_size + 0xf) & ~0xf;
+}
 
+void *
+_jit_gen_prolog(jit_gencode_t gen, jit_function_t func, void *buf)
+{
+	unsigned char prolog[JIT_PROLOG_SIZE];
+	unsigned char *inst = prolog;
+	int reg;
+	int frame_size;
+	int regs_to_save;
+
+	/* Push ebp onto the stack */
+	x86_64_push_reg_size(inst, X86_64_RBP, 8);
+
+	/* Initialize EBP for the current frame */
+	x86_64_mov_reg_reg_size(inst, X86_64_RBP, X86_64_RSP, 8);
+
+	/* Allocate space for the local variable frame */
+	frame_size = get_frame_size(gen, func, &regs_to_save);
 	if(frame_size > 0)
 	{
 		x86_64_sub_reg_imm_size(inst, X86_64_RSP, frame_size, 8);
@@ -2594,12 +2961,263 @@ _jit_gen_epilog(jit_gencode_t gen, jit_function_t func)
 	x86_64_mov_reg_reg_size(inst, X86_64_RSP, X86_64_RBP, 8);
 	x86_64_pop_reg_size(inst, X86_64_RBP, 8);
 
-	/* and return */
+	/* and return.  The unwind information needs to know where the
+	   frame register is popped */
+	gen->epilog_ret = inst;
 	x86_64_ret(inst);
 
 	gen->ptr = inst;
 }
 
+/*
+ * Build the exception table of a function that has one.  This is called
+ * once the prolog is in place and the size of the frame is known.
+ */
+_jit_catch_table_t
+_jit_gen_catch_table(jit_gencode_t gen, jit_function_t func)
+{
+	_jit_catch_table_t table;
+	jit_block_t block;
+	int regs_to_save;
+
+	/* Nothing can be caught if the function has no catcher */
+	block = jit_block_from_label(func, func->builder->catcher_label);
+	if(!block || !block->address)
+	{
+		return 0;
+	}
+
+	table = (_jit_catch_table_t) _jit_gen_alloc(gen, sizeof(struct _jit_catch_table));
+	table->start = gen->code_start;
+	table->end = gen->code_end;
+	table->catcher = block->address;
+
+	/* The catcher runs with the stack pointer where the prolog left it */
+	table->stack_size = get_frame_size(gen, func, &regs_to_save);
+#ifdef JIT_USE_PARAM_AREA
+	if(func->builder->param_area_size > 0x50 && regs_to_save > 0)
+	{
+		table->stack_size += func->builder->param_area_size;
+	}
+#endif /* JIT_USE_PARAM_AREA */
+
+	table->thrown_pc_offset = (jit_int) func->builder->thrown_pc->frame_offset;
+	return table;
+}
+
+/*
+ * DWARF call frame instructions and register numbers that are used
+ * in the unwind information.
+ */
+#define DW_CFA_advance_loc		0x40
+#define DW_CFA_offset			0x80
+#define DW_CFA_restore			0xc0
+#define DW_CFA_nop			0x00
+#define DW_CFA_advance_loc1		0x02
+#define DW_CFA_advance_loc2		0x03
+#define DW_CFA_advance_loc4		0x04
+#define DW_CFA_def_cfa			0x0c
+#define DW_CFA_def_cfa_register		0x0d
+#define DW_CFA_def_cfa_offset		0x0e
+#define DW_REG_RBP			6
+#define DW_REG_RSP			7
+#define DW_REG_RA			16
+
+/*
+ * Map the cpu register numbers to the DWARF register numbers.
+ */
+static const unsigned char dwarf_regs[16] = {
+	0, 2, 1, 3, 7, 6, 4, 5, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+static unsigned char *
+put_uleb128(unsigned char *buf, jit_nuint value)
+{
+	do
+	{
+		*buf = (unsigned char)(value & 0x7f);
+		value >>= 7;
+		if(value != 0)
+		{
+			*buf |= 0x80;
+		}
+		++buf;
+	}
+	while(value != 0);
+	return buf;
+}
+
+static unsigned char *
+put_uint32(unsigned char *buf, jit_uint value)
+{
+	jit_memcpy(buf, &value, sizeof(jit_uint));
+	return buf + sizeof(jit_uint);
+}
+
+static unsigned char *
+put_uint64(unsigned char *buf, jit_ulong value)
+{
+	jit_memcpy(buf, &value, sizeof(jit_ulong));
+	return buf + sizeof(jit_ulong);
+}
+
+static unsigned char *
+put_advance(unsigned char *buf, jit_nuint delta)
+{
+	if(delta < 0x40)
+	{
+		*buf++ = (unsigned char)(DW_CFA_advance_loc | delta);
+	}
+	else if(delta < 0x100)
+	{
+		*buf++ = DW_CFA_advance_loc1;
+		*buf++ = (unsigned char) delta;
+	}
+	else if(delta < 0x10000)
+	{
+		jit_ushort value = (jit_ushort) delta;
+		*buf++ = DW_CFA_advance_loc2;
+		jit_memcpy(buf, &value, sizeof(jit_ushort));
+		buf += sizeof(jit_ushort);
+	}
+	else
+	{
+		*buf++ = DW_CFA_advance_loc4;
+		buf = put_uint32(buf, (jit_uint) delta);
+	}
+	return buf;
+}
+
+/*
+ * Pad a CIE or FDE with "nop" instructions to a multiple of the pointer
+ * size and fill in its length.
+ */
+static unsigned char *
+end_entry(unsigned char *start, unsigned char *buf)
+{
+	while(((buf - start) % sizeof(void *)) != 0)
+	{
+		*buf++ = DW_CFA_nop;
+	}
+	put_uint32(start, (jit_uint)(buf - start - sizeof(jit_uint)));
+	return buf;
+}
+
+/*
+ * Build the ".eh_frame" data that describes the frame of the code that
+ * was just generated for the system unwinder.  The prolog pushes the
+ * frame pointer, sets it up and saves the callee-saved registers below
+ * the frame.  From then on the canonical frame address is 16 bytes above
+ * the frame pointer until the "pop" of the frame pointer just before the
+ * "ret" of the epilog.  The short sequence that leaves the frame before
+ * a tail call is not described.
+ */
+_jit_unwind_info_t
+_jit_gen_unwind_info(jit_gencode_t gen, jit_function_t func)
+{
+	unsigned char prolog[JIT_PROLOG_SIZE];
+	unsigned char data[256];
+	unsigned char *buf;
+	unsigned char *fde;
+	unsigned char *prolog_end;
+	_jit_unwind_info_t info;
+	jit_nuint prolog_size;
+	int frame_size;
+	int regs_to_save;
+	int current_offset;
+	int reg;
+
+	/* Generate the prolog again to find out how long it is */
+	prolog_size = (prolog + JIT_PROLOG_SIZE)
+		- (unsigned char *) _jit_gen_prolog(gen, func, prolog);
+	prolog_end = gen->code_start + prolog_size;
+
+	/* The CIE has the state on entry, with the return address just
+	   above the stack pointer */
+	buf = data;
+	buf = put_uint32(buf, 0);
+	buf = put_uint32(buf, 0);
+	*buf++ = 1;
+	*buf++ = 'z';
+	*buf++ = 'R';
+	*buf++ = 0;
+	buf = put_uleb128(buf, 1);
+	*buf++ = 0x78;			/* data alignment -8 */
+	*buf++ = DW_REG_RA;
+	buf = put_uleb128(buf, 1);
+	*buf++ = 0x00;			/* DW_EH_PE_absptr */
+	*buf++ = DW_CFA_def_cfa;
+	buf = put_uleb128(buf, DW_REG_RSP);
+	buf = put_uleb128(buf, 8);
+	*buf++ = DW_CFA_offset | DW_REG_RA;
+	buf = put_uleb128(buf, 1);
+	buf = end_entry(data, buf);
+
+	/* The FDE covers all of the code of the function */
+	fde = buf;
+	buf = put_uint32(buf, 0);
+	buf = put_uint32(buf, (jit_uint)(buf - data));
+	buf = put_uint64(buf, (jit_ulong)(jit_nuint) gen->code_start);
+	buf = put_uint64(buf, (jit_ulong)(gen->code_end - gen->code_start));
+	buf = put_uleb128(buf, 0);
+
+	/* "push %rbp" */
+	buf = put_advance(buf, 1);
+	*buf++ = DW_CFA_def_cfa_offset;
+	buf = put_uleb128(buf, 16);
+	*buf++ = DW_CFA_offset | DW_REG_RBP;
+	buf = put_uleb128(buf, 2);
+
+	/* "mov %rsp, %rbp" */
+	buf = put_advance(buf, 3);
+	*buf++ = DW_CFA_def_cfa_register;
+	buf = put_uleb128(buf, DW_REG_RBP);
+
+	/* The saved registers, in the same order as the prolog stores them */
+	buf = put_advance(buf, prolog_size - 4);
+	frame_size = get_frame_size(gen, func, &regs_to_save);
+	current_offset = 0;
+#ifdef JIT_USE_PARAM_AREA
+	if(func->builder->param_area_size > 0 &&
+	   func->builder->param_area_size <= 0x50)
+	{
+		current_offset = func->builder->param_area_size;
+	}
+#endif /* JIT_USE_PARAM_AREA */
+	for(reg = 0; reg <= 14; ++reg)
+	{
+		if(jit_reg_is_used(gen->touched, reg) &&
+		   (_jit_reg_info[reg].flags & JIT_REG_CALL_USED) == 0)
+		{
+			*buf++ = DW_CFA_offset | dwarf_regs[_jit_reg_info[reg].cpu_reg];
+			buf = put_uleb128(buf, (16 + frame_size - current_offset) / 8);
+			current_offset += 8;
+		}
+	}
+
+	/* "pop %rbp" at the end of the epilog */
+	if(gen->epilog_ret > prolog_end)
+	{
+		buf = put_advance(buf, gen->epilog_ret - prolog_end);
+		*buf++ = DW_CFA_def_cfa;
+		buf = put_uleb128(buf, DW_REG_RSP);
+		buf = put_uleb128(buf, 8);
+		*buf++ = DW_CFA_restore | DW_REG_RBP;
+	}
+	buf = end_entry(fde, buf);
+
+	/* The list of entries ends with a zero length */
+	buf = put_uint32(buf, 0);
+
+	info = (_jit_unwind_info_t) jit_malloc(sizeof(struct _jit_unwind_info) + (buf - data));
+	if(info)
+	{
+		info->next = 0;
+		jit_memcpy(info->eh_frame, data, buf - data);
+	}
+	return info;
+}
+
 /*
  * Copy a small block. This generates inlined code.
  *
@@ -2729,7 +3347,7 @@ memory_copy(jit_gencode_t gen, unsigned char *inst,
 	{
 		x86_64_add_reg_imm_size(inst, X86_64_RDI, doffset, 8);
 	}
-	inst = x86_64_call_code(inst, (jit_nint)jit_memcpy);
+	inst = x86_64_call_code(gen, inst, (jit_nint)jit_memcpy, 0);
 	return inst;
 }
 
@@ -2817,6 +3435,61 @@ small_block_set(jit_gencode_t gen, unsigned char *inst,
 	return inst;
 }
 
+/*
+ * Apply a packed xmm operation to two vectors in the stack frame and
+ * store the result into a third.  The 0x66 prefix is output if
+ * "prefix" is non-zero.  If "imm" is not negative then it is output
+ * as the immediate operand of the instruction.  The vectors might not
+ * be aligned on a 16-byte boundary, so they are moved with movups.
+ */
+static unsigned char *
+vector_op(unsigned char *inst, int prefix, int opc, int imm,
+		  jit_nint doffset, jit_nint offset1, jit_nint offset2,
+		  int xreg1, int xreg2)
+{
+	x86_64_movups_reg_membase(inst, xreg1, X86_64_RBP, offset1);
+	x86_64_movups_reg_membase(inst, xreg2, X86_64_RBP, offset2);
+	if(prefix)
+	{
+		x86_64_plopd_reg_reg(inst, opc, xreg1, xreg2);
+	}
+	else
+	{
+		x86_64_plops_reg_reg(inst, opc, xreg1, xreg2);
+	}
+	if(imm >= 0)
+	{
+		*inst++ = (unsigned char)imm;
+	}
+	x86_64_movups_membase_reg(inst, X86_64_RBP, doffset, xreg1);
+	return inst;
+}
+
+/*
+ * Multiply two vectors of 32-bit integers.  SSE2 has no pmulld, so
+ * the even and odd elements are multiplied separately with pmuludq
+ * and the low halves of the products are interleaved.
+ */
+static unsigned char *
+vector_imul(unsigned char *inst, jit_nint doffset,
+			jit_nint offset1, jit_nint offset2,
+			int xreg1, int xreg2, int xreg3, int xreg4)
+{
+	x86_64_movups_reg_membase(inst, xreg1, X86_64_RBP, offset1);
+	x86_64_movups_reg_membase(inst, xreg2, X86_64_RBP, offset2);
+	x86_64_movaps_reg_reg(inst, xreg3, xreg1);
+	x86_64_movaps_reg_reg(inst, xreg4, xreg2);
+	x86_64_plopd_reg_reg(inst, XMM_PMULUDQ, xreg1, xreg2);
+	x86_64_psrlq_reg_imm(inst, xreg3, 32);
+	x86_64_psrlq_reg_imm(inst, xreg4, 32);
+	x86_64_plopd_reg_reg(inst, XMM_PMULUDQ, xreg3, xreg4);
+	x86_64_pshufd_reg_reg(inst, xreg1, xreg1, 0x08);
+	x86_64_pshufd_reg_reg(inst, xreg3, xreg3, 0x08);
+	x86_64_plopd_reg_reg(inst, XMM_PUNPCKLDQ, xreg1, xreg3);
+	x86_64_movups_membase_reg(inst, X86_64_RBP, doffset, xreg1);
+	return inst;
+}
+
 void
 _jit_gen_start_block(jit_gencode_t gen, jit_block_t block)
 {
@@ -114,11 +114,13 @@ extern	"C" {
  */
 
 #define jit_extra_gen_state	\
-	void *alloca_fixup
+	void *alloca_fixup;	\
+	unsigned char *epilog_ret
 
 #define jit_extra_gen_init(gen)	\
 	do {	\
 		(gen)->alloca_fixup = 0;	\
+		(gen)->epilog_ret = 0;	\
 	} while (0)
 
 #define jit_extra_gen_cleanup(gen)	do { ; } while (0)
@@ -134,6 +136,23 @@ extern	"C" {
  */
 #define JIT_USE_PARAM_AREA
 
+/*
+ * Functions with a "try" may be compiled with an exception table that
+ * is found with the unwinder of the GNU runtime
+ * (see JIT_OPTION_EXCEPTION_TABLES).
+ */
+#if defined(__GNUC__)
+#define JIT_USE_EXCEPTION_TABLES
+#endif
+
+/*
+ * The frame of the generated code may be described to the unwinder of
+ * the GNU runtime in the ".eh_frame" format (see JIT_OPTION_UNWIND_INFO).
+ */
+#if defined(__GNUC__)
+#define JIT_USE_UNWIND_INFO
+#endif
+
 #ifdef	__cplusplus
 };
 #endif
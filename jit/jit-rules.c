@@ -758,9 +758,47 @@ _jit_gen_alloc(jit_gencode_t gen, unsigned long size)
 		jit_exception_builtin(JIT_RESULT_MEMORY_FULL);
 	}
 	gen->mem_limit = _jit_memory_get_limit(gen->context);
+	if(gen->reloc_table)
+	{
+		/* The data is allocated downwards from the end of the page */
+		if(!(gen->reloc_table->data_end))
+		{
+			gen->reloc_table->data_end = (unsigned char *)ptr + size;
+		}
+		gen->reloc_table->data_start = (unsigned char *)ptr;
+	}
 	return ptr;
 }
 
+void
+_jit_gen_add_reloc(jit_gencode_t gen, unsigned char *field, int type,
+		   void *target, jit_function_t callee)
+{
+	_jit_reloc_table_t table = gen->reloc_table;
+	_jit_reloc_t *reloc;
+	if(!table)
+	{
+		return;
+	}
+	if(table->num_relocs >= table->max_relocs)
+	{
+		table = (_jit_reloc_table_t)jit_realloc
+			(table, sizeof(struct _jit_reloc_table) +
+			 table->max_relocs * 2 * sizeof(_jit_reloc_t));
+		if(!table)
+		{
+			jit_exception_builtin(JIT_RESULT_OUT_OF_MEMORY);
+		}
+		table->max_relocs = table->max_relocs * 2 + 1;
+		gen->reloc_table = table;
+	}
+	reloc = &(table->relocs[(table->num_relocs)++]);
+	reloc->field = field;
+	reloc->type = type;
+	reloc->target = target;
+	reloc->callee = callee;
+}
+
 int _jit_int_lowest_byte(void)
 {
 	union
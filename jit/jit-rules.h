@@ -178,6 +178,9 @@ struct jit_gencode
 	void			*epilog_fixup;	/* Fixup list for function epilogs */
 	int			stack_changed;	/* Stack top changed since entry */
 	jit_varint_encoder_t	offset_encoder;	/* Bytecode offset encoder */
+	unsigned int		num_spills;	/* Values stored to the frame */
+	unsigned int		num_reloads;	/* Values loaded from the frame */
+	_jit_reloc_table_t	reloc_table;	/* Relocations for pre-compiling */
 };
 
 /*
@@ -206,6 +209,13 @@ void _jit_gen_check_space(jit_gencode_t gen, int space);
  */
 void *_jit_gen_alloc(jit_gencode_t gen, unsigned long size);
 
+/*
+ * Record a place in the code that refers to an address outside of the
+ * code, if the function is being pre-compiled (see _jit_reloc_table).
+ */
+void _jit_gen_add_reloc(jit_gencode_t gen, unsigned char *field, int type,
+			void *target, jit_function_t callee);
+
 void _jit_init_backend(void);
 void _jit_gen_get_elf_info(jit_elf_info_t *info);
 int _jit_create_entry_insns(jit_function_t func);
@@ -239,6 +249,12 @@ void _jit_gen_insn(jit_gencode_t gen, jit_function_t func,
 void _jit_gen_start_block(jit_gencode_t gen, jit_block_t block);
 void _jit_gen_end_block(jit_gencode_t gen, jit_block_t block);
 int _jit_gen_is_global_candidate(jit_type_t type);
+#ifdef JIT_USE_EXCEPTION_TABLES
+_jit_catch_table_t _jit_gen_catch_table(jit_gencode_t gen, jit_function_t func);
+#endif
+#ifdef JIT_USE_UNWIND_INFO
+_jit_unwind_info_t _jit_gen_unwind_info(jit_gencode_t gen, jit_function_t func);
+#endif
 
 #if defined(JIT_NATIVE_INT32) && !defined(JIT_BACKEND_INTERP)
 int _jit_reg_get_pair(jit_type_t type, int reg);
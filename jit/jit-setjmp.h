@@ -58,6 +58,12 @@ void _jit_unwind_pop_setjmp(void);
  */
 void _jit_unwind_pop_and_rethrow(void);
 
+/*
+ * Rethrow an exception from the catcher of a function that has an
+ * exception table, so that the function itself does not catch it again.
+ */
+void _jit_unwind_rethrow(void *object);
+
 #ifdef	__cplusplus
 };
 #endif
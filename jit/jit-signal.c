@@ -75,9 +75,11 @@ void _jit_signal_init(void)
 {
 	struct sigaction sa_fpe, sa_segv;
 
+	/* The handlers do not return when the exception is caught, so the
+	   signal must not stay blocked while they run */
 	sa_fpe.sa_sigaction = sigfpe_handler;
 	sigemptyset(&sa_fpe.sa_mask);
-	sa_fpe.sa_flags = SA_SIGINFO;
+	sa_fpe.sa_flags = SA_SIGINFO | SA_NODEFER;
 	if (sigaction(SIGFPE, &sa_fpe, 0)) {
 		perror("Sigaction SIGFPE");
 		exit(1);
@@ -85,7 +87,7 @@ void _jit_signal_init(void)
 
 	sa_segv.sa_sigaction = sigsegv_handler;
 	sigemptyset(&sa_segv.sa_mask);
-	sa_segv.sa_flags = SA_SIGINFO;
+	sa_segv.sa_flags = SA_SIGINFO | SA_NODEFER;
 	if (sigaction(SIGSEGV, &sa_segv, 0)) {
 		perror("Sigaction SIGSEGV");
 		exit(1);
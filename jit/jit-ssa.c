@@ -0,0 +1,1564 @@
+/*
+ * jit-ssa.c - Optimizations based on the static single assignment form.
+ *
+ * Copyright (C) 2026  Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+
+/*
+ * The pass builds the SSA form on the side.  The instructions are not
+ * renamed, instead every definition of a value gets a version number
+ * and every use of a value records the version that reaches it.  The
+ * phi nodes are kept in separate lists.  Because all the versions of
+ * a value still share the same storage the phi nodes never have to be
+ * turned into copies.  The transformations only have to make sure that
+ * the value still holds the expected version where it is used:
+ *
+ *  - conditional constant propagation replaces the uses of versions
+ *    that are known to be constant with the constant and resolves the
+ *    branches whose outcome is known,
+ *  - copy propagation replaces the use of a copy with the original
+ *    value if the original value still has the same version there,
+ *  - dead code elimination removes the definitions of versions that
+ *    are no longer used.
+ *
+ * The dominance frontiers are computed with the algorithm from "A Simple,
+ * Fast Dominance Algorithm" by Keith D. Cooper, Timothy J. Harvey and
+ * Ken Kennedy.  The phi nodes are placed for the values that are live
+ * across blocks ("semi-pruned" SSA form).
+ */
+
+/*
+ * Lattice states of a version.
+ */
+#define _JIT_SSA_TOP		0
+#define _JIT_SSA_CONST		1
+#define _JIT_SSA_BOTTOM		2
+
+/*
+ * Operand slots of an instruction.
+ */
+#define _JIT_SSA_DEF		0
+#define _JIT_SSA_USE_DEST	1
+#define _JIT_SSA_USE_VALUE1	2
+#define _JIT_SSA_USE_VALUE2	3
+#define _JIT_SSA_NUM_SLOTS	4
+
+typedef struct _jit_ssa_phi *_jit_ssa_phi_t;
+struct _jit_ssa_phi
+{
+	_jit_ssa_phi_t		next;
+	int			var;
+	int			version;
+
+	/* The incoming version for every predecessor of the block */
+	int			args[1];
+};
+
+typedef struct _jit_ssa_version _jit_ssa_version_t;
+struct _jit_ssa_version
+{
+	/* The value this is a version of */
+	int			var;
+
+	/* Where the version is defined.  Versions that reach the function
+	   entry have no block, versions defined by a phi have no insn */
+	jit_block_t		block;
+	jit_insn_t		insn;
+	int			*slots;
+	_jit_ssa_phi_t		phi;
+
+	/* Lattice state */
+	int			state;
+	jit_value_t		constant;
+
+	/* Dead code elimination mark */
+	int			live;
+};
+
+typedef struct _jit_ssa _jit_ssa_t;
+struct _jit_ssa
+{
+	jit_function_t		func;
+	int			dont_fold;
+
+	/* Blocks in reverse postorder */
+	jit_block_t		*blocks;
+	int			num_blocks;
+
+	/* Dominator tree */
+	int			*idom;
+	int			*first_child;
+	int			*next_sibling;
+
+	/* Dominance frontiers, the frontier of the block b is
+	   df[df_start[b]] .. df[df_start[b + 1] - 1] */
+	int			*df_start;
+	int			*df;
+
+	/* Values that are renamed */
+	jit_value_t		*vars;
+	int			num_vars;
+	int			max_vars;
+
+	/* Versions, the first num_vars versions reach the function entry */
+	_jit_ssa_version_t	*versions;
+	int			num_versions;
+	int			max_versions;
+
+	/* Version numbers for the operands of all instructions */
+	int			**slots;
+
+	/* Phi nodes of each block */
+	_jit_ssa_phi_t		*phis;
+
+	/* Renaming state: the current version of every value and
+	   the log of the replaced versions */
+	int			*current;
+	int			*log_var;
+	int			*log_version;
+	int			log_size;
+	int			*log_mark;
+	int			*walk_child;
+	int			*walk_stack;
+
+	/* Conditional constant propagation state */
+	char			*executable;
+	char			*edge_executable;
+	int			*edge_start;
+	int			*branch_taken;
+	int			changed;
+};
+
+/*
+ * Check if the value can be renamed.  Values that might be accessed
+ * through memory or that the code generator uses behind the scenes
+ * are left alone.
+ */
+static int
+is_candidate(jit_function_t func, jit_value_t value)
+{
+	jit_type_t type;
+
+	if(!value || value->is_constant || value->is_volatile || value->is_addressable)
+	{
+		return 0;
+	}
+	if(value == func->builder->struct_return
+	   || value == func->builder->parent_frame
+	   || value == func->parent_frame
+	   || value == func->cached_parent_frame)
+	{
+		return 0;
+	}
+#ifdef JIT_BACKEND_INTERP
+	if(value == func->arguments_pointer)
+	{
+		return 0;
+	}
+#endif
+
+	type = jit_type_normalize(value->type);
+	switch(jit_type_get_kind(type))
+	{
+	case JIT_TYPE_SBYTE:
+	case JIT_TYPE_UBYTE:
+	case JIT_TYPE_SHORT:
+	case JIT_TYPE_USHORT:
+	case JIT_TYPE_INT:
+	case JIT_TYPE_UINT:
+	case JIT_TYPE_LONG:
+	case JIT_TYPE_ULONG:
+	case JIT_TYPE_FLOAT32:
+	case JIT_TYPE_FLOAT64:
+	case JIT_TYPE_NFLOAT:
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Check if the instruction defines its value1 operand rather than
+ * its destination.
+ */
+static int
+defines_value1(jit_insn_t insn)
+{
+	switch(insn->opcode)
+	{
+	case JIT_OP_INCOMING_REG:
+	case JIT_OP_INCOMING_FRAME_POSN:
+	case JIT_OP_RETURN_REG:
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Get the value used in the specified operand slot of an instruction.
+ */
+static jit_value_t
+get_use(jit_insn_t insn, int slot)
+{
+	switch(slot)
+	{
+	case _JIT_SSA_USE_DEST:
+		if((insn->flags & JIT_INSN_DEST_OTHER_FLAGS) == 0
+		   && (insn->flags & JIT_INSN_DEST_IS_VALUE) != 0)
+		{
+			return insn->dest;
+		}
+		break;
+
+	case _JIT_SSA_USE_VALUE1:
+		if((insn->flags & JIT_INSN_VALUE1_OTHER_FLAGS) == 0 && !defines_value1(insn))
+		{
+			return insn->value1;
+		}
+		break;
+
+	case _JIT_SSA_USE_VALUE2:
+		if((insn->flags & JIT_INSN_VALUE2_OTHER_FLAGS) == 0)
+		{
+			return insn->value2;
+		}
+		break;
+	}
+	return 0;
+}
+
+/*
+ * Replace the value used in the specified operand slot.
+ */
+static void
+set_use(jit_insn_t insn, int slot, jit_value_t value)
+{
+	switch(slot)
+	{
+	case _JIT_SSA_USE_DEST:
+		insn->dest = value;
+		break;
+
+	case _JIT_SSA_USE_VALUE1:
+		insn->value1 = value;
+		break;
+
+	case _JIT_SSA_USE_VALUE2:
+		insn->value2 = value;
+		break;
+	}
+}
+
+/*
+ * Check if the instruction is a plain copy of a value of the same type.
+ */
+static int
+is_copy(jit_insn_t insn)
+{
+	switch(insn->opcode)
+	{
+	case JIT_OP_COPY_INT:
+	case JIT_OP_COPY_LONG:
+	case JIT_OP_COPY_FLOAT32:
+	case JIT_OP_COPY_FLOAT64:
+	case JIT_OP_COPY_NFLOAT:
+		return (jit_type_normalize(insn->dest->type)
+			== jit_type_normalize(insn->value1->type));
+	}
+	return 0;
+}
+
+/*
+ * Check if the instruction is a conditional branch.
+ */
+static int
+is_conditional_branch(jit_insn_t insn)
+{
+	return (insn && insn->opcode > JIT_OP_BR && insn->opcode <= JIT_OP_BR_NFGE_INV);
+}
+
+/*
+ * Check if the instruction only computes its destination value,
+ * so it may be removed once the value is no longer needed.
+ */
+static int
+is_removable(jit_insn_t insn, int *slots)
+{
+	return (slots[_JIT_SSA_DEF] >= 0 && !defines_value1(insn));
+}
+
+/*
+ * Check if the operand slot may be replaced with a constant.  The
+ * register moves and the jump tables expect a real value.
+ */
+static int
+accepts_constant(jit_insn_t insn, int slot)
+{
+	if((jit_opcodes[insn->opcode].flags & JIT_OPCODE_IS_REG) != 0)
+	{
+		return 0;
+	}
+	if(insn->opcode == JIT_OP_JUMP_TABLE)
+	{
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Compare two constants.
+ */
+static int
+same_constant(jit_value_t value1, jit_value_t value2)
+{
+	jit_constant_t const1, const2;
+	jit_type_t type;
+
+	if(value1 == value2)
+	{
+		return 1;
+	}
+	type = jit_type_normalize(value1->type);
+	if(type != jit_type_normalize(value2->type))
+	{
+		return 0;
+	}
+
+	const1 = jit_value_get_constant(value1);
+	const2 = jit_value_get_constant(value2);
+	switch(jit_type_get_kind(type))
+	{
+	case JIT_TYPE_SBYTE:
+	case JIT_TYPE_UBYTE:
+	case JIT_TYPE_SHORT:
+	case JIT_TYPE_USHORT:
+	case JIT_TYPE_INT:
+	case JIT_TYPE_UINT:
+		return const1.un.int_value == const2.un.int_value;
+
+	case JIT_TYPE_LONG:
+	case JIT_TYPE_ULONG:
+		return const1.un.long_value == const2.un.long_value;
+
+	case JIT_TYPE_FLOAT32:
+		return !jit_memcmp(&const1.un.float32_value, &const2.un.float32_value,
+				   sizeof(jit_float32));
+
+	case JIT_TYPE_FLOAT64:
+		return !jit_memcmp(&const1.un.float64_value, &const2.un.float64_value,
+				   sizeof(jit_float64));
+
+	case JIT_TYPE_NFLOAT:
+		return !jit_memcmp(&const1.un.nfloat_value, &const2.un.nfloat_value,
+				   sizeof(jit_nfloat));
+	}
+	return 0;
+}
+
+/*
+ * Free the pass data.
+ */
+static void
+free_ssa(_jit_ssa_t *ssa)
+{
+	_jit_ssa_phi_t phi, next;
+	int index;
+
+	for(index = 0; index < ssa->num_vars; index++)
+	{
+		ssa->vars[index]->index = -1;
+	}
+	if(ssa->phis)
+	{
+		for(index = 0; index < ssa->num_blocks; index++)
+		{
+			for(phi = ssa->phis[index]; phi; phi = next)
+			{
+				next = phi->next;
+				jit_free(phi);
+			}
+		}
+	}
+	if(ssa->slots)
+	{
+		for(index = 0; index < ssa->num_blocks; index++)
+		{
+			jit_free(ssa->slots[index]);
+		}
+	}
+
+	jit_free(ssa->blocks);
+	jit_free(ssa->idom);
+	jit_free(ssa->first_child);
+	jit_free(ssa->next_sibling);
+	jit_free(ssa->df_start);
+	jit_free(ssa->df);
+	jit_free(ssa->vars);
+	jit_free(ssa->versions);
+	jit_free(ssa->slots);
+	jit_free(ssa->phis);
+	jit_free(ssa->current);
+	jit_free(ssa->log_var);
+	jit_free(ssa->log_version);
+	jit_free(ssa->log_mark);
+	jit_free(ssa->walk_child);
+	jit_free(ssa->walk_stack);
+	jit_free(ssa->executable);
+	jit_free(ssa->edge_executable);
+	jit_free(ssa->edge_start);
+	jit_free(ssa->branch_taken);
+}
+
+/*
+ * Number the reachable blocks in reverse postorder and
+ * compute the dominator tree on the block numbers.
+ */
+static int
+compute_dominators(_jit_ssa_t *ssa)
+{
+	jit_builder_t builder = ssa->func->builder;
+	jit_block_t block;
+	int index, count;
+
+	if(!_jit_block_compute_dominators(ssa->func))
+	{
+		return 0;
+	}
+
+	count = builder->num_block_order;
+	ssa->blocks = jit_malloc(count * sizeof(jit_block_t));
+	ssa->idom = jit_malloc(count * sizeof(int));
+	ssa->first_child = jit_malloc(count * sizeof(int));
+	ssa->next_sibling = jit_malloc(count * sizeof(int));
+	if(!ssa->blocks || !ssa->idom || !ssa->first_child || !ssa->next_sibling)
+	{
+		return 0;
+	}
+	for(index = 0; index < count; index++)
+	{
+		block = builder->block_order[count - 1 - index];
+		block->index = index;
+		ssa->blocks[index] = block;
+	}
+	ssa->num_blocks = count;
+
+	ssa->idom[0] = 0;
+	for(index = 1; index < count; index++)
+	{
+		ssa->idom[index] = ssa->blocks[index]->idom->index;
+	}
+
+	/* Link the children in the tree, in the block order */
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		ssa->first_child[index] = -1;
+		ssa->next_sibling[index] = -1;
+	}
+	for(index = ssa->num_blocks - 1; index > 0; index--)
+	{
+		ssa->next_sibling[index] = ssa->first_child[ssa->idom[index]];
+		ssa->first_child[ssa->idom[index]] = index;
+	}
+	return 1;
+}
+
+/*
+ * Walk up the dominator tree from the predecessors of every join
+ * point to find the dominance frontiers.  This is done twice, first
+ * to count the frontier sizes and then to fill them in.
+ */
+static void
+build_frontiers(_jit_ssa_t *ssa, int *last, int *count, int create)
+{
+	jit_block_t block;
+	int index, pred, runner;
+
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		last[index] = -1;
+	}
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		block = ssa->blocks[index];
+		if(block->num_preds < 2)
+		{
+			continue;
+		}
+		for(pred = 0; pred < block->num_preds; pred++)
+		{
+			runner = block->preds[pred]->src->index;
+			if(runner < 0)
+			{
+				continue;
+			}
+			while(runner != ssa->idom[index] && last[runner] != index)
+			{
+				if(create)
+				{
+					ssa->df[ssa->df_start[runner] + count[runner]] = index;
+				}
+				++(count[runner]);
+				last[runner] = index;
+				runner = ssa->idom[runner];
+			}
+		}
+	}
+}
+
+static int
+compute_frontiers(_jit_ssa_t *ssa)
+{
+	int *last, *count;
+	int index, total;
+
+	last = jit_malloc(ssa->num_blocks * sizeof(int));
+	count = jit_calloc(ssa->num_blocks, sizeof(int));
+	ssa->df_start = jit_malloc((ssa->num_blocks + 1) * sizeof(int));
+	if(!last || !count || !ssa->df_start)
+	{
+		jit_free(last);
+		jit_free(count);
+		return 0;
+	}
+
+	build_frontiers(ssa, last, count, 0);
+
+	total = 0;
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		ssa->df_start[index] = total;
+		total += count[index];
+		count[index] = 0;
+	}
+	ssa->df_start[ssa->num_blocks] = total;
+
+	ssa->df = jit_malloc((total ? total : 1) * sizeof(int));
+	if(!ssa->df)
+	{
+		jit_free(last);
+		jit_free(count);
+		return 0;
+	}
+
+	build_frontiers(ssa, last, count, 1);
+
+	jit_free(last);
+	jit_free(count);
+	return 1;
+}
+
+/*
+ * Register a value for renaming.
+ */
+static int
+add_var(_jit_ssa_t *ssa, jit_value_t value)
+{
+	jit_value_t *vars;
+
+	if(value->index >= 0)
+	{
+		return 1;
+	}
+	if(ssa->num_vars == ssa->max_vars)
+	{
+		ssa->max_vars = ssa->max_vars ? ssa->max_vars * 2 : 64;
+		vars = jit_realloc(ssa->vars, ssa->max_vars * sizeof(jit_value_t));
+		if(!vars)
+		{
+			return 0;
+		}
+		ssa->vars = vars;
+	}
+	value->index = ssa->num_vars;
+	ssa->vars[ssa->num_vars++] = value;
+	return 1;
+}
+
+/*
+ * Find the values to rename and count their definitions.
+ */
+static int
+collect_vars(_jit_ssa_t *ssa, int *num_defs)
+{
+	jit_function_t func = ssa->func;
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_value_t value;
+	int index, posn, slot;
+
+	*num_defs = 0;
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		block = ssa->blocks[index];
+		for(posn = 0; posn < block->num_insns; posn++)
+		{
+			insn = &block->insns[posn];
+			if(insn->opcode == JIT_OP_NOP)
+			{
+				continue;
+			}
+			value = _jit_insn_get_def(insn);
+			if(is_candidate(func, value))
+			{
+				if(!add_var(ssa, value))
+				{
+					return 0;
+				}
+				++(*num_defs);
+			}
+			for(slot = _JIT_SSA_USE_DEST; slot < _JIT_SSA_NUM_SLOTS; slot++)
+			{
+				value = get_use(insn, slot);
+				if(is_candidate(func, value) && !add_var(ssa, value))
+				{
+					return 0;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+/*
+ * Place the phi nodes for the values that are used in some block
+ * before they are defined there.
+ */
+static int
+place_phis(_jit_ssa_t *ssa, int *num_phis)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_value_t value;
+	_jit_ssa_phi_t phi;
+	char *is_global;
+	int *defined, *has_phi, *in_work, *work;
+	int *def_head, *def_next, *def_block;
+	int index, posn, slot, var, top, num_defs, frontier, succ;
+	int ok;
+
+	*num_phis = 0;
+	ok = 0;
+	is_global = jit_calloc(ssa->num_vars ? ssa->num_vars : 1, 1);
+	defined = jit_malloc((ssa->num_vars ? ssa->num_vars : 1) * sizeof(int));
+	def_head = jit_malloc((ssa->num_vars ? ssa->num_vars : 1) * sizeof(int));
+	has_phi = jit_malloc(ssa->num_blocks * sizeof(int));
+	in_work = jit_malloc(ssa->num_blocks * sizeof(int));
+	work = jit_malloc(ssa->num_blocks * sizeof(int));
+	def_next = 0;
+	def_block = 0;
+	if(!is_global || !defined || !def_head || !has_phi || !in_work || !work)
+	{
+		goto done;
+	}
+
+	/* Find the values that are used before being defined in a block,
+	   and remember the blocks that define them */
+	num_defs = 0;
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		num_defs += ssa->blocks[index]->num_insns;
+	}
+	def_next = jit_malloc((num_defs ? num_defs : 1) * sizeof(int));
+	def_block = jit_malloc((num_defs ? num_defs : 1) * sizeof(int));
+	if(!def_next || !def_block)
+	{
+		goto done;
+	}
+	for(var = 0; var < ssa->num_vars; var++)
+	{
+		defined[var] = -1;
+		def_head[var] = -1;
+	}
+	num_defs = 0;
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		block = ssa->blocks[index];
+		for(posn = 0; posn < block->num_insns; posn++)
+		{
+			insn = &block->insns[posn];
+			if(insn->opcode == JIT_OP_NOP)
+			{
+				continue;
+			}
+			for(slot = _JIT_SSA_USE_DEST; slot < _JIT_SSA_NUM_SLOTS; slot++)
+			{
+				value = get_use(insn, slot);
+				if(value && value->index >= 0 && defined[value->index] != index)
+				{
+					is_global[value->index] = 1;
+				}
+			}
+			value = _jit_insn_get_def(insn);
+			if(value && value->index >= 0 && defined[value->index] != index)
+			{
+				defined[value->index] = index;
+				def_block[num_defs] = index;
+				def_next[num_defs] = def_head[value->index];
+				def_head[value->index] = num_defs++;
+			}
+		}
+	}
+
+	/* Place the phi nodes on the iterated dominance frontiers */
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		has_phi[index] = -1;
+		in_work[index] = -1;
+	}
+	for(var = 0; var < ssa->num_vars; var++)
+	{
+		if(!is_global[var])
+		{
+			continue;
+		}
+
+		top = 0;
+		for(posn = def_head[var]; posn >= 0; posn = def_next[posn])
+		{
+			work[top++] = def_block[posn];
+			in_work[def_block[posn]] = var;
+		}
+		while(top > 0)
+		{
+			index = work[--top];
+			for(frontier = ssa->df_start[index]; frontier < ssa->df_start[index + 1]; frontier++)
+			{
+				succ = ssa->df[frontier];
+				if(has_phi[succ] == var)
+				{
+					continue;
+				}
+				has_phi[succ] = var;
+
+				block = ssa->blocks[succ];
+				phi = jit_malloc(sizeof(struct _jit_ssa_phi)
+						 + block->num_preds * sizeof(int));
+				if(!phi)
+				{
+					goto done;
+				}
+				phi->var = var;
+				phi->version = -1;
+				phi->next = ssa->phis[succ];
+				ssa->phis[succ] = phi;
+				++(*num_phis);
+
+				if(in_work[succ] != var)
+				{
+					in_work[succ] = var;
+					work[top++] = succ;
+				}
+			}
+		}
+	}
+	ok = 1;
+
+ done:
+	jit_free(is_global);
+	jit_free(defined);
+	jit_free(def_head);
+	jit_free(def_next);
+	jit_free(def_block);
+	jit_free(has_phi);
+	jit_free(in_work);
+	jit_free(work);
+	return ok;
+}
+
+/*
+ * Make a version the current version of a value and log
+ * the replaced version to restore it later.
+ */
+static void
+push_version(_jit_ssa_t *ssa, int var, int version)
+{
+	ssa->log_var[ssa->log_size] = var;
+	ssa->log_version[ssa->log_size] = ssa->current[var];
+	++(ssa->log_size);
+	ssa->current[var] = version;
+}
+
+/*
+ * Get the index of a control flow edge among the predecessors
+ * of its destination block.
+ */
+static int
+get_pred_index(_jit_edge_t edge)
+{
+	jit_block_t block = edge->dst;
+	int index;
+
+	for(index = 0; index < block->num_preds; index++)
+	{
+		if(block->preds[index] == edge)
+		{
+			return index;
+		}
+	}
+	return -1;
+}
+
+static int
+new_version(_jit_ssa_t *ssa, int var, jit_block_t block)
+{
+	_jit_ssa_version_t *version;
+
+	version = &ssa->versions[ssa->num_versions];
+	version->var = var;
+	version->block = block;
+	version->insn = 0;
+	version->slots = 0;
+	version->phi = 0;
+	version->state = _JIT_SSA_TOP;
+	version->constant = 0;
+	version->live = 0;
+	return ssa->num_versions++;
+}
+
+/*
+ * Assign versions to the definitions and the uses in a block.
+ */
+static void
+rename_block(_jit_ssa_t *ssa, int index)
+{
+	jit_block_t block, succ;
+	jit_insn_t insn;
+	jit_value_t value;
+	_jit_ssa_phi_t phi;
+	int *slots;
+	int posn, slot, version, pred;
+
+	block = ssa->blocks[index];
+	for(phi = ssa->phis[index]; phi; phi = phi->next)
+	{
+		version = new_version(ssa, phi->var, block);
+		ssa->versions[version].phi = phi;
+		phi->version = version;
+		push_version(ssa, phi->var, version);
+	}
+
+	for(posn = 0; posn < block->num_insns; posn++)
+	{
+		insn = &block->insns[posn];
+		slots = &ssa->slots[index][posn * _JIT_SSA_NUM_SLOTS];
+		for(slot = 0; slot < _JIT_SSA_NUM_SLOTS; slot++)
+		{
+			slots[slot] = -1;
+		}
+		if(insn->opcode == JIT_OP_NOP)
+		{
+			continue;
+		}
+
+		for(slot = _JIT_SSA_USE_DEST; slot < _JIT_SSA_NUM_SLOTS; slot++)
+		{
+			value = get_use(insn, slot);
+			if(value && value->index >= 0)
+			{
+				slots[slot] = ssa->current[value->index];
+			}
+		}
+
+		value = _jit_insn_get_def(insn);
+		if(value && value->index >= 0)
+		{
+			version = new_version(ssa, value->index, block);
+			ssa->versions[version].insn = insn;
+			ssa->versions[version].slots = slots;
+			slots[_JIT_SSA_DEF] = version;
+			push_version(ssa, value->index, version);
+		}
+	}
+
+	/* Fill in the phi arguments of the successors */
+	for(pred = 0; pred < block->num_succs; pred++)
+	{
+		succ = block->succs[pred]->dst;
+		if(succ->index < 0)
+		{
+			continue;
+		}
+		version = get_pred_index(block->succs[pred]);
+		for(phi = ssa->phis[succ->index]; phi; phi = phi->next)
+		{
+			phi->args[version] = ssa->current[phi->var];
+		}
+	}
+}
+
+/*
+ * Replace the uses in a block with constants or with the sources
+ * of copies where this is possible.
+ */
+static int
+rewrite_block(_jit_ssa_t *ssa, int index)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_value_t value;
+	_jit_ssa_version_t *version;
+	_jit_ssa_phi_t phi;
+	int *slots;
+	int posn, slot, source, changed;
+
+	block = ssa->blocks[index];
+	for(phi = ssa->phis[index]; phi; phi = phi->next)
+	{
+		push_version(ssa, phi->var, phi->version);
+	}
+
+	changed = 0;
+	for(posn = 0; posn < block->num_insns; posn++)
+	{
+		insn = &block->insns[posn];
+		slots = &ssa->slots[index][posn * _JIT_SSA_NUM_SLOTS];
+		if(ssa->executable[index])
+		{
+			for(slot = _JIT_SSA_USE_DEST; slot < _JIT_SSA_NUM_SLOTS; slot++)
+			{
+				if(slots[slot] < 0)
+				{
+					continue;
+				}
+
+				version = &ssa->versions[slots[slot]];
+				if(version->state == _JIT_SSA_CONST)
+				{
+					if(accepts_constant(insn, slot))
+					{
+						set_use(insn, slot, version->constant);
+						slots[slot] = -1;
+						changed = 1;
+					}
+					continue;
+				}
+
+				/* Follow the chain of copies as long as the source
+				   still holds the same version.  The temporary
+				   values must not be used outside of their block */
+				while(version->insn && is_copy(version->insn)
+				      && version->slots[_JIT_SSA_USE_VALUE1] >= 0)
+				{
+					source = version->slots[_JIT_SSA_USE_VALUE1];
+					value = version->insn->value1;
+					if(ssa->current[ssa->versions[source].var] != source
+					   || (value->is_temporary && ssa->versions[source].block != block))
+					{
+						break;
+					}
+					set_use(insn, slot, value);
+					slots[slot] = source;
+					version = &ssa->versions[source];
+					changed = 1;
+				}
+			}
+		}
+		if(slots[_JIT_SSA_DEF] >= 0)
+		{
+			push_version(ssa, ssa->versions[slots[_JIT_SSA_DEF]].var,
+				     slots[_JIT_SSA_DEF]);
+		}
+	}
+	return changed;
+}
+
+/*
+ * Walk the dominator tree in preorder, either renaming or rewriting
+ * the blocks.  The current versions are restored when the walk leaves
+ * a block.
+ */
+static int
+walk_dominator_tree(_jit_ssa_t *ssa, int rewrite)
+{
+	int top, index, child, var, changed;
+
+	changed = 0;
+	ssa->log_size = 0;
+	for(var = 0; var < ssa->num_vars; var++)
+	{
+		ssa->current[var] = var;
+	}
+
+	top = 0;
+	index = 0;
+	for(;;)
+	{
+		/* Enter the block */
+		ssa->log_mark[index] = ssa->log_size;
+		if(rewrite)
+		{
+			changed |= rewrite_block(ssa, index);
+		}
+		else
+		{
+			rename_block(ssa, index);
+		}
+		ssa->walk_child[index] = ssa->first_child[index];
+		ssa->walk_stack[top++] = index;
+
+		/* Leave the blocks that have no children left to visit */
+		for(;;)
+		{
+			index = ssa->walk_stack[top - 1];
+			child = ssa->walk_child[index];
+			if(child >= 0)
+			{
+				ssa->walk_child[index] = ssa->next_sibling[child];
+				index = child;
+				break;
+			}
+
+			while(ssa->log_size > ssa->log_mark[index])
+			{
+				--(ssa->log_size);
+				ssa->current[ssa->log_var[ssa->log_size]] =
+					ssa->log_version[ssa->log_size];
+			}
+			if(--top == 0)
+			{
+				return changed;
+			}
+		}
+	}
+}
+
+/*
+ * Lower the lattice state of a version.
+ */
+static void
+lower_state(_jit_ssa_t *ssa, int version, int state, jit_value_t constant)
+{
+	_jit_ssa_version_t *info = &ssa->versions[version];
+
+	if(state == _JIT_SSA_CONST && info->state == _JIT_SSA_CONST
+	   && !same_constant(info->constant, constant))
+	{
+		state = _JIT_SSA_BOTTOM;
+	}
+	if(state > info->state)
+	{
+		info->state = state;
+		info->constant = (state == _JIT_SSA_CONST) ? constant : 0;
+		ssa->changed = 1;
+	}
+}
+
+/*
+ * Get the lattice state of an operand.
+ */
+static int
+get_state(_jit_ssa_t *ssa, jit_value_t value, int version, jit_value_t *constant)
+{
+	if(value && value->is_constant)
+	{
+		*constant = value;
+		return _JIT_SSA_CONST;
+	}
+	if(version < 0)
+	{
+		*constant = 0;
+		return _JIT_SSA_BOTTOM;
+	}
+	*constant = ssa->versions[version].constant;
+	return ssa->versions[version].state;
+}
+
+/*
+ * Compute the lattice state of the value that an instruction defines.
+ */
+static void
+evaluate_insn(_jit_ssa_t *ssa, jit_insn_t insn, int *slots)
+{
+	const _jit_intrinsic_info_t *info;
+	jit_value_t const1, const2, result;
+	int def, state1, state2, flag;
+
+	def = slots[_JIT_SSA_DEF];
+	if(def < 0)
+	{
+		return;
+	}
+	if(defines_value1(insn))
+	{
+		lower_state(ssa, def, _JIT_SSA_BOTTOM, 0);
+		return;
+	}
+
+	state1 = get_state(ssa, insn->value1, slots[_JIT_SSA_USE_VALUE1], &const1);
+	if(is_copy(insn))
+	{
+		if(state1 != _JIT_SSA_TOP)
+		{
+			lower_state(ssa, def, state1, const1);
+		}
+		return;
+	}
+
+	info = &_jit_intrinsics[insn->opcode];
+	flag = info->flags & _JIT_INTRINSIC_FLAG_MASK;
+	if(ssa->dont_fold || !insn->value1
+	   || (flag != _JIT_INTRINSIC_FLAG_NOT
+	       && (flag != _JIT_INTRINSIC_FLAG_NONE || info->signature == JIT_SIG_NONE)))
+	{
+		lower_state(ssa, def, _JIT_SSA_BOTTOM, 0);
+		return;
+	}
+
+	if(insn->value2)
+	{
+		state2 = get_state(ssa, insn->value2, slots[_JIT_SSA_USE_VALUE2], &const2);
+	}
+	else
+	{
+		state2 = _JIT_SSA_CONST;
+		const2 = const1;
+	}
+	if(state1 == _JIT_SSA_BOTTOM || state2 == _JIT_SSA_BOTTOM)
+	{
+		lower_state(ssa, def, _JIT_SSA_BOTTOM, 0);
+		return;
+	}
+	if(state1 == _JIT_SSA_TOP || state2 == _JIT_SSA_TOP
+	   || ssa->versions[def].state != _JIT_SSA_TOP)
+	{
+		/* The operands are not known yet, or the result is already
+		   known and the operands are still the same constants */
+		return;
+	}
+
+	if(insn->value2)
+	{
+		result = _jit_opcode_apply(ssa->func, insn->opcode, const1, const2,
+					   insn->dest->type);
+	}
+	else
+	{
+		result = _jit_opcode_apply_unary(ssa->func, insn->opcode, const1,
+						 insn->dest->type);
+	}
+	if(result)
+	{
+		lower_state(ssa, def, _JIT_SSA_CONST, result);
+	}
+	else
+	{
+		lower_state(ssa, def, _JIT_SSA_BOTTOM, 0);
+	}
+}
+
+/*
+ * Evaluate a conditional branch.  Returns 1 if the branch is always
+ * taken, 0 if it is never taken and -1 if this is not known.
+ */
+static int
+evaluate_branch(_jit_ssa_t *ssa, jit_insn_t insn, int *slots)
+{
+	jit_value_t const1, const2, result;
+	int flags, state1, state2;
+
+	if(ssa->dont_fold)
+	{
+		return -1;
+	}
+
+	/* The flags are stored in a signed short */
+	flags = (jit_ushort) _jit_intrinsics[insn->opcode].flags;
+	state1 = get_state(ssa, insn->value1, slots[_JIT_SSA_USE_VALUE1], &const1);
+	if(state1 != _JIT_SSA_CONST)
+	{
+		return -1;
+	}
+
+	switch(flags & _JIT_INTRINSIC_FLAG_MASK)
+	{
+	case _JIT_INTRINSIC_FLAG_BRANCH_UNARY:
+		switch(flags & ~_JIT_INTRINSIC_FLAG_MASK)
+		{
+		case _JIT_INTRINSIC_FLAG_IFALSE:
+			return jit_value_get_nint_constant(const1) == 0;
+		case _JIT_INTRINSIC_FLAG_ITRUE:
+			return jit_value_get_nint_constant(const1) != 0;
+		case _JIT_INTRINSIC_FLAG_LFALSE:
+			return jit_value_get_long_constant(const1) == 0;
+		case _JIT_INTRINSIC_FLAG_LTRUE:
+			return jit_value_get_long_constant(const1) != 0;
+		}
+		break;
+
+	case _JIT_INTRINSIC_FLAG_BRANCH:
+		state2 = get_state(ssa, insn->value2, slots[_JIT_SSA_USE_VALUE2], &const2);
+		if(state2 != _JIT_SSA_CONST)
+		{
+			return -1;
+		}
+		result = _jit_opcode_apply(ssa->func, flags & ~_JIT_INTRINSIC_FLAG_MASK,
+					   const1, const2, jit_type_int);
+		if(result)
+		{
+			return jit_value_get_nint_constant(result) != 0;
+		}
+		break;
+	}
+	return -1;
+}
+
+/*
+ * Mark a control flow edge and its destination block as executable.
+ */
+static void
+mark_edge(_jit_ssa_t *ssa, _jit_edge_t edge)
+{
+	int index, pred;
+
+	index = edge->dst->index;
+	if(index < 0)
+	{
+		return;
+	}
+	pred = ssa->edge_start[index] + get_pred_index(edge);
+	if(!ssa->edge_executable[pred])
+	{
+		ssa->edge_executable[pred] = 1;
+		ssa->changed = 1;
+	}
+	if(!ssa->executable[index])
+	{
+		ssa->executable[index] = 1;
+		ssa->changed = 1;
+	}
+}
+
+/*
+ * Conditional constant propagation.  The executable blocks are
+ * evaluated in reverse postorder until nothing changes.
+ */
+static void
+propagate_constants(_jit_ssa_t *ssa)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_value_t constant;
+	_jit_ssa_phi_t phi;
+	int index, posn, pred, state, taken;
+	int *slots;
+
+	for(index = 0; index < ssa->num_vars; index++)
+	{
+		/* Parameters and uninitialized values */
+		ssa->versions[index].state = _JIT_SSA_BOTTOM;
+	}
+	ssa->executable[0] = 1;
+
+	do
+	{
+		ssa->changed = 0;
+		for(index = 0; index < ssa->num_blocks; index++)
+		{
+			if(!ssa->executable[index])
+			{
+				continue;
+			}
+			block = ssa->blocks[index];
+
+			for(phi = ssa->phis[index]; phi; phi = phi->next)
+			{
+				for(pred = 0; pred < block->num_preds; pred++)
+				{
+					if(!ssa->edge_executable[ssa->edge_start[index] + pred])
+					{
+						continue;
+					}
+					state = get_state(ssa, 0, phi->args[pred], &constant);
+					if(state != _JIT_SSA_TOP)
+					{
+						lower_state(ssa, phi->version, state, constant);
+					}
+				}
+			}
+
+			slots = ssa->slots[index];
+			for(posn = 0; posn < block->num_insns; posn++)
+			{
+				insn = &block->insns[posn];
+				if(insn->opcode != JIT_OP_NOP)
+				{
+					evaluate_insn(ssa, insn, &slots[posn * _JIT_SSA_NUM_SLOTS]);
+				}
+			}
+
+			insn = _jit_block_get_last(block);
+			taken = -1;
+			if(is_conditional_branch(insn))
+			{
+				posn = block->num_insns - 1;
+				taken = evaluate_branch(ssa, insn, &slots[posn * _JIT_SSA_NUM_SLOTS]);
+			}
+			ssa->branch_taken[index] = taken;
+			for(pred = 0; pred < block->num_succs; pred++)
+			{
+				if(taken < 0
+				   || (taken == 1 && block->succs[pred]->flags == _JIT_EDGE_BRANCH)
+				   || (taken == 0 && block->succs[pred]->flags == _JIT_EDGE_FALLTHRU))
+				{
+					mark_edge(ssa, block->succs[pred]);
+				}
+			}
+		}
+	}
+	while(ssa->changed);
+}
+
+static void
+mark_live(_jit_ssa_t *ssa, int *work, int *top, int version)
+{
+	if(version >= 0 && !ssa->versions[version].live)
+	{
+		ssa->versions[version].live = 1;
+		work[(*top)++] = version;
+	}
+}
+
+/*
+ * Remove the instructions that define versions that are not used.
+ */
+static int
+eliminate_dead_code(_jit_ssa_t *ssa)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	_jit_ssa_version_t *version;
+	int *work, *slots;
+	int index, posn, slot, top, pred, changed;
+
+	work = jit_malloc((ssa->num_versions ? ssa->num_versions : 1) * sizeof(int));
+	if(!work)
+	{
+		return 0;
+	}
+
+	/* Everything that the instructions with side effects use is live */
+	top = 0;
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		if(!ssa->executable[index])
+		{
+			continue;
+		}
+		block = ssa->blocks[index];
+		for(posn = 0; posn < block->num_insns; posn++)
+		{
+			insn = &block->insns[posn];
+			slots = &ssa->slots[index][posn * _JIT_SSA_NUM_SLOTS];
+			if(insn->opcode == JIT_OP_NOP || is_removable(insn, slots))
+			{
+				continue;
+			}
+			for(slot = _JIT_SSA_USE_DEST; slot < _JIT_SSA_NUM_SLOTS; slot++)
+			{
+				mark_live(ssa, work, &top, slots[slot]);
+			}
+		}
+	}
+
+	/* And so is everything that the live versions are computed from */
+	while(top > 0)
+	{
+		version = &ssa->versions[work[--top]];
+		if(version->insn)
+		{
+			for(slot = _JIT_SSA_USE_DEST; slot < _JIT_SSA_NUM_SLOTS; slot++)
+			{
+				mark_live(ssa, work, &top, version->slots[slot]);
+			}
+		}
+		else if(version->phi)
+		{
+			index = version->block->index;
+			for(pred = 0; pred < version->block->num_preds; pred++)
+			{
+				if(ssa->edge_executable[ssa->edge_start[index] + pred])
+				{
+					mark_live(ssa, work, &top, version->phi->args[pred]);
+				}
+			}
+		}
+	}
+	jit_free(work);
+
+	changed = 0;
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		if(!ssa->executable[index])
+		{
+			continue;
+		}
+		block = ssa->blocks[index];
+		for(posn = 0; posn < block->num_insns; posn++)
+		{
+			insn = &block->insns[posn];
+			slots = &ssa->slots[index][posn * _JIT_SSA_NUM_SLOTS];
+			if(insn->opcode != JIT_OP_NOP && is_removable(insn, slots)
+			   && !ssa->versions[slots[_JIT_SSA_DEF]].live)
+			{
+				insn->opcode = JIT_OP_NOP;
+				changed = 1;
+			}
+		}
+	}
+	return changed;
+}
+
+static int
+build_ssa(_jit_ssa_t *ssa)
+{
+	jit_block_t block;
+	int index, num_defs, num_phis, num_edges;
+
+	if(!compute_dominators(ssa) || !compute_frontiers(ssa))
+	{
+		return 0;
+	}
+
+	if(!collect_vars(ssa, &num_defs))
+	{
+		return 0;
+	}
+	if(ssa->num_vars == 0)
+	{
+		return 0;
+	}
+
+	ssa->phis = jit_calloc(ssa->num_blocks, sizeof(_jit_ssa_phi_t));
+	ssa->slots = jit_calloc(ssa->num_blocks, sizeof(int *));
+	if(!ssa->phis || !ssa->slots)
+	{
+		return 0;
+	}
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		block = ssa->blocks[index];
+		if(block->num_insns)
+		{
+			ssa->slots[index] = jit_malloc(block->num_insns * _JIT_SSA_NUM_SLOTS
+						       * sizeof(int));
+			if(!ssa->slots[index])
+			{
+				return 0;
+			}
+		}
+	}
+
+	if(!place_phis(ssa, &num_phis))
+	{
+		return 0;
+	}
+
+	ssa->max_versions = ssa->num_vars + num_defs + num_phis;
+	ssa->versions = jit_malloc(ssa->max_versions * sizeof(_jit_ssa_version_t));
+	ssa->current = jit_malloc(ssa->num_vars * sizeof(int));
+	ssa->log_var = jit_malloc(ssa->max_versions * sizeof(int));
+	ssa->log_version = jit_malloc(ssa->max_versions * sizeof(int));
+	ssa->log_mark = jit_malloc(ssa->num_blocks * sizeof(int));
+	ssa->walk_child = jit_malloc(ssa->num_blocks * sizeof(int));
+	ssa->walk_stack = jit_malloc(ssa->num_blocks * sizeof(int));
+	if(!ssa->versions || !ssa->current || !ssa->log_var || !ssa->log_version
+	   || !ssa->log_mark || !ssa->walk_child || !ssa->walk_stack)
+	{
+		return 0;
+	}
+
+	/* The initial versions of the values reach the function entry */
+	for(index = 0; index < ssa->num_vars; index++)
+	{
+		new_version(ssa, index, 0);
+	}
+	walk_dominator_tree(ssa, 0);
+
+	/* Allocate the constant propagation state */
+	num_edges = 0;
+	ssa->edge_start = jit_malloc(ssa->num_blocks * sizeof(int));
+	if(!ssa->edge_start)
+	{
+		return 0;
+	}
+	for(index = 0; index < ssa->num_blocks; index++)
+	{
+		ssa->edge_start[index] = num_edges;
+		num_edges += ssa->blocks[index]->num_preds;
+	}
+	ssa->edge_executable = jit_calloc(num_edges ? num_edges : 1, 1);
+	ssa->executable = jit_calloc(ssa->num_blocks, 1);
+	ssa->branch_taken = jit_malloc(ssa->num_blocks * sizeof(int));
+	if(!ssa->edge_executable || !ssa->executable || !ssa->branch_taken)
+	{
+		return 0;
+	}
+	return 1;
+}
+
+int
+_jit_function_optimize_ssa(jit_function_t func)
+{
+	_jit_ssa_t ssa;
+	jit_block_t block;
+	int index, changed;
+
+	/* The exception handlers and the tail calls read values behind
+	   the scenes, indirect jumps are not in the control flow graph */
+	if(func->has_try || func->builder->has_tail_call)
+	{
+		return 0;
+	}
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		if(block->address_of)
+		{
+			return 0;
+		}
+	}
+
+	jit_memzero(&ssa, sizeof(ssa));
+	ssa.func = func;
+	ssa.dont_fold = (int) jit_context_get_meta_numeric(func->context,
+							   JIT_OPTION_DONT_FOLD);
+
+	changed = 0;
+	if(build_ssa(&ssa))
+	{
+		propagate_constants(&ssa);
+		changed = walk_dominator_tree(&ssa, 1);
+		changed |= eliminate_dead_code(&ssa);
+
+		/* Resolve the branches with the known outcome, the blocks
+		   that become unreachable are removed by the caller */
+		for(index = 0; index < ssa.num_blocks; index++)
+		{
+			if(ssa.executable[index] && ssa.branch_taken[index] >= 0)
+			{
+				_jit_block_resolve_branch(func, ssa.blocks[index],
+							  ssa.branch_taken[index]);
+				changed = 1;
+			}
+		}
+	}
+
+	free_ssa(&ssa);
+	return changed;
+}
@@ -42,6 +42,14 @@
  */
 jit_mutex_t _jit_global_lock;
 
+/*
+ * The control objects of all the threads, so that their hazard pointers
+ * can be checked.  This has its own lock because the hazard pointers are
+ * set while "_jit_global_lock" may be held.
+ */
+static jit_thread_control_t controls;
+static jit_mutex_t control_lock;
+
 #if defined(JIT_THREADS_PTHREAD)
 
 /*
@@ -49,17 +57,41 @@ jit_mutex_t _jit_global_lock;
  */
 static pthread_key_t control_key;
 
+/*
+ * Free the control object of a thread that exits.
+ */
+static void destroy_control(void *obj)
+{
+	jit_thread_control_t control = (jit_thread_control_t)obj;
+	jit_thread_control_t *prev;
+
+	jit_mutex_lock(&control_lock);
+	for(prev = &controls; *prev; prev = &((*prev)->next))
+	{
+		if(*prev == control)
+		{
+			*prev = control->next;
+			break;
+		}
+	}
+	jit_mutex_unlock(&control_lock);
+
+	_jit_arena_destroy(control->builder_arena);
+	jit_free(control);
+}
+
 /*
  * Initialize the pthread support routines.  Only called once.
  */
 static void init_pthread(void)
 {
 	jit_mutex_create(&_jit_global_lock);
+	jit_mutex_create(&control_lock);
 
 	/* Allocate a thread-specific variable for the JIT's thread
 	   control object, and arrange for it to be freed when the
 	   thread exits or is otherwise terminated */
-	pthread_key_create(&control_key, jit_free);
+	pthread_key_create(&control_key, destroy_control);
 }
 
 #elif defined(JIT_THREADS_WIN32)
@@ -75,6 +107,7 @@ static DWORD control_key;
 static void init_win32_thread(void)
 {
 	jit_mutex_create(&_jit_global_lock);
+	jit_mutex_create(&control_lock);
 
 	control_key = TlsAlloc();
 }
@@ -153,11 +186,33 @@ jit_thread_control_t _jit_thread_get_control(void)
 		if(control)
 		{
 			set_raw_control(control);
+			jit_mutex_lock(&control_lock);
+			control->next = controls;
+			controls = control;
+			jit_mutex_unlock(&control_lock);
 		}
 	}
 	return control;
 }
 
+int _jit_thread_is_hazard(void *ptr)
+{
+	jit_thread_control_t control;
+	int result = 0;
+
+	/* The hazard pointers that were set before the caller removed
+	   the memory from the shared structures are visible now */
+	_jit_thread_init();
+	jit_memory_barrier();
+	jit_mutex_lock(&control_lock);
+	for(control = controls; control && !result; control = control->next)
+	{
+		result = (control->hazard_table == ptr || control->hazard_node == ptr);
+	}
+	jit_mutex_unlock(&control_lock);
+	return result;
+}
+
 jit_thread_id_t _jit_thread_current_id(void)
 {
 #if defined(JIT_THREADS_PTHREAD)
@@ -170,6 +225,63 @@ jit_thread_id_t _jit_thread_current_id(void)
 #endif
 }
 
+#if defined(JIT_THREADS_WIN32)
+
+/*
+ * Start information for a Win32 thread.
+ */
+struct jit_thread_start
+{
+	void			*(*start)(void *);
+	void			*arg;
+};
+
+static DWORD WINAPI thread_start(LPVOID param)
+{
+	struct jit_thread_start info = *((struct jit_thread_start *)param);
+	jit_free(param);
+	(*info.start)(info.arg);
+	return 0;
+}
+
+#endif
+
+int _jit_thread_create(jit_thread_id_t *thread, void *(*start)(void *), void *arg)
+{
+#if defined(JIT_THREADS_PTHREAD)
+	return (pthread_create(thread, 0, start, arg) == 0);
+#elif defined(JIT_THREADS_WIN32)
+	struct jit_thread_start *info;
+	info = jit_new(struct jit_thread_start);
+	if(!info)
+	{
+		return 0;
+	}
+	info->start = start;
+	info->arg = arg;
+	*thread = CreateThread(NULL, 0, thread_start, info, 0, NULL);
+	if(!(*thread))
+	{
+		jit_free(info);
+		return 0;
+	}
+	return 1;
+#else
+	/* There is only one thread, so we cannot start another */
+	return 0;
+#endif
+}
+
+void _jit_thread_join(jit_thread_id_t thread)
+{
+#if defined(JIT_THREADS_PTHREAD)
+	pthread_join(thread, 0);
+#elif defined(JIT_THREADS_WIN32)
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#endif
+}
+
 int _jit_monitor_wait(jit_monitor_t *mon, jit_int timeout)
 {
 #if defined(JIT_THREADS_PTHREAD)
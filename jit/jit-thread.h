@@ -62,6 +62,17 @@ typedef int jit_thread_id_t;
  */
 typedef struct jit_thread_control *jit_thread_control_t;
 
+/*
+ * Start a new thread that runs "start(arg)".  Returns zero if threads
+ * are not supported or the thread could not be created.
+ */
+int _jit_thread_create(jit_thread_id_t *thread, void *(*start)(void *), void *arg);
+
+/*
+ * Wait for a thread created with "_jit_thread_create" to finish.
+ */
+void _jit_thread_join(jit_thread_id_t thread);
+
 /*
  * Initialize the thread routines.  Ignored if called multiple times.
  */
@@ -77,6 +88,12 @@ jit_thread_control_t _jit_thread_get_control(void);
  */
 jit_thread_id_t _jit_thread_current_id(void);
 
+/*
+ * Determine if "ptr" is one of the hazard pointers of a thread, in which
+ * case the memory that it points to must not be freed yet.
+ */
+int _jit_thread_is_hazard(void *ptr);
+
 /*
  * Define the primitive mutex operations.
  */
@@ -209,6 +226,33 @@ typedef int jit_monitor_t;
 int _jit_monitor_wait(jit_monitor_t *mon, jit_int timeout);
 #define	jit_monitor_wait(mon,timeout)	_jit_monitor_wait((mon), (timeout))
 
+/*
+ * Define the atomic increment and decrement operations for reference
+ * counts.  Both return the new value of the counter.  The memory barrier
+ * orders the memory accesses of lock-free readers and writers.
+ */
+#if defined(JIT_THREADS_PTHREAD) && defined(__GNUC__)
+
+#define	jit_atomic_inc(ptr)		(__sync_add_and_fetch((ptr), 1))
+#define	jit_atomic_dec(ptr)		(__sync_sub_and_fetch((ptr), 1))
+#define	jit_memory_barrier()		(__sync_synchronize())
+
+#elif defined(JIT_THREADS_WIN32)
+
+#define	jit_atomic_inc(ptr)		\
+		((unsigned int) InterlockedIncrement((LONG volatile *)(ptr)))
+#define	jit_atomic_dec(ptr)		\
+		((unsigned int) InterlockedDecrement((LONG volatile *)(ptr)))
+#define	jit_memory_barrier()		MemoryBarrier()
+
+#else
+
+#define	jit_atomic_inc(ptr)		(++(*(ptr)))
+#define	jit_atomic_dec(ptr)		(--(*(ptr)))
+#define	jit_memory_barrier()		do { ; } while (0)
+
+#endif
+
 #ifdef	__cplusplus
 };
 #endif
@@ -0,0 +1,567 @@
+/*
+ * jit-tier.c - Tiered compilation of on-demand functions.
+ *
+ * Copyright (C) 2026  Free Software Foundation
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit-internal.h"
+
+/*
+ * Functions that are compiled with JIT_OPTION_TIERED_COMPILE first get
+ * baseline code that is generated with JIT_OPTLEVEL_NONE.  The baseline
+ * code increments the function's counter on entry and on every loop back
+ * edge.  Once the counter reaches the threshold the function entry wakes
+ * up the background thread.  The thread also polls the counters periodically
+ * to catch functions that spend their time in long running loops.  Hot
+ * functions are then rebuilt with the user's on-demand compiler at the
+ * normal optimization level.  Callers always go through the indirector
+ * so they pick up the new entry point on the next call.
+ *
+ * With JIT_OPTION_BRANCH_PROFILE the baseline code also counts how often
+ * each conditional branch runs and how often it falls through.  The
+ * conditional branches are numbered in the order of the blocks, which
+ * is the same each time the on-demand compiler builds the function, so
+ * the counts are turned into "likely" and "unlikely" hints on the
+ * branches of the optimized build for the block layout pass.
+ */
+
+/*
+ * How often the background thread polls the counters, in milliseconds.
+ */
+#define	JIT_TIER_POLL_INTERVAL		20
+
+/*
+ * Maximum number of functions promoted in one round.
+ */
+#define	JIT_TIER_BATCH_SIZE		32
+
+/*
+ * A branch of the baseline code must have run at least this many times
+ * for its profile to be used, and must have gone the same way at least
+ * this percentage of the time to be taken as likely or unlikely.
+ */
+#define	JIT_TIER_PROFILE_MIN		16
+#define	JIT_TIER_PROFILE_BIAS		80
+
+/*
+ * Get the tiering threshold for a context.
+ */
+static jit_uint
+tier_threshold(jit_context_t context)
+{
+	return (jit_uint) jit_context_get_meta_numeric(context, JIT_OPTION_TIERED_COMPILE);
+}
+
+/*
+ * Emit code that increments a counter.  Returns the value with the
+ * new count or NULL if out of memory.
+ */
+static jit_value_t
+emit_increment(jit_function_t func, jit_uint volatile *count)
+{
+	jit_value_t counter, value, one;
+
+	counter = jit_value_create_nint_constant(func, jit_type_void_ptr,
+						 (jit_nint) count);
+	if(!counter)
+	{
+		return 0;
+	}
+	value = jit_insn_load_relative(func, counter, 0, jit_type_uint);
+	if(!value)
+	{
+		return 0;
+	}
+	one = jit_value_create_nint_constant(func, jit_type_uint, 1);
+	if(!one)
+	{
+		return 0;
+	}
+	value = jit_insn_add(func, value, one);
+	if(!value)
+	{
+		return 0;
+	}
+	if(!jit_insn_store_relative(func, counter, 0, value))
+	{
+		return 0;
+	}
+	return value;
+}
+
+/*
+ * Emit code that increments the function's tier counter.  Returns
+ * the value with the new count or NULL if out of memory.
+ */
+static jit_value_t
+emit_counter_update(jit_function_t func)
+{
+	return emit_increment(func, &func->tier_count);
+}
+
+/*
+ * Emit the entry counter and the call that requests promotion
+ * once the counter reaches the threshold.
+ */
+static int
+emit_entry_counter(jit_function_t func, jit_uint threshold)
+{
+	jit_type_t signature;
+	jit_type_t param;
+	jit_value_t value, limit, arg;
+	jit_label_t label = jit_label_undefined;
+
+	value = emit_counter_update(func);
+	if(!value)
+	{
+		return 0;
+	}
+	limit = jit_value_create_nint_constant(func, jit_type_uint, (jit_nint) threshold);
+	if(!limit)
+	{
+		return 0;
+	}
+	value = jit_insn_lt(func, value, limit);
+	if(!value)
+	{
+		return 0;
+	}
+	if(!jit_insn_branch_if(func, value, &label))
+	{
+		return 0;
+	}
+
+	arg = jit_value_create_nint_constant(func, jit_type_void_ptr, (jit_nint) func);
+	if(!arg)
+	{
+		return 0;
+	}
+	param = jit_type_void_ptr;
+	signature = jit_type_create_signature(jit_abi_cdecl, jit_type_void, &param, 1, 1);
+	if(!signature)
+	{
+		return 0;
+	}
+	value = jit_insn_call_native(func, "_jit_function_request_tier_up",
+				     (void *) _jit_function_request_tier_up,
+				     signature, &arg, 1, JIT_CALL_NOTHROW);
+	jit_type_free(signature);
+	if(!value)
+	{
+		return 0;
+	}
+
+	return jit_insn_label(func, &label);
+}
+
+int
+_jit_tier_begin(jit_function_t func)
+{
+	jit_uint threshold;
+
+	threshold = tier_threshold(func->context);
+	if(!threshold || func->tier != _JIT_TIER_NONE)
+	{
+		return 0;
+	}
+
+	/* Nested functions are called directly by their parents, and the
+	   position-independent or pre-compiled code cannot refer to the
+	   counters */
+	if(func->nested_parent
+	   || jit_context_get_meta_numeric(func->context, JIT_OPTION_POSITION_INDEPENDENT)
+	   || jit_context_get_meta_numeric(func->context, JIT_OPTION_PRE_COMPILE))
+	{
+		return 0;
+	}
+
+	/* The function must be called through its indirector from now on */
+	func->is_recompilable = 1;
+	func->optimization_level = JIT_OPTLEVEL_NONE;
+	func->tier_count = 0;
+
+	/* If we run out of memory here then the on-demand compiler
+	   will run out of memory too and report the problem */
+	if(_jit_function_ensure_builder(func))
+	{
+		emit_entry_counter(func, threshold);
+	}
+
+	return 1;
+}
+
+void
+_jit_tier_count_back_edges(jit_function_t func)
+{
+	jit_builder_t builder;
+	jit_block_t block, target, current;
+	jit_insn_t insn;
+	struct _jit_insn branch;
+
+	builder = func->builder;
+	if(!builder)
+	{
+		return;
+	}
+
+	/* A branch to a block that comes earlier in the block list is
+	   taken to be a loop back edge.  Insert the counter update right
+	   before such a branch. */
+	current = builder->current_block;
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		block->visited = 1;
+
+		insn = _jit_block_get_last(block);
+		if(!insn || insn->opcode < JIT_OP_BR || insn->opcode > JIT_OP_BR_NFGE_INV)
+		{
+			continue;
+		}
+		target = jit_block_from_label(func, (jit_label_t) insn->dest);
+		if(!target || !target->visited)
+		{
+			continue;
+		}
+
+		branch = *insn;
+		--(block->num_insns);
+		builder->current_block = block;
+		emit_counter_update(func);
+		insn = _jit_block_add_insn(block);
+		if(insn)
+		{
+			*insn = branch;
+		}
+	}
+	builder->current_block = current;
+
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		block->visited = 0;
+	}
+}
+
+static int
+is_cond_branch(jit_insn_t insn)
+{
+	return (insn && insn->opcode > JIT_OP_BR && insn->opcode <= JIT_OP_BR_NFGE_INV);
+}
+
+void
+_jit_tier_count_branches(jit_function_t func)
+{
+	jit_builder_t builder;
+	jit_block_t block, first, next, fallthru, current;
+	jit_insn_t insn;
+	struct _jit_insn branch;
+	jit_uint *counts;
+	unsigned int num_branches, index;
+
+	builder = func->builder;
+	if(!builder || func->branch_counts
+	   || !jit_context_get_meta_numeric(func->context, JIT_OPTION_BRANCH_PROFILE))
+	{
+		return;
+	}
+
+	/* The first conditional branch is the one of the entry counter,
+	   which the optimized code does not have.  The branches of the
+	   function itself are numbered after it, in the same way as the
+	   optimized build numbers them from the start. */
+	first = 0;
+	num_branches = 0;
+	for(block = builder->entry_block; block; block = block->next)
+	{
+		if(is_cond_branch(_jit_block_get_last(block)))
+		{
+			if(!first)
+			{
+				first = block;
+			}
+			else
+			{
+				++num_branches;
+			}
+		}
+	}
+	if(!num_branches)
+	{
+		return;
+	}
+	counts = (jit_uint *) jit_calloc(2 * num_branches, sizeof(jit_uint));
+	if(!counts)
+	{
+		return;
+	}
+	func->branch_counts = counts;
+	func->num_branches = num_branches;
+
+	/* Count how often each branch is reached right before it, and how
+	   often it falls through in a new block right after it */
+	current = builder->current_block;
+	index = 0;
+	for(block = first->next; block; block = next)
+	{
+		next = block->next;
+		insn = _jit_block_get_last(block);
+		if(!is_cond_branch(insn))
+		{
+			continue;
+		}
+
+		branch = *insn;
+		--(block->num_insns);
+		builder->current_block = block;
+		emit_increment(func, &counts[2 * index]);
+		insn = _jit_block_add_insn(block);
+		if(insn)
+		{
+			*insn = branch;
+		}
+
+		fallthru = _jit_block_create(func);
+		if(fallthru)
+		{
+			_jit_block_attach_after(block, fallthru, fallthru);
+			builder->current_block = fallthru;
+			emit_increment(func, &counts[2 * index + 1]);
+		}
+		++index;
+	}
+	builder->current_block = current;
+}
+
+void
+_jit_tier_use_branch_profile(jit_function_t func)
+{
+	jit_block_t block;
+	jit_insn_t insn;
+	jit_ulong total, taken;
+	unsigned int index;
+
+	if(!func->builder || !func->branch_counts)
+	{
+		return;
+	}
+
+	index = 0;
+	for(block = func->builder->entry_block; block; block = block->next)
+	{
+		insn = _jit_block_get_last(block);
+		if(!is_cond_branch(insn))
+		{
+			continue;
+		}
+
+		/* Give up if the function was built differently this time */
+		if(index >= func->num_branches)
+		{
+			break;
+		}
+		total = func->branch_counts[2 * index];
+		taken = total - func->branch_counts[2 * index + 1];
+		++index;
+		if(total < JIT_TIER_PROFILE_MIN || taken > total)
+		{
+			continue;
+		}
+
+		insn->flags &= ~(JIT_INSN_BRANCH_LIKELY | JIT_INSN_BRANCH_UNLIKELY);
+		if(taken * 100 >= total * JIT_TIER_PROFILE_BIAS)
+		{
+			insn->flags |= JIT_INSN_BRANCH_LIKELY;
+		}
+		else if((total - taken) * 100 >= total * JIT_TIER_PROFILE_BIAS)
+		{
+			insn->flags |= JIT_INSN_BRANCH_UNLIKELY;
+		}
+	}
+}
+
+void
+_jit_tier_end(jit_function_t func, unsigned int level, int result)
+{
+	func->optimization_level = level;
+	if(result == JIT_RESULT_OK)
+	{
+		func->tier = _JIT_TIER_BASELINE;
+	}
+}
+
+/*
+ * Promote the functions whose counters went over the threshold.
+ * Returns zero if there was nothing to do.
+ */
+static int
+promote_hot_functions(jit_context_t context)
+{
+	jit_function_t batch[JIT_TIER_BATCH_SIZE];
+	jit_function_t func;
+	jit_uint threshold;
+	int count, index, destroy;
+
+	threshold = tier_threshold(context);
+
+	/* Collect the hot functions */
+	count = 0;
+	_jit_memory_lock(context);
+	jit_monitor_lock(&context->tier_monitor);
+	for(func = context->functions; func && count < JIT_TIER_BATCH_SIZE; func = func->next)
+	{
+		if(func->tier == _JIT_TIER_BASELINE && func->tier_count >= threshold)
+		{
+			func->tier = _JIT_TIER_PROMOTING;
+			batch[count++] = func;
+		}
+	}
+	jit_monitor_unlock(&context->tier_monitor);
+	_jit_memory_unlock(context);
+
+	/* Recompile them.  The functions are not retried if this fails,
+	   the baseline code is still good.  A function that was destroyed
+	   in the meantime is only destroyed for real here. */
+	for(index = 0; index < count; ++index)
+	{
+		func = batch[index];
+		if(func->tier == _JIT_TIER_PROMOTING)
+		{
+			_jit_function_recompile(func);
+		}
+
+		jit_monitor_lock(&context->tier_monitor);
+		destroy = (func->tier == _JIT_TIER_DESTROYED);
+		if(!destroy)
+		{
+			func->tier = _JIT_TIER_OPTIMIZED;
+		}
+		jit_monitor_unlock(&context->tier_monitor);
+
+		if(destroy)
+		{
+			_jit_function_destroy(func);
+		}
+	}
+
+	return count;
+}
+
+/*
+ * The body of the background compilation thread.
+ */
+static void *
+tier_thread(void *arg)
+{
+	jit_context_t context = (jit_context_t) arg;
+
+	jit_monitor_lock(&context->tier_monitor);
+	while(!context->tier_shutdown)
+	{
+		if(!context->tier_pending)
+		{
+			jit_monitor_wait(&context->tier_monitor, JIT_TIER_POLL_INTERVAL);
+			if(context->tier_shutdown)
+			{
+				break;
+			}
+		}
+		context->tier_pending = 0;
+		jit_monitor_unlock(&context->tier_monitor);
+
+		while(promote_hot_functions(context))
+		{
+			/* Keep going until all the hot functions are done */
+		}
+
+		jit_monitor_lock(&context->tier_monitor);
+	}
+	jit_monitor_unlock(&context->tier_monitor);
+
+	return 0;
+}
+
+void
+_jit_function_request_tier_up(jit_function_t func)
+{
+	jit_context_t context = func->context;
+
+	/* Bail out quickly if the request is already being served */
+	if(func->tier != _JIT_TIER_BASELINE || context->tier_pending)
+	{
+		return;
+	}
+
+	jit_monitor_lock(&context->tier_monitor);
+	if(!context->tier_started && !context->tier_shutdown)
+	{
+		context->tier_started =
+			_jit_thread_create(&context->tier_thread, tier_thread, context);
+	}
+	if(context->tier_started)
+	{
+		context->tier_pending = 1;
+		jit_monitor_signal(&context->tier_monitor);
+		jit_monitor_unlock(&context->tier_monitor);
+		return;
+	}
+	jit_monitor_unlock(&context->tier_monitor);
+
+#if !defined(JIT_THREADS_PTHREAD) && !defined(JIT_THREADS_WIN32)
+	/* There is no background thread, so promote the function right now.
+	   The caller returns to the baseline code which is not freed. */
+	func->tier = _JIT_TIER_PROMOTING;
+	_jit_function_recompile(func);
+	func->tier = _JIT_TIER_OPTIMIZED;
+#endif
+}
+
+int
+_jit_tier_forget(jit_function_t func)
+{
+	jit_context_t context = func->context;
+	int deferred;
+
+	/* Only baseline functions can be picked by the background thread */
+	if(func->tier == _JIT_TIER_NONE)
+	{
+		return 1;
+	}
+
+	jit_monitor_lock(&context->tier_monitor);
+	deferred = (func->tier == _JIT_TIER_PROMOTING);
+	func->tier = deferred ? _JIT_TIER_DESTROYED : _JIT_TIER_NONE;
+	jit_monitor_unlock(&context->tier_monitor);
+
+	return !deferred;
+}
+
+void
+_jit_tier_shutdown(jit_context_t context)
+{
+	int started;
+
+	jit_monitor_lock(&context->tier_monitor);
+	context->tier_shutdown = 1;
+	started = context->tier_started;
+	context->tier_started = 0;
+	jit_monitor_signal(&context->tier_monitor);
+	jit_monitor_unlock(&context->tier_monitor);
+
+	if(started)
+	{
+		_jit_thread_join(context->tier_thread);
+	}
+}
@@ -433,7 +433,7 @@ jit_type_t jit_type_copy(jit_type_t type)
 	{
 		return type;
 	}
-	++(type->ref_count);
+	jit_atomic_inc(&(type->ref_count));
 	return type;
 }
 
@@ -451,10 +451,14 @@ void jit_type_free(jit_type_t type)
 	{
 		return;
 	}
-	if(--(type->ref_count) != 0)
+	if(jit_atomic_dec(&(type->ref_count)) != 0)
 	{
 		return;
 	}
+	if(type->kind == JIT_TYPE_SIGNATURE)
+	{
+		_jit_apply_free_stubs(type);
+	}
 	jit_type_free(type->sub_type);
 	for(index = 0; index < type->num_components; ++index)
 	{
@@ -661,6 +665,62 @@ jit_type_t jit_type_create_pointer(jit_type_t type, int incref)
 	return ntype;
 }
 
+/*@
+ * @deftypefun jit_type_t jit_type_create_vector (jit_type_t @var{type}, unsigned int @var{num_elements})
+ * Create a type descriptor for a 128-bit vector of @var{num_elements}
+ * values of the element @var{type}.  The supported vector types are
+ * 16 x @code{jit_type_sbyte}, 4 x @code{jit_type_int},
+ * 4 x @code{jit_type_float32} and 2 x @code{jit_type_float64}.
+ * Returns NULL for any other combination, or if out of memory.
+ *
+ * A vector is laid out like a structure with @var{num_elements} fields
+ * and 16-byte alignment, so it can be loaded, stored, copied and passed
+ * to functions like any other structure.  The arithmetic, bitwise and
+ * comparison instructions operate on all elements at once when they are
+ * given vector operands.
+ * @end deftypefun
+@*/
+jit_type_t jit_type_create_vector(jit_type_t type, unsigned int num_elements)
+{
+	jit_type_t fields[16];
+	jit_type_t vtype;
+	unsigned int index;
+
+	type = jit_type_remove_tags(type);
+	if(!type)
+	{
+		return 0;
+	}
+	switch(type->kind)
+	{
+	case JIT_TYPE_SBYTE:
+	case JIT_TYPE_INT:
+	case JIT_TYPE_FLOAT32:
+	case JIT_TYPE_FLOAT64:
+		break;
+
+	default:
+		return 0;
+	}
+	if(num_elements * type->size != JIT_VECTOR_SIZE)
+	{
+		return 0;
+	}
+
+	for(index = 0; index < num_elements; ++index)
+	{
+		fields[index] = type;
+	}
+	vtype = create_complex(JIT_TYPE_STRUCT, fields, num_elements, 1);
+	if(vtype)
+	{
+		/* The element type marks the structure as a vector */
+		vtype->sub_type = jit_type_copy(type);
+		vtype->alignment = JIT_VECTOR_SIZE;
+	}
+	return vtype;
+}
+
 /*@
  * @deftypefun jit_type_t jit_type_create_tagged (jit_type_t @var{type}, int @var{kind}, void *@var{data}, jit_meta_free_func @var{free_func}, int @var{incref})
  * Tag a type with some additional user data.  Tagging is typically used by
@@ -1474,6 +1534,33 @@ int jit_type_is_tagged(jit_type_t type)
 	}
 }
 
+/*@
+ * @deftypefun int jit_type_is_vector (jit_type_t @var{type})
+ * Determine if a type is a vector that was created with
+ * @code{jit_type_create_vector}.  Tags are ignored.
+ * @end deftypefun
+@*/
+int jit_type_is_vector(jit_type_t type)
+{
+	return (jit_type_get_vector_element(type) != 0);
+}
+
+/*@
+ * @deftypefun jit_type_t jit_type_get_vector_element (jit_type_t @var{type})
+ * Get the element type of a vector type.  Returns NULL if @var{type}
+ * is not a vector.
+ * @end deftypefun
+@*/
+jit_type_t jit_type_get_vector_element(jit_type_t type)
+{
+	type = jit_type_remove_tags(type);
+	if(type && type->kind == JIT_TYPE_STRUCT)
+	{
+		return type->sub_type;
+	}
+	return 0;
+}
+
 /*@
  * @deftypefun jit_type_t jit_type_remove_tags (jit_type_t @var{type})
  * Remove tags from a type, and return the underlying type.
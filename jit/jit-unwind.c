@@ -213,3 +213,308 @@ jit_unwind_get_offset(jit_unwind_context_t *unwind)
 
 	return _jit_function_get_bytecode(func, unwind->cache, pc, 0);
 }
+
+/*
+ * Contexts that have functions with exception tables.  The list is
+ * protected by "_jit_global_lock".
+ */
+static jit_context_t volatile unwind_contexts;
+
+void
+_jit_unwind_add_context(jit_context_t context)
+{
+	if(context->unwind_listed)
+	{
+		return;
+	}
+	jit_mutex_lock(&_jit_global_lock);
+	if(!context->unwind_listed)
+	{
+		context->unwind_next = unwind_contexts;
+		context->unwind_listed = 1;
+		unwind_contexts = context;
+	}
+	jit_mutex_unlock(&_jit_global_lock);
+}
+
+void
+_jit_unwind_remove_context(jit_context_t context)
+{
+	jit_context_t *link;
+
+	if(!context->unwind_listed)
+	{
+		return;
+	}
+	jit_mutex_lock(&_jit_global_lock);
+	for(link = (jit_context_t *) &unwind_contexts; *link; link = &(*link)->unwind_next)
+	{
+		if(*link == context)
+		{
+			*link = context->unwind_next;
+			break;
+		}
+	}
+	context->unwind_listed = 0;
+	jit_mutex_unlock(&_jit_global_lock);
+}
+
+#if defined(JIT_USE_EXCEPTION_TABLES) && defined(JIT_USE_UNWIND_INFO) && \
+	!defined(JIT_BACKEND_INTERP)
+
+#include <unwind.h>
+
+/*
+ * The DWARF numbers of the callee-saved registers other than the frame
+ * pointer, in the order that "resume" loads them.
+ */
+#define	NUM_SAVED_REGS		5
+static const int saved_regs[NUM_SAVED_REGS] = {3, 12, 13, 14, 15};
+#define	DW_REG_RBP		6
+
+/*
+ * The state of the search for a catcher.  Once the frame of a function
+ * with an exception table is found, the registers that it had at the
+ * throw are kept here until the frame is resumed.
+ */
+typedef struct
+{
+	char			*limit;
+	int			skip;
+	_jit_catch_table_t	table;
+	char			*frame;
+	void			*thrown_pc;
+	jit_nuint		regs[NUM_SAVED_REGS];
+} catch_state_t;
+
+/*
+ * Find the exception table that covers the instruction at "pc".
+ */
+static _jit_catch_table_t
+find_catch_table(unsigned char *pc)
+{
+	jit_context_t context;
+	jit_function_info_t info;
+	jit_function_t func;
+	_jit_catch_table_t table;
+
+	table = 0;
+	jit_mutex_lock(&_jit_global_lock);
+	for(context = unwind_contexts; context; context = context->unwind_next)
+	{
+		info = _jit_memory_find_function_info(context, pc);
+		func = _jit_memory_get_function(context, info);
+		if(func)
+		{
+			/* The table is only valid for the latest code of the
+			   function */
+			table = func->catch_table;
+			if(table && (pc < table->start || pc >= table->end))
+			{
+				table = 0;
+			}
+			break;
+		}
+	}
+	jit_mutex_unlock(&_jit_global_lock);
+	return table;
+}
+
+/*
+ * Look at one frame for "_Unwind_Backtrace".  The unwinder steps through
+ * native frames with or without frame pointers, through the frames of
+ * compiled code with the information that "_jit_unwind_register" gives
+ * it, and through the frame of a signal handler to the instruction that
+ * raised the signal.
+ */
+static _Unwind_Reason_Code
+find_catcher(struct _Unwind_Context *context, void *data)
+{
+	catch_state_t *state = (catch_state_t *) data;
+	_jit_catch_table_t table;
+	unsigned char *pc;
+	int before_insn;
+	int index;
+
+	/* Frames beyond the closest "setjmp" catcher are left to it */
+	if(state->limit && (char *) _Unwind_GetCFA(context) > state->limit)
+	{
+		return _URC_END_OF_STACK;
+	}
+
+	/* A return address points after the call, but the address in the
+	   frame of a signal handler is that of the instruction itself */
+	before_insn = 0;
+	pc = (unsigned char *) _Unwind_GetIPInfo(context, &before_insn);
+	if(!pc)
+	{
+		return _URC_END_OF_STACK;
+	}
+	if(!before_insn)
+	{
+		--pc;
+	}
+
+	table = find_catch_table(pc);
+	if(!table)
+	{
+		return _URC_NO_REASON;
+	}
+	if(state->skip > 0)
+	{
+		--(state->skip);
+		return _URC_NO_REASON;
+	}
+
+	state->table = table;
+	state->frame = (char *) _Unwind_GetGR(context, DW_REG_RBP);
+	state->thrown_pc = pc;
+	for(index = 0; index < NUM_SAVED_REGS; ++index)
+	{
+		state->regs[index] = (jit_nuint) _Unwind_GetGR(context, saved_regs[index]);
+	}
+	return _URC_END_OF_STACK;
+}
+
+/*
+ * Resume the code at "pc" with the given frame and stack pointers and
+ * callee-saved registers.
+ */
+static void
+resume(void *frame, void *stack, void *pc, jit_nuint *regs)
+{
+	__asm__ __volatile__ (
+		"movq 0(%3), %%rbx\n\t"
+		"movq 8(%3), %%r12\n\t"
+		"movq 16(%3), %%r13\n\t"
+		"movq 24(%3), %%r14\n\t"
+		"movq 32(%3), %%r15\n\t"
+		"movq %0, %%rsp\n\t"
+		"movq %1, %%rbp\n\t"
+		"jmpq *%2\n\t"
+		: : "a" (stack), "d" (frame), "c" (pc), "S" (regs) : "memory");
+}
+
+void
+_jit_unwind_catch(int skip)
+{
+	jit_thread_control_t control;
+	catch_state_t state;
+
+	/* There is nothing to look for if no function has a table */
+	if(!unwind_contexts)
+	{
+		return;
+	}
+	control = _jit_thread_get_control();
+	if(!control)
+	{
+		return;
+	}
+
+	/* The closest "setjmp" catcher lives in the frame of a function
+	   that called all the frames which are closer to the throw */
+	state.limit = (char *) control->setjmp_head;
+	state.skip = skip;
+	state.table = 0;
+	_Unwind_Backtrace(find_catcher, &state);
+	if(!state.table)
+	{
+		return;
+	}
+
+	/* Tell the catcher where the exception came from, in the same way
+	   as "catch_pc" does for a "setjmp" catcher */
+	*((void **) (state.frame + state.table->thrown_pc_offset)) = state.thrown_pc;
+
+	/* Drop the backtrace records of the frames that are left behind,
+	   like "longjmp" does */
+	while(control->backtrace_head
+	      && (char *) control->backtrace_head < state.frame)
+	{
+		control->backtrace_head = control->backtrace_head->parent;
+	}
+
+	resume(state.frame, state.frame - state.table->stack_size,
+	       state.table->catcher, state.regs);
+}
+
+#else /* !JIT_USE_EXCEPTION_TABLES */
+
+void
+_jit_unwind_catch(int skip)
+{
+	/* Exception tables are not supported by this back end */
+}
+
+#endif /* !JIT_USE_EXCEPTION_TABLES */
+
+#if defined(JIT_USE_UNWIND_INFO) && !defined(JIT_BACKEND_INTERP)
+
+/*
+ * The registration functions of the GNU unwinder.  They are weak so that
+ * the library still loads if the unwinder of the process lacks them.
+ */
+extern void __register_frame(void *begin) __attribute__((weak));
+extern void __deregister_frame(void *begin) __attribute__((weak));
+
+void
+_jit_unwind_register(jit_function_t func, _jit_unwind_info_t info)
+{
+	if(!info)
+	{
+		return;
+	}
+	if(!__register_frame || !__deregister_frame)
+	{
+		jit_free(info);
+		return;
+	}
+
+	/* The older versions of the code stay registered as long as they
+	   stay in the code cache, which is until the function is destroyed */
+	info->next = func->unwind_info;
+	func->unwind_info = info;
+	__register_frame(info->eh_frame);
+}
+
+void
+_jit_unwind_deregister(jit_function_t func)
+{
+	_jit_unwind_info_t info;
+
+	while((info = func->unwind_info) != 0)
+	{
+		func->unwind_info = info->next;
+		__deregister_frame(info->eh_frame);
+		jit_free(info);
+	}
+}
+
+int
+_jit_unwind_is_available(void)
+{
+	return (__register_frame && __deregister_frame);
+}
+
+#else /* !JIT_USE_UNWIND_INFO */
+
+void
+_jit_unwind_register(jit_function_t func, _jit_unwind_info_t info)
+{
+	/* Unwind information is not supported by this back end */
+	jit_free(info);
+}
+
+void
+_jit_unwind_deregister(jit_function_t func)
+{
+}
+
+int
+_jit_unwind_is_available(void)
+{
+	return 0;
+}
+
+#endif /* !JIT_USE_UNWIND_INFO */
@@ -505,7 +505,8 @@ jit_value_get_param(jit_function_t func, unsigned int param)
 	}
 
 	/* Create the values for the first time */
-	values = (jit_value_t *) jit_calloc(num_params, sizeof(jit_value_t));
+	values = (jit_value_t *) _jit_builder_calloc(func->builder, num_params,
+						       sizeof(jit_value_t));
 	if(!values)
 	{
 		return 0;
@@ -52,6 +52,14 @@
 # define MAP_ANONYMOUS        MAP_ANON
 #endif
 
+/*
+ * The size of the huge pages that "jit_vmem_reserve_huge" asks for.
+ */
+#if defined(JIT_VMEM_MMAP) && defined(JIT_LINUX_PLATFORM) \
+	&& (defined(MAP_HUGETLB) || defined(MADV_HUGEPAGE))
+# define JIT_VMEM_HUGE_PAGE_SIZE	(2 * 1024 * 1024)
+#endif
+
 static jit_uint page_size;
 
 #if defined(JIT_VMEM_WIN32)
@@ -122,6 +130,23 @@ jit_vmem_page_size(void)
 	return page_size;
 }
 
+/*@
+ * @deftypefun {unsigned int} jit_vmem_huge_page_size (void)
+ * Get the size of the huge pages that @code{jit_vmem_reserve_huge}
+ * tries to back its memory with.  This is the normal page size on
+ * systems without huge pages.
+ * @end deftypefun
+@*/
+jit_uint
+jit_vmem_huge_page_size(void)
+{
+#if defined(JIT_VMEM_HUGE_PAGE_SIZE)
+	return JIT_VMEM_HUGE_PAGE_SIZE;
+#else
+	return page_size;
+#endif
+}
+
 jit_nuint
 jit_vmem_round_up(jit_nuint value)
 {
@@ -185,6 +210,70 @@ jit_vmem_reserve_committed(jit_uint size, jit_prot_t prot)
 #endif
 }
 
+/*@
+ * @deftypefun {void *} jit_vmem_reserve_huge (jit_uint @var{size}, jit_prot_t @var{prot})
+ * Reserve and commit a contiguous region of @var{size} bytes that starts
+ * on a huge page boundary and is backed by huge pages where the system
+ * allows it, so that code spread over the region takes few TLB entries.
+ * On Linux the pages come from the reserved huge page pool if it has
+ * enough of them, and otherwise the region is marked for transparent
+ * huge pages.  Elsewhere the region is committed with normal pages.
+ * The @var{size} should be a multiple of @code{jit_vmem_huge_page_size()}.
+ * Release the region with @code{jit_vmem_release}.
+ * @end deftypefun
+@*/
+void *
+jit_vmem_reserve_huge(jit_uint size, jit_prot_t prot)
+{
+#if defined(JIT_VMEM_HUGE_PAGE_SIZE)
+
+	unsigned char *addr, *start;
+	jit_nuint offset;
+	int nprot;
+
+	nprot = convert_prot(prot);
+
+# if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+	/* Huge page mappings are aligned to the huge page size.  Ask for
+	   2 MiB pages in case the default size is a different one */
+	addr = mmap(0, size, nprot,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT),
+		    -1, 0);
+	if(addr != MAP_FAILED)
+	{
+		return addr;
+	}
+# endif
+
+	/* Map more than needed and trim the ends to get the alignment */
+	if(size > ((jit_uint) ~0) - JIT_VMEM_HUGE_PAGE_SIZE)
+	{
+		return (void *) 0;
+	}
+	addr = jit_vmem_reserve_committed(size + JIT_VMEM_HUGE_PAGE_SIZE, prot);
+	if(!addr)
+	{
+		return (void *) 0;
+	}
+	offset = ((jit_nuint) addr) & (JIT_VMEM_HUGE_PAGE_SIZE - 1);
+	start = addr + (offset ? JIT_VMEM_HUGE_PAGE_SIZE - offset : 0);
+	if(start > addr)
+	{
+		munmap(addr, start - addr);
+	}
+	munmap(start + size, (addr + JIT_VMEM_HUGE_PAGE_SIZE) - start);
+
+# if defined(MADV_HUGEPAGE)
+	/* The region still works with normal pages if this fails */
+	madvise(start, size, MADV_HUGEPAGE);
+# endif
+	return start;
+
+#else
+	return jit_vmem_reserve_committed(size, prot);
+#endif
+}
+
 int
 jit_vmem_release(void *addr, jit_uint size)
 {
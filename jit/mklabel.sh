@@ -289,7 +289,10 @@ echo ''
 # Output the non-goto case of the helper macros.
 echo '#else /* JIT_INTERP_SWITCH */'
 echo ''
-echo '#define VMSWITCH(pc)        for(;;) { switch(VMFETCH((pc)))'
+echo '#if !defined(VMPROFILE)'
+echo '#define VMPROFILE(pc)'
+echo '#endif'
+echo '#define VMSWITCH(pc)        for(;;) { VMPROFILE((pc)); switch(VMFETCH((pc)))'
 echo '#define VMSWITCHEND         }'
 echo '#define VMCASE(val)         case (val)'
 echo '#define VMBREAK             VMNULLASM(); break'
@@ -0,0 +1,223 @@
+/*
+ * apply-tests.c - Tests for function application and closures
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+/* More parameters of each class than fit in registers */
+#define NUM_WORDS	8
+#define NUM_FLOATS	10
+#define NUM_PARAMS	(NUM_WORDS + NUM_FLOATS)
+
+typedef jit_float64 (*sum_func)(jit_sbyte, jit_ubyte, jit_short, jit_ushort,
+				jit_int, jit_uint, jit_long, jit_int *,
+				jit_float32, jit_float64, jit_float32,
+				jit_float64, jit_float32, jit_float64,
+				jit_float32, jit_float64, jit_float32,
+				jit_float64);
+typedef jit_short (*neg_func)(jit_short);
+
+static jit_context_t context;
+static jit_type_t sum_signature;
+static jit_type_t neg_signature;
+
+/* The arguments for the sum, and their sum */
+
+static jit_sbyte arg_sbyte = -5;
+static jit_ubyte arg_ubyte = 250;
+static jit_short arg_short = -3000;
+static jit_ushort arg_ushort = 60000;
+static jit_int arg_int = -100000;
+static jit_uint arg_uint = 3000000000U;
+static jit_long arg_long = -(jit_long)1 << 40;
+static jit_int pointee = 7;
+static jit_int *arg_ptr = &pointee;
+static jit_float32 arg_float32[NUM_FLOATS / 2] = {0.5, 1.5, 2.5, 3.5, 4.5};
+static jit_float64 arg_float64[NUM_FLOATS / 2] = {0.25, 1.25, 2.25, 3.25, 4.25};
+
+static jit_float64
+expected_sum(void)
+{
+	jit_float64 sum;
+	int i;
+
+	sum = (jit_float64)arg_sbyte + arg_ubyte + arg_short + arg_ushort
+		+ arg_int + arg_uint + (jit_float64)arg_long + *arg_ptr;
+	for (i = 0; i < NUM_FLOATS / 2; i++)
+	{
+		sum += arg_float32[i] + arg_float64[i];
+	}
+	return sum;
+}
+
+static void
+get_sum_args(void **args)
+{
+	int i;
+
+	args[0] = &arg_sbyte;
+	args[1] = &arg_ubyte;
+	args[2] = &arg_short;
+	args[3] = &arg_ushort;
+	args[4] = &arg_int;
+	args[5] = &arg_uint;
+	args[6] = &arg_long;
+	args[7] = &arg_ptr;
+	for (i = 0; i < NUM_FLOATS / 2; i++)
+	{
+		args[NUM_WORDS + i * 2] = &arg_float32[i];
+		args[NUM_WORDS + i * 2 + 1] = &arg_float64[i];
+	}
+}
+
+/* Every parameter must arrive in one piece, whether it is passed in
+   a register or on the stack.  */
+
+static void
+test_apply(void)
+{
+	jit_function_t func;
+	jit_value_t sum, value;
+	void *args[NUM_PARAMS];
+	jit_float64 result = 0;
+	jit_short neg_arg = 1234, neg_result = 0;
+	unsigned int i;
+
+	func = jit_function_create (context, sum_signature);
+	sum = jit_value_create_float64_constant (func, jit_type_float64, 0.0);
+	for (i = 0; i < NUM_PARAMS; i++)
+	{
+		value = jit_value_get_param (func, i);
+		if (i == NUM_WORDS - 1)
+		{
+			value = jit_insn_load_relative (func, value, 0,
+							jit_type_int);
+		}
+		value = jit_insn_convert (func, value, jit_type_float64, 0);
+		sum = jit_insn_add (func, sum, value);
+	}
+	jit_insn_return (func, sum);
+	CHECK (jit_function_compile (func));
+
+	get_sum_args (args);
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == expected_sum ());
+	CHECK (jit_function_apply (func, args, 0));
+
+	/* Small return values are stored with their own size */
+	func = jit_function_create (context, neg_signature);
+	jit_insn_return (func, jit_insn_neg (func, jit_value_get_param (func, 0)));
+	CHECK (jit_function_compile (func));
+	args[0] = &neg_arg;
+	CHECK (jit_function_apply (func, args, &neg_result));
+	CHECK (neg_result == -1234);
+}
+
+static void
+sum_closure(jit_type_t signature, void *result, void **args, void *user_data)
+{
+	jit_float64 sum = 0;
+	int i;
+
+	CHECK (signature == sum_signature);
+	sum += *(jit_sbyte *)args[0] + *(jit_ubyte *)args[1];
+	sum += *(jit_short *)args[2] + *(jit_ushort *)args[3];
+	sum += *(jit_int *)args[4] + (jit_float64)*(jit_uint *)args[5];
+	sum += (jit_float64)*(jit_long *)args[6] + **(jit_int **)args[7];
+	for (i = 0; i < NUM_FLOATS / 2; i++)
+	{
+		sum += *(jit_float32 *)args[NUM_WORDS + i * 2];
+		sum += *(jit_float64 *)args[NUM_WORDS + i * 2 + 1];
+	}
+	*(jit_float64 *)result = sum * *(jit_float64 *)user_data;
+}
+
+static void
+neg_closure(jit_type_t signature, void *result, void **args, void *user_data)
+{
+	*(jit_short *)result = (jit_short)(-*(jit_short *)args[0]);
+}
+
+/* Closures see the same arguments and return values as C does */
+
+static void
+test_closure(void)
+{
+	jit_float64 scale = 2.0;
+	sum_func sum;
+	neg_func neg;
+
+	sum = (sum_func)jit_closure_create (context, sum_signature,
+					    sum_closure, &scale);
+	neg = (neg_func)jit_closure_create (context, neg_signature,
+					    neg_closure, 0);
+	if (!sum || !neg)
+	{
+		/* Closures are not supported on this platform */
+		return;
+	}
+
+	CHECK (sum (arg_sbyte, arg_ubyte, arg_short, arg_ushort, arg_int,
+		    arg_uint, arg_long, arg_ptr,
+		    arg_float32[0], arg_float64[0], arg_float32[1],
+		    arg_float64[1], arg_float32[2], arg_float64[2],
+		    arg_float32[3], arg_float64[3], arg_float32[4],
+		    arg_float64[4]) == expected_sum () * 2.0);
+	CHECK (neg (1234) == -1234);
+	CHECK (neg (-32768) == -32768);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t params[NUM_PARAMS];
+	int i;
+
+	jit_init ();
+	context = jit_context_create ();
+
+	params[0] = jit_type_sbyte;
+	params[1] = jit_type_ubyte;
+	params[2] = jit_type_short;
+	params[3] = jit_type_ushort;
+	params[4] = jit_type_int;
+	params[5] = jit_type_uint;
+	params[6] = jit_type_long;
+	params[7] = jit_type_void_ptr;
+	for (i = 0; i < NUM_FLOATS / 2; i++)
+	{
+		params[NUM_WORDS + i * 2] = jit_type_float32;
+		params[NUM_WORDS + i * 2 + 1] = jit_type_float64;
+	}
+	sum_signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_float64, params, NUM_PARAMS, 1);
+	neg_signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_short, params + 2, 1, 1);
+
+	test_apply ();
+	test_closure ();
+
+	jit_context_destroy (context);
+	jit_type_free (sum_signature);
+	jit_type_free (neg_signature);
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * arena-tests.c - Tests for the builder arena
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+/* Enough instructions to outgrow the memory that an arena keeps */
+#define NUM_LARGE	40000
+
+static jit_context_t context;
+static jit_type_t signature;
+
+static jit_int
+call(jit_function_t func, jit_int arg)
+{
+	void *args[1];
+	jit_int result = 0;
+
+	args[0] = &arg;
+	CHECK (jit_function_apply (func, args, &result));
+	return result;
+}
+
+/* Build "sum = 0; for (i = 0; i < n; i++) sum += (i % 3 == 0) ? k : 1"
+   with a jump table for the choice */
+
+static jit_function_t
+create_loop(jit_int k)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t n, i, sum, rem;
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+	jit_label_t next = jit_label_undefined;
+	jit_label_t labels[3] = {
+		jit_label_undefined, jit_label_undefined, jit_label_undefined
+	};
+
+	n = jit_value_get_param (func, 0);
+	i = jit_value_create (func, jit_type_int);
+	sum = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, i, jit_value_create_nint_constant
+			(func, jit_type_int, 0));
+	jit_insn_store (func, sum, jit_value_create_nint_constant
+			(func, jit_type_int, 0));
+
+	jit_insn_label (func, &loop);
+	jit_insn_branch_if_not (func, jit_insn_lt (func, i, n), &done);
+	rem = jit_insn_rem (func, i, jit_value_create_nint_constant
+			    (func, jit_type_int, 3));
+	jit_insn_jump_table (func, rem, labels, 3);
+
+	jit_insn_label (func, &labels[0]);
+	jit_insn_store (func, sum, jit_insn_add
+			(func, sum, jit_value_create_nint_constant
+			 (func, jit_type_int, k)));
+	jit_insn_branch (func, &next);
+
+	jit_insn_label (func, &labels[1]);
+	jit_insn_label (func, &labels[2]);
+	jit_insn_store (func, sum, jit_insn_add
+			(func, sum, jit_value_create_nint_constant
+			 (func, jit_type_int, 1)));
+
+	jit_insn_label (func, &next);
+	jit_insn_store (func, i, jit_insn_add
+			(func, i, jit_value_create_nint_constant
+			 (func, jit_type_int, 1)));
+	jit_insn_branch (func, &loop);
+
+	jit_insn_label (func, &done);
+	jit_insn_return (func, sum);
+	return func;
+}
+
+static jit_int
+expected_loop(jit_int k, jit_int n)
+{
+	jit_int i, sum = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		sum += (i % 3 == 0) ? k : 1;
+	}
+	return sum;
+}
+
+/* Many functions in a row reuse the memory of the same arena */
+
+static void
+test_reuse(void)
+{
+	jit_function_t func;
+	jit_int k;
+
+	for (k = 0; k < 200; k++)
+	{
+		func = create_loop (k);
+		CHECK (jit_function_compile (func));
+		CHECK (call (func, 10) == expected_loop (k, 10));
+	}
+}
+
+/* Builders that are alive at the same time have their own arenas */
+
+static void
+test_interleaved(void)
+{
+	jit_function_t func1, func2, func3;
+
+	func1 = create_loop (5);
+	func2 = create_loop (7);
+
+	/* An abandoned builder gives its arena back too */
+	func3 = create_loop (9);
+	jit_function_abandon (func3);
+
+	CHECK (jit_function_compile (func2));
+	func3 = create_loop (11);
+	CHECK (jit_function_compile (func1));
+	CHECK (jit_function_compile (func3));
+	CHECK (call (func1, 20) == expected_loop (5, 20));
+	CHECK (call (func2, 20) == expected_loop (7, 20));
+	CHECK (call (func3, 20) == expected_loop (11, 20));
+}
+
+/* A function that needs more than one chunk of memory */
+
+static void
+test_large(void)
+{
+	jit_function_t func;
+	jit_value_t x;
+	jit_int expected = 1;
+	int i;
+
+	func = jit_function_create (context, signature);
+	x = jit_value_get_param (func, 0);
+	for (i = 0; i < NUM_LARGE; i++)
+	{
+		x = jit_insn_add (func, x, jit_value_create_nint_constant
+				  (func, jit_type_int, i % 7));
+		expected += i % 7;
+	}
+	jit_insn_return (func, x);
+	CHECK (jit_function_compile (func));
+	CHECK (call (func, 1) == expected);
+
+	/* The next function starts from a clean arena */
+	func = create_loop (3);
+	CHECK (jit_function_compile (func));
+	CHECK (call (func, 30) == expected_loop (3, 30));
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t param = jit_type_int;
+
+	jit_init ();
+	context = jit_context_create ();
+	jit_context_set_meta_numeric (context, JIT_OPTION_BUILDER_ARENA, 1);
+	signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_int, &param, 1, 1);
+
+	test_reuse ();
+	test_interleaved ();
+	test_large ();
+
+	jit_type_free (signature);
+	jit_context_destroy (context);
+	return 0;
+}
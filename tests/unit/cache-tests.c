@@ -0,0 +1,214 @@
+/*
+ * cache-tests.c - Tests for the function code cache
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+#define NUM_ROUNDS	2000
+#define NUM_LIVE	16
+
+/* Build "return x + 1 + 2 + ... + N".  */
+
+static jit_function_t
+create_func(jit_context_t ctx, jit_type_t sig, int n)
+{
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_value_t x = jit_value_get_param (func, 0);
+	int i;
+
+	for (i = 1; i <= n; i++)
+	{
+		x = jit_insn_add (func, x,
+				  jit_value_create_nint_constant (func,
+								  jit_type_int,
+								  i));
+	}
+	jit_insn_return (func, x);
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* Compile and destroy lots of functions of different sizes.  The cache
+   must reuse the memory of the destroyed functions instead of growing.  */
+
+static void
+test_reuse(void)
+{
+	jit_function_t funcs[NUM_LIVE] = { 0 };
+	jit_memory_stats_t stats;
+	jit_nuint total;
+	int i, n, x, result;
+	void *args[1];
+
+	jit_init ();
+	jit_context_t ctx = jit_context_create ();
+	CHECK (jit_context_set_meta_numeric (ctx, JIT_OPTION_CACHE_PAGE_SIZE,
+					     4096));
+
+	jit_type_t params[1] = { jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, 1, 1);
+	args[0] = &x;
+	total = 0;
+	for (i = 0; i < NUM_ROUNDS; i++)
+	{
+		n = (i * 7) % 40;
+		jit_function_destroy (funcs[i % NUM_LIVE]);
+		funcs[i % NUM_LIVE] = create_func (ctx, sig, n);
+
+		x = 3;
+		CHECK (jit_function_apply (funcs[i % NUM_LIVE], args, &result));
+		CHECK (result == 3 + n * (n + 1) / 2);
+		if (!jit_uses_interpreter ())
+		{
+			void *pc = jit_function_to_closure (funcs[i % NUM_LIVE]);
+			CHECK (jit_function_from_pc (ctx, pc, 0)
+			       == funcs[i % NUM_LIVE]);
+		}
+
+		if (i == NUM_ROUNDS / 10)
+		{
+			CHECK (jit_context_get_memory_stats (ctx, &stats));
+			total = stats.total_size;
+		}
+	}
+
+	CHECK (jit_context_get_memory_stats (ctx, &stats));
+	CHECK (stats.total_size <= 2 * total);
+	CHECK (stats.used_size + stats.free_size == stats.total_size);
+
+	for (i = 0; i < NUM_LIVE; i++)
+	{
+		jit_function_destroy (funcs[i]);
+	}
+	CHECK (jit_context_get_memory_stats (ctx, &stats));
+	CHECK (stats.used_size < total);
+
+	jit_type_free (sig);
+	jit_context_destroy (ctx);
+}
+
+/* The code of the functions comes from one region when the cache is
+   asked for huge pages, and the region is reused like other pages.  */
+
+static void
+test_huge_pages(void)
+{
+	jit_function_t funcs[NUM_LIVE] = { 0 };
+	unsigned char *low, *high, *pc;
+	jit_nuint region = 4 * 1024 * 1024;
+	int i, n, x, result;
+	void *args[1];
+
+	jit_init ();
+	jit_context_t ctx = jit_context_create ();
+	CHECK (jit_context_set_meta_numeric (ctx, JIT_OPTION_CACHE_HUGE_PAGES,
+					     region));
+
+	jit_type_t params[1] = { jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, 1, 1);
+	args[0] = &x;
+	low = high = 0;
+	for (i = 0; i < NUM_ROUNDS / 4; i++)
+	{
+		n = (i * 11) % 60;
+		jit_function_destroy (funcs[i % NUM_LIVE]);
+		funcs[i % NUM_LIVE] = create_func (ctx, sig, n);
+
+		x = 5;
+		CHECK (jit_function_apply (funcs[i % NUM_LIVE], args, &result));
+		CHECK (result == 5 + n * (n + 1) / 2);
+		if (!jit_uses_interpreter ())
+		{
+			pc = jit_function_to_closure (funcs[i % NUM_LIVE]);
+			CHECK (jit_function_from_pc (ctx, pc, 0)
+			       == funcs[i % NUM_LIVE]);
+			if (!low || pc < low)
+			{
+				low = pc;
+			}
+			if (!high || pc > high)
+			{
+				high = pc;
+			}
+		}
+	}
+	CHECK (high - low < region);
+
+	jit_type_free (sig);
+	jit_context_destroy (ctx);
+}
+
+static int num_stats;
+
+static void
+custom_stats(jit_memory_context_t memctx, jit_memory_stats_t *stats)
+{
+	CHECK (memctx != 0 && stats->total_size == 0);
+	stats->total_size = 1;
+	++num_stats;
+}
+
+/* A custom memory manager has no statistics until it provides them
+   with jit_context_set_memory_stats_func.  */
+
+static void
+test_custom_stats(void)
+{
+	static struct jit_memory_manager manager;
+	jit_memory_stats_t stats;
+	int x = 2, result;
+	void *args[1] = { &x };
+
+	jit_init ();
+	jit_context_t ctx = jit_context_create ();
+	manager = *jit_default_memory_manager ();
+	jit_context_set_memory_manager (ctx, &manager);
+
+	jit_type_t params[1] = { jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, 1, 1);
+	jit_function_t func = create_func (ctx, sig, 3);
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 2 + 6);
+	CHECK (!jit_context_get_memory_stats (ctx, &stats));
+
+	jit_context_set_memory_stats_func (ctx, custom_stats);
+	CHECK (jit_context_get_memory_stats (ctx, &stats));
+	CHECK (stats.total_size == 1 && num_stats == 1);
+
+	jit_type_free (sig);
+	jit_context_destroy (ctx);
+}
+
+int main()
+{
+	test_reuse ();
+	test_huge_pages ();
+	test_custom_stats ();
+
+	return 0;
+}
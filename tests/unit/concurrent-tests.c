@@ -0,0 +1,275 @@
+/*
+ * concurrent-tests.c - Concurrent and tiered on-demand compilation tests
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define NUM_FUNCS	64
+#define NUM_THREADS	8
+
+static jit_function_t funcs[NUM_FUNCS];
+static int build_count[NUM_FUNCS];
+
+/* Build "return x * 3 + N" where N is the function index.  */
+
+static int
+build_func(jit_function_t func)
+{
+	int index = (int) (jit_nint) jit_function_get_meta (func, 1);
+	jit_value_t x = jit_value_get_param (func, 0);
+	jit_value_t three
+	  = jit_value_create_nint_constant (func, jit_type_int, 3);
+	jit_value_t n
+	  = jit_value_create_nint_constant (func, jit_type_int, index);
+	jit_value_t tmp = jit_insn_mul (func, x, three);
+	tmp = jit_insn_add (func, tmp, n);
+	jit_insn_return (func, tmp);
+
+	++build_count[index];
+	return JIT_RESULT_OK;
+}
+
+static void *
+call_funcs(void *arg)
+{
+	int start = (int) (jit_nint) arg;
+	int i;
+
+	for (i = 0; i < NUM_FUNCS; i++)
+	{
+		int index = (start + i) % NUM_FUNCS;
+		int x = 5;
+		int result = -1;
+		void *args[] = { &x };
+		if (!jit_function_apply (funcs[index], args, &result)
+		    || result != 15 + index)
+		{
+			return (void *) 1;
+		}
+	}
+	return 0;
+}
+
+/* Invoke the same set of uncompiled functions from several threads.
+   Each function must be built exactly once and give the right answer.  */
+
+static void
+test_concurrent_on_demand(void)
+{
+	pthread_t threads[NUM_THREADS];
+	void *status;
+	int i;
+
+	jit_init ();
+	jit_context_t ctx = jit_context_create ();
+	CHECK (jit_context_set_meta_numeric (ctx, JIT_OPTION_CONCURRENT_COMPILE,
+					     1));
+
+	jit_type_t params[1] = { jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, 1, 1);
+	for (i = 0; i < NUM_FUNCS; i++)
+	{
+		funcs[i] = jit_function_create (ctx, sig);
+		CHECK (funcs[i] != NULL);
+		CHECK (jit_function_set_meta (funcs[i], 1, (void *) (jit_nint) i,
+					      0, 0));
+		jit_function_set_on_demand_compiler (funcs[i], build_func);
+	}
+
+	for (i = 0; i < NUM_THREADS; i++)
+	{
+		CHECK (pthread_create (&threads[i], NULL, call_funcs,
+				       (void *) (jit_nint) (i * 7)) == 0);
+	}
+	for (i = 0; i < NUM_THREADS; i++)
+	{
+		CHECK (pthread_join (threads[i], &status) == 0);
+		CHECK (status == NULL);
+	}
+
+	for (i = 0; i < NUM_FUNCS; i++)
+	{
+		CHECK (jit_function_is_compiled (funcs[i]));
+		CHECK (build_count[i] == 1);
+	}
+
+	jit_type_free (sig);
+	jit_context_destroy (ctx);
+}
+
+static jit_context_t lookup_context;
+static void *lookup_pc;
+static jit_function_t lookup_func;
+static volatile int lookup_done;
+
+static void *
+find_func(void *arg)
+{
+	while (!lookup_done)
+	{
+		if (jit_function_from_pc (lookup_context, lookup_pc, 0)
+		    != lookup_func)
+		{
+			return (void *) 1;
+		}
+	}
+	return 0;
+}
+
+/* Look up a function from several threads while other functions are
+   compiled and destroyed, which replaces the lookup table of the code
+   cache and frees the old ones.  */
+
+static void
+test_concurrent_lookup(void)
+{
+	pthread_t threads[NUM_THREADS];
+	jit_function_t func;
+	void *status;
+	int i;
+
+	if (jit_uses_interpreter ())
+		return;
+
+	jit_init ();
+	lookup_context = jit_context_create ();
+
+	jit_type_t params[1] = { jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, 1, 1);
+	lookup_func = jit_function_create (lookup_context, sig);
+	CHECK (jit_function_set_meta (lookup_func, 1, (void *) 0, 0, 0));
+	CHECK (build_func (lookup_func) == JIT_RESULT_OK);
+	CHECK (jit_function_compile (lookup_func));
+	lookup_pc = jit_function_to_closure (lookup_func);
+
+	for (i = 0; i < NUM_THREADS; i++)
+	{
+		CHECK (pthread_create (&threads[i], NULL, find_func, NULL) == 0);
+	}
+	for (i = 0; i < 2000; i++)
+	{
+		func = jit_function_create (lookup_context, sig);
+		CHECK (jit_function_set_meta (func, 1,
+					      (void *) (jit_nint) (i % NUM_FUNCS),
+					      0, 0));
+		CHECK (build_func (func) == JIT_RESULT_OK);
+		CHECK (jit_function_compile (func));
+		jit_function_destroy (func);
+	}
+	lookup_done = 1;
+	for (i = 0; i < NUM_THREADS; i++)
+	{
+		CHECK (pthread_join (threads[i], &status) == 0);
+		CHECK (status == NULL);
+	}
+
+	jit_type_free (sig);
+	jit_context_destroy (lookup_context);
+}
+
+static int loop_build_count;
+
+/* Build "sum = 0; for (i = 0; i < x; i++) sum += i; return sum".  */
+
+static int
+build_loop(jit_function_t func)
+{
+	jit_value_t x = jit_value_get_param (func, 0);
+	jit_value_t sum = jit_value_create (func, jit_type_int);
+	jit_value_t i = jit_value_create (func, jit_type_int);
+	jit_value_t zero
+	  = jit_value_create_nint_constant (func, jit_type_int, 0);
+	jit_value_t one
+	  = jit_value_create_nint_constant (func, jit_type_int, 1);
+	jit_label_t top = jit_label_undefined;
+	jit_label_t test = jit_label_undefined;
+
+	jit_insn_store (func, sum, zero);
+	jit_insn_store (func, i, zero);
+	jit_insn_branch (func, &test);
+	jit_insn_label (func, &top);
+	jit_insn_store (func, sum, jit_insn_add (func, sum, i));
+	jit_insn_store (func, i, jit_insn_add (func, i, one));
+	jit_insn_label (func, &test);
+	jit_insn_branch_if (func, jit_insn_lt (func, i, x), &top);
+	jit_insn_return (func, sum);
+
+	++loop_build_count;
+	return JIT_RESULT_OK;
+}
+
+/* A function that is called often enough gets recompiled by the
+   background thread and keeps giving the right answer.  */
+
+static void
+test_tiered_compile(void)
+{
+	jit_function_t func;
+	int i, x, result;
+	void *args[1];
+
+	jit_init ();
+	jit_context_t ctx = jit_context_create ();
+	CHECK (jit_context_set_meta_numeric (ctx, JIT_OPTION_TIERED_COMPILE,
+					     50));
+
+	jit_type_t params[1] = { jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, 1, 1);
+	func = jit_function_create (ctx, sig);
+	CHECK (func != NULL);
+	jit_function_set_on_demand_compiler (func, build_loop);
+
+	args[0] = &x;
+	for (i = 0; i < 200 && loop_build_count < 2; i++)
+	{
+		x = i % 10;
+		result = -1;
+		CHECK (jit_function_apply (func, args, &result));
+		CHECK (result == x * (x - 1) / 2);
+		usleep (10000);
+	}
+	CHECK (loop_build_count == 2);
+
+	x = 10;
+	CHECK (jit_function_apply (func, args, &result));
+	CHECK (result == 45);
+
+	jit_type_free (sig);
+	jit_context_destroy (ctx);
+}
+
+int main()
+{
+	test_concurrent_on_demand ();
+	test_concurrent_lookup ();
+	test_tiered_compile ();
+
+	return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * elf-tests.c - Tests for writing and reloading pre-compiled functions
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include <stdio.h>
+#include "unit-tests.h"
+
+#define ELF_FILE	"elf-tests.so"
+
+/* Native code can only be written on x86-64 */
+#if defined(__x86_64__) || defined(__x86_64)
+#define WRITES_NATIVE	1
+#else
+#define WRITES_NATIVE	0
+#endif
+
+/* The exception that a builtin error turns into */
+
+static void *
+exception_handler(int exception_type)
+{
+	return (void *) (jit_nint) exception_type;
+}
+
+/* Build "return n <= 1 ? 1 : n * fact (n - 1)".  */
+
+static jit_function_t
+create_fact(jit_context_t ctx, jit_type_t sig)
+{
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_value_t n = jit_value_get_param (func, 0);
+	jit_value_t one = jit_value_create_nint_constant (func, jit_type_int, 1);
+	jit_label_t recurse = jit_label_undefined;
+	jit_value_t args[1], result;
+
+	jit_insn_branch_if (func, jit_insn_gt (func, n, one), &recurse);
+	jit_insn_return (func, one);
+	jit_insn_label (func, &recurse);
+	args[0] = jit_insn_sub (func, n, one);
+	result = jit_insn_call (func, "fact", func, sig, args, 1, 0);
+	jit_insn_return (func, jit_insn_mul (func, n, result));
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* Build "switch (n) { case 0: ... case 2: return fact (n + 3); }"
+   with a jump table, returning -1 for other values.  */
+
+static jit_function_t
+create_pick(jit_context_t ctx, jit_type_t sig, jit_function_t fact)
+{
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_value_t n = jit_value_get_param (func, 0);
+	jit_label_t labels[3];
+	jit_value_t args[1];
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		labels[i] = jit_label_undefined;
+	}
+	jit_insn_jump_table (func, n, labels, 3);
+	jit_insn_return (func, jit_value_create_nint_constant (func,
+							       jit_type_int,
+							       -1));
+	for (i = 0; i < 3; i++)
+	{
+		jit_insn_label (func, &labels[i]);
+		args[0] = jit_value_create_nint_constant (func, jit_type_int,
+							  i + 3);
+		jit_insn_return (func, jit_insn_call (func, "fact", fact, sig,
+						      args, 1, 0));
+	}
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* Build "return (int) (n * 2.5) / n", which loads a constant and
+   throws a builtin exception if "n" is zero.  */
+
+static jit_function_t
+create_scale(jit_context_t ctx, jit_type_t sig)
+{
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_value_t n = jit_value_get_param (func, 0);
+	jit_value_t scaled;
+
+	scaled = jit_insn_mul (func, jit_insn_convert (func, n,
+						       jit_type_float64, 0),
+			       jit_value_create_float64_constant
+			       (func, jit_type_float64, 2.5));
+	jit_insn_return (func, jit_insn_div (func,
+					     jit_insn_convert (func, scaled,
+							       jit_type_int,
+							       0),
+					     n));
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+static int
+call_int(jit_function_t func, int n)
+{
+	void *args[1] = { &n };
+	jit_int result = 0;
+	CHECK (jit_function_apply (func, args, &result));
+	return result;
+}
+
+/* Write functions that call each other, use a jump table, load a
+   constant and throw, then load them into a fresh context and call them
+   without compiling.  */
+
+static void
+test_round_trip(void)
+{
+	jit_type_t params[1] = { jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl, jit_type_int,
+						    params, 1, 1);
+	jit_context_t ctx = jit_context_create ();
+	jit_function_t fact, pick, scale;
+	jit_writeelf_t writeelf;
+	jit_readelf_t readelf;
+	jit_int result;
+	void *args[1];
+	int zero = 0;
+
+	jit_context_set_meta_numeric (ctx, JIT_OPTION_PRE_COMPILE, 1);
+	jit_context_set_meta_numeric (ctx, JIT_OPTION_POSITION_INDEPENDENT, 1);
+	fact = create_fact (ctx, sig);
+	pick = create_pick (ctx, sig, fact);
+	scale = create_scale (ctx, sig);
+
+	writeelf = jit_writeelf_create ("elf-tests");
+	CHECK (writeelf);
+	if (!jit_uses_interpreter () && !WRITES_NATIVE)
+	{
+		/* Native code cannot be relocated, but the binary is valid */
+		CHECK (!jit_writeelf_add_function (writeelf, fact, "fact"));
+		CHECK (jit_writeelf_write (writeelf, ELF_FILE));
+		jit_writeelf_destroy (writeelf);
+		CHECK (jit_readelf_open (&readelf, ELF_FILE, 0) == JIT_READELF_OK);
+		CHECK (!jit_readelf_get_symbol (readelf, "fact"));
+		jit_readelf_close (readelf);
+		jit_context_destroy (ctx);
+		jit_type_free (sig);
+		remove (ELF_FILE);
+		return;
+	}
+
+	/* The callee is added after the caller, and is still resolved */
+	CHECK (jit_writeelf_add_function (writeelf, pick, "pick"));
+	CHECK (!jit_writeelf_write (writeelf, ELF_FILE));
+	CHECK (jit_writeelf_add_function (writeelf, fact, "fact"));
+	CHECK (!jit_writeelf_add_function (writeelf, fact, "fact"));
+	CHECK (jit_writeelf_add_function (writeelf, scale, "scale"));
+	CHECK (jit_writeelf_write (writeelf, ELF_FILE));
+	jit_writeelf_destroy (writeelf);
+	jit_context_destroy (ctx);
+
+	ctx = jit_context_create ();
+	CHECK (jit_readelf_open (&readelf, ELF_FILE, 0) == JIT_READELF_OK);
+	CHECK (!jit_strcmp (jit_readelf_get_name (readelf), "elf-tests"));
+	jit_readelf_add_to_context (readelf, ctx);
+	CHECK (!jit_readelf_get_function (readelf, ctx, "missing", sig));
+	fact = jit_readelf_get_function (readelf, ctx, "fact", sig);
+	pick = jit_readelf_get_function (readelf, ctx, "pick", sig);
+	scale = jit_readelf_get_function (readelf, ctx, "scale", sig);
+	CHECK (fact && pick && scale);
+	CHECK (jit_readelf_resolve_all (ctx, 1));
+	CHECK (jit_function_is_compiled (pick));
+
+	CHECK (call_int (fact, 5) == 120);
+	CHECK (call_int (pick, 0) == 6);
+	CHECK (call_int (pick, 1) == 24);
+	CHECK (call_int (pick, 2) == 120);
+	CHECK (call_int (pick, 7) == -1);
+	CHECK (call_int (scale, 4) == 2);
+	CHECK (call_int (scale, -3) == 2);
+	args[0] = &zero;
+	CHECK (!jit_function_apply (scale, args, &result));
+
+	jit_context_destroy (ctx);
+	jit_readelf_close (readelf);
+	jit_type_free (sig);
+	remove (ELF_FILE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_init ();
+	jit_exception_set_handler (exception_handler);
+	test_round_trip ();
+	return 0;
+}
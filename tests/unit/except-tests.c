@@ -0,0 +1,408 @@
+/*
+ * except-tests.c - Tests for the exception tables
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+/* The object that is thrown by the "thrower" function */
+static int thrown_object;
+
+/* The value that a catcher returns */
+#define CAUGHT		-1000
+
+static jit_context_t context;
+static jit_type_t signature;
+
+static jit_value_t
+int_constant(jit_function_t func, jit_int value)
+{
+	return jit_value_create_nint_constant (func, jit_type_int, value);
+}
+
+static jit_value_t
+call(jit_function_t func, jit_function_t callee, jit_value_t arg)
+{
+	return jit_insn_call (func, 0, callee, 0, &arg, 1, 0);
+}
+
+static int
+apply(jit_function_t func, jit_int x, jit_int *result)
+{
+	void *args[1] = { &x };
+	return jit_function_apply (func, args, result);
+}
+
+static jit_int
+call_ok(jit_function_t func, jit_int x)
+{
+	jit_int result = 0;
+	CHECK (apply (func, x, &result));
+	return result;
+}
+
+/* The exception that a builtin error turns into */
+
+static void *
+exception_handler(int exception_type)
+{
+	return (void *) (jit_nint) exception_type;
+}
+
+/* "if (x < 0) throw; return a * x + b * (x + 1) + c" with enough values
+   to take some of the callee-saved registers */
+
+static jit_function_t
+create_thrower(void)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t x, a, b, c;
+	jit_label_t label = jit_label_undefined;
+
+	x = jit_value_get_param (func, 0);
+	jit_insn_branch_if_not (func, jit_insn_lt (func, x, int_constant (func, 0)),
+				&label);
+	jit_insn_throw (func, jit_value_create_nint_constant
+			(func, jit_type_void_ptr, (jit_nint) &thrown_object));
+	jit_insn_label (func, &label);
+	a = jit_insn_add (func, x, int_constant (func, 3));
+	b = jit_insn_mul (func, x, int_constant (func, 5));
+	c = jit_insn_sub (func, b, a);
+	a = jit_insn_mul (func, a, x);
+	b = jit_insn_mul (func, b, jit_insn_add (func, x, int_constant (func, 1)));
+	jit_insn_return (func, jit_insn_add (func, jit_insn_add (func, a, b), c));
+	jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+static jit_int
+expected_thrower(jit_int x)
+{
+	jit_int a = x + 3, b = x * 5, c = b - a;
+	return a * x + b * (x + 1) + c;
+}
+
+/* "try { r = callee(x) } catch (e) { return CAUGHT - (e != thrown) };
+   return r + 1".  If "covered" is zero the call is outside the range of
+   the "try" and the catcher rethrows */
+
+static jit_function_t
+create_catcher(jit_function_t callee, int covered)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_label_t start = jit_label_undefined;
+	jit_label_t end = jit_label_undefined;
+	jit_label_t unhandled = jit_label_undefined;
+	jit_value_t x, result, exception;
+
+	CHECK (jit_insn_uses_catcher (func));
+	x = jit_value_get_param (func, 0);
+	if (!covered)
+	{
+		result = call (func, callee, x);
+	}
+	jit_insn_label (func, &start);
+	if (covered)
+	{
+		result = call (func, callee, x);
+	}
+	else
+	{
+		result = jit_insn_add (func, result, int_constant (func, 0));
+	}
+	jit_insn_label (func, &end);
+	jit_insn_return (func, jit_insn_add (func, result, int_constant (func, 1)));
+
+	exception = jit_insn_start_catcher (func);
+	jit_insn_branch_if_pc_not_in_range (func, start, end, &unhandled);
+	exception = jit_insn_ne (func, exception, jit_value_create_nint_constant
+				 (func, jit_type_void_ptr, (jit_nint) &thrown_object));
+	jit_insn_return (func, jit_insn_sub (func, int_constant (func, CAUGHT),
+					     exception));
+	jit_insn_label (func, &unhandled);
+	jit_insn_rethrow_unhandled (func);
+
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* "s = 0; for (i = 0; i < 3; i++) s = s * k + callee(x - i) + k * i;
+   return s" keeps values in registers across the calls */
+
+static jit_function_t
+create_loop(jit_function_t callee, jit_int k)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t x, i, s, kv, r;
+	jit_label_t loop = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+
+	x = jit_value_get_param (func, 0);
+	i = jit_value_create (func, jit_type_int);
+	s = jit_value_create (func, jit_type_int);
+	kv = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, i, int_constant (func, 0));
+	jit_insn_store (func, s, int_constant (func, 0));
+	jit_insn_store (func, kv, int_constant (func, k));
+
+	jit_insn_label (func, &loop);
+	jit_insn_branch_if_not (func, jit_insn_lt (func, i, int_constant (func, 3)),
+				&done);
+	r = call (func, callee, jit_insn_sub (func, x, i));
+	r = jit_insn_add (func, jit_insn_mul (func, s, kv), r);
+	jit_insn_store (func, s, jit_insn_add (func, r, jit_insn_mul (func, kv, i)));
+	jit_insn_store (func, i, jit_insn_add (func, i, int_constant (func, 1)));
+	jit_insn_branch (func, &loop);
+
+	jit_insn_label (func, &done);
+	jit_insn_return (func, s);
+	jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* "if (x < 0) throw; return x * 2" in native code that uses the frame
+   pointer register for something else, as code that is built without
+   frame pointers may */
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+__attribute__((noinline, optimize("omit-frame-pointer")))
+#endif
+static jit_int
+native_thrower(jit_int x)
+{
+	if (x < 0)
+	{
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__)
+		__asm__ __volatile__ ("movq $1, %%rbp" : : : "rbp");
+#endif
+		jit_exception_throw (&thrown_object);
+	}
+	return x * 2;
+}
+
+/* "try { r = native_thrower(x) } catch (e) { return CAUGHT - (e != thrown) };
+   return r + 1" */
+
+static jit_function_t
+create_native_catcher(void)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t x, result, exception;
+
+	CHECK (jit_insn_uses_catcher (func));
+	x = jit_value_get_param (func, 0);
+	result = jit_insn_call_native (func, "native_thrower",
+				       (void *) native_thrower, signature,
+				       &x, 1, 0);
+	jit_insn_return (func, jit_insn_add (func, result, int_constant (func, 1)));
+
+	exception = jit_insn_start_catcher (func);
+	exception = jit_insn_ne (func, exception, jit_value_create_nint_constant
+				 (func, jit_type_void_ptr, (jit_nint) &thrown_object));
+	jit_insn_return (func, jit_insn_sub (func, int_constant (func, CAUGHT),
+					     exception));
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* "a = x * 3; b = x + 7; try { r = callee(x) } catch (e) { return a * b };
+   return r + a + b" where "a" and "b" stay in registers across the call */
+
+static jit_function_t
+create_keeper(jit_function_t callee)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t x, a, b, result;
+
+	CHECK (jit_insn_uses_catcher (func));
+	x = jit_value_get_param (func, 0);
+	a = jit_value_create (func, jit_type_int);
+	b = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, a, jit_insn_mul (func, x, int_constant (func, 3)));
+	jit_insn_store (func, b, jit_insn_add (func, x, int_constant (func, 7)));
+	result = call (func, callee, x);
+	jit_insn_return (func, jit_insn_add (func, jit_insn_add (func, result, a), b));
+
+	jit_insn_start_catcher (func);
+	jit_insn_return (func, jit_insn_mul (func, a, b));
+	jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* "try { return 1000 / x } catch { return CAUGHT - exception }" */
+
+static jit_function_t
+create_divider(void)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t exception;
+
+	CHECK (jit_insn_uses_catcher (func));
+	jit_insn_return (func, jit_insn_div (func, int_constant (func, 1000),
+					     jit_value_get_param (func, 0)));
+	exception = jit_insn_start_catcher (func);
+	jit_insn_return (func, jit_insn_sub
+			 (func, int_constant (func, CAUGHT),
+			  jit_insn_convert (func, exception, jit_type_int, 0)));
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+static void
+test_catch(void)
+{
+	jit_function_t thrower, catcher, loop;
+	jit_int x, k = 7, s;
+
+	thrower = create_thrower ();
+	catcher = create_catcher (thrower, 1);
+	CHECK (call_ok (catcher, 4) == expected_thrower (4) + 1);
+	CHECK (call_ok (catcher, -1) == CAUGHT);
+
+	/* The callers of the catcher still see their registers */
+	loop = create_loop (catcher, k);
+	for (x = 0; x < 4; x++)
+	{
+		jit_int i, r;
+		s = 0;
+		for (i = 0; i < 3; i++)
+		{
+			r = (x - i < 0) ? CAUGHT : expected_thrower (x - i) + 1;
+			s = s * k + r + k * i;
+		}
+		CHECK (call_ok (loop, x) == s);
+	}
+}
+
+/* The catcher sees the values that the function kept in registers */
+
+static void
+test_registers(void)
+{
+	jit_function_t thrower, keeper;
+
+	thrower = create_thrower ();
+	keeper = create_keeper (thrower);
+	CHECK (call_ok (keeper, 3) == expected_thrower (3) + 9 + 10);
+	CHECK (call_ok (keeper, -2) == -6 * 5);
+	CHECK (call_ok (keeper, -5) == -15 * 2);
+}
+
+/* The exception comes out of native code without frame pointers */
+
+static void
+test_native(void)
+{
+	jit_function_t catcher;
+
+	catcher = create_native_catcher ();
+	CHECK (call_ok (catcher, 4) == 9);
+	CHECK (call_ok (catcher, -1) == CAUGHT);
+	CHECK (call_ok (catcher, -3) == CAUGHT);
+}
+
+static void
+test_rethrow(void)
+{
+	jit_function_t thrower, inner, outer;
+	jit_int result;
+
+	thrower = create_thrower ();
+	inner = create_catcher (thrower, 0);
+	CHECK (call_ok (inner, 2) == expected_thrower (2) + 1);
+
+	/* The exception leaves the function that rethrows it */
+	CHECK (!apply (inner, -2, &result));
+	CHECK (jit_exception_get_last () == &thrown_object);
+
+	/* And is caught by the next catcher up the stack */
+	outer = create_catcher (inner, 1);
+	CHECK (call_ok (outer, -2) == CAUGHT);
+	CHECK (call_ok (outer, 2) == expected_thrower (2) + 2);
+}
+
+static void
+test_builtin(void)
+{
+	jit_function_t divider;
+
+	divider = create_divider ();
+	CHECK (call_ok (divider, 10) == 100);
+	CHECK (call_ok (divider, 0) == CAUGHT - JIT_RESULT_DIVISION_BY_ZERO);
+
+	/* Again, in case the exception came from a signal */
+	CHECK (call_ok (divider, 0) == CAUGHT - JIT_RESULT_DIVISION_BY_ZERO);
+	CHECK (call_ok (divider, -10) == -100);
+}
+
+/* Catchers with "setjmp" and with exception tables on the same stack */
+
+static void
+test_mixed(void)
+{
+	jit_function_t thrower, inner, middle, outer;
+
+	thrower = create_thrower ();
+	inner = create_catcher (thrower, 0);
+	jit_context_set_meta_numeric (context, JIT_OPTION_EXCEPTION_TABLES, 0);
+	middle = create_catcher (inner, 1);
+	jit_context_set_meta_numeric (context, JIT_OPTION_EXCEPTION_TABLES, 1);
+	outer = create_catcher (middle, 1);
+
+	CHECK (call_ok (outer, -1) == CAUGHT + 1);
+	CHECK (call_ok (outer, 1) == expected_thrower (1) + 3);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t param = jit_type_int;
+
+	/* The interpreter catches exceptions in its own way and ignores
+	   the option */
+	if (jit_uses_interpreter ())
+	{
+		return 0;
+	}
+
+	jit_init ();
+	jit_exception_set_handler (exception_handler);
+	context = jit_context_create ();
+	jit_context_set_meta_numeric (context, JIT_OPTION_EXCEPTION_TABLES, 1);
+	signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_int, &param, 1, 1);
+
+	jit_context_build_start (context);
+	test_catch ();
+	test_registers ();
+	test_native ();
+	test_rethrow ();
+	test_builtin ();
+	test_mixed ();
+	jit_context_build_end (context);
+
+	jit_type_free (signature);
+	jit_context_destroy (context);
+	return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * inline-cache-tests.c - Tests for inline caches on indirect calls
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+#define NUM_TARGETS	5
+
+static jit_context_t context;
+static jit_type_t target_signature;
+static jit_type_t caller_signature;
+
+/* Build "return x * scale + y" */
+
+static void
+build_target(jit_function_t func, int scale)
+{
+	jit_value_t x, y;
+
+	x = jit_insn_convert (func, jit_value_get_param (func, 0),
+			      jit_type_float64, 0);
+	y = jit_value_get_param (func, 1);
+	x = jit_insn_mul (func, x, jit_value_create_float64_constant
+			  (func, jit_type_float64, (jit_float64)scale));
+	jit_insn_return (func, jit_insn_add (func, x, y));
+}
+
+static int
+compile_target(jit_function_t func)
+{
+	build_target (func, (int)(jit_nint)jit_function_get_meta (func, 1));
+	return 1;
+}
+
+static jit_float64
+native_target(jit_int x, jit_float64 y)
+{
+	return x * 100.0 + y;
+}
+
+/* Build "return target (x, y)", where "target" is a vtable pointer or
+   a native function pointer.  */
+
+static jit_function_t
+create_caller(int vtable)
+{
+	jit_function_t func = jit_function_create (context, caller_signature);
+	jit_value_t args[2], result;
+
+	args[0] = jit_value_get_param (func, 1);
+	args[1] = jit_value_get_param (func, 2);
+	if (vtable)
+	{
+		result = jit_insn_call_indirect_vtable
+			(func, jit_value_get_param (func, 0), target_signature,
+			 args, 2, 0);
+	}
+	else
+	{
+		result = jit_insn_call_indirect
+			(func, jit_value_get_param (func, 0), target_signature,
+			 args, 2, 0);
+	}
+	jit_insn_return (func, result);
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+static jit_float64
+call(jit_function_t caller, void *target, jit_int x)
+{
+	jit_float64 y = 0.5, result = 0;
+	void *args[3] = { &target, &x, &y };
+
+	CHECK (jit_function_apply (caller, args, &result));
+	return result;
+}
+
+/* Call a site with one target, then several, then more targets than
+   it has entries for.  Every call must reach the right target.  */
+
+static void
+test_targets(void)
+{
+	static const int order[] = { 0, 0, 1, 0, 1, 2, 3, 4, 0, 3, 2, 1 };
+	jit_function_t targets[NUM_TARGETS];
+	void *vtable[NUM_TARGETS];
+	jit_function_t caller;
+	unsigned int i;
+	int j;
+
+	for (j = 0; j < NUM_TARGETS; j++)
+	{
+		targets[j] = jit_function_create (context, target_signature);
+		if (j == NUM_TARGETS - 1)
+		{
+			/* The last one is compiled on demand by the call */
+			jit_function_set_meta (targets[j], 1,
+					       (void *)(jit_nint)(j + 1), 0, 0);
+			jit_function_set_on_demand_compiler (targets[j],
+							     compile_target);
+		}
+		else
+		{
+			build_target (targets[j], j + 1);
+			CHECK (jit_function_compile (targets[j]));
+		}
+		vtable[j] = jit_function_to_vtable_pointer (targets[j]);
+	}
+
+	caller = create_caller (1);
+	for (i = 0; i < sizeof (order) / sizeof (order[0]); i++)
+	{
+		j = order[i];
+		CHECK (call (caller, vtable[j], 3) == 3.0 * (j + 1) + 0.5);
+	}
+	CHECK (jit_function_is_compiled (targets[NUM_TARGETS - 1]));
+
+	/* A second site starts out empty */
+	caller = create_caller (1);
+	for (i = 0; i < sizeof (order) / sizeof (order[0]); i++)
+	{
+		j = order[sizeof (order) / sizeof (order[0]) - 1 - i];
+		CHECK (call (caller, vtable[j], -2) == -2.0 * (j + 1) + 0.5);
+	}
+}
+
+/* Native functions may be too far away from the site to be called
+   directly, which must not disturb the jit targets.  */
+
+static void
+test_native(void)
+{
+	jit_function_t target, caller;
+	void *closure;
+	int i;
+
+	target = jit_function_create (context, target_signature);
+	build_target (target, 7);
+	CHECK (jit_function_compile (target));
+
+	/* Only native code calls closures of jit functions directly */
+	closure = 0;
+	if (!jit_uses_interpreter ())
+	{
+		closure = jit_function_to_closure (target);
+	}
+
+	caller = create_caller (0);
+	for (i = 0; i < 4; i++)
+	{
+		CHECK (call (caller, (void *)native_target, i) == i * 100.0 + 0.5);
+		if (closure)
+		{
+			CHECK (call (caller, closure, i) == i * 7.0 + 0.5);
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t params[3];
+
+	jit_init ();
+	context = jit_context_create ();
+	jit_context_set_meta_numeric (context, JIT_OPTION_INLINE_CACHE, 2);
+
+	params[0] = jit_type_int;
+	params[1] = jit_type_float64;
+	target_signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_float64, params, 2, 1);
+	params[0] = jit_type_void_ptr;
+	params[1] = jit_type_int;
+	params[2] = jit_type_float64;
+	caller_signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_float64, params, 3, 1);
+
+	test_targets ();
+	test_native ();
+
+	jit_context_destroy (context);
+	jit_type_free (target_signature);
+	jit_type_free (caller_signature);
+	return 0;
+}
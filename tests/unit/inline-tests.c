@@ -0,0 +1,372 @@
+/*
+ * inline-tests.c - Tests for the inlining of calls between functions
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+#define INLINE_LIMIT	16
+
+static jit_context_t context;
+static jit_type_t unary_signature;
+static jit_type_t binary_signature;
+static jit_type_t store_signature;
+static int num_builds;
+
+static jit_value_t
+int_constant(jit_function_t func, jit_int value)
+{
+	return jit_value_create_nint_constant (func, jit_type_int, value);
+}
+
+static jit_function_t
+create_caller(jit_type_t signature)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+	return func;
+}
+
+static jit_int
+call_unary(jit_function_t func, jit_int x)
+{
+	jit_int result = 0;
+	void *args[1] = { &x };
+
+	CHECK (jit_function_apply (func, args, &result));
+	return result;
+}
+
+/* "return x * 3 + 1" */
+
+static void
+build_scale(jit_function_t func)
+{
+	jit_value_t x = jit_value_get_param (func, 0);
+	x = jit_insn_mul (func, x, int_constant (func, 3));
+	jit_insn_return (func, jit_insn_add (func, x, int_constant (func, 1)));
+}
+
+/* "return x < lo ? lo : x" */
+
+static int
+build_clamp(jit_function_t func)
+{
+	jit_value_t x = jit_value_get_param (func, 0);
+	jit_value_t lo = jit_value_get_param (func, 1);
+	jit_label_t label = jit_label_undefined;
+
+	jit_insn_branch_if_not (func, jit_insn_lt (func, x, lo), &label);
+	jit_insn_return (func, lo);
+	jit_insn_label (func, &label);
+	jit_insn_return (func, x);
+	++num_builds;
+	return JIT_RESULT_OK;
+}
+
+/* "return n <= 1 ? 1 : n * fact (n - 1)" */
+
+static int
+build_fact(jit_function_t func)
+{
+	jit_value_t n = jit_value_get_param (func, 0);
+	jit_value_t arg, result;
+	jit_label_t label = jit_label_undefined;
+
+	jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+	jit_insn_branch_if_not (func, jit_insn_le (func, n, int_constant (func, 1)),
+				&label);
+	jit_insn_return (func, int_constant (func, 1));
+	jit_insn_label (func, &label);
+	arg = jit_insn_sub (func, n, int_constant (func, 1));
+	result = jit_insn_call (func, "fact", func, 0, &arg, 1, 0);
+	jit_insn_return (func, jit_insn_mul (func, n, result));
+	++num_builds;
+	return JIT_RESULT_OK;
+}
+
+/* "return x + 1 + 2 + ... + 20", too large to be inlined */
+
+static int
+build_sum(jit_function_t func)
+{
+	jit_value_t x = jit_value_get_param (func, 0);
+	int i;
+
+	for (i = 1; i <= 20; i++)
+	{
+		x = jit_insn_add (func, x, int_constant (func, i));
+	}
+	jit_insn_return (func, x);
+	++num_builds;
+	return JIT_RESULT_OK;
+}
+
+static jit_function_t
+create_on_demand(jit_type_t signature, jit_on_demand_func compiler)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_function_set_on_demand_compiler (func, compiler);
+	return func;
+}
+
+/* A function that is still being built is inlined from its builder
+   once it is marked as complete.  It is never compiled because nothing
+   calls it.  */
+
+static void
+test_builder(void)
+{
+	jit_function_t callee, caller;
+	jit_value_t arg, x, y;
+
+	callee = jit_function_create (context, unary_signature);
+	build_scale (callee);
+	jit_function_set_complete (callee);
+
+	caller = create_caller (unary_signature);
+	arg = jit_value_get_param (caller, 0);
+	x = jit_insn_call (caller, "scale", callee, 0, &arg, 1, 0);
+	arg = int_constant (caller, 5);
+	y = jit_insn_call (caller, "scale", callee, 0, &arg, 1, 0);
+	jit_insn_return (caller, jit_insn_add (caller, x, y));
+	CHECK (jit_function_compile (caller));
+
+	CHECK (call_unary (caller, 2) == 7 + 16);
+	CHECK (call_unary (caller, -1) == -2 + 16);
+	CHECK (!jit_function_is_compiled (callee));
+
+	/* The builder of the callee is left alone */
+	CHECK (jit_function_compile (callee));
+	CHECK (call_unary (callee, 4) == 13);
+}
+
+/* The instructions of a callee are no longer copied once it is
+   optimized or compiled, which another thread could be doing while the
+   caller is being built.  */
+
+static void
+test_optimized(void)
+{
+	jit_function_t callee, caller;
+	jit_block_t block = 0;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	jit_value_t arg;
+	int num_calls = 0;
+
+	callee = jit_function_create (context, unary_signature);
+	build_scale (callee);
+	jit_function_set_complete (callee);
+	CHECK (jit_optimize (callee) == JIT_RESULT_OK);
+
+	caller = create_caller (unary_signature);
+	arg = jit_value_get_param (caller, 0);
+	jit_insn_return (caller, jit_insn_call (caller, "scale", callee, 0,
+						&arg, 1, 0));
+	while ((block = jit_block_next (caller, block)) != 0)
+	{
+		jit_insn_iter_init (&iter, block);
+		while ((insn = jit_insn_iter_next (&iter)) != 0)
+		{
+			if (jit_insn_get_opcode (insn) == JIT_OP_CALL)
+				++num_calls;
+		}
+	}
+	CHECK (num_calls == 1);
+
+	CHECK (jit_function_compile (callee));
+	CHECK (jit_function_compile (caller));
+	CHECK (call_unary (caller, 4) == 13);
+}
+
+/* A function whose body is not complete yet is called as usual, even
+   though it has a builder with some instructions in it.  */
+
+static void
+test_incomplete(void)
+{
+	jit_function_t callee, caller;
+	jit_value_t arg;
+
+	callee = jit_function_create (context, unary_signature);
+	jit_value_get_param (callee, 0);
+
+	caller = create_caller (unary_signature);
+	arg = jit_value_get_param (caller, 0);
+	jit_insn_return (caller, jit_insn_call (caller, "answer", callee, 0,
+						&arg, 1, 0));
+	CHECK (jit_function_compile (caller));
+
+	jit_insn_return (callee, int_constant (callee, 42));
+	CHECK (jit_function_compile (callee));
+
+	CHECK (call_unary (callee, 1) == 42);
+	CHECK (call_unary (caller, 1) == 42);
+}
+
+/* Functions with an on-demand compiler are built again for inlining,
+   whether they were compiled before or not.  */
+
+static void
+test_on_demand(void)
+{
+	jit_function_t compiled, fresh, caller;
+	jit_value_t args[2], x;
+	jit_int a = 3, b = 10, result = 0;
+	void *apply_args[2] = { &a, &b };
+	int builds;
+
+	compiled = create_on_demand (binary_signature, build_clamp);
+	fresh = create_on_demand (binary_signature, build_clamp);
+	CHECK (jit_function_apply (compiled, apply_args, &result));
+	CHECK (result == 10);
+
+	builds = num_builds;
+	caller = create_caller (unary_signature);
+	args[0] = jit_value_get_param (caller, 0);
+	args[1] = int_constant (caller, 10);
+	x = jit_insn_call (caller, "clamp", compiled, 0, args, 2, 0);
+	args[0] = x;
+	args[1] = int_constant (caller, 20);
+	x = jit_insn_call (caller, "clamp", fresh, 0, args, 2, 0);
+	jit_insn_return (caller, x);
+	CHECK (jit_function_compile (caller));
+	CHECK (num_builds == builds + 2);
+
+	CHECK (call_unary (caller, 3) == 20);
+	CHECK (call_unary (caller, 15) == 20);
+	CHECK (call_unary (caller, 42) == 42);
+	CHECK (!jit_function_is_compiled (fresh));
+	CHECK (num_builds == builds + 2);
+
+	/* Nothing is inlined below the aggressive level */
+	caller = jit_function_create (context, unary_signature);
+	args[0] = jit_value_get_param (caller, 0);
+	args[1] = int_constant (caller, 7);
+	jit_insn_return (caller, jit_insn_call (caller, "clamp", fresh, 0,
+						args, 2, 0));
+	CHECK (jit_function_compile (caller));
+	CHECK (num_builds == builds + 2);
+	CHECK (call_unary (caller, 1) == 7);
+	CHECK (jit_function_is_compiled (fresh));
+}
+
+/* The recursive call in an inlined function goes to the function
+   itself, and large functions are called as usual.  */
+
+static void
+test_calls(void)
+{
+	jit_function_t fact, sum, caller;
+	jit_value_t arg, x;
+
+	fact = create_on_demand (unary_signature, build_fact);
+	sum = create_on_demand (unary_signature, build_sum);
+
+	caller = create_caller (unary_signature);
+	arg = jit_value_get_param (caller, 0);
+	x = jit_insn_call (caller, "fact", fact, 0, &arg, 1, 0);
+	x = jit_insn_call (caller, "sum", sum, 0, &x, 1, 0);
+	jit_insn_return (caller, x);
+	CHECK (jit_function_compile (caller));
+	CHECK (!jit_function_is_compiled (sum));
+
+	CHECK (call_unary (caller, 1) == 1 + 210);
+	CHECK (call_unary (caller, 5) == 120 + 210);
+	CHECK (jit_function_is_compiled (fact));
+	CHECK (jit_function_is_compiled (sum));
+}
+
+/* "*p = v * 2" changes memory that the caller reads afterwards */
+
+static void
+test_void(void)
+{
+	jit_function_t callee, caller;
+	jit_value_t args[2], ptr, v;
+	jit_type_t signature;
+	jit_type_t params[2];
+	jit_int value = 0, arg = 21, result = 0;
+	jit_int *pointer = &value;
+	void *apply_args[2] = { &pointer, &arg };
+
+	callee = jit_function_create (context, store_signature);
+	ptr = jit_value_get_param (callee, 0);
+	v = jit_insn_mul (callee, jit_value_get_param (callee, 1),
+			  int_constant (callee, 2));
+	jit_insn_store_relative (callee, ptr, 0, v);
+	jit_insn_default_return (callee);
+	jit_function_set_complete (callee);
+
+	params[0] = jit_type_void_ptr;
+	params[1] = jit_type_int;
+	signature = jit_type_create_signature (jit_abi_cdecl, jit_type_int,
+					       params, 2, 1);
+	caller = create_caller (signature);
+	args[0] = jit_value_get_param (caller, 0);
+	args[1] = jit_value_get_param (caller, 1);
+	jit_insn_call (caller, "store", callee, 0, args, 2, 0);
+	jit_insn_return (caller, jit_insn_add
+			 (caller, jit_insn_load_relative (caller, args[0], 0,
+							  jit_type_int),
+			  int_constant (caller, 1)));
+	CHECK (jit_function_compile (caller));
+	jit_type_free (signature);
+
+	CHECK (jit_function_apply (caller, apply_args, &result));
+	CHECK (value == 42 && result == 43);
+	CHECK (!jit_function_is_compiled (callee));
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t params[2];
+
+	jit_init ();
+	context = jit_context_create ();
+	jit_context_set_meta_numeric (context, JIT_OPTION_INLINE_LIMIT,
+				      INLINE_LIMIT);
+
+	params[0] = jit_type_int;
+	params[1] = jit_type_int;
+	unary_signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_int, params, 1, 1);
+	binary_signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_int, params, 2, 1);
+	params[0] = jit_type_void_ptr;
+	store_signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_void, params, 2, 1);
+
+	test_builder ();
+	test_optimized ();
+	test_incomplete ();
+	test_on_demand ();
+	test_calls ();
+	test_void ();
+
+	jit_context_destroy (context);
+	jit_type_free (unary_signature);
+	jit_type_free (binary_signature);
+	jit_type_free (store_signature);
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * interp-tests.c - Tests for the bytecode of the interpreter
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+static jit_context_t context;
+static jit_type_t signature;
+
+static jit_value_t
+int_constant(jit_function_t func, jit_int value)
+{
+	return jit_value_create_nint_constant (func, jit_type_int, value);
+}
+
+static jit_int
+call(jit_function_t func, jit_int x)
+{
+	jit_int result = 0;
+	void *args[1] = { &x };
+
+	CHECK (jit_function_apply (func, args, &result));
+	return result;
+}
+
+/* "s = 100; if (x > 10) goto skip; s = x + 1; skip: return s * 3".  The
+   store of "s" and the load that follows the label are fused into one
+   superinstruction, and the branch goes to the load.  */
+
+static void
+test_forward(void)
+{
+	jit_function_t func;
+	jit_value_t x, s;
+	jit_label_t skip = jit_label_undefined;
+
+	func = jit_function_create (context, signature);
+	x = jit_value_get_param (func, 0);
+	s = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, s, int_constant (func, 100));
+	jit_insn_branch_if (func, jit_insn_gt (func, x, int_constant (func, 10)),
+			    &skip);
+	jit_insn_store (func, s, jit_insn_add (func, x, int_constant (func, 1)));
+	jit_insn_label (func, &skip);
+	jit_insn_return (func, jit_insn_mul (func, s, int_constant (func, 3)));
+	CHECK (jit_function_compile (func));
+
+	CHECK (call (func, 2) == 9);
+	CHECK (call (func, 10) == 33);
+	CHECK (call (func, 11) == 300);
+}
+
+/* "s = 0; i = 1; top: s = s + i; i = i + 1; if (i <= x) goto top;
+   return s".  The loop goes back to the load of "s" which is fused with
+   the store of "i" before the loop.  */
+
+static void
+test_loop(void)
+{
+	jit_function_t func;
+	jit_value_t x, s, i;
+	jit_label_t top = jit_label_undefined;
+
+	func = jit_function_create (context, signature);
+	x = jit_value_get_param (func, 0);
+	s = jit_value_create (func, jit_type_int);
+	i = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, s, int_constant (func, 0));
+	jit_insn_store (func, i, int_constant (func, 1));
+	jit_insn_label (func, &top);
+	jit_insn_store (func, s, jit_insn_add (func, s, i));
+	jit_insn_store (func, i, jit_insn_add (func, i, int_constant (func, 1)));
+	jit_insn_branch_if (func, jit_insn_le (func, i, x), &top);
+	jit_insn_return (func, s);
+	CHECK (jit_function_compile (func));
+
+	CHECK (call (func, 1) == 1);
+	CHECK (call (func, 4) == 10);
+	CHECK (call (func, 100) == 5050);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t param = jit_type_int;
+
+	jit_init ();
+	context = jit_context_create ();
+	signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_int, &param, 1, 1);
+
+	jit_context_build_start (context);
+	test_forward ();
+	test_loop ();
+	jit_context_build_end (context);
+
+	jit_type_free (signature);
+	jit_context_destroy (context);
+	return 0;
+}
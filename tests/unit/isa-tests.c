@@ -0,0 +1,171 @@
+/*
+ * isa-tests.c - Tests for the instructions selected by cpu features
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "unit-tests.h"
+
+/* The whole test runs twice: once with the features of the host cpu,
+   and once more with "JIT_X86_64_ISA=baseline" to check the fallback
+   instruction sequences.  */
+#define ISA_VARIABLE	"JIT_X86_64_ISA"
+
+typedef jit_value_t (*unary_insn)(jit_function_t, jit_value_t);
+typedef jit_value_t (*binary_insn)(jit_function_t, jit_value_t, jit_value_t);
+
+static jit_context_t context;
+
+static jit_function_t
+create_unary(jit_type_t type, unary_insn insn)
+{
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl, type,
+						    &type, 1, 1);
+	jit_function_t func = jit_function_create (context, sig);
+	jit_insn_return (func, insn (func, jit_value_get_param (func, 0)));
+	CHECK (jit_function_compile (func));
+	jit_type_free (sig);
+	return func;
+}
+
+static jit_function_t
+create_binary(jit_type_t type, binary_insn insn)
+{
+	jit_type_t params[2] = { type, jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl, type,
+						    params, 2, 1);
+	jit_function_t func = jit_function_create (context, sig);
+	jit_insn_return (func, insn (func, jit_value_get_param (func, 0),
+				     jit_value_get_param (func, 1)));
+	CHECK (jit_function_compile (func));
+	jit_type_free (sig);
+	return func;
+}
+
+static void
+test_rounding(void)
+{
+	static const jit_float64 values[] = {
+		2.5, -2.5, 3.5, 0.75, -0.75, 1e10 + 0.5, -7.0
+	};
+	unary_insn insns[4] = {
+		jit_insn_floor, jit_insn_ceil, jit_insn_trunc, jit_insn_rint
+	};
+	jit_float32 (*float32_ops[4])(jit_float32) = {
+		jit_float32_floor, jit_float32_ceil,
+		jit_float32_trunc, jit_float32_rint
+	};
+	jit_float64 (*float64_ops[4])(jit_float64) = {
+		jit_float64_floor, jit_float64_ceil,
+		jit_float64_trunc, jit_float64_rint
+	};
+	jit_function_t ffunc, dfunc;
+	jit_float32 fvalue, fresult;
+	jit_float64 dvalue, dresult;
+	void *args[1];
+	unsigned int i, op;
+
+	for (op = 0; op < 4; op++)
+	{
+		ffunc = create_unary (jit_type_float32, insns[op]);
+		dfunc = create_unary (jit_type_float64, insns[op]);
+		for (i = 0; i < sizeof (values) / sizeof (values[0]); i++)
+		{
+			fvalue = (jit_float32)values[i];
+			args[0] = &fvalue;
+			CHECK (jit_function_apply (ffunc, args, &fresult));
+			CHECK (fresult == float32_ops[op] (fvalue));
+
+			dvalue = values[i];
+			args[0] = &dvalue;
+			CHECK (jit_function_apply (dfunc, args, &dresult));
+			CHECK (dresult == float64_ops[op] (dvalue));
+		}
+	}
+}
+
+static void
+test_shifts(void)
+{
+	static const int counts[] = { 0, 1, 7, 31, 33, 63 };
+	binary_insn insns[3] = { jit_insn_shl, jit_insn_shr, jit_insn_ushr };
+	jit_function_t ifunc[3], lfunc[3], ufunc;
+	jit_int ivalue = -123456, iresult;
+	jit_long lvalue = -1234567890123LL, lresult;
+	jit_uint uvalue = 0x80000001, uresult;
+	void *args[2];
+	unsigned int i, op;
+	int count;
+
+	for (op = 0; op < 3; op++)
+	{
+		ifunc[op] = create_binary (jit_type_int, insns[op]);
+		lfunc[op] = create_binary (jit_type_long, insns[op]);
+	}
+	ufunc = create_binary (jit_type_uint, jit_insn_shr);
+
+	args[1] = &count;
+	for (i = 0; i < sizeof (counts) / sizeof (counts[0]); i++)
+	{
+		count = counts[i];
+
+		args[0] = &ivalue;
+		CHECK (jit_function_apply (ifunc[0], args, &iresult));
+		CHECK (iresult == (jit_int)((jit_uint)ivalue << (count & 31)));
+		CHECK (jit_function_apply (ifunc[1], args, &iresult));
+		CHECK (iresult == (ivalue >> (count & 31)));
+		CHECK (jit_function_apply (ifunc[2], args, &iresult));
+		CHECK (iresult == (jit_int)((jit_uint)ivalue >> (count & 31)));
+
+		args[0] = &lvalue;
+		CHECK (jit_function_apply (lfunc[0], args, &lresult));
+		CHECK (lresult == (jit_long)((jit_ulong)lvalue << (count & 63)));
+		CHECK (jit_function_apply (lfunc[1], args, &lresult));
+		CHECK (lresult == (lvalue >> (count & 63)));
+		CHECK (jit_function_apply (lfunc[2], args, &lresult));
+		CHECK (lresult == (jit_long)((jit_ulong)lvalue >> (count & 63)));
+
+		args[0] = &uvalue;
+		CHECK (jit_function_apply (ufunc, args, &uresult));
+		CHECK (uresult == (uvalue >> (count & 31)));
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_init ();
+	context = jit_context_create ();
+
+	test_rounding ();
+	test_shifts ();
+
+	jit_context_destroy (context);
+
+	if (!getenv (ISA_VARIABLE))
+	{
+		CHECK (setenv (ISA_VARIABLE, "baseline", 1) == 0);
+		execv (argv[0], argv);
+		CHECK (0);
+	}
+	return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * layout-tests.c - Tests for the layout of basic blocks by branch hints
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+#include <unistd.h>
+
+static jit_context_t context;
+static jit_type_t signature;
+static int build_count;
+
+static jit_value_t
+int_constant(jit_function_t func, jit_int value)
+{
+	return jit_value_create_nint_constant (func, jit_type_int, value);
+}
+
+static jit_int
+slow_path(jit_int x)
+{
+	return x * 3 + 1;
+}
+
+/* "if (x < 0) throw; s = 0; for (i = 0; i < x; i++) { if (i % 7 == 0)
+   s += slow_path(i); else if (i & 1) s += i; else s -= 1; } return s",
+   with the branches marked as given by "hints" */
+
+static void
+build_body(jit_function_t func, const int *hints)
+{
+	jit_type_t param = jit_type_int;
+	jit_type_t slow_signature;
+	jit_value_t x, s, i, r;
+	jit_label_t ok = jit_label_undefined;
+	jit_label_t top = jit_label_undefined;
+	jit_label_t test = jit_label_undefined;
+	jit_label_t slow = jit_label_undefined;
+	jit_label_t even = jit_label_undefined;
+	jit_label_t next = jit_label_undefined;
+
+	slow_signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_int, &param, 1, 1);
+
+	x = jit_value_get_param (func, 0);
+	s = jit_value_create (func, jit_type_int);
+	i = jit_value_create (func, jit_type_int);
+
+	jit_insn_branch_if_not_hint (func, jit_insn_lt (func, x, int_constant (func, 0)),
+				     &ok, hints[0]);
+	jit_insn_throw (func, jit_value_create_nint_constant
+			(func, jit_type_void_ptr, (jit_nint) &build_count));
+	jit_insn_label (func, &ok);
+	jit_insn_store (func, s, int_constant (func, 0));
+	jit_insn_store (func, i, int_constant (func, 0));
+	jit_insn_branch (func, &test);
+
+	jit_insn_label (func, &top);
+	jit_insn_branch_if_hint (func, jit_insn_eq (func, jit_insn_rem
+						    (func, i, int_constant (func, 7)),
+						    int_constant (func, 0)),
+				 &slow, hints[1]);
+	jit_insn_branch_if_not_hint (func, jit_insn_and (func, i, int_constant (func, 1)),
+				     &even, hints[2]);
+	jit_insn_store (func, s, jit_insn_add (func, s, i));
+	jit_insn_branch (func, &next);
+	jit_insn_label (func, &even);
+	jit_insn_store (func, s, jit_insn_sub (func, s, int_constant (func, 1)));
+	jit_insn_branch (func, &next);
+	jit_insn_label (func, &slow);
+	r = jit_insn_call_native (func, "slow_path", (void *) slow_path,
+				  slow_signature, &i, 1, JIT_CALL_NOTHROW);
+	jit_insn_store (func, s, jit_insn_add (func, s, r));
+	jit_insn_label (func, &next);
+	jit_insn_store (func, i, jit_insn_add (func, i, int_constant (func, 1)));
+
+	jit_insn_label (func, &test);
+	jit_insn_branch_if_hint (func, jit_insn_lt (func, i, x), &top, hints[3]);
+	jit_insn_return (func, s);
+
+	jit_type_free (slow_signature);
+}
+
+static jit_int
+expected(jit_int x)
+{
+	jit_int s = 0, i;
+	for (i = 0; i < x; i++)
+	{
+		if (i % 7 == 0)
+		{
+			s += slow_path (i);
+		}
+		else if (i & 1)
+		{
+			s += i;
+		}
+		else
+		{
+			s -= 1;
+		}
+	}
+	return s;
+}
+
+static int
+call(jit_function_t func, jit_int x, jit_int *result)
+{
+	void *args[1] = { &x };
+	return jit_function_apply (func, args, result);
+}
+
+static void
+check_results(jit_function_t func)
+{
+	jit_int x, result;
+
+	for (x = 0; x < 40; x += 3)
+	{
+		result = -1;
+		CHECK (call (func, x, &result));
+		CHECK (result == expected (x));
+	}
+	CHECK (!call (func, -1, &result));
+	CHECK (jit_exception_get_last () == &build_count);
+	jit_exception_clear_last ();
+}
+
+/* Every combination of hints gives the same answers as no hints */
+
+static void
+test_hints(void)
+{
+	static const int hint_sets[][4] = {
+		{ 0, 0, 0, 0 },
+		{ JIT_BRANCH_LIKELY, JIT_BRANCH_UNLIKELY, 0, JIT_BRANCH_LIKELY },
+		{ JIT_BRANCH_UNLIKELY, JIT_BRANCH_LIKELY, JIT_BRANCH_LIKELY,
+		  JIT_BRANCH_UNLIKELY },
+		{ JIT_BRANCH_LIKELY, JIT_BRANCH_UNLIKELY, JIT_BRANCH_UNLIKELY,
+		  JIT_BRANCH_LIKELY },
+	};
+	jit_function_t func;
+	int index;
+
+	for (index = 0; index < sizeof (hint_sets) / sizeof (hint_sets[0]); index++)
+	{
+		func = jit_function_create (context, signature);
+		build_body (func, hint_sets[index]);
+		jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+		CHECK (jit_function_compile (func));
+		check_results (func);
+	}
+}
+
+static int
+build_profiled(jit_function_t func)
+{
+	static const int no_hints[4] = { 0, 0, 0, 0 };
+
+	build_body (func, no_hints);
+	++build_count;
+	return JIT_RESULT_OK;
+}
+
+/* The function keeps giving the same answers once it is rebuilt with
+   the hints from its baseline profile */
+
+static void
+test_profile(void)
+{
+	jit_function_t func;
+	jit_int result;
+	int i;
+
+	CHECK (jit_context_set_meta_numeric (context, JIT_OPTION_TIERED_COMPILE, 50));
+	CHECK (jit_context_set_meta_numeric (context, JIT_OPTION_BRANCH_PROFILE, 1));
+
+	func = jit_function_create (context, signature);
+	jit_function_set_on_demand_compiler (func, build_profiled);
+	for (i = 0; i < 200 && build_count < 2; i++)
+	{
+		CHECK (call (func, 30, &result));
+		CHECK (result == expected (30));
+		usleep (10000);
+	}
+	CHECK (build_count == 2);
+	check_results (func);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t param = jit_type_int;
+
+	jit_init ();
+	context = jit_context_create ();
+	signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_int, &param, 1, 1);
+
+	jit_context_build_start (context);
+	test_hints ();
+	jit_context_build_end (context);
+
+	test_profile ();
+
+	jit_type_free (signature);
+	jit_context_destroy (context);
+	return 0;
+}
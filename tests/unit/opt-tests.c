@@ -0,0 +1,457 @@
+/*
+ * opt-tests.c - Aggressive optimization tests
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+/* Count the instructions with opcodes in the range [first, last].  */
+
+static int count_insns(jit_function_t func, int first, int last)
+{
+	jit_block_t block = 0;
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	int count = 0;
+
+	while ((block = jit_block_next (func, block)) != 0)
+	{
+		jit_insn_iter_init (&iter, block);
+		while ((insn = jit_insn_iter_next (&iter)) != 0)
+		{
+			int opcode = jit_insn_get_opcode (insn);
+			if (opcode >= first && opcode <= last)
+				++count;
+		}
+	}
+	return count;
+}
+
+static jit_function_t create_function(jit_context_t ctx, int num_params)
+{
+	jit_type_t params[2] = { jit_type_int, jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, num_params, 1);
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_type_free (sig);
+	jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+	return func;
+}
+
+/* Make a function like
+
+   x = 5
+   y = x * 2
+   if y > 8 then goto .L0
+   r = a - 1
+   goto .L1
+   .L0:
+   r = a + y
+   .L1:
+   return r
+
+   The outcome of the branch is known once the constant is propagated
+   into the multiplication, so the branch and the unused path go away.  */
+
+static void test_constant_branch(void)
+{
+	jit_init();
+	jit_context_t ctx = jit_context_create ();
+
+	jit_function_t func = create_function (ctx, 1);
+	jit_value_t a = jit_value_get_param (func, 0);
+	jit_label_t l0 = jit_label_undefined;
+	jit_label_t l1 = jit_label_undefined;
+
+	jit_value_t x = jit_value_create (func, jit_type_int);
+	jit_value_t y = jit_value_create (func, jit_type_int);
+	jit_value_t r = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, x,
+			jit_value_create_nint_constant (func, jit_type_int, 5));
+	jit_insn_store (func, y,
+			jit_insn_mul (func, x,
+				      jit_value_create_nint_constant
+				      (func, jit_type_int, 2)));
+	jit_insn_branch_if (func,
+			    jit_insn_gt (func, y,
+					 jit_value_create_nint_constant
+					 (func, jit_type_int, 8)),
+			    &l0);
+	jit_insn_store (func, r,
+			jit_insn_sub (func, a,
+				      jit_value_create_nint_constant
+				      (func, jit_type_int, 1)));
+	jit_insn_branch (func, &l1);
+	jit_insn_label (func, &l0);
+	jit_insn_store (func, r, jit_insn_add (func, a, y));
+	jit_insn_label (func, &l1);
+	jit_insn_return (func, r);
+
+	CHECK (jit_optimize (func));
+	CHECK (count_insns (func, JIT_OP_BR_IFALSE, JIT_OP_BR_NFGE_INV) == 0);
+	CHECK (count_insns (func, JIT_OP_IMUL, JIT_OP_IMUL) == 0);
+	CHECK (count_insns (func, JIT_OP_ISUB, JIT_OP_ISUB) == 0);
+	CHECK (jit_function_compile (func));
+
+	jit_int arg, result;
+	void *args[1] = { &arg };
+	for (arg = -3; arg < 4; ++arg)
+	{
+		CHECK (jit_function_apply (func, args, &result));
+		CHECK (result == arg + 10);
+	}
+
+	jit_context_destroy (ctx);
+}
+
+/* Make a function like
+
+   b = a
+   c = b
+   d = a * 7
+   if a < 0 then goto .L0
+   return c + 1
+   .L0:
+   return c - 1
+
+   The copies are propagated into the other blocks and the unused
+   multiplication is removed.  */
+
+static void test_copies(void)
+{
+	jit_init();
+	jit_context_t ctx = jit_context_create ();
+
+	jit_function_t func = create_function (ctx, 1);
+	jit_value_t a = jit_value_get_param (func, 0);
+	jit_value_t one = jit_value_create_nint_constant (func, jit_type_int, 1);
+	jit_label_t l0 = jit_label_undefined;
+
+	jit_value_t b = jit_value_create (func, jit_type_int);
+	jit_value_t c = jit_value_create (func, jit_type_int);
+	jit_value_t d = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, b, a);
+	jit_insn_store (func, c, b);
+	jit_insn_store (func, d,
+			jit_insn_mul (func, a,
+				      jit_value_create_nint_constant
+				      (func, jit_type_int, 7)));
+	jit_insn_branch_if (func,
+			    jit_insn_lt (func, a,
+					 jit_value_create_nint_constant
+					 (func, jit_type_int, 0)),
+			    &l0);
+	jit_insn_return (func, jit_insn_add (func, c, one));
+	jit_insn_label (func, &l0);
+	jit_insn_return (func, jit_insn_sub (func, c, one));
+
+	CHECK (jit_optimize (func));
+	CHECK (count_insns (func, JIT_OP_COPY_INT, JIT_OP_COPY_INT) == 0);
+	CHECK (count_insns (func, JIT_OP_IMUL, JIT_OP_IMUL) == 0);
+	CHECK (jit_function_compile (func));
+
+	jit_int arg, result;
+	void *args[1] = { &arg };
+	for (arg = -3; arg < 4; ++arg)
+	{
+		CHECK (jit_function_apply (func, args, &result));
+		CHECK (result == (arg < 0 ? arg - 1 : arg + 1));
+	}
+
+	jit_context_destroy (ctx);
+}
+
+/* Values that are redefined in a loop must not be taken as constants.  */
+
+static jit_int loop_expected(jit_int n, jit_int m)
+{
+	jit_int i, k = 3, sum = 0;
+	for (i = 0; i < n; ++i)
+	{
+		sum += i * k;
+		if (sum > m)
+			k = 1;
+	}
+	return sum + k;
+}
+
+static void test_loop(void)
+{
+	jit_init();
+	jit_context_t ctx = jit_context_create ();
+
+	jit_function_t func = create_function (ctx, 2);
+	jit_value_t n = jit_value_get_param (func, 0);
+	jit_value_t m = jit_value_get_param (func, 1);
+	jit_value_t zero = jit_value_create_nint_constant (func, jit_type_int, 0);
+	jit_value_t one = jit_value_create_nint_constant (func, jit_type_int, 1);
+	jit_label_t top = jit_label_undefined;
+	jit_label_t next = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+
+	jit_value_t i = jit_value_create (func, jit_type_int);
+	jit_value_t k = jit_value_create (func, jit_type_int);
+	jit_value_t sum = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, i, zero);
+	jit_insn_store (func, k,
+			jit_value_create_nint_constant (func, jit_type_int, 3));
+	jit_insn_store (func, sum, zero);
+	jit_insn_label (func, &top);
+	jit_insn_branch_if_not (func, jit_insn_lt (func, i, n), &done);
+	jit_insn_store (func, sum,
+			jit_insn_add (func, sum, jit_insn_mul (func, i, k)));
+	jit_insn_branch_if_not (func, jit_insn_gt (func, sum, m), &next);
+	jit_insn_store (func, k, one);
+	jit_insn_label (func, &next);
+	jit_insn_store (func, i, jit_insn_add (func, i, one));
+	jit_insn_branch (func, &top);
+	jit_insn_label (func, &done);
+	jit_insn_return (func, jit_insn_add (func, sum, k));
+
+	CHECK (jit_function_compile (func));
+
+	jit_int arg1, arg2, result;
+	void *args[2] = { &arg1, &arg2 };
+	for (arg1 = 0; arg1 < 12; arg1 += 3)
+	{
+		for (arg2 = -1; arg2 < 40; arg2 += 10)
+		{
+			CHECK (jit_function_apply (func, args, &result));
+			CHECK (result == loop_expected (arg1, arg2));
+		}
+	}
+
+	jit_context_destroy (ctx);
+}
+
+/* Count the instructions with opcodes in the range [first, last] in
+   the blocks from the one at the label "start" up to the one at the
+   label "end".  */
+
+static int count_range_insns(jit_function_t func, jit_label_t start,
+			     jit_label_t end, int first, int last)
+{
+	jit_block_t block = jit_block_from_label (func, start);
+	jit_block_t end_block = jit_block_from_label (func, end);
+	jit_insn_iter_t iter;
+	jit_insn_t insn;
+	int count = 0;
+
+	for (; block && block != end_block; block = jit_block_next (func, block))
+	{
+		jit_insn_iter_init (&iter, block);
+		while ((insn = jit_insn_iter_next (&iter)) != 0)
+		{
+			int opcode = jit_insn_get_opcode (insn);
+			if (opcode >= first && opcode <= last)
+				++count;
+		}
+	}
+	return count;
+}
+
+/* Make a function like
+
+   sum = 0
+   i = 0
+   .L0:
+   if !(i < n) goto .L2
+   check_null(array)
+   elem = *(array + i * sizeof(jit_nint))
+   if elem >= 0 then goto .L1
+   elem = -elem
+   .L1:
+   check_null(array)
+   factor = scale * 3
+   sum = sum + elem * factor
+   i = i + 1
+   goto .L0
+   .L2:
+   return sum
+
+   The second null check is redundant, "scale * 3" is invariant and
+   "i * sizeof(jit_nint)" is reduced to an addition, so only the
+   multiplication by "factor" remains in the loop.  */
+
+static jit_nint loop_code_expected(jit_nint *array, jit_nint n, jit_nint scale)
+{
+	jit_nint i, sum = 0;
+	for (i = 0; i < n; ++i)
+		sum += (array[i] < 0 ? -array[i] : array[i]) * scale * 3;
+	return sum;
+}
+
+static void test_loop_code(void)
+{
+	jit_init();
+	jit_context_t ctx = jit_context_create ();
+
+	jit_type_t params[3] = { jit_type_void_ptr, jit_type_nint, jit_type_nint };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_nint,
+						    params, 3, 1);
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_type_free (sig);
+	jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+
+	jit_value_t array = jit_value_get_param (func, 0);
+	jit_value_t n = jit_value_get_param (func, 1);
+	jit_value_t scale = jit_value_get_param (func, 2);
+	jit_value_t zero = jit_value_create_nint_constant (func, jit_type_nint, 0);
+	jit_value_t one = jit_value_create_nint_constant (func, jit_type_nint, 1);
+	jit_label_t l0 = jit_label_undefined;
+	jit_label_t l1 = jit_label_undefined;
+	jit_label_t l2 = jit_label_undefined;
+
+	jit_value_t sum = jit_value_create (func, jit_type_nint);
+	jit_value_t i = jit_value_create (func, jit_type_nint);
+	jit_value_t elem = jit_value_create (func, jit_type_nint);
+	jit_value_t factor = jit_value_create (func, jit_type_nint);
+	jit_insn_store (func, sum, zero);
+	jit_insn_store (func, i, zero);
+
+	jit_insn_label (func, &l0);
+	jit_insn_branch_if_not (func, jit_insn_lt (func, i, n), &l2);
+	jit_insn_check_null (func, array);
+	jit_insn_store (func, elem,
+			jit_insn_load_relative
+			(func, jit_insn_load_elem_address (func, array, i,
+							   jit_type_nint),
+			 0, jit_type_nint));
+	jit_insn_branch_if (func, jit_insn_ge (func, elem, zero), &l1);
+	jit_insn_store (func, elem, jit_insn_neg (func, elem));
+	jit_insn_label (func, &l1);
+	jit_insn_check_null (func, array);
+	jit_insn_store (func, factor,
+			jit_insn_mul (func, scale,
+				      jit_value_create_nint_constant
+				      (func, jit_type_nint, 3)));
+	jit_insn_store (func, sum,
+			jit_insn_add (func, sum, jit_insn_mul (func, elem, factor)));
+	jit_insn_store (func, i, jit_insn_add (func, i, one));
+	jit_insn_branch (func, &l0);
+	jit_insn_label (func, &l2);
+	jit_insn_return (func, sum);
+
+	CHECK (jit_optimize (func));
+	CHECK (count_range_insns (func, l0, l2,
+				  JIT_OP_CHECK_NULL, JIT_OP_CHECK_NULL) == 1);
+	CHECK (count_range_insns (func, l0, l2, JIT_OP_IMUL, JIT_OP_IMUL)
+	       + count_range_insns (func, l0, l2, JIT_OP_LMUL, JIT_OP_LMUL) == 1);
+	CHECK (jit_function_compile (func));
+
+	jit_nint values[7] = { 3, -1, 4, -1, 5, -9, 2 };
+	jit_nint *arg1 = values;
+	jit_nint arg2, arg3 = 5, result;
+	void *args[3] = { &arg1, &arg2, &arg3 };
+	for (arg2 = 0; arg2 <= 7; ++arg2)
+	{
+		CHECK (jit_function_apply (func, args, &result));
+		CHECK (result == loop_code_expected (values, arg2, arg3));
+	}
+
+	jit_context_destroy (ctx);
+}
+
+/* Make a function like
+
+   sum = 0
+   i = 0
+   .L0:
+   if !(i < n) goto .L1
+   sum = sum + *(array + (jit_nint) i * sizeof(jit_int))
+   i = i + 1
+   goto .L0
+   .L1:
+   return sum
+
+   with "i" and "n" of the type jit_int.  The index is extended to
+   jit_nint before the multiplication, which is still reduced to an
+   addition.  */
+
+static void test_loop_int_index(void)
+{
+	jit_init();
+	jit_context_t ctx = jit_context_create ();
+
+	jit_type_t params[2] = { jit_type_void_ptr, jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, 2, 1);
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_type_free (sig);
+	jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+
+	jit_value_t array = jit_value_get_param (func, 0);
+	jit_value_t n = jit_value_get_param (func, 1);
+	jit_value_t zero = jit_value_create_nint_constant (func, jit_type_int, 0);
+	jit_value_t one = jit_value_create_nint_constant (func, jit_type_int, 1);
+	jit_label_t l0 = jit_label_undefined;
+	jit_label_t l1 = jit_label_undefined;
+
+	jit_value_t sum = jit_value_create (func, jit_type_int);
+	jit_value_t i = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, sum, zero);
+	jit_insn_store (func, i, zero);
+
+	jit_insn_label (func, &l0);
+	jit_insn_branch_if_not (func, jit_insn_lt (func, i, n), &l1);
+	jit_insn_store (func, sum,
+			jit_insn_add (func, sum,
+				      jit_insn_load_relative
+				      (func, jit_insn_load_elem_address
+				       (func, array, i, jit_type_int),
+				       0, jit_type_int)));
+	jit_insn_store (func, i, jit_insn_add (func, i, one));
+	jit_insn_branch (func, &l0);
+	jit_insn_label (func, &l1);
+	jit_insn_return (func, sum);
+
+	CHECK (jit_optimize (func));
+	CHECK (count_range_insns (func, l0, l1, JIT_OP_IMUL, JIT_OP_IMUL)
+	       + count_range_insns (func, l0, l1, JIT_OP_LMUL, JIT_OP_LMUL) == 0);
+	CHECK (jit_function_compile (func));
+
+	jit_int values[5] = { 3, -1, 4, -1, 5 };
+	jit_int *arg1 = values;
+	jit_int arg2, result, expected = 0;
+	void *args[2] = { &arg1, &arg2 };
+	for (arg2 = 0; arg2 <= 5; ++arg2)
+	{
+		CHECK (jit_function_apply (func, args, &result));
+		CHECK (result == expected);
+		if (arg2 < 5)
+			expected += values[arg2];
+	}
+
+	jit_context_destroy (ctx);
+}
+
+int main()
+{
+	test_constant_branch ();
+	test_copies ();
+	test_loop ();
+	test_loop_code ();
+	test_loop_int_index ();
+	return 0;
+}
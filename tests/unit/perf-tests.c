@@ -0,0 +1,186 @@
+/*
+ * perf-tests.c - Tests for the Linux perf support
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+#include <string.h>
+#include <unistd.h>
+
+#define JITDUMP_MAGIC		0x4A695444
+#define JITDUMP_CODE_LOAD	0
+#define JITDUMP_CODE_DEBUG_INFO	2
+
+static jit_context_t context;
+static char map_path[64];
+static char dump_path[64];
+
+/* Build "return x * 2 + 1" with two marked bytecode offsets */
+
+static jit_function_t
+create_function(const char *name)
+{
+	jit_type_t param = jit_type_int;
+	jit_type_t signature;
+	jit_function_t func;
+	jit_value_t x;
+
+	signature = jit_type_create_signature (jit_abi_cdecl, jit_type_int,
+					       &param, 1, 1);
+	func = jit_function_create (context, signature);
+	jit_type_free (signature);
+	if (name)
+	{
+		CHECK (jit_function_set_name (func, name));
+		CHECK (strcmp (jit_function_get_name (func), name) == 0);
+	}
+
+	jit_insn_mark_offset (func, 10);
+	x = jit_insn_mul (func, jit_value_get_param (func, 0),
+			  jit_value_create_nint_constant (func, jit_type_int, 2));
+	jit_insn_mark_offset (func, 20);
+	jit_insn_return (func, jit_insn_add
+			 (func, x, jit_value_create_nint_constant
+			  (func, jit_type_int, 1)));
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* Find the line of a function in the perf map */
+
+static int
+find_in_map(const char *name, void *entry)
+{
+	char line[256], expected[256];
+	FILE *file;
+	unsigned long start, size;
+	int found = 0;
+
+	file = fopen (map_path, "r");
+	CHECK (file != 0);
+	while (fgets (line, sizeof (line), file))
+	{
+		CHECK (sscanf (line, "%lx %lx %255s", &start, &size,
+			       expected) == 3);
+		if (strcmp (expected, name) == 0)
+		{
+			CHECK (start == (unsigned long) entry);
+			CHECK (size > 0);
+			found = 1;
+		}
+	}
+	fclose (file);
+	return found;
+}
+
+/* Check the records of the jitdump file */
+
+static void
+check_dump(const char *name, void *entry)
+{
+	unsigned char buf[65536];
+	jit_uint header[6];
+	jit_uint id, size;
+	size_t len, pos;
+	FILE *file;
+	int num_loads = 0, num_debug = 0;
+
+	file = fopen (dump_path, "r");
+	CHECK (file != 0);
+	len = fread (buf, 1, sizeof (buf), file);
+	fclose (file);
+
+	memcpy (header, buf, sizeof (header));
+	CHECK (header[0] == JITDUMP_MAGIC);
+	CHECK (header[1] == 1);
+	CHECK (header[5] == (jit_uint) getpid ());
+
+	for (pos = header[2]; pos + 16 <= len; pos += size)
+	{
+		memcpy (&id, buf + pos, 4);
+		memcpy (&size, buf + pos + 4, 4);
+		CHECK (size >= 16 && pos + size <= len);
+		if (id == JITDUMP_CODE_LOAD)
+		{
+			jit_ulong addr;
+			memcpy (&addr, buf + pos + 32, 8);
+			CHECK (strcmp ((char *) buf + pos + 56, name) == 0);
+			CHECK (addr == (jit_ulong) (jit_nuint) entry);
+			++num_loads;
+		}
+		else if (id == JITDUMP_CODE_DEBUG_INFO)
+		{
+			jit_ulong nr_entry;
+			memcpy (&nr_entry, buf + pos + 24, 8);
+			CHECK (nr_entry == 2);
+			CHECK (num_loads == 0);
+			++num_debug;
+		}
+	}
+	CHECK (num_loads == 1 && num_debug == 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+#if defined(__linux__)
+	jit_function_t func;
+	void *entry;
+	char name[64];
+
+	jit_init ();
+	sprintf (map_path, "/tmp/perf-%d.map", (int) getpid ());
+	sprintf (dump_path, "/tmp/jit-%d.dump", (int) getpid ());
+	unlink (map_path);
+	unlink (dump_path);
+
+	context = jit_context_create ();
+	jit_context_set_meta_numeric (context, JIT_OPTION_PERF,
+				      JIT_PERF_MAP | JIT_PERF_JITDUMP);
+	func = create_function ("perf_test_function");
+
+	if (jit_uses_interpreter ())
+	{
+		/* There is no native code to describe */
+		CHECK (access (map_path, F_OK) != 0);
+		CHECK (access (dump_path, F_OK) != 0);
+	}
+	else
+	{
+		entry = jit_function_to_closure (func);
+		CHECK (find_in_map ("perf_test_function", entry));
+		check_dump ("perf_test_function", entry);
+
+		/* Unnamed functions get a name from their address */
+		func = create_function (0);
+		CHECK (jit_function_get_name (func) == 0);
+		entry = jit_function_to_closure (func);
+		sprintf (name, "jit_function_%p", entry);
+		CHECK (find_in_map (name, entry));
+
+		unlink (map_path);
+		unlink (dump_path);
+	}
+
+	jit_context_destroy (context);
+#endif
+	return 0;
+}
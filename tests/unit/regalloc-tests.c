@@ -0,0 +1,204 @@
+/*
+ * regalloc-tests.c - Global register allocation tests
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+#define NUM_LOOPS	8
+
+static jit_int called;
+
+static jit_int touch(jit_int value)
+{
+	++called;
+	return value + 1;
+}
+
+/* Build a function like
+
+   total = 0
+   for k in 0 .. NUM_LOOPS - 1:
+     sum = 0
+     for i in 0 .. n - 1:
+       sum = sum + i * (k + 1)
+     total = total + touch(sum)
+   return total + n
+
+   Every loop has its own counter and sum, so there are more loop
+   values than global registers.  Their live ranges do not overlap,
+   so they can share registers, while "total" and "n" stay live
+   across all the loops and the calls.  */
+
+static jit_int expected(jit_int n)
+{
+	jit_int total = 0;
+	jit_int k, i, sum;
+
+	for (k = 0; k < NUM_LOOPS; k++)
+	{
+		sum = 0;
+		for (i = 0; i < n; i++)
+			sum += i * (k + 1);
+		total += sum + 1;
+	}
+	return total + n;
+}
+
+static void test_loop_values(void)
+{
+	jit_init();
+	jit_context_t ctx = jit_context_create ();
+
+	jit_type_t params[1] = { jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, 1, 1);
+	jit_type_t touch_sig = jit_type_create_signature (jit_abi_cdecl,
+							  jit_type_int,
+							  params, 1, 1);
+
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_value_t n = jit_value_get_param (func, 0);
+	jit_value_t zero = jit_value_create_nint_constant (func, jit_type_int, 0);
+	jit_value_t one = jit_value_create_nint_constant (func, jit_type_int, 1);
+
+	jit_value_t total = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, total, zero);
+
+	int k;
+	for (k = 0; k < NUM_LOOPS; k++)
+	{
+		jit_label_t top = jit_label_undefined;
+		jit_label_t done = jit_label_undefined;
+		jit_value_t i = jit_value_create (func, jit_type_int);
+		jit_value_t sum = jit_value_create (func, jit_type_int);
+		jit_value_t scale
+		  = jit_value_create_nint_constant (func, jit_type_int, k + 1);
+
+		jit_insn_store (func, i, zero);
+		jit_insn_store (func, sum, zero);
+
+		jit_insn_label (func, &top);
+		jit_insn_branch_if_not (func, jit_insn_lt (func, i, n), &done);
+		jit_insn_store (func, sum,
+				jit_insn_add (func, sum,
+					      jit_insn_mul (func, i, scale)));
+		jit_insn_store (func, i, jit_insn_add (func, i, one));
+		jit_insn_branch (func, &top);
+		jit_insn_label (func, &done);
+
+		jit_value_t result
+		  = jit_insn_call_native (func, "touch", (void *) touch,
+					  touch_sig, &sum, 1, JIT_CALL_NOTHROW);
+		jit_insn_store (func, total, jit_insn_add (func, total, result));
+	}
+	jit_insn_return (func, jit_insn_add (func, total, n));
+
+	jit_function_set_optimization_level
+	  (func, jit_function_get_max_optimization_level ());
+	CHECK (jit_function_compile (func));
+
+	jit_int arg, result;
+	void *args[1] = { &arg };
+	for (arg = 0; arg < 20; arg += 7)
+	{
+		called = 0;
+		CHECK (jit_function_apply (func, args, &result));
+		CHECK (result == expected (arg));
+		CHECK (called == NUM_LOOPS);
+	}
+
+	jit_type_free (touch_sig);
+	jit_type_free (sig);
+	jit_context_destroy (ctx);
+}
+
+/* Values that are used on both sides of a conditional branch stay in
+   registers across the blocks that are reached by falling through.  */
+
+static jit_int fallthrough_expected(jit_int a, jit_int b)
+{
+	jit_int x = a * 3;
+	if (x < b)
+		return x - a;
+	jit_int y = x + a;
+	if (y > 100)
+		return y - b;
+	return y * x + a;
+}
+
+static void test_fallthrough_values(void)
+{
+	jit_init();
+	jit_context_t ctx = jit_context_create ();
+
+	jit_type_t params[2] = { jit_type_int, jit_type_int };
+	jit_type_t sig = jit_type_create_signature (jit_abi_cdecl,
+						    jit_type_int,
+						    params, 2, 1);
+
+	jit_function_t func = jit_function_create (ctx, sig);
+	jit_value_t a = jit_value_get_param (func, 0);
+	jit_value_t b = jit_value_get_param (func, 1);
+	jit_value_t three = jit_value_create_nint_constant (func, jit_type_int, 3);
+	jit_value_t limit
+	  = jit_value_create_nint_constant (func, jit_type_int, 100);
+	jit_label_t small = jit_label_undefined;
+	jit_label_t large = jit_label_undefined;
+
+	jit_value_t x = jit_value_create (func, jit_type_int);
+	jit_value_t y = jit_value_create (func, jit_type_int);
+	jit_insn_store (func, x, jit_insn_mul (func, a, three));
+	jit_insn_branch_if (func, jit_insn_lt (func, x, b), &small);
+	jit_insn_store (func, y, jit_insn_add (func, x, a));
+	jit_insn_branch_if (func, jit_insn_gt (func, y, limit), &large);
+	jit_insn_return (func, jit_insn_add (func, jit_insn_mul (func, y, x), a));
+	jit_insn_label (func, &small);
+	jit_insn_return (func, jit_insn_sub (func, x, a));
+	jit_insn_label (func, &large);
+	jit_insn_return (func, jit_insn_sub (func, y, b));
+
+	jit_function_set_optimization_level
+	  (func, jit_function_get_max_optimization_level ());
+	CHECK (jit_function_compile (func));
+
+	jit_int arg1, arg2, result;
+	void *args[2] = { &arg1, &arg2 };
+	for (arg1 = -5; arg1 < 40; arg1 += 4)
+	{
+		for (arg2 = -10; arg2 < 60; arg2 += 13)
+		{
+			CHECK (jit_function_apply (func, args, &result));
+			CHECK (result == fallthrough_expected (arg1, arg2));
+		}
+	}
+
+	jit_type_free (sig);
+	jit_context_destroy (ctx);
+}
+
+int main()
+{
+	test_loop_values ();
+	test_fallthrough_values ();
+	return 0;
+}
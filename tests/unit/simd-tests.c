@@ -0,0 +1,263 @@
+/*
+ * simd-tests.c - Tests for the vector types and instructions
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+typedef jit_value_t (*binary_insn)(jit_function_t, jit_value_t, jit_value_t);
+typedef jit_value_t (*unary_insn)(jit_function_t, jit_value_t);
+
+static jit_context_t context;
+static jit_type_t vbyte, vint, vfloat32, vfloat64;
+static jit_type_t signature;
+
+static jit_function_t
+create_function(void)
+{
+	return jit_function_create (context, signature);
+}
+
+/* Run "*out = insn (*a, *b)" on vectors.  When "unary" is set, the
+   instruction only takes "*a".  */
+
+static void
+run_insn(jit_type_t type, binary_insn binary, unary_insn unary,
+	 void *a, void *b, void *out)
+{
+	jit_function_t func = create_function ();
+	jit_value_t va, vb, result;
+	void *args[3] = { &a, &b, &out };
+
+	va = jit_insn_load_relative (func, jit_value_get_param (func, 0), 0, type);
+	vb = jit_insn_load_relative (func, jit_value_get_param (func, 1), 0, type);
+	result = binary ? binary (func, va, vb) : unary (func, va);
+	CHECK (result);
+	CHECK (jit_insn_store_relative (func, jit_value_get_param (func, 2), 0,
+					result));
+	CHECK (jit_insn_default_return (func));
+	CHECK (jit_function_compile (func));
+	CHECK (jit_function_apply (func, args, 0));
+}
+
+static void
+test_types(void)
+{
+	CHECK (vbyte && vint && vfloat32 && vfloat64);
+	CHECK (jit_type_get_size (vfloat64) == 16);
+	CHECK (jit_type_get_alignment (vint) == 16);
+	CHECK (jit_type_num_fields (vbyte) == 16);
+	CHECK (jit_type_is_vector (vfloat32));
+	CHECK (jit_type_is_struct (vfloat32));
+	CHECK (jit_type_get_vector_element (vfloat64) == jit_type_float64);
+	CHECK (!jit_type_is_vector (jit_type_float32));
+	CHECK (!jit_type_create_vector (jit_type_int, 2));
+	CHECK (!jit_type_create_vector (jit_type_nfloat, 1));
+	CHECK (!jit_type_create_vector (jit_type_short, 8));
+}
+
+static void
+test_float32(void)
+{
+	jit_float32 a[4] = { 1.0f, -2.0f, 9.0f, 4.0f };
+	jit_float32 b[4] = { 2.0f, -2.0f, 3.0f, 8.0f };
+	jit_float32 c[4] = { 4.0f, 9.0f, 0.25f, 0.0f };
+	jit_float32 r[4];
+	jit_int m[4];
+
+	run_insn (vfloat32, jit_insn_add, 0, a, b, r);
+	CHECK (r[0] == 3.0f && r[1] == -4.0f && r[2] == 12.0f && r[3] == 12.0f);
+	run_insn (vfloat32, jit_insn_sub, 0, a, b, r);
+	CHECK (r[0] == -1.0f && r[1] == 0.0f && r[2] == 6.0f && r[3] == -4.0f);
+	run_insn (vfloat32, jit_insn_mul, 0, a, b, r);
+	CHECK (r[0] == 2.0f && r[1] == 4.0f && r[2] == 27.0f && r[3] == 32.0f);
+	run_insn (vfloat32, jit_insn_div, 0, a, b, r);
+	CHECK (r[0] == 0.5f && r[1] == 1.0f && r[2] == 3.0f && r[3] == 0.5f);
+	run_insn (vfloat32, jit_insn_min, 0, a, b, r);
+	CHECK (r[0] == 1.0f && r[1] == -2.0f && r[2] == 3.0f && r[3] == 4.0f);
+	run_insn (vfloat32, jit_insn_max, 0, a, b, r);
+	CHECK (r[0] == 2.0f && r[1] == -2.0f && r[2] == 9.0f && r[3] == 8.0f);
+	run_insn (vfloat32, 0, jit_insn_sqrt, c, c, r);
+	CHECK (r[0] == 2.0f && r[1] == 3.0f && r[2] == 0.5f && r[3] == 0.0f);
+
+	run_insn (vfloat32, jit_insn_eq, 0, a, b, m);
+	CHECK (m[0] == 0 && m[1] == -1 && m[2] == 0 && m[3] == 0);
+	run_insn (vfloat32, jit_insn_lt, 0, a, b, m);
+	CHECK (m[0] == -1 && m[1] == 0 && m[2] == 0 && m[3] == -1);
+	run_insn (vfloat32, jit_insn_le, 0, a, b, m);
+	CHECK (m[0] == -1 && m[1] == -1 && m[2] == 0 && m[3] == -1);
+	run_insn (vfloat32, jit_insn_gt, 0, a, b, m);
+	CHECK (m[0] == 0 && m[1] == 0 && m[2] == -1 && m[3] == 0);
+}
+
+static void
+test_float64(void)
+{
+	jit_float64 a[2] = { 1.5, 16.0 };
+	jit_float64 b[2] = { 0.5, 25.0 };
+	jit_float64 r[2];
+	jit_long m[2];
+
+	run_insn (vfloat64, jit_insn_add, 0, a, b, r);
+	CHECK (r[0] == 2.0 && r[1] == 41.0);
+	run_insn (vfloat64, jit_insn_mul, 0, a, b, r);
+	CHECK (r[0] == 0.75 && r[1] == 400.0);
+	run_insn (vfloat64, 0, jit_insn_sqrt, a, b, r);
+	CHECK (r[1] == 4.0);
+	run_insn (vfloat64, jit_insn_lt, 0, a, b, m);
+	CHECK (m[0] == 0 && m[1] == -1);
+}
+
+static void
+test_int(void)
+{
+	jit_int a[4] = { 7, -3, 0x10000, 100 };
+	jit_int b[4] = { 6, -3, 0x10001, -100 };
+	jit_int r[4];
+
+	run_insn (vint, jit_insn_add, 0, a, b, r);
+	CHECK (r[0] == 13 && r[1] == -6 && r[2] == 0x20001 && r[3] == 0);
+	run_insn (vint, jit_insn_sub, 0, a, b, r);
+	CHECK (r[0] == 1 && r[1] == 0 && r[2] == -1 && r[3] == 200);
+	run_insn (vint, jit_insn_mul, 0, a, b, r);
+	CHECK (r[0] == 42 && r[1] == 9 && r[2] == 0x10000 && r[3] == -10000);
+	run_insn (vint, jit_insn_eq, 0, a, b, r);
+	CHECK (r[0] == 0 && r[1] == -1 && r[2] == 0 && r[3] == 0);
+	run_insn (vint, jit_insn_gt, 0, a, b, r);
+	CHECK (r[0] == -1 && r[1] == 0 && r[2] == 0 && r[3] == -1);
+	run_insn (vint, jit_insn_lt, 0, a, b, r);
+	CHECK (r[0] == 0 && r[1] == 0 && r[2] == -1 && r[3] == 0);
+	run_insn (vint, jit_insn_xor, 0, a, b, r);
+	CHECK (r[0] == 1 && r[1] == 0 && r[2] == 1 && r[3] == (100 ^ -100));
+	run_insn (vint, jit_insn_and, 0, a, b, r);
+	CHECK (r[0] == 6 && r[1] == -3 && r[2] == 0x10000 && r[3] == (100 & -100));
+}
+
+static void
+test_byte(void)
+{
+	jit_sbyte a[16], b[16], r[16];
+	jit_function_t func;
+	int i;
+
+	for (i = 0; i < 16; i++)
+	{
+		a[i] = (jit_sbyte)(i * 9 - 20);
+		b[i] = (jit_sbyte)(i == 3 ? a[3] : 10 - i);
+	}
+	a[15] = 127;
+	b[15] = 1;
+
+	run_insn (vbyte, jit_insn_add, 0, a, b, r);
+	CHECK (r[0] == -10 && r[15] == -128);
+	run_insn (vbyte, jit_insn_sub, 0, a, b, r);
+	CHECK (r[0] == -30 && r[3] == 0 && r[15] == 126);
+	run_insn (vbyte, jit_insn_eq, 0, a, b, r);
+	CHECK (r[3] == -1 && r[4] == 0);
+	run_insn (vbyte, jit_insn_gt, 0, a, b, r);
+	CHECK (r[0] == 0 && r[3] == 0 && r[15] == -1);
+
+	/* There is no byte multiplication, and vectors do not mix with
+	   scalars */
+	func = create_function ();
+	CHECK (!jit_insn_mul (func, jit_value_create (func, vbyte),
+			      jit_value_create (func, vbyte)));
+	CHECK (!jit_insn_add (func, jit_value_create (func, vbyte),
+			      jit_value_create (func, jit_type_int)));
+}
+
+static jit_value_t
+reverse(jit_function_t func, jit_value_t value)
+{
+	unsigned int lanes[4] = { 3, 2, 1, 0 };
+	if (jit_type_get_vector_element (jit_value_get_type (value))
+	    == jit_type_float64)
+	{
+		lanes[0] = 1;
+		lanes[1] = 0;
+	}
+	return jit_insn_vector_shuffle (func, value, lanes);
+}
+
+static jit_value_t
+splat_third(jit_function_t func, jit_value_t value)
+{
+	jit_value_t half = jit_value_create_float32_constant (func,
+							      jit_type_float32,
+							      0.5f);
+	jit_value_t sum = jit_insn_add (func, value,
+					jit_insn_vector_splat (func, vfloat32,
+							       half));
+	return jit_insn_vector_splat (func, vfloat32,
+				      jit_insn_vector_extract (func, sum, 2));
+}
+
+static void
+test_shuffle(void)
+{
+	jit_float32 f[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+	jit_float64 d[2] = { 1.0, 2.0 };
+	jit_float32 fr[4];
+	jit_float64 dr[2];
+	jit_function_t func;
+
+	run_insn (vfloat32, 0, reverse, f, f, fr);
+	CHECK (fr[0] == 4.0f && fr[1] == 3.0f && fr[2] == 2.0f && fr[3] == 1.0f);
+	run_insn (vfloat64, 0, reverse, d, d, dr);
+	CHECK (dr[0] == 2.0 && dr[1] == 1.0);
+	run_insn (vfloat32, 0, splat_third, f, f, fr);
+	CHECK (fr[0] == 3.5f && fr[1] == 3.5f && fr[2] == 3.5f && fr[3] == 3.5f);
+
+	/* Byte vectors cannot be shuffled */
+	func = create_function ();
+	CHECK (!reverse (func, jit_value_create (func, vbyte)));
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t params[3] = { jit_type_void_ptr, jit_type_void_ptr,
+				 jit_type_void_ptr };
+
+	jit_init ();
+	context = jit_context_create ();
+	signature = jit_type_create_signature (jit_abi_cdecl, jit_type_void,
+					       params, 3, 1);
+	vbyte = jit_type_create_vector (jit_type_sbyte, 16);
+	vint = jit_type_create_vector (jit_type_int, 4);
+	vfloat32 = jit_type_create_vector (jit_type_float32, 4);
+	vfloat64 = jit_type_create_vector (jit_type_float64, 2);
+
+	test_types ();
+	test_float32 ();
+	test_float64 ();
+	test_int ();
+	test_byte ();
+	test_shuffle ();
+
+	jit_context_destroy (context);
+	jit_type_free (vbyte);
+	jit_type_free (vint);
+	jit_type_free (vfloat32);
+	jit_type_free (vfloat64);
+	jit_type_free (signature);
+	return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * stats-tests.c - Tests for the compile statistics
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+/* Enough live values to run out of registers */
+#define NUM_VALUES	40
+
+static jit_type_t signature;
+
+/* Build "return x + 1" */
+
+static jit_function_t
+create_small(jit_context_t context)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t x = jit_value_get_param (func, 0);
+
+	jit_insn_return (func, jit_insn_add
+			 (func, x, jit_value_create_nint_constant
+			  (func, jit_type_int, 1)));
+	return func;
+}
+
+/* Build "v[i] = x * (i + 1)" for all i, then return the sum of v,
+   so that all the values are live at once */
+
+static jit_function_t
+create_large(jit_context_t context)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t x = jit_value_get_param (func, 0);
+	jit_value_t values[NUM_VALUES];
+	jit_value_t sum;
+	int i;
+
+	for (i = 0; i < NUM_VALUES; i++)
+	{
+		values[i] = jit_insn_mul (func, x, jit_value_create_nint_constant
+					  (func, jit_type_int, i + 1));
+	}
+	sum = values[0];
+	for (i = 1; i < NUM_VALUES; i++)
+	{
+		sum = jit_insn_add (func, sum, values[i]);
+	}
+	jit_insn_return (func, sum);
+	return func;
+}
+
+static void
+test_disabled(void)
+{
+	jit_context_t context = jit_context_create ();
+	jit_compile_stats_t stats;
+	jit_function_t func;
+
+	func = create_small (context);
+	CHECK (jit_function_compile (func));
+	CHECK (!jit_function_get_compile_stats (func, &stats));
+	CHECK (stats.num_functions == 0);
+	CHECK (!jit_context_get_compile_stats (context, &stats));
+	CHECK (stats.num_functions == 0);
+
+	jit_context_destroy (context);
+}
+
+/* The totals of the context add up the statistics of its functions */
+
+static void
+test_totals(void)
+{
+	jit_context_t context = jit_context_create ();
+	jit_compile_stats_t small, large, total;
+	jit_function_t small_func, large_func;
+
+	jit_context_set_meta_numeric (context, JIT_OPTION_COMPILE_STATS, 1);
+
+	small_func = create_small (context);
+	large_func = create_large (context);
+	jit_function_set_optimization_level (large_func,
+					     JIT_OPTLEVEL_AGGRESSIVE);
+	CHECK (!jit_function_get_compile_stats (small_func, &small));
+	CHECK (jit_function_compile (small_func));
+	CHECK (jit_function_compile (large_func));
+
+	CHECK (jit_function_get_compile_stats (small_func, &small));
+	CHECK (jit_function_get_compile_stats (large_func, &large));
+	CHECK (jit_context_get_compile_stats (context, &total));
+
+	CHECK (small.num_functions == 1);
+	CHECK (small.num_blocks >= 1);
+	CHECK (small.num_insns >= 2);
+	CHECK (small.code_size > 0);
+	CHECK (large.num_insns > small.num_insns);
+	CHECK (large.code_size > small.code_size);
+	CHECK (large.total_time >= large.codegen_time);
+	CHECK (large.total_time > 0);
+	if (!jit_uses_interpreter ())
+	{
+		CHECK (large.num_spills > 0);
+		CHECK (large.num_reloads > 0);
+	}
+
+	CHECK (total.num_functions == 2);
+	CHECK (total.num_insns == small.num_insns + large.num_insns);
+	CHECK (total.code_size == small.code_size + large.code_size);
+	CHECK (total.num_spills == small.num_spills + large.num_spills);
+	CHECK (total.total_time == small.total_time + large.total_time);
+	CHECK (total.memory.used_size >= total.code_size);
+
+	jit_context_destroy (context);
+}
+
+/* Build "s = x; s = s * k + x" for "count" different constants k, then
+   return s */
+
+static jit_function_t
+create_chain(jit_context_t context, int count)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t x = jit_value_get_param (func, 0);
+	jit_value_t s = x;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		s = jit_insn_add (func, jit_insn_mul
+				  (func, s, jit_value_create_nint_constant
+				   (func, jit_type_int, 2 * i + 1)), x);
+	}
+	jit_insn_return (func, s);
+	return func;
+}
+
+/* Functions that do not fit in the rest of the code space are given a
+   larger space before their code is generated, not after */
+
+static void
+test_restarts(void)
+{
+	jit_context_t context = jit_context_create ();
+	jit_compile_stats_t stats;
+	jit_function_t func;
+	int i;
+
+	jit_context_set_meta_numeric (context, JIT_OPTION_COMPILE_STATS, 1);
+	jit_context_build_start (context);
+	for (i = 0; i < 200; i++)
+	{
+		func = create_chain (context, 50 + (i * 37) % 400);
+		CHECK (jit_function_compile (func));
+	}
+	for (i = 1; i <= 3; i++)
+	{
+		func = create_chain (context, 20000 * i);
+		CHECK (jit_function_compile (func));
+		CHECK (jit_function_get_compile_stats (func, &stats));
+		CHECK (stats.num_restarts == 0);
+		CHECK (stats.code_size > 64 * 1024);
+	}
+	jit_context_build_end (context);
+
+	CHECK (jit_context_get_compile_stats (context, &stats));
+	CHECK (stats.num_functions == 203);
+	CHECK (stats.num_restarts == 0);
+
+	jit_context_destroy (context);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t param = jit_type_int;
+
+	jit_init ();
+	signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_int, &param, 1, 1);
+
+	test_disabled ();
+	test_totals ();
+	test_restarts ();
+
+	jit_type_free (signature);
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * unwind-tests.c - Tests for the unwind information of compiled functions
+ *
+ * Copyright (C) 2026 Free Software Foundation
+ *
+ * This file is part of the libjit library.
+ *
+ * The libjit library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * The libjit library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the libjit library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <jit/jit.h>
+#include "unit-tests.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+#include <unwind.h>
+
+/* The functions that the unwinder found, from the innermost one */
+#define MAX_FRAMES	64
+static void *frames[MAX_FRAMES];
+static int num_frames;
+
+static jit_context_t context;
+static jit_type_t signature;
+
+static _Unwind_Reason_Code
+trace(struct _Unwind_Context *unwind, void *arg)
+{
+	if(num_frames < MAX_FRAMES)
+	{
+		frames[num_frames++] = _Unwind_FindEnclosingFunction
+			((void *) _Unwind_GetIP (unwind));
+	}
+	return _URC_NO_REASON;
+}
+
+static jit_int
+native_backtrace(jit_int x)
+{
+	num_frames = 0;
+	_Unwind_Backtrace (trace, 0);
+	return x + 1;
+}
+
+static int
+find_frame(void *func, int from)
+{
+	while(from < num_frames)
+	{
+		if(frames[from] == func)
+		{
+			return from;
+		}
+		++from;
+	}
+	return -1;
+}
+
+/* "return native_backtrace(x) * 2", with a value kept in a callee-saved
+   register across the call if "keep" is set */
+
+static jit_function_t
+create_inner(int keep)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t x, r;
+
+	x = jit_value_get_param (func, 0);
+	r = jit_insn_call_native (func, "native_backtrace", (void *) native_backtrace,
+				  signature, &x, 1, JIT_CALL_NOTHROW);
+	if(keep)
+	{
+		r = jit_insn_add (func, r, jit_insn_mul (func, x, x));
+	}
+	jit_insn_return (func, jit_insn_mul (func, r,
+					     jit_value_create_nint_constant
+					     (func, jit_type_int, 2)));
+	jit_function_set_optimization_level (func, JIT_OPTLEVEL_AGGRESSIVE);
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* "return inner(x + 1) + 3" */
+
+static jit_function_t
+create_outer(jit_function_t inner)
+{
+	jit_function_t func = jit_function_create (context, signature);
+	jit_value_t x, r;
+
+	x = jit_insn_add (func, jit_value_get_param (func, 0),
+			  jit_value_create_nint_constant (func, jit_type_int, 1));
+	r = jit_insn_call (func, 0, inner, 0, &x, 1, 0);
+	jit_insn_return (func, jit_insn_add (func, r,
+					     jit_value_create_nint_constant
+					     (func, jit_type_int, 3)));
+	CHECK (jit_function_compile (func));
+	return func;
+}
+
+/* Call a compiled function through its closure, so that there are no
+   frames of the library between this function and the generated code */
+
+static jit_int __attribute__((noinline))
+call_closure(jit_function_t func, jit_int x)
+{
+	jit_int (*closure)(jit_int) = (jit_int (*)(jit_int)) jit_function_to_closure (func);
+	jit_int result = closure (x);
+	__asm__ __volatile__ ("" : : : "memory");
+	return result;
+}
+
+static void
+test_backtrace(int keep)
+{
+	jit_function_t inner, outer;
+	int index;
+
+	inner = create_inner (keep);
+	outer = create_outer (inner);
+	CHECK (call_closure (outer, 4) == ((6 + (keep ? 25 : 0)) * 2 + 3));
+
+	/* The unwinder gets from the native function through both of the
+	   compiled functions to their native caller */
+	index = find_frame ((void *) native_backtrace, 0);
+	CHECK (index >= 0);
+	index = find_frame (jit_function_to_closure (inner), index + 1);
+	CHECK (index >= 0);
+	index = find_frame (jit_function_to_closure (outer), index + 1);
+	CHECK (index >= 0);
+	index = find_frame ((void *) call_closure, index + 1);
+	CHECK (index >= 0);
+}
+
+static void
+test_destroy(void)
+{
+	jit_function_t inner;
+	unsigned char *code;
+
+	/* The information goes away with the function */
+	inner = create_inner (1);
+	code = (unsigned char *) jit_function_to_closure (inner);
+	CHECK (_Unwind_FindEnclosingFunction (code + 1) == code);
+	jit_function_destroy (inner);
+	CHECK (_Unwind_FindEnclosingFunction (code + 1) == 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	jit_type_t param = jit_type_int;
+
+	/* The interpreter does not run the code natively */
+	if(jit_uses_interpreter ())
+	{
+		return 0;
+	}
+
+	jit_init ();
+	context = jit_context_create ();
+	jit_context_set_meta_numeric (context, JIT_OPTION_UNWIND_INFO, 1);
+	signature = jit_type_create_signature
+		(jit_abi_cdecl, jit_type_int, &param, 1, 1);
+
+	jit_context_build_start (context);
+	test_backtrace (0);
+	test_backtrace (1);
+	test_destroy ();
+	jit_context_build_end (context);
+
+	jit_type_free (signature);
+	jit_context_destroy (context);
+	return 0;
+}
+
+#else
+
+int
+main(int argc, char *argv[])
+{
+	/* Unwind information is only generated for x86-64 */
+	return 0;
+}
+
+#endif
@@ -51,6 +51,8 @@ extern char yytext[];
 #define TASK_GEN_HEADER		1
 #define TASK_GEN_TABLE		2
 #define TASK_GEN_CF_TABLE	3
+#define TASK_GEN_SUPER		4
+#define TASK_GEN_SLOTS		5
  
 /*
  * Value Flags
@@ -162,6 +164,10 @@ struct genops_opcode
 	int			input2_flags;
 	const char	       *expression;
 	struct intrinsic_info	intrinsic_info;
+	const char	       *super_first;
+	const char	       *super_second;
+	const char	       *slots_base;
+	int			slots_imm;
 };
 
 /*
@@ -192,6 +198,14 @@ static int genops_file_needs_close = 0;
  */
 static int genops_gen_intrinsic_table = 0;
 static const char *genops_intrinsic_decl = 0;
+static const char *genops_super_decl = 0;
+static const char *genops_slots_decl = 0;
+
+/*
+ * The interpreter source that the superinstructions and the
+ * slot opcodes are built from.
+ */
+static const char *genops_interp_filename = 0;
 
 /*
  * Blocks coppied to the resulting file.
@@ -257,7 +271,9 @@ static struct genops_opcode *
 genops_add_opcode(const char *name, int type, int oper, int dest_flags,
 		  int input1_flags, int input2_flags, const char *expression,
 		  const char *intrinsic_flags, int signature,
-		  const char *intrinsic)
+		  const char *intrinsic, const char *super_first,
+		  const char *super_second, const char *slots_base,
+		  int slots_imm)
 {
 	struct genops_opcode *opcode;
 
@@ -288,6 +304,10 @@ genops_add_opcode(const char *name, int type, int oper, int dest_flags,
 	opcode->intrinsic_info.flags = intrinsic_flags;
 	opcode->intrinsic_info.signature = signature;
 	opcode->intrinsic_info.intrinsic = intrinsic;
+	opcode->super_first = super_first;
+	opcode->super_second = super_second;
+	opcode->slots_base = slots_base;
+	opcode->slots_imm = slots_imm;
 
 	return opcode;
 }
@@ -826,6 +846,14 @@ genops_set_option(const char *option, const char *value)
 	{
 		genops_intrinsic_decl = value;
 	}
+	else if(!strcmp(option, "super_table_decl"))
+	{
+		genops_super_decl = value;
+	}
+	else if(!strcmp(option, "slots_table_decl"))
+	{
+		genops_slots_decl = value;
+	}
 	else
 	{
 		yyerror("Invalid option");
@@ -857,6 +885,10 @@ genops_set_option(const char *option, const char *value)
 	{
 		const char     *name;
 		int		oper;
+		const char     *super_first;
+		const char     *super_second;
+		const char     *slots_base;
+		int		slots_imm;
 	} opcode_header;
 	struct
 	{
@@ -893,6 +925,10 @@ genops_set_option(const char *option, const char *value)
 		const char     *intrinsic_flags;
 		int		signature;
 		const char     *intrinsic;
+		const char     *super_first;
+		const char     *super_second;
+		const char     *slots_base;
+		int		slots_imm;
 	} opcode;
 }
 
@@ -929,6 +965,9 @@ genops_set_option(const char *option, const char *value)
 %token K_JUMP_TABLE		"jump_table"
 %token K_OP_DEF			"op_def"
 %token K_OP_INTRINSIC		"op_intrinsic"
+%token K_OP_SUPER		"op_super"
+%token K_OP_SLOTS		"op_slots"
+%token K_OP_SLOTS_IMM		"op_slots_imm"
 %token K_OP_TYPE			"op_type"
 %token K_OP_VALUES		"op_values"
 %token K_OPCODES			"opcodes"
@@ -1046,7 +1085,11 @@ Opcodes
 					  ($1).expression,
 					  ($1).intrinsic_flags,
 					  ($1).signature,
-					  ($1).intrinsic);
+					  ($1).intrinsic,
+					  ($1).super_first,
+					  ($1).super_second,
+					  ($1).slots_base,
+					  ($1).slots_imm);
 		}
 	| Opcodes Opcode	{
 			genops_add_opcode(($2).name, ($2).type,
@@ -1056,7 +1099,11 @@ Opcodes
 					  ($2).expression,
 					  ($2).intrinsic_flags,
 					  ($2).signature,
-					  ($2).intrinsic);
+					  ($2).intrinsic,
+					  ($2).super_first,
+					  ($2).super_second,
+					  ($2).slots_base,
+					  ($2).slots_imm);
 		}
 	;
 
@@ -1072,6 +1119,10 @@ Opcode
 			($$).intrinsic_flags = 0;
 			($$).signature = SIG_NONE;
 			($$).intrinsic = 0;;
+			($$).super_first = ($1).super_first;
+			($$).super_second = ($1).super_second;
+			($$).slots_base = ($1).slots_base;
+			($$).slots_imm = ($1).slots_imm;
 		}
 	| OpcodeHeader '{' OpcodeProperties '}'	{
 			($$).name = ($1).name;
@@ -1084,6 +1135,10 @@ Opcode
 			($$).intrinsic_flags = ($3).intrinsic_flags;
 			($$).signature = ($3).signature;
 			($$).intrinsic = ($3).intrinsic;;
+			($$).super_first = ($1).super_first;
+			($$).super_second = ($1).super_second;
+			($$).slots_base = ($1).slots_base;
+			($$).slots_imm = ($1).slots_imm;
 		}
 	;
 
@@ -1091,10 +1146,42 @@ OpcodeHeader
 	: K_OP_DEF '(' LITERAL ')'	{
 			($$).name = $3;
 			($$).oper = OP_NONE;
+			($$).super_first = 0;
+			($$).super_second = 0;
+			($$).slots_base = 0;
+			($$).slots_imm = 0;
 		}
 	| K_OP_DEF '(' LITERAL ',' Op ')'	{
 			($$).name = $3;
 			($$).oper = $5;
+			($$).super_first = 0;
+			($$).super_second = 0;
+			($$).slots_base = 0;
+			($$).slots_imm = 0;
+		}
+	| K_OP_SUPER '(' LITERAL ',' IDENTIFIER ',' IDENTIFIER ')'	{
+			($$).name = $3;
+			($$).oper = OP_NONE;
+			($$).super_first = $5;
+			($$).super_second = $7;
+			($$).slots_base = 0;
+			($$).slots_imm = 0;
+		}
+	| K_OP_SLOTS '(' LITERAL ',' IDENTIFIER ')'	{
+			($$).name = $3;
+			($$).oper = OP_NONE;
+			($$).super_first = 0;
+			($$).super_second = 0;
+			($$).slots_base = $5;
+			($$).slots_imm = 0;
+		}
+	| K_OP_SLOTS_IMM '(' LITERAL ',' IDENTIFIER ')'	{
+			($$).name = $3;
+			($$).oper = OP_NONE;
+			($$).super_first = 0;
+			($$).super_second = 0;
+			($$).slots_base = $5;
+			($$).slots_imm = 1;
 		}
 	;
 
@@ -1364,6 +1451,20 @@ genops_parseargs(int argc, char *argv[])
 		{
 			genops_task = TASK_GEN_TABLE;
 		}
+		else if((!strcmp(argv[current], "-S") ||
+			 !strcmp(argv[current], "--super")) &&
+			current < argc - 2)
+		{
+			genops_task = TASK_GEN_SUPER;
+			genops_interp_filename = argv[++current];
+		}
+		else if((!strcmp(argv[current], "-L") ||
+			 !strcmp(argv[current], "--slots")) &&
+			current < argc - 2)
+		{
+			genops_task = TASK_GEN_SLOTS;
+			genops_interp_filename = argv[++current];
+		}
 		else if(!strcmp(argv[current], "--help"))
 		{
 			return 1;
@@ -1571,6 +1672,66 @@ genops_output_intrinsic_table(const char *define_start)
 	printf("};\n");
 }
 
+static void
+genops_output_super_table(const char *define_start)
+{
+	struct genops_opcode *current;
+	char *upper_name;
+
+	printf("%s = {\n", genops_super_decl);
+	current = opcode_header->first_opcode;
+	while(current)
+	{
+		if(current->super_first)
+		{
+			upper_name = genops_string_upper(current->name);
+			if(upper_name == 0)
+			{
+				/* Out of memory */
+				perror(genops_filename);
+				exit(1);
+			}
+			printf("\t{%s, %s, %s%s},\n",
+			       current->super_first, current->super_second,
+			       define_start, upper_name);
+			free(upper_name);
+		}
+		current = current->next;
+	}
+	printf("\t{0, 0, 0}\n");
+	printf("};\n");
+}
+
+static void
+genops_output_slots_table(const char *define_start)
+{
+	struct genops_opcode *current;
+	char *upper_name;
+
+	printf("%s = {\n", genops_slots_decl);
+	current = opcode_header->first_opcode;
+	while(current)
+	{
+		if(current->slots_base)
+		{
+			upper_name = genops_string_upper(current->name);
+			if(upper_name == 0)
+			{
+				/* Out of memory */
+				perror(genops_filename);
+				exit(1);
+			}
+			printf("\t{%s, %s%s, %d},\n",
+			       current->slots_base, define_start, upper_name,
+			       current->slots_imm);
+			free(upper_name);
+		}
+		current = current->next;
+	}
+	printf("\t{0, 0, 0}\n");
+	printf("};\n");
+}
+
 static void
 genops_output_opcode_table(const char *filename)
 {
@@ -1586,12 +1747,420 @@ genops_output_opcode_table(const char *filename)
 		printf("\n");
 		genops_output_intrinsic_table(opcode_header->define_start);
 	}
+	if(genops_super_decl)
+	{
+		printf("\n");
+		genops_output_super_table(opcode_header->define_start);
+	}
+	if(genops_slots_decl)
+	{
+		printf("\n");
+		genops_output_slots_table(opcode_header->define_start);
+	}
 	if(end_code_block)
 	{
 		printf("%s", end_code_block);
 	}
 }
 
+/*
+ * Read the whole contents of a file into memory.
+ */
+static char *
+genops_read_file(const char *filename)
+{
+	FILE *file;
+	char *contents;
+	long size;
+
+	file = fopen(filename, "r");
+	if(!file)
+	{
+		perror(filename);
+		exit(1);
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	contents = (char *)malloc(size + 1);
+	if(!contents)
+	{
+		exit(1);
+	}
+	size = fread(contents, 1, size, file);
+	contents[size] = '\0';
+	fclose(file);
+	return contents;
+}
+
+/*
+ * Skip whitespace and comments.
+ */
+static const char *
+genops_skip_space(const char *cp)
+{
+	for(;;)
+	{
+		while(isspace((unsigned char)*cp))
+		{
+			++cp;
+		}
+		if(cp[0] == '/' && cp[1] == '*')
+		{
+			cp = strstr(cp + 2, "*/");
+			if(!cp)
+			{
+				return "";
+			}
+			cp += 2;
+		}
+		else
+		{
+			return cp;
+		}
+	}
+}
+
+/*
+ * Find the body of an opcode in the interpreter source, which has
+ * the form "VMCASE(name): { ... } VMBREAK;".  Several cases may share
+ * the same body.  Returns the opening brace and sets "end" to the
+ * position just past the closing one.
+ */
+static const char *
+genops_find_body(const char *source, const char *name, const char **end)
+{
+	char pattern[256];
+	const char *start;
+	const char *cp;
+	int level;
+
+	snprintf(pattern, sizeof(pattern), "VMCASE(%s):", name);
+	start = strstr(source, pattern);
+	if(!start)
+	{
+		return 0;
+	}
+	cp = genops_skip_space(start + strlen(pattern));
+	while(!strncmp(cp, "VMCASE(", 7))
+	{
+		cp = strchr(cp, ':');
+		if(!cp)
+		{
+			return 0;
+		}
+		cp = genops_skip_space(cp + 1);
+	}
+	if(*cp != '{')
+	{
+		return 0;
+	}
+	start = cp;
+
+	/* Find the matching closing brace, ignoring the contents
+	   of comments and literals */
+	level = 0;
+	while(*cp != '\0')
+	{
+		if(cp[0] == '/' && cp[1] == '*')
+		{
+			cp = strstr(cp + 2, "*/");
+			if(!cp)
+			{
+				return 0;
+			}
+			cp += 2;
+			continue;
+		}
+		if(*cp == '"' || *cp == '\'')
+		{
+			char quote = *cp++;
+			while(*cp != '\0' && *cp != quote)
+			{
+				if(*cp == '\\' && cp[1] != '\0')
+				{
+					++cp;
+				}
+				++cp;
+			}
+			if(*cp != '\0')
+			{
+				++cp;
+			}
+			continue;
+		}
+		if(*cp == '{')
+		{
+			++level;
+		}
+		else if(*cp == '}' && --level == 0)
+		{
+			*end = cp + 1;
+			if(strncmp(genops_skip_space(cp + 1), "VMBREAK;", 8) != 0)
+			{
+				return 0;
+			}
+			return start;
+		}
+		++cp;
+	}
+	return 0;
+}
+
+/*
+ * Determine if the body of an opcode always continues with the
+ * following instruction.  Only such an opcode may start a
+ * superinstruction.
+ */
+static int
+genops_body_falls_through(const char *start, const char *end)
+{
+	static const char * const jumps[] = {
+		"VMBREAK", "goto", "pc =", "VM_BR_TARGET", "VM_PERFORM_TAIL", 0
+	};
+	const char *cp;
+	int index;
+
+	for(index = 0; jumps[index]; ++index)
+	{
+		cp = strstr(start, jumps[index]);
+		if(cp && cp < end)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Output the interpreter cases for the superinstructions.  The body
+ * of a superinstruction is the body of its first opcode followed by
+ * the body of the second one.  The first opcode leaves the program
+ * counter at the second one, whose arguments remain in place.
+ */
+static void
+genops_output_super_cases(const char *filename)
+{
+	struct genops_opcode *current;
+	const char *source;
+	const char *first_start;
+	const char *first_end;
+	const char *second_start;
+	const char *second_end;
+	char *upper_name;
+
+	source = genops_read_file(genops_interp_filename);
+	printf("/%c Automatically generated from %s and %s - DO NOT EDIT %c/\n",
+		   '*', filename, genops_interp_filename, '*');
+	current = opcode_header->first_opcode;
+	while(current)
+	{
+		if(!current->super_first)
+		{
+			current = current->next;
+			continue;
+		}
+		first_start = genops_find_body(source, current->super_first,
+					       &first_end);
+		second_start = genops_find_body(source, current->super_second,
+						&second_end);
+		if(!first_start || !second_start)
+		{
+			fprintf(stderr, "%s: no interpreter code for %s\n",
+				genops_interp_filename,
+				first_start ? current->super_second
+					    : current->super_first);
+			exit(1);
+		}
+		if(!genops_body_falls_through(first_start, first_end))
+		{
+			fprintf(stderr, "%s: %s does not continue with the next "
+				"instruction\n", genops_interp_filename,
+				current->super_first);
+			exit(1);
+		}
+		upper_name = genops_string_upper(current->name);
+		if(upper_name == 0)
+		{
+			/* Out of memory */
+			perror(genops_filename);
+			exit(1);
+		}
+		printf("\n\t\tVMCASE(%s%s):\n", opcode_header->define_start,
+		       upper_name);
+		printf("\t\t{\n");
+		printf("\t\t/* %s */\n", current->super_first);
+		printf("\t\t%.*s\n", (int)(first_end - first_start), first_start);
+		printf("\t\t/* %s */\n", current->super_second);
+		printf("\t\t%.*s\n", (int)(second_end - second_start),
+		       second_start);
+		printf("\t\t}\n");
+		printf("\t\tVMBREAK;\n");
+		free(upper_name);
+		current = current->next;
+	}
+}
+
+/*
+ * Get the C type and the register suffix for the value flags
+ * of a slot opcode operand.
+ */
+static int
+genops_slot_type(int flags, const char **type, const char **reg)
+{
+	switch(flags)
+	{
+		case VALUE_FLAG_INT:
+		{
+			*type = "jit_int";
+			*reg = "INT";
+		}
+		return 1;
+
+		case VALUE_FLAG_LONG:
+		{
+			*type = "jit_long";
+			*reg = "LONG";
+		}
+		return 1;
+
+		case VALUE_FLAG_FLOAT32:
+		{
+			*type = "jit_float32";
+			*reg = "FLOAT32";
+		}
+		return 1;
+
+		case VALUE_FLAG_FLOAT64:
+		{
+			*type = "jit_float64";
+			*reg = "FLOAT64";
+		}
+		return 1;
+
+		case VALUE_FLAG_NFLOAT:
+		{
+			*type = "jit_nfloat";
+			*reg = "NFLOAT";
+		}
+		return 1;
+
+		case VALUE_FLAG_PTR:
+		{
+			*type = "void *";
+			*reg = "PTR";
+		}
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Output the interpreter cases for the slot opcodes.  A slot opcode
+ * is followed by a word for each of its operands, in the order dest,
+ * value1 and value2, which holds the position of the operand in the
+ * frame or the immediate value of value2.  The operands are moved to
+ * and from the registers around the body of the base opcode.  A branch
+ * has no dest, and its target follows the operands.
+ */
+static void
+genops_output_slots_cases(const char *filename)
+{
+	struct genops_opcode *current;
+	const char *source;
+	const char *start;
+	const char *end;
+	const char *dest_type;
+	const char *dest_reg;
+	const char *type;
+	const char *reg;
+	char *upper_name;
+	int is_branch;
+	int num_words;
+
+	source = genops_read_file(genops_interp_filename);
+	printf("/%c Automatically generated from %s and %s - DO NOT EDIT %c/\n",
+		   '*', filename, genops_interp_filename, '*');
+	current = opcode_header->first_opcode;
+	while(current)
+	{
+		if(!current->slots_base)
+		{
+			current = current->next;
+			continue;
+		}
+		start = genops_find_body(source, current->slots_base, &end);
+		if(!start)
+		{
+			fprintf(stderr, "%s: no interpreter code for %s\n",
+				genops_interp_filename, current->slots_base);
+			exit(1);
+		}
+		is_branch = ((current->type & OP_TYPE_BRANCH) != 0);
+		if(is_branch ? current->dest_flags != VALUE_FLAG_EMPTY
+			     : !genops_body_falls_through(start, end))
+		{
+			fprintf(stderr, "%s: %s cannot be used with frame slots\n",
+				genops_interp_filename, current->slots_base);
+			exit(1);
+		}
+		if(current->input1_flags == VALUE_FLAG_EMPTY ||
+		   (current->slots_imm &&
+		    current->input2_flags != VALUE_FLAG_INT &&
+		    current->input2_flags != VALUE_FLAG_LONG))
+		{
+			fprintf(stderr, "%s: invalid operands for %s\n",
+				genops_filename, current->name);
+			exit(1);
+		}
+		upper_name = genops_string_upper(current->name);
+		if(upper_name == 0)
+		{
+			/* Out of memory */
+			perror(genops_filename);
+			exit(1);
+		}
+		printf("\n\t\tVMCASE(%s%s):\n", opcode_header->define_start,
+		       upper_name);
+		printf("\t\t{\n");
+		num_words = 0;
+		if(genops_slot_type(current->dest_flags, &dest_type, &dest_reg))
+		{
+			printf("\t\t\tslot_dest = VM_SLOT(%d);\n", ++num_words);
+		}
+		if(genops_slot_type(current->input1_flags, &type, &reg))
+		{
+			printf("\t\t\tVM_R1_%s = *((%s *)VM_SLOT(%d));\n",
+			       reg, type, ++num_words);
+		}
+		if(genops_slot_type(current->input2_flags, &type, &reg))
+		{
+			if(current->slots_imm)
+			{
+				printf("\t\t\tVM_R2_%s = VM_IMM(%s, %d);\n",
+				       reg, type, ++num_words);
+			}
+			else
+			{
+				printf("\t\t\tVM_R2_%s = *((%s *)VM_SLOT(%d));\n",
+				       reg, type, ++num_words);
+			}
+		}
+		printf("\t\t\tVM_MODIFY_PC(%d);\n", num_words);
+		printf("\t\t/* %s */\n", current->slots_base);
+		printf("\t\t%.*s\n", (int)(end - start), start);
+		if(genops_slot_type(current->dest_flags, &dest_type, &dest_reg))
+		{
+			printf("\t\t\t*((%s *)slot_dest) = VM_R0_%s;\n",
+			       dest_type, dest_reg);
+		}
+		printf("\t\t}\n");
+		printf("\t\tVMBREAK;\n");
+		free(upper_name);
+		current = current->next;
+	}
+}
+
 #define USAGE \
 "Usage: %s option file\n" \
 "Generates an opcode header or table from opcode definitions\n" \
@@ -1599,8 +2168,15 @@ genops_output_opcode_table(const char *filename)
 "Options:\n" \
 "  -H, --header\tgenerate a header file\n" \
 "  -T, --table\tgenerate a file with the opcode table\n" \
+"  -S, --super interp-file\n" \
+"\t\tgenerate the interpreter code for the superinstructions\n" \
+"\t\tfrom the opcode bodies in interp-file\n" \
+"  -L, --slots interp-file\n" \
+"\t\tgenerate the interpreter code for the slot opcodes\n" \
+"\t\tfrom the opcode bodies in interp-file\n" \
 "  --help\tdisplay this information\n" \
-"\nExactly one of header or table option must be supplied.\n" \
+"\nExactly one of the header, table, super or slots options must be\n" \
+"supplied.\n" \
 "If file is - standard input is used.\n"
 
 int main(int argc, char *argv[])
@@ -1638,6 +2214,18 @@ int main(int argc, char *argv[])
 			genops_output_opcode_table(genops_filename);
 		}
 		break;
+
+		case TASK_GEN_SUPER:
+		{
+			genops_output_super_cases(genops_filename);
+		}
+		break;
+
+		case TASK_GEN_SLOTS:
+		{
+			genops_output_slots_cases(genops_filename);
+		}
+		break;
 	}
 	return 0;
 }